@@ -127,6 +127,9 @@ public:
   // Structure files
   std::vector<std::string> structureFiles;
 
+  // Directory for binary copies of structure files (disable: "")
+  std::string structCacheDir;
+
   // Static analysis files
   std::vector<std::string> instructionFiles;
 
@@ -142,6 +145,9 @@ public:
 
   bool doNormalizeTy;
 
+  // Number of threads used to read profiles
+  uint prof_jobs;
+
   // -------------------------------------------------------
   // Attribution/Correlation arguments: special
   // -------------------------------------------------------
@@ -205,6 +211,7 @@ public:
   std::string out_db_config;     // disable: "", stdout: "-"
 
   bool db_makeMetricDB;
+  bool db_metricDBSparse;        // metric db uses the sparse format
   bool db_addStructId;
 
   // -------------------------------------------------------
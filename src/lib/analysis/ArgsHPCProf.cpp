@@ -68,6 +68,7 @@ using std::string;
 
 //*************************** User Include Files ****************************
 #include <dirent.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 
 #include <include/hpctoolkit-config.h>
@@ -119,6 +120,12 @@ Options: General:\n\
   -h, --help           Print this help.\n\
   --debug [<n>]        Debug: use debug level <n>. {1}\n\
 \n\
+Options: Parallel usage:\n\
+  -j <num>, --jobs <num>\n\
+                       Use <num> threads to read measurement files. For\n\
+                       hpcprof-mpi, this is the number of threads per\n\
+                       process. {1}\n\
+\n\
 Options: Source Code and Static Structure:\n\
   --name <name>, --title <name>\n\
                        Set the database's name (title) to <name>.\n\
@@ -129,6 +136,12 @@ Options: Source Code and Static Structure:\n\
   -S <file>, --structure <file>\n\
                        Use hpcstruct structure file <file> for correlation.\n\
                        May pass multiple times (e.g., for shared libraries).\n\
+  --struct-cache <dir>\n\
+                       Read a binary copy of each structure file from <dir>\n\
+                       instead of parsing its XML, and write one there when\n\
+                       there is none (or it is older than the file).\n\
+                       Defaults to the value of HPCTOOLKIT_HPCSTRUCT_CACHE,\n\
+                       if set; otherwise no copies are read or written.\n\
   -R '<old-path>=<new-path>', --replace-path '<old-path>=<new-path>'\n\
                        Substitute instances of <old-path> with <new-path>;\n\
                        apply to all paths (profile's load map, source code)\n\
@@ -148,6 +161,12 @@ Options: Metrics:\n\
                        hpcprof-mpi does not compute 'thread'.\n\
   --force-metric       Force hpcprof to show all thread-level metrics,\n\
                        regardless of their number.\n\
+  --stream             hpcprof: merge the profiles' call path trees first,\n\
+                       then read each profile again to accumulate summary\n\
+                       metrics (and the thread-level metric database),\n\
+                       one profile at a time. Memory use is bounded by\n\
+                       the merged tree rather than the number of\n\
+                       profiles. Does not compute 'thread' metrics.\n\
 \n\
 Options: Output:\n\
   -o <db-path>, --db <db-path>, --output <db-path>\n\
@@ -155,9 +174,12 @@ Options: Output:\n\
                        {./" Analysis_DB_DIR "}";
 
 static const char* usage_details_2 = "\n\
-  --metric-db <yes|no>\n\
+  --metric-db <yes|no|sparse>\n\
                        Control whether to generate a thread-level metric\n\
-                       value database for hpcviewer scatter plots. {no}";
+                       value database for hpcviewer scatter plots. 'sparse'\n\
+                       writes only non-zero values, in a compressed-row\n\
+                       format with a per-file node index; hpcprof supports\n\
+                       only 'sparse'. {no}";
 
 static const char* usage_details_3 = "\n\
   --remove-redundancy \n\
@@ -180,6 +202,10 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
   {  0 , "agent-pthread",   CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
 
+  // Parallel usage
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+
   // Source Code and Static Structure
   {  0 , "name",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
      NULL },
@@ -190,6 +216,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   { 'S', "structure",       CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL },
+  {  0 , "struct-cache",    CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   { 'R', "replace-path",    CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL},
 
@@ -201,6 +229,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   {  0 , "force-metric",    CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "stream",          CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
+     NULL },
 
   // Output options
   { 'o', "output",          CLP::ARG_REQ , CLP::DUPOPT_CLOB, NULL,
@@ -243,6 +273,7 @@ ArgsHPCProf::ArgsHPCProf()
   prof_metrics = Analysis::Args::MetricFlg_StatsSum;
 
   db_makeMetricDB = false;
+  db_metricDBSparse = false;
   remove_redundancy = false;
 }
 
@@ -392,6 +423,16 @@ ArgsHPCProf::parse(int argc, const char* const argv[], AppType type)
       agent = "agent-pthread";
     }
 
+    // Check for other options: Parallel usage
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      long jobs = CmdLineParser::toLong(arg);
+      if (jobs < 1) {
+	ARG_ERROR("--jobs/-j option: number of jobs must be positive");
+      }
+      prof_jobs = (uint)jobs;
+    }
+
     // Check for other options: Source code and static structure
     if (parser.isOpt("name")) {
       title = parser.getOptArg("name");
@@ -414,6 +455,15 @@ ArgsHPCProf::parse(int argc, const char* const argv[], AppType type)
       string str = parser.getOptArg("structure");
       StrUtil::tokenize_str(str, CLP_SEPARATOR, structureFiles);
     }
+    if (parser.isOpt("struct-cache")) {
+      structCacheDir = parser.getOptArg("struct-cache");
+    }
+    else {
+      const char* env = getenv("HPCTOOLKIT_HPCSTRUCT_CACHE");
+      if (env != NULL) {
+	structCacheDir = env;
+      }
+    }
     if (parser.isOpt("normalize")) { 
       const string& arg = parser.getOptArg("normalize");
       doNormalizeTy = parseArg_norm(arg, "--normalize/-N option");
@@ -451,7 +501,8 @@ ArgsHPCProf::parse(int argc, const char* const argv[], AppType type)
 	parseArg_metric(metricVec[i], "--metric/-M option");
       }
     }
-    // N.B.: hpcprof checks for "force-metric": src/tool/hpcprof/Args.cpp
+    // N.B.: hpcprof checks for "force-metric" and "stream":
+    // src/tool/hpcprof/Args.cpp
     
     // Check for other options: Output options
     bool isDbDirSet = false;
@@ -465,7 +516,14 @@ ArgsHPCProf::parse(int argc, const char* const argv[], AppType type)
     }
     if (parser.isOpt("metric-db")) {
       const string& arg = parser.getOptArg("metric-db");
-      db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      if (arg == "sparse") {
+	db_makeMetricDB = true;
+	db_metricDBSparse = true;
+      }
+      else {
+	db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+	db_metricDBSparse = false;
+      }
     }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
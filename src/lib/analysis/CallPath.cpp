@@ -71,8 +71,15 @@ using std::string;
 #include <climits>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <vector>
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #include <typeinfo>
 
 #include <sys/stat.h>
@@ -95,6 +102,10 @@ using std::string;
 #include <lib/profxml/XercesUtil.hpp>
 #include <lib/profxml/PGMReader.hpp>
 
+#include <lib/prof/FileError.hpp>
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrun-metric.h>
 
 #include <lib/binutils/LM.hpp>
@@ -104,6 +115,7 @@ using std::string;
 using namespace xml;
 
 #include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
 #include <lib/support/Logic.hpp>
 #include <lib/support/IOUtil.hpp>
 #include <lib/support/StrUtil.hpp>
@@ -131,38 +143,174 @@ namespace Analysis {
 
 namespace CallPath {
 
+// ProfileReader: Reads a list of profiles with a pool of worker
+// threads and hands them out strictly in list order.  Workers run at
+// most 'm_window' files ahead of the consumer, which bounds the
+// number of unmerged profiles held in memory.
+//
+// N.B.: Merging stays serial and in order: Profile::merge() is not
+// associative with respect to metric groups (Merge_MergeMetricByName)
+// and, with CCT::MrgFlg_NormalizeTraceFileY, rewrites each trace file
+// relative to the accumulated profile.
+class ProfileReader {
+public:
+  ProfileReader(const Util::StringVec& profileFiles,
+		const Util::UIntVec* groupMap, uint rFlags, uint numJobs)
+    : m_files(profileFiles), m_groupMap(groupMap), m_rFlags(rFlags),
+      m_profs(profileFiles.size(), NULL),
+      m_errs(profileFiles.size()),
+      m_isDone(profileFiles.size(), false),
+      m_next(0), m_consumed(0), m_window(2 * numJobs)
+  {
+    for (uint i = 0; i < numJobs; ++i) {
+      m_workers.push_back(std::thread(&ProfileReader::work, this));
+    }
+  }
+
+  ~ProfileReader()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_next = m_files.size(); // stop handing out work
+    }
+    m_cv.notify_all();
+
+    for (uint i = 0; i < m_workers.size(); ++i) {
+      m_workers[i].join();
+    }
+
+    // profiles not taken by the consumer (e.g., after an error)
+    for (uint i = m_consumed; i < m_profs.size(); ++i) {
+      delete m_profs[i];
+    }
+  }
+
+  // get: Returns the i-th profile, blocking until it has been read.
+  // Profiles must be requested in order.  Rethrows any error raised
+  // while reading the profile.
+  Prof::CallPath::Profile*
+  get(uint i)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [&] { return m_isDone[i]; });
+
+    m_consumed = i + 1;
+    Prof::CallPath::Profile* prof = m_profs[i];
+    std::exception_ptr err = m_errs[i];
+    lock.unlock();
+    m_cv.notify_all(); // window advanced
+
+    if (err) {
+      std::rethrow_exception(err);
+    }
+    return prof;
+  }
+
+private:
+  void
+  work()
+  {
+    while (true) {
+      uint i;
+      {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [&] {
+	    return (m_next >= m_files.size()
+		    || m_next < m_consumed + m_window); });
+	if (m_next >= m_files.size()) {
+	  return;
+	}
+	i = m_next++;
+      }
+
+      uint groupId = (m_groupMap) ? (*m_groupMap)[i] : 0;
+      Prof::CallPath::Profile* prof = NULL;
+      std::exception_ptr err;
+      try {
+	prof = read(m_files[i], groupId, m_rFlags);
+      }
+      catch (...) {
+	err = std::current_exception();
+      }
+
+      {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_profs[i] = prof;
+	m_errs[i] = err;
+	m_isDone[i] = true;
+      }
+      m_cv.notify_all();
+    }
+  }
+
+  const Util::StringVec& m_files;
+  const Util::UIntVec* m_groupMap;
+  uint m_rFlags;
+
+  std::vector<Prof::CallPath::Profile*> m_profs;
+  std::vector<std::exception_ptr> m_errs;
+  std::vector<bool> m_isDone;
+
+  uint m_next;     // next file to read
+  uint m_consumed; // number of profiles taken by the consumer
+  uint m_window;   // max number of files read ahead of the consumer
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<std::thread> m_workers;
+};
+
 
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags, uint mrgFlags)
+     int mergeTy, uint rFlags, uint mrgFlags, uint numJobs)
 {
   // Special case
   if (profileFiles.empty()) {
     Prof::CallPath::Profile* prof = Prof::CallPath::Profile::make(rFlags);
     return prof;
   }
-  
+
   // General case
-  uint groupId = (groupMap) ? (*groupMap)[0] : 0;
-  Prof::CallPath::Profile* prof = read(profileFiles[0], groupId, rFlags);
+  ProfileReader* reader = NULL;
+  if (numJobs > 1 && profileFiles.size() > 1) {
+    numJobs = std::min<uint>(numJobs, profileFiles.size());
+    reader = new ProfileReader(profileFiles, groupMap, rFlags, numJobs);
+  }
+
+  auto readProfile = [&](uint i) {
+    if (reader) {
+      return reader->get(i);
+    }
+    uint groupId = (groupMap) ? (*groupMap)[i] : 0;
+    return read(profileFiles[i], groupId, rFlags);
+  };
+
+  // N.B.: the merge stays serial and in file order rather than a tree
+  // reduction: Profile::merge() with Merge_MergeMetricByName is not
+  // associative across differing metric sets, and
+  // MrgFlg_NormalizeTraceFileY renumbers each trace against the
+  // accumulated profile.
+  std::unique_ptr<ProfileReader> readerOwner(reader);
+  std::unique_ptr<Prof::CallPath::Profile> prof(readProfile(0));
 
   // add the directory into the set of directories
   prof->addDirectory(profileFiles[0]);
 
   for (uint i = 1; i < profileFiles.size(); ++i) {
-    groupId = (groupMap) ? (*groupMap)[i] : 0;
-    Prof::CallPath::Profile* p = read(profileFiles[i], groupId, rFlags);
+    std::unique_ptr<Prof::CallPath::Profile> p(readProfile(i));
     prof->merge(*p, mergeTy, mrgFlags);
 
     prof->metricMgr()->mergePerfEventStatistics(p->metricMgr());
-    delete p;
 
     // add the directory into the set of directories
     prof->addDirectory(profileFiles[i]);
   }
+  readerOwner.reset();
+
   prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
   
-  return prof;
+  return prof.release();
 }
 
 
@@ -206,7 +354,8 @@ readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args)
   DocHandlerArgs docargs(&RealPathMgr::singleton());
 
   Prof::Struct::readStructure(*structure, args.structureFiles,
-			      PGMDocHandler::Doc_STRUCT, docargs);
+			      PGMDocHandler::Doc_STRUCT, docargs,
+			      args.structCacheDir);
 
   // BAnal::Struct::makeStructure() creates a Struct::Tree that
   // distinguishes between non-call-site statements and call site
@@ -583,6 +732,182 @@ noteStaticStructureOnLeaves(Prof::CallPath::Profile& prof)
 }
 
 
+void
+Analysis::CallPath::
+readMergeProfile(Prof::CallPath::Profile& profGbl,
+		 const string& profileFile, uint groupId, uint groupMax,
+		 int mergeFlg, bool doAggregate, uint& mBeg, uint& mEnd)
+{
+  Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
+  Prof::CCT::ANode* cctRootGbl = profGbl.cct()->root();
+
+  // -------------------------------------------------------
+  // read profile file
+  // -------------------------------------------------------
+  uint rFlags = (Prof::CallPath::Profile::RFlg_NoMetricSfx
+		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
+  uint rGroupId = (groupMax > 1) ? groupId : 0;
+
+  Prof::CallPath::Profile* prof =
+    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
+
+  // -------------------------------------------------------
+  // merge into canonical CCT
+  // -------------------------------------------------------
+  int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
+
+  // Add *some* structure information to the leaves of 'prof' so that
+  // it will be merged successfully with the structured canonical CCT
+  // 'profGbl'.
+  //
+  // Background: When CCT::Stmts are merged in
+  // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
+  // information is not retained.  This means that when merging 'prof'
+  // into 'profGbl' (using CallPath::Profile::merge()), many leaves in
+  // 'prof' will not find their corresponding node in 'profGbl' unless
+  // corrective measures are taken.
+  prof->structure(profGbl.structure());
+  noteStaticStructureOnLeaves(*prof);
+  prof->structure(NULL);
+
+  mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
+  mEnd = mBeg + prof->metricMgr()->size();        //  open end)
+
+  delete prof;
+
+  if (!doAggregate) {
+    return;
+  }
+
+  // -------------------------------------------------------
+  // compute local incl/excl sampled metrics
+  // -------------------------------------------------------
+  VMAIntervalSet ivalsetIncl;
+  VMAIntervalSet ivalsetExcl;
+
+  for (uint mId = mBeg; mId < mEnd; ++mId) {
+    Prof::Metric::ADesc* m = mMgrGbl->metric(mId);
+    if (m->type() == Prof::Metric::ADesc::TyIncl) {
+      ivalsetIncl.insert(VMAInterval(mId, mId + 1)); // [ )
+    }
+    else if (m->type() == Prof::Metric::ADesc::TyExcl) {
+      ivalsetExcl.insert(VMAInterval(mId, mId + 1)); // [ )
+    }
+  }
+
+  cctRootGbl->aggregateMetricsIncl(ivalsetIncl);
+  cctRootGbl->aggregateMetricsExcl(ivalsetExcl);
+}
+
+
+uint
+Analysis::CallPath::
+makeSummaryMetricDescs(Prof::CallPath::Profile& profGbl, bool needAllStats,
+		       std::vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
+		       const std::vector<uint>* groupIdToGroupSizeMap,
+		       uint& mDrvdBeg, uint& mDrvdEnd)
+{
+  Prof::Metric::Mgr& mMgrGbl = *(profGbl.metricMgr());
+
+  uint mSrcBeg = 0, mSrcEnd = mMgrGbl.size(); // [ )
+
+  uint numDrvd = 0;
+  mDrvdBeg = mDrvdEnd = 0; // [ )
+
+  mDrvdBeg = mMgrGbl.makeSummaryMetricsIncr(needAllStats, mSrcBeg, mSrcEnd);
+  if (mDrvdBeg != Prof::Metric::Mgr::npos) {
+    mDrvdEnd = mMgrGbl.size();
+    numDrvd = (mDrvdEnd - mDrvdBeg);
+  }
+
+  for (uint i = mSrcBeg; i < mSrcEnd; ++i) {
+    Prof::Metric::ADesc* m = mMgrGbl.metric(i);
+    m->visibility(HPCRUN_FMT_METRIC_HIDE);
+    m->isTemporary(true);
+  }
+
+  for (uint i = mDrvdBeg; i < mDrvdEnd; ++i) {
+    Prof::Metric::ADesc* m = mMgrGbl.metric(i);
+
+    uint groupId = 1; // default group-id
+
+    // find groupId embedded in metric descriptor name
+    const string& nmPfx = m->namePfx();
+    if (!nmPfx.empty()) {
+      groupId = (uint)StrUtil::toUInt64(nmPfx);
+    }
+    DIAG_Assert(groupId > 0, DIAG_UnexpectedInput);
+    DIAG_Assert(groupId < groupIdToGroupMetricsMap.size(), DIAG_UnexpectedInput);
+
+    // set the number of inputs
+    if (groupIdToGroupSizeMap) {
+      Prof::Metric::DerivedIncrDesc* mm =
+	dynamic_cast<Prof::Metric::DerivedIncrDesc*>(m);
+      DIAG_Assert(mm, DIAG_UnexpectedInput);
+
+      uint numInputs = (*groupIdToGroupSizeMap)[groupId]; // / <n> TODO:threads
+      if (mm->expr()) {
+        mm->expr()->numSrcFxd(numInputs);
+      }
+    }
+
+    // populate groupIdToGroupMetricsMap map
+    VMAIntervalSet*& ivalset = groupIdToGroupMetricsMap[groupId];
+    if (!ivalset) {
+      ivalset = new VMAIntervalSet;
+    }
+    ivalset->insert(i, i + 1); // [ )
+  }
+
+  return numDrvd;
+}
+
+
+void
+Analysis::CallPath::
+makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
+		       const string& profileFile, uint groupId, uint groupMax,
+		       const std::vector<VMAIntervalSet*>& groupIdToGroupMetricsMap)
+{
+  Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
+  Prof::CCT::ANode* cctRootGbl = profGbl.cct()->root();
+
+  // -------------------------------------------------------
+  // merge into canonical CCT and compute local incl/excl sampled metrics
+  // -------------------------------------------------------
+  uint mBeg, mEnd; // [ )
+  readMergeProfile(profGbl, profileFile, groupId, groupMax,
+		   Prof::CCT::MrgFlg_AssertCCTMergeOnly, true/*doAggregate*/,
+		   mBeg, mEnd);
+
+  // -------------------------------------------------------
+  // update local derived metrics
+  // -------------------------------------------------------
+  const VMAIntervalSet* ivalsetDrvd = groupIdToGroupMetricsMap[groupId];
+  if (ivalsetDrvd) {
+    DIAG_Assert(ivalsetDrvd->size() == 1, DIAG_UnexpectedInput);
+    const VMAInterval& ival = *(ivalsetDrvd->begin());
+    uint mDrvdBeg = (uint)ival.beg();
+    uint mDrvdEnd = (uint)ival.end();
+
+    cctRootGbl->computeMetricsIncr(*mMgrGbl, mDrvdBeg, mDrvdEnd,
+				   Prof::Metric::AExprIncr::FnAccum);
+  }
+
+  // -------------------------------------------------------
+  // reinitialize metric values for next time
+  // -------------------------------------------------------
+
+  // TODO: This really should (a) come immediately after the MetricMgr
+  // merge above and (b) use FnInitSrc (not 0).  However, to do this
+  // we would need to (a) split the MetricMgr merge and CCT merge into
+  // two; and (b) use a CCT init (which whould initialize using
+  // assignment) instead of CCT::merge() (which initializes based on
+  // addition against 0).
+  cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
+}
+
+
 //
 // overlayStaticStructure: Create frames for CCT::Call and CCT::Stmt
 // nodes using a preorder walk over the CCT.
@@ -1256,6 +1581,10 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
     oFlags |= CCT::Tree::OFlg_StructId;
   }
 
+  if (args.db_makeMetricDB && args.db_metricDBSparse) {
+    oFlags |= CCT::Tree::OFlg_SparseMetricDB;
+  }
+
   uint metricBegId = 0;
   uint metricEndId = prof.metricMgr()->size();
 
@@ -1299,6 +1628,111 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
   os.flush();
 }
 
+
+
+string
+makeMetricDBFileName(const string& dbDir, uint groupId,
+		     const string& profileFile, bool isSparse)
+{
+  string grpStr = StrUtil::toStr(groupId);
+
+  string fnm_base = FileUtil::rmSuffix(FileUtil::basename(profileFile.c_str()));
+
+  const char* sfx = (isSparse) ? HPCPROF_SparseMetricDBSfx : HPCPROF_MetricDBSfx;
+  string fnm = grpStr + "." + fnm_base + "." + sfx;
+
+  return dbDir + "/" + fnm;
+}
+
+
+void
+writeSparseMetricDB(const Prof::CallPath::Profile& prof,
+		    uint mBegId, uint mEndId, const string& fnm)
+{
+  const Prof::CCT::Tree& cct = *prof.cct();
+
+  uint numNodes = cct.maxDenseId();
+  uint numMetrics = mEndId - mBegId;
+
+  DIAG_Assert(numMetrics <= HPCMETRICDB_SPARSE_FMT_MaxMetrics,
+	      "writeSparseMetricDB: too many metrics: " << numMetrics);
+
+  // -------------------------------------------------------
+  // gather non-zero values as compressed rows, in node id order
+  // -------------------------------------------------------
+  std::vector<Prof::CCT::ANode*> nodes(numNodes + 1, NULL);
+  for (Prof::CCT::ANodeIterator it(cct.root()); it.Current(); ++it) {
+    Prof::CCT::ANode* n = it.current();
+    nodes[n->id()] = n;
+  }
+
+  std::vector<hpcmetricDB_sparse_fmt_row_t> rows;
+  std::vector<hpcmetricDB_sparse_fmt_value_t> vals;
+
+  for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
+    const Prof::CCT::ANode* n = nodes[nodeId];
+    if (!n) {
+      continue;
+    }
+
+    size_t rowBeg = vals.size();
+    for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
+      if (n->hasMetricSlow(mId2)) {
+	hpcmetricDB_sparse_fmt_value_t v;
+	v.metricId = (uint16_t)mId1;
+	v.value = n->metric(mId2);
+	vals.push_back(v);
+      }
+    }
+
+    if (vals.size() > rowBeg) {
+      hpcmetricDB_sparse_fmt_row_t r;
+      r.nodeId = nodeId;
+      r.valueIdx = rowBeg;
+      rows.push_back(r);
+    }
+  }
+
+  hpcmetricDB_sparse_fmt_row_t sentinel;
+  sentinel.nodeId = numNodes + 1;
+  sentinel.valueIdx = vals.size();
+  rows.push_back(sentinel);
+
+  // -------------------------------------------------------
+  // write data
+  // -------------------------------------------------------
+  FILE* fs = hpcio_fopen_w(fnm.c_str(), 1);
+  if (!fs) {
+    std::string errorString;
+    hpcrun_getFileErrorString(fnm, errorString);
+    DIAG_Throw("failed opening metric-db file for writing " << errorString);
+  }
+  DIAG_MsgIf(0, "writeSparseMetricDB: " << fnm);
+
+  hpcmetricDB_sparse_fmt_hdr_t hdr;
+  hdr.numNodes   = numNodes;
+  hdr.numMetrics = numMetrics;
+  hdr.numRows    = rows.size() - 1;
+  hdr.numValues  = vals.size();
+
+  int ret = hpcmetricDB_sparse_fmt_hdr_fwrite(&hdr, fs);
+  if (ret == HPCFMT_OK) {
+    ret = hpcmetricDB_sparse_fmt_index_fwrite(rows.data(), rows.size(), fs);
+  }
+  if (ret == HPCFMT_OK) {
+    ret = hpcmetricDB_sparse_fmt_values_fwrite(vals.data(), vals.size(), fs);
+  }
+
+  if (hpcio_fclose(fs) != 0) {
+    ret = HPCFMT_ERR;
+  }
+  if (ret != HPCFMT_OK) {
+    std::string errorString;
+    hpcrun_getFileErrorString(fnm, errorString);
+    DIAG_Throw("failed writing metric-db file " << errorString);
+  }
+}
+
 } // namespace CallPath
 
 } // namespace Analysis
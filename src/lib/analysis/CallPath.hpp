@@ -75,6 +75,7 @@
 #include "Util.hpp"
 
 #include <lib/binutils/LM.hpp>
+#include <lib/binutils/VMAInterval.hpp>
 
 #include <lib/prof/CallPath-Profile.hpp>
 #include <lib/prof/Struct-Tree.hpp>
@@ -94,9 +95,12 @@ extern std::ostream* dbgOs; // for parallel debugging
 //
 // ---------------------------------------------------------
 
+// read: Read and merge 'profileFiles'.  If 'numJobs' > 1, the files
+// are read by a pool of 'numJobs' threads; they are still merged in
+// the order given, so the result is identical to a serial read.
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags = 0, uint mrgFlags = 0);
+     int mergeTy, uint rFlags = 0, uint mrgFlags = 0, uint numJobs = 1);
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags = 0);
@@ -149,6 +153,42 @@ overlayStaticStructure(Prof::CallPath::Profile& prof,
 void
 noteStaticStructureOnLeaves(Prof::CallPath::Profile& prof);
 
+
+// ---------------------------------------------------------
+// Metrics of a canonical CCT, one profile at a time (hpcprof-mpi and
+// hpcprof --stream).  'profGbl' is the canonical CCT, with structure
+// and canonical ids.
+// ---------------------------------------------------------
+
+// readMergeProfile: Reads 'profileFile' and merges it into 'profGbl'
+// with CCT merge flags 'mergeFlg'; if 'doAggregate', also computes its
+// inclusive and exclusive values there.  Its metrics are [mBeg, mEnd)
+// of 'profGbl'.
+void
+readMergeProfile(Prof::CallPath::Profile& profGbl,
+		 const string& profileFile, uint groupId, uint groupMax,
+		 int mergeFlg, bool doAggregate, uint& mBeg, uint& mEnd);
+
+// makeSummaryMetricDescs: Makes the incremental summary metrics of the
+// (hidden) source metrics of 'profGbl', which are [mDrvdBeg, mDrvdEnd),
+// and records them in 'groupIdToGroupMetricsMap' by measurement group.
+// If 'groupIdToGroupSizeMap' is given, it sets the number of inputs of
+// each summary metric.  Returns the number of summary metrics.
+uint
+makeSummaryMetricDescs(Prof::CallPath::Profile& profGbl, bool needAllStats,
+		       std::vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
+		       const std::vector<uint>* groupIdToGroupSizeMap,
+		       uint& mDrvdBeg, uint& mDrvdEnd);
+
+// makeSummaryMetrics_Lcl: Reads 'profileFile', merges it into 'profGbl'
+// and accumulates it into the summary metrics of its group.  Each
+// profile's CCT must be a subset of 'profGbl', which therefore must
+// not be pruned.
+void
+makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
+		       const string& profileFile, uint groupId, uint groupMax,
+		       const std::vector<VMAIntervalSet*>& groupIdToGroupMetricsMap);
+
 void
 pruneBySummaryMetrics(Prof::CallPath::Profile& prof, uint8_t* prunedNodes);
 
@@ -178,6 +218,20 @@ void
 makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args);
 
 
+// makeMetricDBFileName: Returns the path of the thread-level metric-db
+// file for 'profileFile' within database directory 'dbDir'.
+string
+makeMetricDBFileName(const string& dbDir, uint groupId,
+		     const string& profileFile, bool isSparse);
+
+// writeSparseMetricDB: Writes the non-zero values of metrics [mBegId,
+// mEndId) of every CCT node (by dense id) to the sparse metric-db file
+// 'fnm'.  Assumes dense ids have been assigned.
+void
+writeSparseMetricDB(const Prof::CallPath::Profile& prof,
+		    uint mBegId, uint mEndId, const string& fnm);
+
+
 } // namespace CallPath
 
 } // namespace Analysis
@@ -63,6 +63,8 @@
 #include <string>
 using std::string;
 
+#include <vector>
+
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
@@ -96,6 +98,9 @@ Analysis::Raw::writeAsText(/*destination,*/ const char* filenm)
   else if (ty == ProfType_CallpathMetricDB) {
     writeAsText_callpathMetricDB(filenm);
   }
+  else if (ty == ProfType_CallpathMetricDBSparse) {
+    writeAsText_callpathMetricDBSparse(filenm);
+  }
   else if (ty == ProfType_CallpathTrace) {
     writeAsText_callpathTrace(filenm);
   }
@@ -166,6 +171,61 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 }
 
 
+void
+Analysis::Raw::writeAsText_callpathMetricDBSparse(const char* filenm)
+{
+  if (!filenm) { return; }
+
+  try {
+    FILE* fs = hpcio_fopen_r(filenm);
+    if (!fs) {
+      DIAG_Throw("error opening metric-db file '" << filenm << "'");
+    }
+
+    hpcmetricDB_sparse_fmt_hdr_t hdr;
+    int ret = hpcmetricDB_sparse_fmt_hdr_fread(&hdr, fs);
+    if (ret != HPCFMT_OK) {
+      DIAG_Throw("error reading metric-db file '" << filenm << "'");
+    }
+
+    hpcmetricDB_sparse_fmt_hdr_fprint(&hdr, stdout);
+
+    std::vector<hpcmetricDB_sparse_fmt_row_t> rows(hdr.numRows + 1);
+    ret = hpcmetricDB_sparse_fmt_index_fread(rows.data(), rows.size(), fs);
+    if (ret != HPCFMT_OK) {
+      DIAG_Throw("error reading metric-db file '" << filenm << "'");
+    }
+
+    // values immediately follow the index
+    std::vector<hpcmetricDB_sparse_fmt_value_t> vals(hdr.numMetrics);
+    for (uint r = 0; r < hdr.numRows; ++r) {
+      uint64_t numVals = rows[r + 1].valueIdx - rows[r].valueIdx;
+      if (rows[r + 1].valueIdx < rows[r].valueIdx
+	  || numVals > hdr.numMetrics) {
+	DIAG_Throw("corrupt index in metric-db file '" << filenm << "'");
+      }
+
+      ret = hpcmetricDB_sparse_fmt_values_fread(vals.data(), numVals, fs);
+      if (ret != HPCFMT_OK) {
+	DIAG_Throw("error reading metric-db file '" << filenm << "'");
+      }
+
+      fprintf(stdout, "(%6u: ", rows[r].nodeId);
+      for (uint i = 0; i < numVals; ++i) {
+	fprintf(stdout, "[%u] %g ", vals[i].metricId, vals[i].value);
+      }
+      fprintf(stdout, ")\n");
+    }
+
+    hpcio_fclose(fs);
+  }
+  catch (...) {
+    DIAG_EMsg("While reading '" << filenm << "'...");
+    throw;
+  }
+}
+
+
 void
 Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 {
@@ -64,12 +64,16 @@
 #include <string>
 using std::string;
 
+#include <map>
 #include <algorithm>
 #include <typeinfo>
 
+#include <cerrno>
 #include <cstring> // strlen()
 
 #include <dirent.h> // scandir()
+#include <fcntl.h>  // open()
+#include <unistd.h> // close(), unlink()
 
 //*************************** User Include Files ****************************
 
@@ -83,10 +87,12 @@ using std::string;
 #include <lib/prof-lean/hpcio.h>
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/hpcrun-container.h>
 #include <lib/prof-lean/hpcrunflat-fmt.h>
 
 #include <lib/support/PathFindMgr.hpp>
 #include <lib/support/PathReplacementMgr.hpp>
+#include <lib/support/StrUtil.hpp>
 #include <lib/support/diagnostics.h>
 #include <lib/support/dictionary.h>
 #include <lib/support/realpath.h>
@@ -120,6 +126,59 @@ hpcrunFileFilter(const struct dirent* entry)
 }
 
 
+static int 
+hpcpackFileFilter(const struct dirent* entry)
+{
+  static const string ext = string(".") + HPCRUN_ContainerFnmSfx;
+  static const uint extLen = ext.length();
+
+  return fileExtensionFilter(entry, ext, extLen);
+}
+
+
+static bool
+hasSuffix(const string& nm, const char* sfx)
+{
+  size_t sfxLen = strlen(sfx);
+  return (nm.length() > sfxLen + 1
+	  && nm[nm.length() - sfxLen - 1] == '.'
+	  && nm.compare(nm.length() - sfxLen, sfxLen, sfx) == 0);
+}
+
+
+// Returns the profiles in container 'fnm' as '<fnm>/<member>', sorted
+// by name.  An incomplete container (eg, the process died) is skipped.
+static std::vector<string>
+containerProfilePaths(const string& fnm)
+{
+  std::vector<string> paths;
+
+  FILE* fs = hpcio_fopen_r(fnm.c_str());
+  if (!fs) {
+    DIAG_Throw("could not open container: " << fnm);
+  }
+
+  hpcrun_container_index_t idx;
+  int ret = hpcrun_container_index_fread(&idx, fs, malloc);
+  hpcio_fclose(fs);
+  if (ret != HPCFMT_OK) {
+    DIAG_EMsg("skipping incomplete or corrupt container: " << fnm);
+  }
+  else {
+    for (uint i = 0; i < idx.num_members; ++i) {
+      string nm = idx.members[i].name;
+      if (hasSuffix(nm, HPCRUN_ProfileFnmSfx)) {
+	paths.push_back(fnm + "/" + nm);
+      }
+    }
+  }
+  hpcrun_container_index_free(&idx, free);
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+
 #if 0
 static int 
 hpctraceFileFilter(const struct dirent* entry)
@@ -145,9 +204,15 @@ getProfileType(const std::string& filenm)
   static const int bufSZ = 32;
   char buf[bufSZ] = { '\0' };
 
-  std::istream* is = IOUtil::OpenIStream(filenm.c_str());
-  is->read(buf, bufSZ);
-  IOUtil::CloseStream(is);
+  // N.B.: hpcio_fopen_r also opens container members
+  FILE* fs = hpcio_fopen_r(filenm.c_str());
+  if (!fs) {
+    DIAG_Throw("could not open file: " << filenm);
+  }
+  if (fread(buf, 1, bufSZ, fs) == 0) {
+    buf[0] = '\0';
+  }
+  hpcio_fclose(fs);
   
   ProfType_t ty = ProfType_NULL;
   if (strncmp(buf, HPCRUN_FMT_Magic, HPCRUN_FMT_MagicLen) == 0) {
@@ -156,6 +221,10 @@ getProfileType(const std::string& filenm)
   else if (strncmp(buf, HPCMETRICDB_FMT_Magic, HPCMETRICDB_FMT_MagicLen) == 0) {
     ty = ProfType_CallpathMetricDB;
   }
+  else if (strncmp(buf, HPCMETRICDB_SPARSE_FMT_Magic,
+		   HPCMETRICDB_SPARSE_FMT_MagicLen) == 0) {
+    ty = ProfType_CallpathMetricDBSparse;
+  }
   else if (strncmp(buf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen) == 0) {
     ty = ProfType_CallpathTrace;
   }
@@ -208,8 +277,34 @@ normalizeProfileArgs(const StringVec& inPaths)
         }
         free(dirEntries);
       }
+
+      // profiles in containers (hpcrun --container) join the same group
+      dirEntriesSz = scandir(path.c_str(), &dirEntries,
+			     hpcpackFileFilter, alphasort);
+      for (int i = 0; i < dirEntriesSz; ++i) {
+	std::vector<string> members =
+	  containerProfilePaths(path + dirEntries[i]->d_name);
+	free(dirEntries[i]);
+	for (uint j = 0; j < members.size(); ++j) {
+	  out.paths->push_back(members[j]);
+	  out.pathLenMax = std::max(out.pathLenMax, (uint)members[j].length());
+	  out.groupMap->push_back(out.groupMax);
+	}
+      }
+      if (dirEntriesSz > 0) {
+	free(dirEntries);
+      }
       // TODO: collect group
     }
+    else if (hasSuffix(path, HPCRUN_ContainerFnmSfx)) {
+      out.groupMax++; // obtain next group;
+      std::vector<string> members = containerProfilePaths(path);
+      for (uint j = 0; j < members.size(); ++j) {
+	out.paths->push_back(members[j]);
+	out.pathLenMax = std::max(out.pathLenMax, (uint)members[j].length());
+	out.groupMap->push_back(out.groupMax);
+      }
+    }
     else {
       out.groupMax++; // obtain next group;
       out.paths->push_back(path);
@@ -606,17 +701,125 @@ copySourceFile(const string& filenm, const string& dstDir,
 namespace Analysis {
 namespace Util {
 
+// copyMemberInto: append all of 'fs' to container member 'm'
+static bool
+copyMemberInto(hpcrun_container_member_t* m, FILE* fs)
+{
+  const size_t bufSz = HPCIO_RWBufferSz;
+  char* buf = new char[bufSz];
+  bool ok = true;
+
+  size_t n;
+  while ((n = fread(buf, 1, bufSz, fs)) > 0) {
+    if (hpcrun_container_member_write(m, buf, n) != (ssize_t)n) {
+      ok = false;
+      break;
+    }
+  }
+  if (ferror(fs)) {
+    ok = false;
+  }
+
+  delete[] buf;
+  return ok;
+}
+
+
+// copyTraceContainer: Traces from one hpcrun container ('<x>.hpcpack')
+// are packed into one container in 'dstDir' rather than unpacked into
+// a file per thread.  Since hpcprof-mpi ranks may each copy a part of
+// the same container, the destination name is uniquified.
+static void
+copyTraceContainer(const std::string& dstDir, const string& container,
+		   const std::vector<string>& srcFiles)
+{
+  const string base = FileUtil::basename(container);
+  const string sfx = string(".") + HPCRUN_ContainerFnmSfx;
+  const string stem = base.substr(0, base.length() - sfx.length());
+
+  string dstFnm = dstDir + "/" + base;
+  int fd = -1;
+  for (int i = 1; ; ++i) {
+    fd = open(dstFnm.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0 || errno != EEXIST) {
+      break;
+    }
+    dstFnm = dstDir + "/" + stem + "-" + StrUtil::toStr(i) + sfx;
+  }
+  if (fd < 0) {
+    DIAG_EMsg("While copying trace files: could not create '" << dstFnm
+	      << "': " << strerror(errno));
+    return;
+  }
+
+  hpcrun_container_t* c = hpcrun_container_create(fd, malloc);
+  if (!c) {
+    DIAG_EMsg("While copying trace files: could not write '" << dstFnm << "'");
+    close(fd);
+    unlink(dstFnm.c_str());
+    return;
+  }
+
+  for (uint i = 0; i < srcFiles.size(); ++i) {
+    const string& x = srcFiles[i];
+    const string srcFnm1 = Prof::CallPath::Profile::traceTmpFileName(x);
+    const char* memberNm = hpcrun_container_path_member(x.c_str());
+
+    bool haveTmp = FileUtil::isReadable(srcFnm1);
+    const string& srcFnm = (haveTmp) ? srcFnm1 : x;
+
+    DIAG_Msg(2, "trace (cp): '" << srcFnm << "' -> '" << dstFnm << "/"
+	     << memberNm << "'");
+
+    FILE* fs = hpcio_fopen_r(srcFnm.c_str());
+    if (!fs) {
+      DIAG_EMsg("While copying trace files: could not open '" << srcFnm << "'");
+      continue;
+    }
+    hpcrun_container_member_t* m = hpcrun_container_member_new(c, memberNm);
+    if (!m) {
+      DIAG_EMsg("While copying trace files ['"
+		<< srcFnm << "' -> '" << dstFnm << "']: out of memory");
+      hpcio_fclose(fs);
+      continue;
+    }
+    if (!copyMemberInto(m, fs)) {
+      DIAG_EMsg("While copying trace files ['"
+		<< srcFnm << "' -> '" << dstFnm << "']: I/O error");
+    }
+    hpcio_fclose(fs);
+
+    if (haveTmp) {
+      FileUtil::remove(srcFnm1.c_str());
+    }
+  }
+
+  if (hpcrun_container_close(c, free) != HPCFMT_OK) {
+    DIAG_EMsg("While copying trace files: could not write '" << dstFnm << "'");
+  }
+}
+
+
 // copyTraceFiles:
 void
 copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
 {
   bool tryMove = true;
 
+  std::map<string, std::vector<string> > containerFiles;
+
   for (std::set<string>::iterator it = srcFiles.begin();
        it != srcFiles.end(); ++it) {
 
     const string& x = *it;
 
+    const char* memberNm = hpcrun_container_path_member(x.c_str());
+    if (memberNm) {
+      string container = x.substr(0, memberNm - x.c_str() - 1);
+      containerFiles[container].push_back(x);
+      continue;
+    }
+
     const string  srcFnm1 = x + "." + HPCPROF_TmpFnmSfx;
     const string& srcFnm2 = x;
     const string  dstFnm = dstDir + "/" + FileUtil::basename(x);
@@ -664,6 +867,11 @@ copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
       }
     }
   }
+
+  for (std::map<string, std::vector<string> >::iterator it =
+	 containerFiles.begin(); it != containerFiles.end(); ++it) {
+    copyTraceContainer(dstDir, it->first, it->second);
+  }
 }
 
 
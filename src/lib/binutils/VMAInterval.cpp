@@ -83,6 +83,10 @@ using std::string;
 
 #define DBG 0
 
+#ifndef UNIT_TEST
+#define UNIT_TEST 0
+#endif
+
 //***************************************************************************
 
 //***************************************************************************
@@ -453,3 +457,109 @@ VMAIntervalMap_ddump(VMAIntervalMap<T>* x)
   x->ddump();
 }
 */
+
+
+//***************************************************************************
+// unit test (needs hpctoolkit-config.h from a configured build tree)
+//
+//   g++ -std=gnu++11 -O2 -DUNIT_TEST=1 -I<build>/src -I../.. -I../../lib
+//      VMAInterval.cpp ../support/StrUtil.cpp ../support/diagnostics.cpp
+//      ../support/Exception.cpp
+//   ./a.out [maps] [intervals]
+//
+// VMAIntervalIndex::find(x) must return the same value as
+// VMAIntervalMap::find([x, x+1)) for every x, on random maps with
+// overlapping and empty intervals.  Then compare the lookup speed of
+// the two on one large map.
+//***************************************************************************
+
+#if UNIT_TEST
+
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+static double
+test_secs(const struct timespec& t0, const struct timespec& t1)
+{
+  return (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+}
+
+
+static void
+test_fill(VMAIntervalMap<int>& mp, int numIvals, VMA span, VMA maxLen)
+{
+  for (int i = 0; i < numIvals; ++i) {
+    VMA beg = rand() % span;
+    VMA len = rand() % (maxLen + 1);  // includes empty intervals
+    mp.insert(std::make_pair(VMAInterval(beg, beg + len), i));
+  }
+}
+
+
+int
+main(int argc, char** argv)
+{
+  int numMaps = (argc > 1) ? atoi(argv[1]) : 200;
+  int numIvals = (argc > 2) ? atoi(argv[2]) : 4000000;
+
+  srand(1);
+
+  // equivalence: probe every VMA of small, overlapping maps
+  for (int m = 0; m < numMaps; ++m) {
+    VMAIntervalMap<int> mp;
+    int n = rand() % 200;
+    VMA span = 1 + rand() % 2000;
+    test_fill(mp, n, span, 1 + rand() % 40);
+
+    VMAIntervalIndex<int> idx;
+    idx.build(mp);
+
+    for (VMA x = 0; x < span + 50; ++x) {
+      VMAIntervalMap<int>::iterator it = mp.find(VMAInterval(x, x + 1));
+      const int* v = idx.find(x);
+      const int* expect = (it != mp.end()) ? &it->second : NULL;
+      if ((v == NULL) != (expect == NULL) || (v && *v != *expect)) {
+	std::cout << "FAIL: map " << m << ", vma " << x << endl;
+	return 1;
+      }
+    }
+  }
+  std::cout << numMaps << " maps: index matches map" << endl;
+
+  // speed: disjoint intervals, random probes
+  VMAIntervalMap<int> mp;
+  for (int i = 0; i < numIvals; ++i) {
+    mp.insert(std::make_pair(VMAInterval(16 * (VMA)i, 16 * (VMA)i + 12), i));
+  }
+  VMAIntervalIndex<int> idx;
+  idx.build(mp);
+
+  std::vector<VMA> probes(numIvals);
+  for (int i = 0; i < numIvals; ++i) {
+    probes[i] = ((VMA)rand() * RAND_MAX + rand()) % (16 * (VMA)numIvals);
+  }
+
+  struct timespec t0, t1, t2;
+  long sumMap = 0, sumIdx = 0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < numIvals; ++i) {
+    VMAIntervalMap<int>::iterator it =
+      mp.find(VMAInterval(probes[i], probes[i] + 1));
+    sumMap += (it != mp.end()) ? it->second : -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  for (int i = 0; i < numIvals; ++i) {
+    const int* v = idx.find(probes[i]);
+    sumIdx += (v) ? *v : -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t2);
+
+  std::cout << numIvals << " intervals: map " << test_secs(t0, t1)
+	    << "s, index " << test_secs(t1, t2) << "s: "
+	    << ((sumMap == sumIdx) ? "ok" : "MISMATCH") << endl;
+
+  return (sumMap == sumIdx) ? 0 : 1;
+}
+
+#endif
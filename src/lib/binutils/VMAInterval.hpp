@@ -67,6 +67,10 @@
 
 #include <set>
 #include <map>
+#include <vector>
+#include <algorithm>
+
+#include <stdint.h>
 
 //*************************** User Include Files ****************************
 
@@ -505,6 +509,164 @@ private:
 };
 
 
+
+//***************************************************************************
+// VMAIntervalIndex
+//***************************************************************************
+
+// --------------------------------------------------------------------------
+// VMAIntervalIndex: an immutable snapshot of a VMAIntervalMap for
+// lookup-heavy phases.  find(vma) returns exactly what
+// VMAIntervalMap::find([vma, vma+1)) would, but uses flat arrays
+// instead of a red-black tree.
+//
+// The interval keys are stored in Eytzinger (breadth-first) order,
+// so the top levels of the search share a few cache lines.  The
+// descent is branch-free and prefetches the grandchildren's
+// keys. The mapped values are kept separately in key order, and
+// only the final candidates touch them.
+//
+// The index does not track its source map.  Callers must build() it
+// again (or invalidate() it) after modifying the map.
+// --------------------------------------------------------------------------
+
+template <typename T>
+class VMAIntervalIndex
+{
+public:
+  VMAIntervalIndex()
+    : m_valid(false), m_staleFinds(0)
+  { }
+
+  ~VMAIntervalIndex()
+  { }
+
+  // build: snapshot the contents of 'mp'
+  void
+  build(const VMAIntervalMap<T>& mp)
+  {
+    size_t n = mp.size();
+    m_key.resize(n);
+    m_val.resize(n);
+    size_t i = 0;
+    for (typename VMAIntervalMap<T>::const_iterator it = mp.begin();
+	 it != mp.end(); ++it, ++i) {
+      m_key[i].beg = it->first.beg();
+      m_key[i].end = it->first.end();
+      m_val[i] = it->second;
+    }
+
+    // slot 0 is unused so that children of k are 2k and 2k+1
+    m_eytzKey.resize(n + 1);
+    m_eytzRank.resize(n + 1);
+    size_t rank = 0;
+    fillEytzinger(1, rank);
+
+    m_valid = true;
+    m_staleFinds = 0;
+  }
+
+  void
+  clear()
+  {
+    m_key.clear();
+    m_val.clear();
+    m_eytzKey.clear();
+    m_eytzRank.clear();
+    m_valid = false;
+    m_staleFinds = 0;
+  }
+
+  // invalidate: note that the source map has changed
+  void
+  invalidate()
+  { m_valid = false; }
+
+  bool
+  isValid() const
+  { return m_valid; }
+
+  // noteStaleFind: count a lookup that had to bypass an invalid
+  // index; returns the number of such lookups since it became
+  // invalid.  Lets callers defer a rebuild until it pays for itself.
+  size_t
+  noteStaleFind()
+  { return ++m_staleFinds; }
+
+  size_t
+  size() const
+  { return m_key.size(); }
+
+  // find: Given a VMA x, return a pointer to the value mapped to the
+  //   interval that contains [x, x+1), or NULL.
+  const T*
+  find(VMA x) const
+  {
+    size_t n = m_key.size();
+    if (n == 0) {
+      return NULL;
+    }
+
+    const Key* eytz = &m_eytzKey[0];
+    size_t k = 1;
+    while (k <= n) {
+      __builtin_prefetch(eytz + std::min(4 * k, n));
+      k = 2 * k + lessThanPoint(eytz[k], x);
+    }
+    // k encodes the descent; strip the trailing right turns (and one
+    // left) to recover the lower bound.  k == 0: every key is less.
+    k >>= __builtin_ffsll(~(long long)k);
+    size_t lb = (k == 0) ? n : m_eytzRank[k];
+
+    // As in VMAIntervalMap::find(), only the lower bound and its
+    // predecessor can contain [x, x+1).
+    if (lb < n && contains(m_key[lb], x)) {
+      return &m_val[lb];
+    }
+    if (lb > 0 && contains(m_key[lb - 1], x)) {
+      return &m_val[lb - 1];
+    }
+    return NULL;
+  }
+
+private:
+  struct Key {
+    VMA beg;
+    VMA end;
+  };
+
+  // (beg, end) < [x, x+1), in the order of operator<(VMAInterval)
+  static size_t
+  lessThanPoint(const Key& key, VMA x)
+  { return (key.beg < x) | ((key.beg == x) & (key.end <= x)); }
+
+  static bool
+  contains(const Key& key, VMA x)
+  { return (key.beg <= x) && (x < key.end); }
+
+  void
+  fillEytzinger(size_t k, size_t& rank)
+  {
+    if (k < m_eytzKey.size()) {
+      fillEytzinger(2 * k, rank);
+      m_eytzKey[k] = m_key[rank];
+      m_eytzRank[k] = (uint32_t)rank;
+      rank++;
+      fillEytzinger(2 * k + 1, rank);
+    }
+  }
+
+private:
+  std::vector<Key>      m_key;      // key order
+  std::vector<T>        m_val;      // key order
+  std::vector<Key>      m_eytzKey;  // Eytzinger order, 1-based
+  std::vector<uint32_t> m_eytzRank; // Eytzinger slot -> key order
+
+  bool   m_valid;
+  size_t m_staleFinds;
+};
+
+
 //***************************************************************************
 
 #endif 
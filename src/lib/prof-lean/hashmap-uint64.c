@@ -0,0 +1,754 @@
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//******************************************************************************
+//
+// File: hashmap-uint64.c
+//
+// Purpose:
+//   a concurrent open-addressing hash map from 64-bit unsigned keys to
+//   pointers (see hashmap-uint64.h).
+//
+// Description:
+//   a map is a chain of tables. slots are probed linearly from a key's
+//   home slot, for at most HASHMAP_PROBE_LIMIT slots. a free (empty or
+//   deleted) slot has a NULL value. an insert claims the first free
+//   slot with a single compare-and-swap of its key to the new key, then
+//   commits by storing the (non-NULL) value; a slot holding a key but
+//   no value is pending and invisible to lookups and deletes. deleted
+//   slots are never emptied, so a probe may stop at the first empty
+//   slot; since deleted slots are reused, probe sequences stay short,
+//   and no probe needs to go further than the longest one any insert
+//   has used ('max_probe').
+//
+//   because deleted slots are reused, two threads inserting the same key
+//   can claim different slots (one of them freed behind the other's
+//   scan), so before committing, an insert scans its key's windows for
+//   other claims of the key. it gives up if it finds a committed one or
+//   a pending one at a lower address, and waits for a pending one at a
+//   higher address to commit (then gives up) or give up (then commits).
+//   the claims are sequentially consistent, so of two racing inserts at
+//   least one sees the other, and waits only go from lower to higher
+//   slots, so exactly one insert of a key succeeds and none waits
+//   forever.
+//
+//   an insert uses the first table in the chain with a free slot in the
+//   key's probe window. when there is none, a table twice the size of
+//   the last one is allocated and linked at the end of the chain, so the
+//   map grows instead of refusing keys, and a failed probe costs at most
+//   HASHMAP_PROBE_LIMIT slots per table; a table whose window was found
+//   full is skipped by inserts until a delete frees one of its slots.
+//   tables are never freed; once keys are retired, later inserts fill
+//   the earlier tables again.
+//
+//******************************************************************************
+
+
+
+//******************************************************************************
+// macros
+//******************************************************************************
+
+#ifndef UNIT_TEST
+#define UNIT_TEST 0
+#endif
+
+// longest probe sequence an insert may use in one table
+#define HASHMAP_PROBE_LIMIT 32
+
+
+
+//******************************************************************************
+// global includes
+//******************************************************************************
+
+#include <string.h>
+
+
+
+//******************************************************************************
+// local includes
+//******************************************************************************
+
+#include "stdatomic.h"
+#include "hashmap-uint64.h"
+
+
+
+//******************************************************************************
+// type declarations
+//******************************************************************************
+
+typedef struct hashmap_uint64_slot_t {
+  atomic_uint_least64_t key;
+  atomic_uintptr_t value;
+} hashmap_uint64_slot_t;
+
+
+typedef struct hashmap_uint64_table_t {
+  uint64_t mask;
+  unsigned int shift;
+  atomic_uint_least64_t max_probe;
+  atomic_bool full;
+  atomic_uintptr_t next;
+  hashmap_uint64_slot_t *slots;
+} hashmap_uint64_table_t;
+
+
+struct hashmap_uint64_s {
+  mem_alloc alloc;
+  atomic_uint_least64_t count;
+  hashmap_uint64_table_t *tables;
+};
+
+
+
+//******************************************************************************
+// private operations
+//******************************************************************************
+
+static hashmap_uint64_table_t *
+hashmap_table_new
+(
+ uint64_t capacity,
+ mem_alloc alloc
+)
+{
+  // keep the load factor at or below 1/2
+  uint64_t size = 2;
+  unsigned int shift = 1;
+  while (size < 2 * capacity) {
+    size <<= 1;
+    shift++;
+  }
+
+  hashmap_uint64_table_t *t =
+    (hashmap_uint64_table_t *) alloc(sizeof(hashmap_uint64_table_t));
+  if (t == NULL) return NULL;
+
+  t->slots = (hashmap_uint64_slot_t *) alloc(size * sizeof(hashmap_uint64_slot_t));
+  if (t->slots == NULL) return NULL;
+
+  t->mask = size - 1;
+  t->shift = shift;
+  atomic_init(&t->max_probe, 0);
+  atomic_init(&t->full, false);
+  atomic_init(&t->next, 0);
+
+  for (uint64_t i = 0; i < size; i++) {
+    atomic_init(&t->slots[i].key, HASHMAP_UINT64_KEY_EMPTY);
+    atomic_init(&t->slots[i].value, 0);
+  }
+
+  return t;
+}
+
+
+static inline hashmap_uint64_table_t *
+hashmap_table_next
+(
+ hashmap_uint64_table_t *t
+)
+{
+  return (hashmap_uint64_table_t *)
+    atomic_load_explicit(&t->next, memory_order_acquire);
+}
+
+
+static inline uint64_t
+hashmap_home
+(
+ hashmap_uint64_table_t *t,
+ uint64_t key
+)
+{
+  // consecutive keys land in consecutive slots; the high-order bits are
+  // folded in so that keys with a power-of-two stride still spread out.
+  return (key ^ (key >> t->shift)) & t->mask;
+}
+
+
+static inline hashmap_uint64_slot_t *
+hashmap_slot
+(
+ hashmap_uint64_table_t *t,
+ uint64_t home,
+ uint64_t i
+)
+{
+  return &t->slots[(home + i) & t->mask];
+}
+
+
+static inline bool
+hashmap_slot_free
+(
+ uint64_t k
+)
+{
+  return k == HASHMAP_UINT64_KEY_EMPTY || k == HASHMAP_UINT64_KEY_DELETED;
+}
+
+
+static inline uint64_t
+hashmap_probe_limit
+(
+ hashmap_uint64_table_t *t
+)
+{
+  return t->mask < HASHMAP_PROBE_LIMIT ? t->mask : HASHMAP_PROBE_LIMIT - 1;
+}
+
+
+static void
+hashmap_note_probe
+(
+ hashmap_uint64_table_t *t,
+ uint64_t probe
+)
+{
+  uint64_t old = atomic_load_explicit(&t->max_probe, memory_order_relaxed);
+  while (old < probe &&
+	 !atomic_compare_exchange_weak_explicit(&t->max_probe, &old, probe,
+						memory_order_release,
+						memory_order_relaxed));
+}
+
+
+// returns the slot holding key with a committed value, and its table,
+// or NULL
+static hashmap_uint64_slot_t *
+hashmap_find
+(
+ hashmap_uint64_t *map,
+ uint64_t key,
+ hashmap_uint64_table_t **table
+)
+{
+  for (hashmap_uint64_table_t *t = map->tables; t; t = hashmap_table_next(t)) {
+    uint64_t home = hashmap_home(t, key);
+    uint64_t n = atomic_load_explicit(&t->max_probe, memory_order_acquire);
+
+    for (uint64_t i = 0; i <= n; i++) {
+      hashmap_uint64_slot_t *s = hashmap_slot(t, home, i);
+      uint64_t k = atomic_load_explicit(&s->key, memory_order_acquire);
+      if (k == key &&
+	  atomic_load_explicit(&s->value, memory_order_acquire) != 0) {
+	*table = t;
+	return s;
+      }
+      if (k == HASHMAP_UINT64_KEY_EMPTY) break;
+    }
+  }
+  return NULL;
+}
+
+
+// claim a slot for key in t's probe window; NULL if the window is full
+static hashmap_uint64_slot_t *
+hashmap_table_claim
+(
+ hashmap_uint64_table_t *t,
+ uint64_t key
+)
+{
+  if (atomic_load_explicit(&t->full, memory_order_relaxed)) return NULL;
+
+  uint64_t home = hashmap_home(t, key);
+  uint64_t limit = hashmap_probe_limit(t);
+
+  for (uint64_t i = 0; i <= limit; i++) {
+    hashmap_uint64_slot_t *s = hashmap_slot(t, home, i);
+    uint64_t k = atomic_load_explicit(&s->key, memory_order_relaxed);
+    if (hashmap_slot_free(k) &&
+	atomic_compare_exchange_strong(&s->key, &k, key)) {
+      hashmap_note_probe(t, i);
+      return s;
+    }
+  }
+
+  // skip t until a delete frees one of its slots
+  atomic_store_explicit(&t->full, true, memory_order_relaxed);
+  return NULL;
+}
+
+
+// free a slot whose value is NULL
+static void
+hashmap_release
+(
+ hashmap_uint64_table_t *t,
+ hashmap_uint64_slot_t *s
+)
+{
+  atomic_store_explicit(&s->key, HASHMAP_UINT64_KEY_DELETED,
+			memory_order_release);
+  atomic_store_explicit(&t->full, false, memory_order_relaxed);
+}
+
+
+// returns true if the claim 'mine' of key must give way to another
+// claim of key (see the description at the top of this file)
+static bool
+hashmap_claim_conflicts
+(
+ hashmap_uint64_t *map,
+ uint64_t key,
+ hashmap_uint64_slot_t *mine
+)
+{
+  // tables are linked with sequentially consistent operations too, so a
+  // claim in a table this scan cannot see yet will see ours
+  for (hashmap_uint64_table_t *t = map->tables; t;
+       t = (hashmap_uint64_table_t *) atomic_load(&t->next)) {
+    uint64_t home = hashmap_home(t, key);
+    uint64_t limit = hashmap_probe_limit(t);
+
+    for (uint64_t i = 0; i <= limit; i++) {
+      hashmap_uint64_slot_t *s = hashmap_slot(t, home, i);
+      if (s == mine || atomic_load(&s->key) != key) continue;
+
+      if (atomic_load(&s->value) != 0 ||
+	  (uintptr_t) s < (uintptr_t) mine) return true;
+
+      // a pending claim at a higher address: wait until it commits or
+      // gives up
+      while (atomic_load(&s->key) == key && atomic_load(&s->value) == 0);
+      if (atomic_load(&s->key) == key) return true;
+    }
+  }
+  return false;
+}
+
+
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+hashmap_uint64_t *
+hashmap_uint64_new
+(
+ size_t capacity,
+ mem_alloc alloc
+)
+{
+  hashmap_uint64_t *map = (hashmap_uint64_t *) alloc(sizeof(hashmap_uint64_t));
+  if (map == NULL) return NULL;
+
+  map->tables = hashmap_table_new(capacity, alloc);
+  if (map->tables == NULL) return NULL;
+
+  map->alloc = alloc;
+  atomic_init(&map->count, 0);
+
+  return map;
+}
+
+
+void *
+hashmap_uint64_lookup
+(
+ hashmap_uint64_t *map,
+ uint64_t key
+)
+{
+  hashmap_uint64_table_t *t;
+  hashmap_uint64_slot_t *s = hashmap_find(map, key, &t);
+  if (s == NULL) return NULL;
+
+  void *value = (void *) atomic_load_explicit(&s->value, memory_order_relaxed);
+
+  // the key may have been deleted while the value was read
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&s->key, memory_order_relaxed) != key) return NULL;
+
+  return value;
+}
+
+
+bool
+hashmap_uint64_insert
+(
+ hashmap_uint64_t *map,
+ uint64_t key,
+ void *value
+)
+{
+  if (key >= HASHMAP_UINT64_KEY_BUSY || value == NULL) return false;
+  hashmap_uint64_table_t *t;
+  if (hashmap_find(map, key, &t)) return false;
+
+  hashmap_uint64_slot_t *s;
+  hashmap_uint64_table_t *spare = NULL;
+  for (t = map->tables;;) {
+    if ((s = hashmap_table_claim(t, key)) != NULL) break;
+
+    hashmap_uint64_table_t *next = hashmap_table_next(t);
+    if (next == NULL) {
+      // every table is full around key: add one. if another thread
+      // links its table first, that table is tried instead, and the
+      // spare is kept for a further append (or lost, if never needed).
+      if (spare == NULL) {
+	spare = hashmap_table_new(t->mask + 1, map->alloc);
+	if (spare == NULL) return false;
+      }
+      uintptr_t expected = 0;
+      if (atomic_compare_exchange_strong(&t->next, &expected,
+					 (uintptr_t) spare)) {
+	next = spare;
+	spare = NULL;
+      } else {
+	next = (hashmap_uint64_table_t *) expected;
+      }
+    }
+    t = next;
+  }
+
+  if (hashmap_claim_conflicts(map, key, s)) {
+    hashmap_release(t, s);
+    return false;
+  }
+
+  atomic_store_explicit(&s->value, (uintptr_t) value, memory_order_release);
+  atomic_fetch_add_explicit(&map->count, 1, memory_order_relaxed);
+  return true;
+}
+
+
+void *
+hashmap_uint64_delete
+(
+ hashmap_uint64_t *map,
+ uint64_t key
+)
+{
+  hashmap_uint64_table_t *t;
+  hashmap_uint64_slot_t *s = hashmap_find(map, key, &t);
+  if (s == NULL) return NULL;
+
+  // BUSY keeps the slot from being claimed until its value is cleared
+  uint64_t k = key;
+  if (!atomic_compare_exchange_strong_explicit(&s->key, &k,
+					       HASHMAP_UINT64_KEY_BUSY,
+					       memory_order_acquire,
+					       memory_order_relaxed)) {
+    return NULL;
+  }
+  void *value = (void *) atomic_load_explicit(&s->value, memory_order_relaxed);
+  atomic_store_explicit(&s->value, 0, memory_order_relaxed);
+  hashmap_release(t, s);
+  atomic_fetch_sub_explicit(&map->count, 1, memory_order_relaxed);
+
+  return value;
+}
+
+
+void
+hashmap_uint64_forall
+(
+ hashmap_uint64_t *map,
+ hashmap_uint64_fn_t fn,
+ void *arg
+)
+{
+  for (hashmap_uint64_table_t *t = map->tables; t; t = hashmap_table_next(t)) {
+    for (uint64_t i = 0; i <= t->mask; i++) {
+      hashmap_uint64_slot_t *s = &t->slots[i];
+      uint64_t k = atomic_load_explicit(&s->key, memory_order_acquire);
+      void *value = (void *) atomic_load_explicit(&s->value, memory_order_acquire);
+      if (k < HASHMAP_UINT64_KEY_BUSY && value != NULL) {
+	fn(k, value, arg);
+      }
+    }
+  }
+}
+
+
+uint64_t
+hashmap_uint64_count
+(
+ hashmap_uint64_t *map
+)
+{
+  return atomic_load_explicit(&map->count, memory_order_relaxed);
+}
+
+
+
+//******************************************************************************
+// unit test: replay correlation-id traffic (no gpu needed)
+//
+//   cc -std=gnu99 -O2 -c splay-uint64.c
+//   cc -std=gnu99 -O2 -DUNIT_TEST=1 -I.. hashmap-uint64.c splay-uint64.o -lpthread
+//   ./a.out [operations] [live window] [threads]
+//
+// each thread inserts ids from its own counter, looks up an id half a
+// window back, and deletes the id a full window back, which mirrors how
+// correlation ids are created at launch and retired when activity
+// records arrive. the same single-thread replay is timed against
+// splay-uint64 for comparison. next, ids that are never retired are
+// inserted into a map created with room for only 16, to check that it
+// grows without losing any. last, all threads race to insert the same
+// ids, and each id must be inserted exactly once; the ids are deleted
+// between rounds so that later rounds reuse deleted slots.
+//******************************************************************************
+
+#if UNIT_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "splay-uint64.h"
+
+static hashmap_uint64_t *map;
+static uint64_t n_ops = 10000000;
+static uint64_t window = 4096;
+static int n_threads = 4;
+static atomic_uint_least64_t errors = ATOMIC_VAR_INIT(0);
+
+
+static double
+now
+(
+ void
+)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void *
+replay
+(
+ void *arg
+)
+{
+  uint64_t tid = (uint64_t) arg;
+  uint64_t ops = n_ops / n_threads;
+
+  // interleave the threads' ids, as a shared counter would
+  for (uint64_t i = 0; i < ops; i++) {
+    uint64_t id = i * n_threads + tid;
+    if (!hashmap_uint64_insert(map, id, (void *) (id + 1))) {
+      atomic_fetch_add(&errors, 1);
+    }
+    if (i >= window / 2) {
+      uint64_t old = id - (window / 2) * n_threads;
+      if (hashmap_uint64_lookup(map, old) != (void *) (old + 1)) {
+	atomic_fetch_add(&errors, 1);
+      }
+    }
+    if (i >= window) {
+      uint64_t old = id - window * n_threads;
+      if (hashmap_uint64_delete(map, old) != (void *) (old + 1)) {
+	atomic_fetch_add(&errors, 1);
+      }
+    }
+  }
+  return NULL;
+}
+
+
+static void *
+retain
+(
+ void *arg
+)
+{
+  uint64_t tid = (uint64_t) arg;
+  uint64_t ops = window * 16;
+
+  for (uint64_t i = 0; i < ops; i++) {
+    uint64_t id = i * n_threads + tid;
+    if (!hashmap_uint64_insert(map, id, (void *) (id + 1))) {
+      atomic_fetch_add(&errors, 1);
+    }
+  }
+  for (uint64_t i = 0; i < ops; i++) {
+    uint64_t id = i * n_threads + tid;
+    if (hashmap_uint64_lookup(map, id) != (void *) (id + 1)) {
+      atomic_fetch_add(&errors, 1);
+    }
+  }
+  return NULL;
+}
+
+
+#define RACE_IDS    512
+#define RACE_ROUNDS 200
+
+static pthread_barrier_t race_barrier;
+static atomic_uint_least64_t race_wins[RACE_IDS];
+
+
+static void *
+race
+(
+ void *arg
+)
+{
+  uint64_t tid = (uint64_t) arg;
+
+  for (int r = 0; r < RACE_ROUNDS; r++) {
+    // each round uses its own ids; half the threads go in reverse, so
+    // threads meet both head-on and side by side
+    for (uint64_t i = 0; i < RACE_IDS; i++) {
+      uint64_t id = r * RACE_IDS + (tid & 1 ? RACE_IDS - 1 - i : i);
+      if (hashmap_uint64_insert(map, id, (void *) (tid + 1))) {
+	atomic_fetch_add(&race_wins[id % RACE_IDS], 1);
+      }
+    }
+    pthread_barrier_wait(&race_barrier);
+
+    if (tid == 0) {
+      for (uint64_t i = 0; i < RACE_IDS; i++) {
+	uint64_t id = r * RACE_IDS + i;
+	if (atomic_load(&race_wins[i]) != 1 ||
+	    hashmap_uint64_delete(map, id) == NULL) {
+	  atomic_fetch_add(&errors, 1);
+	}
+	atomic_store(&race_wins[i], 0);
+      }
+      if (hashmap_uint64_count(map) != 0) atomic_fetch_add(&errors, 1);
+    }
+    pthread_barrier_wait(&race_barrier);
+  }
+  return NULL;
+}
+
+
+static splay_uint64_node_t *
+splay_replay
+(
+ void
+)
+{
+  splay_uint64_node_t *root = NULL;
+  splay_uint64_node_t *nodes =
+    (splay_uint64_node_t *) calloc(window + 1, sizeof(splay_uint64_node_t));
+
+  for (uint64_t id = 0; id < n_ops; id++) {
+    splay_uint64_node_t *node = &nodes[id % (window + 1)];
+    node->left = node->right = NULL;
+    node->key = id;
+    splay_uint64_insert(&root, node);
+    if (id >= window / 2) splay_uint64_lookup(&root, id - window / 2);
+    if (id >= window) splay_uint64_delete(&root, id - window);
+  }
+  return root;
+}
+
+
+int
+main
+(
+ int argc,
+ char **argv
+)
+{
+  if (argc > 1) n_ops = strtoull(argv[1], NULL, 10);
+  if (argc > 2) window = strtoull(argv[2], NULL, 10);
+  if (argc > 3) n_threads = atoi(argv[3]);
+
+  double t = now();
+  splay_replay();
+  printf("splay-uint64:   1 thread(s), %lu ops: %.3fs\n", n_ops, now() - t);
+
+  int counts[] = { 1, n_threads };
+  for (int c = 0; c < 2; c++) {
+    int nt = counts[c];
+    int saved = n_threads;
+    n_threads = nt;
+    map = hashmap_uint64_new(window * nt + nt, malloc);
+
+    pthread_t threads[nt];
+    t = now();
+    for (int i = 0; i < nt; i++) {
+      pthread_create(&threads[i], NULL, replay, (void *) (uint64_t) i);
+    }
+    for (int i = 0; i < nt; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    printf("hashmap-uint64: %d thread(s), %lu ops: %.3fs (live %lu, errors %lu)\n",
+	   nt, n_ops, now() - t,
+	   hashmap_uint64_count(map), atomic_load(&errors));
+    n_threads = saved;
+  }
+
+  map = hashmap_uint64_new(16, malloc);
+  pthread_t threads[n_threads];
+  t = now();
+  for (int i = 0; i < n_threads; i++) {
+    pthread_create(&threads[i], NULL, retain, (void *) (uint64_t) i);
+  }
+  for (int i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  printf("hashmap-uint64: %d thread(s), %lu ids retained from capacity 16: "
+	 "%.3fs (live %lu, errors %lu)\n",
+	 n_threads, window * 16 * n_threads, now() - t,
+	 hashmap_uint64_count(map), atomic_load(&errors));
+
+  map = hashmap_uint64_new(64, malloc);
+  pthread_barrier_init(&race_barrier, NULL, n_threads);
+  t = now();
+  for (int i = 0; i < n_threads; i++) {
+    pthread_create(&threads[i], NULL, race, (void *) (uint64_t) i);
+  }
+  for (int i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  printf("hashmap-uint64: %d thread(s) racing to insert %d ids x %d rounds: "
+	 "%.3fs (errors %lu)\n",
+	 n_threads, RACE_IDS, RACE_ROUNDS, now() - t, atomic_load(&errors));
+
+  return atomic_load(&errors) != 0;
+}
+
+#endif
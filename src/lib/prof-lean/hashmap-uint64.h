@@ -0,0 +1,199 @@
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//******************************************************************************
+//
+// File: hashmap-uint64.h
+//
+// Purpose:
+//   a concurrent open-addressing hash map from 64-bit unsigned keys to
+//   pointers.
+//
+// Description:
+//   lookup and delete are lock free and insert takes no locks, so they
+//   may be used in signal handlers; an insert waits only while another
+//   thread is inserting the same key. memory comes from a caller-supplied allocator
+//   (e.g., hpcrun_malloc) and is never freed. a map starts with room
+//   for 'capacity' keys; an insert that finds no room allocates a
+//   larger table, so only a failing allocator makes an insert fail.
+//   deleted slots are reused by later inserts.
+//
+//   keys are placed by their low-order bits, so keys drawn from a
+//   counter (e.g., correlation ids) rarely collide while fewer than
+//   'capacity' of them are live.
+//
+//   values must not be NULL. if several threads insert the same key at
+//   once, exactly one of them succeeds. a key must not be inserted and
+//   deleted concurrently by different threads.
+//
+//******************************************************************************
+
+#ifndef hashmap_uint64_h
+#define hashmap_uint64_h
+
+
+
+//******************************************************************************
+// global includes
+//******************************************************************************
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+//******************************************************************************
+// local includes
+//******************************************************************************
+
+#include "mem_manager.h"
+
+
+
+//******************************************************************************
+// macros
+//******************************************************************************
+
+// keys reserved for the map's own use
+#define HASHMAP_UINT64_KEY_EMPTY    UINT64_MAX
+#define HASHMAP_UINT64_KEY_DELETED  (UINT64_MAX - 1)
+#define HASHMAP_UINT64_KEY_BUSY     (UINT64_MAX - 2)
+
+
+
+//******************************************************************************
+// type declarations
+//******************************************************************************
+
+typedef struct hashmap_uint64_s hashmap_uint64_t;
+
+typedef void (*hashmap_uint64_fn_t)
+(
+ uint64_t key,
+ void *value,
+ void *arg
+);
+
+
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+//------------------------------------------------------------------------------
+// create a map with room for at least 'capacity' live keys.
+// returns NULL if the allocator fails.
+//------------------------------------------------------------------------------
+hashmap_uint64_t *
+hashmap_uint64_new
+(
+ size_t capacity,
+ mem_alloc alloc
+);
+
+
+//------------------------------------------------------------------------------
+// returns the value associated with key, or NULL if key is not present
+//------------------------------------------------------------------------------
+void *
+hashmap_uint64_lookup
+(
+ hashmap_uint64_t *map,
+ uint64_t key
+);
+
+
+//------------------------------------------------------------------------------
+// associate value with key.
+//
+// returns false, leaving the map unchanged, if key is already present
+// (or being inserted by a thread that wins), value is NULL, or the map
+// needed to grow and the allocator failed.
+//------------------------------------------------------------------------------
+bool
+hashmap_uint64_insert
+(
+ hashmap_uint64_t *map,
+ uint64_t key,
+ void *value
+);
+
+
+//------------------------------------------------------------------------------
+// remove key from the map; returns its value, or NULL if key is not present
+//------------------------------------------------------------------------------
+void *
+hashmap_uint64_delete
+(
+ hashmap_uint64_t *map,
+ uint64_t key
+);
+
+
+//------------------------------------------------------------------------------
+// calls fn(key, value, arg) for each key in the map. keys inserted or
+// deleted concurrently may or may not be visited.
+//------------------------------------------------------------------------------
+void
+hashmap_uint64_forall
+(
+ hashmap_uint64_t *map,
+ hashmap_uint64_fn_t fn,
+ void *arg
+);
+
+
+//------------------------------------------------------------------------------
+// number of keys in the map
+//------------------------------------------------------------------------------
+uint64_t
+hashmap_uint64_count
+(
+ hashmap_uint64_t *map
+);
+
+
+
+#endif
@@ -97,12 +97,8 @@ hpcfmt_str_fread(char** str, FILE* infs, hpcfmt_alloc_fn alloc)
     return HPCFMT_ERR;
   }
   
-  for (int i = 0; i < len; i++) {
-    int c = fgetc(infs);
-    if (c == EOF) {
-      return HPCFMT_ERR;
-    }
-    buf[i] = (char) c;
+  if (fread(buf, 1, len, infs) != len) {
+    return HPCFMT_ERR;
   }
   buf[len] = '\0';
 
@@ -118,11 +114,8 @@ hpcfmt_str_fwrite(const char* str, FILE* outfs)
 
   hpcfmt_int4_fwrite(len, outfs);
   
-  for (int i = 0; i < len; i++) {
-    int c = fputc(str[i], outfs);
-    if (c == EOF) {
-      return HPCFMT_ERR;
-    }
+  if (fwrite(str, 1, len, outfs) != len) {
+    return HPCFMT_ERR;
   }
   return HPCFMT_OK;
 }
@@ -190,6 +190,18 @@ hpcfmt_intX_fread(uint8_t* val, size_t size, FILE* infs)
 }
 
 
+// hpcfmt_int8_fread_vec: read a vector of 'n' 8-byte values in one block
+static inline int
+hpcfmt_int8_fread_vec(uint64_t* val, size_t n, FILE* infs)
+{
+  size_t sz = hpcio_be8_fread_vec(val, n, infs);
+  if ( sz != n * sizeof(uint64_t) ) {
+    return (sz == 0 && feof(infs)) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
 static inline int
 hpcfmt_real8_fread(double* val, FILE* infs)
 {
@@ -243,6 +255,16 @@ hpcfmt_intX_fwrite(uint8_t* val, size_t size, FILE* outfs)
 }
 
 
+static inline int
+hpcfmt_int8_fwrite_vec(const uint64_t* val, size_t n, FILE* outfs)
+{
+  if ( n * sizeof(uint64_t) != hpcio_be8_fwrite_vec(val, n, outfs) ) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
 static inline int
 hpcfmt_real8_fwrite(double val, FILE* outfs)
 {
@@ -105,6 +105,9 @@ typedef struct hpcio_outbuf_s {
   size_t buf_size;
   size_t in_use;
   int  fd;
+  hpcio_outbuf_write_fn *write_fn;
+  hpcio_outbuf_swap_fn *swap_fn;
+  void *write_arg;
   int  flags;
   char use_lock;
   spinlock_t lock;
@@ -177,11 +180,27 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
 {
   ssize_t amt_done, ret;
 
+  // hand off the whole buffer, nothing to write here
+  if (outbuf->swap_fn != NULL) {
+    if (outbuf->in_use > 0) {
+      outbuf->buf_start = outbuf->swap_fn(outbuf->write_arg, outbuf->buf_start,
+					  outbuf->in_use);
+      outbuf->in_use = 0;
+    }
+    return HPCFMT_OK;
+  }
+
   amt_done = 0;
   while (amt_done < outbuf->in_use) {
     errno = 0;
-    ret = write(outbuf->fd, outbuf->buf_start + amt_done,
-		outbuf->in_use - amt_done);
+    if (outbuf->write_fn != NULL) {
+      ret = outbuf->write_fn(outbuf->write_arg, outbuf->buf_start + amt_done,
+			     outbuf->in_use - amt_done);
+    }
+    else {
+      ret = write(outbuf->fd, outbuf->buf_start + amt_done,
+		  outbuf->in_use - amt_done);
+    }
 
     // Check for short writes.  Note: EINTR is not failure.
     if (ret > 0 || (ret == 0 && errno == EINTR)) {
@@ -241,6 +260,9 @@ hpcio_outbuf_attach
   outbuf->buf_size = buf_size;
   outbuf->in_use = 0;
   outbuf->fd = fd;
+  outbuf->write_fn = NULL;
+  outbuf->swap_fn = NULL;
+  outbuf->write_arg = NULL;
   outbuf->flags = flags;
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
   spinlock_unlock(&outbuf->lock);
@@ -251,6 +273,74 @@ hpcio_outbuf_attach
 }
 
 
+// Same as hpcio_outbuf_attach(), but the buffer is flushed through
+// 'write_fn' instead of to a file descriptor (eg, to append to a
+// member of a container file).  Close does not close anything.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_attach_fn
+(
+  hpcio_outbuf_t **outbuf_ptr /* out */, 
+  hpcio_outbuf_write_fn *write_fn,
+  void *write_arg,
+  void *buf_start, 
+  size_t buf_size, 
+  int flags,
+  allocator_t alloc
+)
+{
+  if (write_fn == NULL) {
+    return HPCFMT_ERR;
+  }
+
+  // any valid fd passes the checks in attach, it is never used
+  int ret = hpcio_outbuf_attach(outbuf_ptr, 0, buf_start, buf_size,
+				flags, alloc);
+  if (ret == HPCFMT_OK) {
+    (*outbuf_ptr)->fd = -1;
+    (*outbuf_ptr)->write_fn = write_fn;
+    (*outbuf_ptr)->write_arg = write_arg;
+  }
+  return ret;
+}
+
+
+// Same as hpcio_outbuf_attach(), but a full buffer is handed to
+// 'swap_fn' in exchange for an empty one, so that the caller never
+// waits for the write (eg, the data are written by another thread).
+// The client owns all the buffers and close does not close anything.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_attach_swap
+(
+  hpcio_outbuf_t **outbuf_ptr /* out */, 
+  hpcio_outbuf_swap_fn *swap_fn,
+  void *swap_arg,
+  void *buf_start, 
+  size_t buf_size, 
+  int flags,
+  allocator_t alloc
+)
+{
+  if (swap_fn == NULL) {
+    return HPCFMT_ERR;
+  }
+
+  int ret = hpcio_outbuf_attach(outbuf_ptr, 0, buf_start, buf_size,
+				flags, alloc);
+  if (ret == HPCFMT_OK) {
+    (*outbuf_ptr)->fd = -1;
+    (*outbuf_ptr)->swap_fn = swap_fn;
+    (*outbuf_ptr)->write_arg = swap_arg;
+  }
+  return ret;
+}
+
+
 // Copy data to the outbuf and flush if necessary.
 //
 // Returns: number of bytes copied, or else -1 on bad buffer.
@@ -336,7 +426,7 @@ hpcio_outbuf_close(hpcio_outbuf_t **outbuf_ptr)
   }
 
   if (outbuf_flush_buffer(outbuf) == HPCFMT_OK
-      && close(outbuf->fd) == 0) {
+      && (outbuf->fd < 0 || close(outbuf->fd) == 0)) {
     // flush and close both succeed
     outbuf->magic = 0;
     outbuf->fd = -1;
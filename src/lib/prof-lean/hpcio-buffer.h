@@ -57,6 +57,19 @@
 
 typedef struct hpcio_outbuf_s hpcio_outbuf_t;
 
+// Alternate sink for hpcio_outbuf_attach_fn(): write up to 'size'
+// bytes from 'data' and return the amount written, or -1 on error.
+// Must be safe inside signal handlers, like write().
+
+typedef ssize_t (hpcio_outbuf_write_fn)(void *arg, const void *data, size_t size);
+
+// Alternate sink for hpcio_outbuf_attach_swap(): take over the full
+// buffer 'buf' holding 'size' bytes and return an empty buffer of the
+// same size to continue in (possibly 'buf' itself, if its contents
+// were discarded).  Must be safe inside signal handlers.
+
+typedef void *(hpcio_outbuf_swap_fn)(void *arg, void *buf, size_t size);
+
 //***************************************************************************
 
 // Flags for hpcio_outbuf_attach().
@@ -80,6 +93,32 @@ hpcio_outbuf_attach
 );
 
 
+int
+hpcio_outbuf_attach_fn
+(
+  hpcio_outbuf_t **outbuf /* out */, 
+  hpcio_outbuf_write_fn *write_fn,
+  void *write_arg,
+  void *buf_start, 
+  size_t buf_size, 
+  int flags,
+  allocator_t alloc
+);
+
+
+int
+hpcio_outbuf_attach_swap
+(
+  hpcio_outbuf_t **outbuf /* out */, 
+  hpcio_outbuf_swap_fn *swap_fn,
+  void *swap_arg,
+  void *buf_start, 
+  size_t buf_size, 
+  int flags,
+  allocator_t alloc
+);
+
+
 ssize_t
 hpcio_outbuf_write
 (
@@ -91,6 +91,7 @@
 //*************************** User Include Files ****************************
 
 #include "hpcio.h"
+#include "hpcrun-container.h"
 
 
 
@@ -141,6 +142,9 @@ FILE*
 hpcio_fopen_r(const char* fnm)
 {
   FILE* fs = fopen(fnm, "r");
+  if (!fs && errno == ENOTDIR && hpcrun_container_path_member(fnm)) {
+    fs = hpcrun_container_fopen_r(fnm);
+  }
   return fs;
 }
 
@@ -278,21 +282,19 @@ hpcio_le8_fwrite(uint64_t* val, FILE* fs)
 
 //***************************************************************************
 // Big endian
+//
+// The readers/writers move a whole value with one fread()/fwrite()
+// (one stream lock) instead of one fgetc()/fputc() per byte.  See
+// hpcio_beX_get/put in the header for the byte (de)composition.
 //***************************************************************************
 
 size_t
 hpcio_be2_fread(uint16_t* val, FILE* fs)
 {
-  uint16_t v = 0; // local copy of val
-  int shift = 0, num_read = 0, c;
-  
-  for (shift = 8; shift >= 0; shift -= 8) {
-    if ( (c = fgetc(fs)) == EOF ) { break; }
-    num_read++;
-    v = (uint16_t)(v | ((c & 0xff) << shift)); // 8, 0
-  }
+  uint8_t b[2] = { 0 };
+  size_t num_read = fread(b, 1, sizeof(b), fs);
 
-  *val = v;
+  *val = hpcio_be2_get(b);
   return num_read;
 }
 
@@ -300,16 +302,10 @@ hpcio_be2_fread(uint16_t* val, FILE* fs)
 size_t
 hpcio_be4_fread(uint32_t* val, FILE* fs)
 {
-  uint32_t v = 0; // local copy of val
-  int shift = 0, num_read = 0, c;
-  
-  for (shift = 24; shift >= 0; shift -= 8) {
-    if ( (c = fgetc(fs)) == EOF ) { break; }
-    num_read++;
-    v |= ((uint32_t)(c & 0xff) << shift); // 24, 16, 8, 0
-  }
+  uint8_t b[4] = { 0 };
+  size_t num_read = fread(b, 1, sizeof(b), fs);
 
-  *val = v;
+  *val = hpcio_be4_get(b);
   return num_read;
 }
 
@@ -317,16 +313,10 @@ hpcio_be4_fread(uint32_t* val, FILE* fs)
 size_t
 hpcio_be8_fread(uint64_t* val, FILE* fs)
 {
-  uint64_t v = 0; // local copy of val
-  int shift = 0, num_read = 0, c;
-  
-  for (shift = 56; shift >= 0; shift -= 8) {
-    if ( (c = fgetc(fs)) == EOF ) { break; }
-    num_read++;
-    v |= ((uint64_t)(c & 0xff) << shift); // 56, 48, 40, ... 0
-  }
+  uint8_t b[8] = { 0 };
+  size_t num_read = fread(b, 1, sizeof(b), fs);
 
-  *val = v;
+  *val = hpcio_be8_get(b);
   return num_read;
 }
 
@@ -334,15 +324,22 @@ hpcio_be8_fread(uint64_t* val, FILE* fs)
 size_t
 hpcio_beX_fread(uint8_t* val, size_t size, FILE* fs)
 {
-  size_t num_read = 0;
+  return fread(val, 1, size, fs);
+}
 
-  for (uint i = 0; i < size; ++i) {
-    int c = fgetc(fs);
-    if (c == EOF) {
-      break;
-    }
-    val[i] = (uint8_t) c;
-    num_read++;
+
+size_t
+hpcio_be8_fread_vec(uint64_t* val, size_t n, FILE* fs)
+{
+  // Read the raw block directly into 'val' and convert it in place.
+  // The conversion loop has no cross-iteration dependences and is
+  // vectorized (byte shuffles) by the compiler.
+  size_t num_read = fread(val, 1, n * sizeof(uint64_t), fs);
+
+  size_t num_vals = num_read / sizeof(uint64_t);
+  uint8_t* b = (uint8_t*)val;
+  for (size_t i = 0; i < num_vals; ++i) {
+    val[i] = hpcio_be8_get(b + i * sizeof(uint64_t));
   }
 
   return num_read;
@@ -354,59 +351,54 @@ hpcio_beX_fread(uint8_t* val, size_t size, FILE* fs)
 size_t
 hpcio_be2_fwrite(uint16_t* val, FILE* fs)
 {
-  uint16_t v = *val; // local copy of val
-  int shift = 0, num_write = 0, c;
-  
-  for (shift = 8; shift >= 0; shift -= 8) {
-    c = fputc( ((v >> shift) & 0xff) , fs);
-    if (c == EOF) { break; }
-    num_write++;
-  }
-  return num_write;
+  uint8_t b[2];
+  hpcio_be2_put(b, *val);
+  return fwrite(b, 1, sizeof(b), fs);
 }
 
 
 size_t
 hpcio_be4_fwrite(uint32_t* val, FILE* fs)
 {
-  uint32_t v = *val; // local copy of val
-  int shift = 0, num_write = 0, c;
-  
-  for (shift = 24; shift >= 0; shift -= 8) {
-    c = fputc( ((v >> shift) & 0xff) , fs);
-    if (c == EOF) { break; }
-    num_write++;
-  }
-  return num_write;
+  uint8_t b[4];
+  hpcio_be4_put(b, *val);
+  return fwrite(b, 1, sizeof(b), fs);
 }
 
 
 size_t
 hpcio_be8_fwrite(uint64_t* val, FILE* fs)
 {
-  uint64_t v = *val; // local copy of val
-  int shift = 0, num_write = 0, c;
-  
-  for (shift = 56; shift >= 0; shift -= 8) {
-    c = fputc( ((v >> shift) & 0xff) , fs);
-    if (c == EOF) { break; }
-    num_write++;
-  }
-  return num_write;
+  uint8_t b[8];
+  hpcio_be8_put(b, *val);
+  return fwrite(b, 1, sizeof(b), fs);
 }
 
 
 size_t
 hpcio_beX_fwrite(uint8_t* val, size_t size, FILE* fs)
 {
+  return fwrite(val, 1, size, fs);
+}
+
+
+size_t
+hpcio_be8_fwrite_vec(const uint64_t* val, size_t n, FILE* fs)
+{
+  // N.B.: no dynamic memory; encode through a fixed stack block
+  uint8_t b[HPCIO_VecBlockSz * sizeof(uint64_t)];
   size_t num_write = 0;
-  
-  for (uint i = 0; i < size; ++i) {
-    int c = fputc(val[i], fs);
-    if (c == EOF) {
+
+  for (size_t i = 0; i < n; i += HPCIO_VecBlockSz) {
+    size_t len = (n - i < HPCIO_VecBlockSz) ? (n - i) : HPCIO_VecBlockSz;
+    for (size_t j = 0; j < len; ++j) {
+      hpcio_be8_put(b + j * sizeof(uint64_t), val[i + j]);
+    }
+    size_t nw = fwrite(b, 1, len * sizeof(uint64_t), fs);
+    num_write += nw;
+    if (nw != len * sizeof(uint64_t)) {
       break;
     }
-    num_write++;
   }
 
   return num_write;
@@ -85,6 +85,9 @@ extern "C" {
 // "static const char*" variables.
 #define HPCIO_RWBufferSz (4 * 1024 * 1024)
 
+// Number of values converted per block by the vector writers.
+#define HPCIO_VecBlockSz (512)
+
 //***************************************************************************
 
 // Open and close a file stream for use with the library's read/write
@@ -96,7 +99,8 @@ extern "C" {
 // 'overwrite' is 1 any existing file will be overwritten.  For
 // reading, it is an error if the file does not exist.  For any of
 // these errors, or other open errors, NULL is returned; otherwise a
-// non-null FILE pointer is returned.
+// non-null FILE pointer is returned.  hpcio_fopen_r also opens
+// members of hpcrun container files, named '<container>/<member>'.
 //
 // hpcio_close: Close the file stream.  Returns 0 upon success; 
 // non-zero on error.
@@ -157,6 +161,12 @@ hpcio_be8_fread(uint64_t* val, FILE* fs);
 size_t
 hpcio_beX_fread(uint8_t* val, size_t size, FILE* fs);
 
+// hpcio_be8_fread_vec: Reads 'n' consecutive 8-byte big-endian values
+// from 'fs' with a single block read and converts them in place.
+// Returns the number of bytes read.
+size_t
+hpcio_be8_fread_vec(uint64_t* val, size_t n, FILE* fs);
+
 
 size_t
 hpcio_be2_fwrite(uint16_t* val, FILE* fs);
@@ -170,6 +180,69 @@ hpcio_be8_fwrite(uint64_t* val, FILE* fs);
 size_t
 hpcio_beX_fwrite(uint8_t* val, size_t size, FILE* fs);
 
+// hpcio_be8_fwrite_vec: Writes 'n' 8-byte values to 'fs' in
+// big-endian order, converting them in blocks of HPCIO_VecBlockSz.
+// Returns the number of bytes written.
+size_t
+hpcio_be8_fwrite_vec(const uint64_t* val, size_t n, FILE* fs);
+
+
+//***************************************************************************
+
+// hpcio_beX_get, hpcio_beX_put: Decode/encode an 'X' byte big-endian
+// value from/to the memory buffer 'b'.  Used to decode fixed-size
+// records that were read in one block.
+
+static inline uint16_t
+hpcio_be2_get(const uint8_t* b)
+{
+  return (uint16_t)(((uint16_t)b[0] << 8) | (uint16_t)b[1]);
+}
+
+
+static inline uint32_t
+hpcio_be4_get(const uint8_t* b)
+{
+  return (((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16)
+	  | ((uint32_t)b[2] << 8) | (uint32_t)b[3]);
+}
+
+
+static inline uint64_t
+hpcio_be8_get(const uint8_t* b)
+{
+  return (((uint64_t)b[0] << 56) | ((uint64_t)b[1] << 48)
+	  | ((uint64_t)b[2] << 40) | ((uint64_t)b[3] << 32)
+	  | ((uint64_t)b[4] << 24) | ((uint64_t)b[5] << 16)
+	  | ((uint64_t)b[6] << 8)  | (uint64_t)b[7]);
+}
+
+
+static inline void
+hpcio_be2_put(uint8_t* b, uint16_t v)
+{
+  b[0] = (uint8_t)(v >> 8);
+  b[1] = (uint8_t)(v);
+}
+
+
+static inline void
+hpcio_be4_put(uint8_t* b, uint32_t v)
+{
+  b[0] = (uint8_t)(v >> 24);
+  b[1] = (uint8_t)(v >> 16);
+  b[2] = (uint8_t)(v >> 8);
+  b[3] = (uint8_t)(v);
+}
+
+
+static inline void
+hpcio_be8_put(uint8_t* b, uint64_t v)
+{
+  hpcio_be4_put(b,     (uint32_t)(v >> 32));
+  hpcio_be4_put(b + 4, (uint32_t)(v));
+}
+
 
 //***************************************************************************
 
@@ -0,0 +1,701 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Write and read per-process container files (see hpcrun-container.h).
+//
+// Description:
+//   Appending a segment reserves its place with an atomic add on the
+//   end of the file and writes it with pwrite(), so threads never wait
+//   for each other and no stdio is involved.  Each member keeps its
+//   own list of segments; consecutive segments of a member that turn
+//   out to be adjacent in the file are recorded as one.
+//
+//   A member is read back through fopencookie(), which lets the
+//   existing stdio-based readers (hpcrun-fmt, hpctrace-fmt) work on it
+//   unchanged.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // fopencookie
+#endif
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+//*************************** User Include Files ****************************
+
+#include "hpcio.h"
+#include "hpcfmt.h"
+#include "hpcrun-fmt.h"
+#include "hpcrun-container.h"
+#include "spinlock.h"
+#include "stdatomic.h"
+#include <include/min-max.h>
+
+#define SEGMENTS_PER_CHUNK  64
+#define FOOTER_BUF_SZ       4096
+
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+typedef struct segment_chunk_s {
+  struct segment_chunk_s *next;
+  uint32_t count;
+  hpcrun_container_segment_t seg[SEGMENTS_PER_CHUNK];
+} segment_chunk_t;
+
+
+struct hpcrun_container_member_s {
+  struct hpcrun_container_member_s *next;
+  hpcrun_container_t *container;
+  char name[HPCRUN_CONTAINER_NameMax + 1];
+  uint32_t num_segments;
+  segment_chunk_t *first;
+  segment_chunk_t *last;
+};
+
+
+struct hpcrun_container_s {
+  int fd;
+  atomic_uint_least64_t end;  // where the next segment goes
+  hpcfmt_alloc_fn *alloc;
+
+  spinlock_t lock;            // protects the member list
+  hpcrun_container_member_t *members;
+  hpcrun_container_member_t **members_tail;
+  uint32_t num_members;
+};
+
+
+typedef struct footer_buf_s {
+  int fd;
+  uint64_t offset;
+  size_t in_use;
+  bool ok;
+  uint8_t buf[FOOTER_BUF_SZ];
+} footer_buf_t;
+
+
+// read side: the state of one open member stream
+typedef struct member_stream_s {
+  int fd;
+  uint64_t size;
+  uint64_t pos;
+  uint32_t num_segments;
+  hpcrun_container_segment_t *segments;
+  uint32_t seg;         // segment containing 'pos' (or before it)
+  uint64_t seg_start;   // member offset of segment 'seg'
+} member_stream_t;
+
+
+
+//*************************** Private Functions *****************************
+
+static int
+pwrite_all(int fd, const void *data, size_t size, uint64_t offset)
+{
+  const char *p = (const char *) data;
+  while (size > 0) {
+    ssize_t ret = pwrite(fd, p, size, offset);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return -1;
+    }
+    p += ret;
+    size -= ret;
+    offset += ret;
+  }
+  return 0;
+}
+
+
+static void
+footer_flush(footer_buf_t *f)
+{
+  if (f->ok && f->in_use > 0) {
+    f->ok = (pwrite_all(f->fd, f->buf, f->in_use, f->offset) == 0);
+    f->offset += f->in_use;
+  }
+  f->in_use = 0;
+}
+
+
+static void
+footer_put(footer_buf_t *f, const void *data, size_t size)
+{
+  const uint8_t *p = (const uint8_t *) data;
+  while (size > 0) {
+    if (f->in_use == FOOTER_BUF_SZ) {
+      footer_flush(f);
+    }
+    size_t amt = MIN(size, FOOTER_BUF_SZ - f->in_use);
+    memcpy(f->buf + f->in_use, p, amt);
+    f->in_use += amt;
+    p += amt;
+    size -= amt;
+  }
+}
+
+
+static void
+footer_put4(footer_buf_t *f, uint32_t val)
+{
+  uint8_t b[4];
+  hpcio_be4_put(b, val);
+  footer_put(f, b, 4);
+}
+
+
+static void
+footer_put8(footer_buf_t *f, uint64_t val)
+{
+  uint8_t b[8];
+  hpcio_be8_put(b, val);
+  footer_put(f, b, 8);
+}
+
+
+static ssize_t
+member_cookie_write(void *cookie, const char *buf, size_t size)
+{
+  // stdio treats 0 as an error
+  ssize_t ret = hpcrun_container_member_write(cookie, buf, size);
+  return (ret < 0) ? 0 : ret;
+}
+
+
+static int
+member_cookie_close(void *cookie)
+{
+  return 0;
+}
+
+
+static ssize_t
+member_stream_read(void *cookie, char *buf, size_t size)
+{
+  member_stream_t *ms = (member_stream_t *) cookie;
+  size_t done = 0;
+
+  while (done < size && ms->pos < ms->size) {
+    while (ms->pos >= ms->seg_start + ms->segments[ms->seg].length) {
+      ms->seg_start += ms->segments[ms->seg].length;
+      ms->seg++;
+    }
+    const hpcrun_container_segment_t *s = &ms->segments[ms->seg];
+    uint64_t in_seg = ms->pos - ms->seg_start;
+    size_t amt = MIN(size - done, s->length - in_seg);
+
+    ssize_t ret = pread(ms->fd, buf + done, amt, s->offset + in_seg);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0) {
+      return (done > 0) ? (ssize_t) done : -1;
+    }
+    if (ret == 0) {
+      break; // truncated container
+    }
+    done += ret;
+    ms->pos += ret;
+  }
+
+  return done;
+}
+
+
+static int
+member_stream_seek(void *cookie, off64_t *offset, int whence)
+{
+  member_stream_t *ms = (member_stream_t *) cookie;
+
+  int64_t base = 0;
+  switch (whence) {
+    case SEEK_SET: base = 0; break;
+    case SEEK_CUR: base = ms->pos; break;
+    case SEEK_END: base = ms->size; break;
+    default: errno = EINVAL; return -1;
+  }
+  if (base + *offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ms->pos = base + *offset;
+  ms->seg = 0;
+  ms->seg_start = 0;
+  *offset = ms->pos;
+  return 0;
+}
+
+
+static int
+member_stream_close(void *cookie)
+{
+  member_stream_t *ms = (member_stream_t *) cookie;
+  int ret = close(ms->fd);
+  free(ms->segments);
+  free(ms);
+  return ret;
+}
+
+
+
+//*************************** Interface Functions ***************************
+
+hpcrun_container_t*
+hpcrun_container_create(int fd, hpcfmt_alloc_fn alloc)
+{
+  if (fd < 0) {
+    return NULL;
+  }
+
+  hpcrun_container_t *c = (hpcrun_container_t *) alloc(sizeof(*c));
+  if (c == NULL) {
+    return NULL;
+  }
+
+  uint8_t hdr[HPCRUN_CONTAINER_HdrSz];
+  memcpy(hdr, HPCRUN_CONTAINER_Magic, 18);
+  memcpy(hdr + 18, HPCRUN_CONTAINER_Version, 5);
+  memcpy(hdr + 23, HPCRUN_CONTAINER_Endian, 1);
+  if (pwrite_all(fd, hdr, sizeof(hdr), 0) != 0) {
+    return NULL;
+  }
+
+  c->fd = fd;
+  atomic_init(&c->end, HPCRUN_CONTAINER_HdrSz);
+  c->alloc = alloc;
+  spinlock_init(&c->lock);
+  c->members = NULL;
+  c->members_tail = &c->members;
+  c->num_members = 0;
+
+  return c;
+}
+
+
+hpcrun_container_member_t*
+hpcrun_container_member_new(hpcrun_container_t *c, const char *name)
+{
+  hpcrun_container_member_t *m =
+    (hpcrun_container_member_t *) c->alloc(sizeof(*m));
+  if (m == NULL) {
+    return NULL;
+  }
+
+  m->next = NULL;
+  m->container = c;
+  m->name[0] = '\0';
+  m->num_segments = 0;
+  m->first = NULL;
+  m->last = NULL;
+  if (name) {
+    hpcrun_container_member_setname(m, name);
+  }
+
+  spinlock_lock(&c->lock);
+  *(c->members_tail) = m;
+  c->members_tail = &m->next;
+  c->num_members++;
+  spinlock_unlock(&c->lock);
+
+  return m;
+}
+
+
+void
+hpcrun_container_member_setname(hpcrun_container_member_t *m,
+				 const char *name)
+{
+  strncpy(m->name, name, HPCRUN_CONTAINER_NameMax);
+  m->name[HPCRUN_CONTAINER_NameMax] = '\0';
+}
+
+
+ssize_t
+hpcrun_container_member_write(void *arg, const void *data, size_t size)
+{
+  hpcrun_container_member_t *m = (hpcrun_container_member_t *) arg;
+  hpcrun_container_t *c = m->container;
+
+  if (size == 0) {
+    return 0;
+  }
+
+  uint64_t offset = atomic_fetch_add(&c->end, size);
+  if (pwrite_all(c->fd, data, size, offset) != 0) {
+    return -1;
+  }
+
+  segment_chunk_t *chunk = m->last;
+  if (chunk && chunk->count > 0) {
+    hpcrun_container_segment_t *prev = &chunk->seg[chunk->count - 1];
+    if (prev->offset + prev->length == offset) {
+      prev->length += size;
+      return size;
+    }
+  }
+
+  if (chunk == NULL || chunk->count == SEGMENTS_PER_CHUNK) {
+    chunk = (segment_chunk_t *) c->alloc(sizeof(*chunk));
+    if (chunk == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
+    chunk->next = NULL;
+    chunk->count = 0;
+    if (m->last) {
+      m->last->next = chunk;
+    }
+    else {
+      m->first = chunk;
+    }
+    m->last = chunk;
+  }
+
+  chunk->seg[chunk->count].offset = offset;
+  chunk->seg[chunk->count].length = size;
+  chunk->count++;
+  m->num_segments++;
+
+  return size;
+}
+
+
+FILE*
+hpcrun_container_member_fopen(hpcrun_container_member_t *m)
+{
+  cookie_io_functions_t fns = {
+    .read  = NULL,
+    .write = member_cookie_write,
+    .seek  = NULL,
+    .close = member_cookie_close
+  };
+  return fopencookie(m, "w", fns);
+}
+
+
+int
+hpcrun_container_close(hpcrun_container_t *c, hpcfmt_free_fn dealloc)
+{
+  footer_buf_t *f = (footer_buf_t *) c->alloc(sizeof(*f));
+  if (f == NULL) {
+    close(c->fd);
+    return HPCFMT_ERR;
+  }
+
+  uint64_t footer_offset = atomic_load(&c->end);
+  f->fd = c->fd;
+  f->offset = footer_offset;
+  f->in_use = 0;
+  f->ok = true;
+
+  spinlock_lock(&c->lock);
+
+  footer_put4(f, c->num_members);
+  for (hpcrun_container_member_t *m = c->members; m; m = m->next) {
+    uint32_t len = strlen(m->name);
+    footer_put4(f, len);
+    footer_put(f, m->name, len);
+    footer_put4(f, m->num_segments);
+    for (segment_chunk_t *chunk = m->first; chunk; chunk = chunk->next) {
+      for (uint32_t i = 0; i < chunk->count; ++i) {
+	footer_put8(f, chunk->seg[i].offset);
+	footer_put8(f, chunk->seg[i].length);
+      }
+    }
+  }
+
+  footer_put8(f, footer_offset);
+  footer_put(f, HPCRUN_CONTAINER_FooterTag, 8);
+  footer_flush(f);
+
+  spinlock_unlock(&c->lock);
+
+  int ret = (f->ok && close(c->fd) == 0) ? HPCFMT_OK : HPCFMT_ERR;
+
+  if (dealloc) {
+    hpcrun_container_member_t *m = c->members;
+    while (m) {
+      segment_chunk_t *chunk = m->first;
+      while (chunk) {
+	segment_chunk_t *next = chunk->next;
+	dealloc(chunk);
+	chunk = next;
+      }
+      hpcrun_container_member_t *next = m->next;
+      dealloc(m);
+      m = next;
+    }
+    dealloc(f);
+    dealloc(c);
+  }
+
+  return ret;
+}
+
+
+//***************************************************************************
+
+int
+hpcrun_container_index_fread(hpcrun_container_index_t *idx, FILE *fs,
+			     hpcfmt_alloc_fn alloc)
+{
+  idx->num_members = 0;
+  idx->members = NULL;
+
+  char hdr[HPCRUN_CONTAINER_HdrSz];
+  if (fseeko(fs, 0, SEEK_SET) != 0
+      || fread(hdr, 1, sizeof(hdr), fs) != sizeof(hdr)
+      || strncmp(hdr, HPCRUN_CONTAINER_Magic, 18) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  uint8_t trailer[HPCRUN_CONTAINER_TrailerSz];
+  if (fseeko(fs, -HPCRUN_CONTAINER_TrailerSz, SEEK_END) != 0
+      || fread(trailer, 1, sizeof(trailer), fs) != sizeof(trailer)
+      || memcmp(trailer + 8, HPCRUN_CONTAINER_FooterTag, 8) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  uint64_t footer_offset = hpcio_be8_get(trailer);
+  if (fseeko(fs, footer_offset, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  uint32_t num_members = 0;
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&num_members, fs));
+  if (num_members > 0) {
+    idx->members = (hpcrun_container_entry_t *)
+      alloc(num_members * sizeof(hpcrun_container_entry_t));
+    if (idx->members == NULL) {
+      return HPCFMT_ERR;
+    }
+  }
+
+  // N.B.: members are counted as they are completed so that an index
+  // that failed to read can still be freed
+  for (uint32_t i = 0; i < num_members; ++i) {
+    hpcrun_container_entry_t *e = &idx->members[i];
+    e->name = NULL;
+    e->size = 0;
+    e->num_segments = 0;
+    e->segments = NULL;
+
+    int ret = hpcfmt_str_fread(&e->name, fs, alloc);
+    if (ret == HPCFMT_OK) {
+      ret = hpcfmt_int4_fread(&e->num_segments, fs);
+    }
+    if (ret == HPCFMT_OK && e->num_segments > 0) {
+      e->segments = (hpcrun_container_segment_t *)
+	alloc(e->num_segments * sizeof(hpcrun_container_segment_t));
+      if (e->segments == NULL) {
+	ret = HPCFMT_ERR;
+      }
+    }
+    for (uint32_t j = 0; ret == HPCFMT_OK && j < e->num_segments; ++j) {
+      ret = hpcfmt_int8_fread(&e->segments[j].offset, fs);
+      if (ret == HPCFMT_OK) {
+	ret = hpcfmt_int8_fread(&e->segments[j].length, fs);
+	e->size += e->segments[j].length;
+      }
+    }
+
+    if (e->name || e->segments) {
+      idx->num_members = i + 1;
+    }
+    if (ret != HPCFMT_OK) {
+      return HPCFMT_ERR;
+    }
+  }
+
+  return HPCFMT_OK;
+}
+
+
+void
+hpcrun_container_index_free(hpcrun_container_index_t *idx,
+			    hpcfmt_free_fn dealloc)
+{
+  for (uint32_t i = 0; i < idx->num_members; ++i) {
+    if (idx->members[i].name) {
+      hpcfmt_str_free(idx->members[i].name, dealloc);
+    }
+    if (idx->members[i].segments) {
+      dealloc(idx->members[i].segments);
+    }
+  }
+  if (idx->members) {
+    dealloc(idx->members);
+  }
+  idx->num_members = 0;
+  idx->members = NULL;
+}
+
+
+const hpcrun_container_entry_t*
+hpcrun_container_index_find(const hpcrun_container_index_t *idx,
+			    const char *name)
+{
+  for (uint32_t i = 0; i < idx->num_members; ++i) {
+    if (strcmp(idx->members[i].name, name) == 0) {
+      return &idx->members[i];
+    }
+  }
+  return NULL;
+}
+
+
+const char*
+hpcrun_container_path_member(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  if (slash == NULL || slash[1] == '\0') {
+    return NULL;
+  }
+
+  size_t sfxLen = strlen(HPCRUN_ContainerFnmSfx);
+  size_t dirLen = slash - path;
+  if (dirLen < sfxLen + 2
+      || slash[-sfxLen - 1] != '.'
+      || strncmp(slash - sfxLen, HPCRUN_ContainerFnmSfx, sfxLen) != 0) {
+    return NULL;
+  }
+
+  return slash + 1;
+}
+
+
+FILE*
+hpcrun_container_fopen_r(const char *path)
+{
+  const char *member = hpcrun_container_path_member(path);
+  if (member == NULL) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  size_t len = member - 1 - path;
+  char *cpath = (char *) malloc(len + 1);
+  if (cpath == NULL) {
+    return NULL;
+  }
+  memcpy(cpath, path, len);
+  cpath[len] = '\0';
+
+  FILE *cfs = fopen(cpath, "r");
+  free(cpath);
+  if (cfs == NULL) {
+    return NULL;
+  }
+
+  hpcrun_container_index_t idx;
+  int ret = hpcrun_container_index_fread(&idx, cfs, malloc);
+  const hpcrun_container_entry_t *e =
+    (ret == HPCFMT_OK) ? hpcrun_container_index_find(&idx, member) : NULL;
+
+  member_stream_t *ms = NULL;
+  if (e) {
+    ms = (member_stream_t *) malloc(sizeof(*ms));
+  }
+  if (ms) {
+    ms->fd = dup(fileno(cfs));
+    ms->size = e->size;
+    ms->pos = 0;
+    ms->num_segments = e->num_segments;
+    ms->segments = e->segments;
+    ms->seg = 0;
+    ms->seg_start = 0;
+    ((hpcrun_container_entry_t *) e)->segments = NULL; // now owned by 'ms'
+  }
+
+  hpcrun_container_index_free(&idx, free);
+  fclose(cfs);
+
+  if (ms == NULL) {
+    errno = (ret == HPCFMT_OK && e == NULL) ? ENOENT : EIO;
+    return NULL;
+  }
+  if (ms->fd < 0) {
+    member_stream_close(ms);
+    return NULL;
+  }
+
+  cookie_io_functions_t fns = {
+    .read  = member_stream_read,
+    .write = NULL,
+    .seek  = member_stream_seek,
+    .close = member_stream_close
+  };
+  FILE *fs = fopencookie(ms, "r", fns);
+  if (fs == NULL) {
+    member_stream_close(ms);
+  }
+  return fs;
+}
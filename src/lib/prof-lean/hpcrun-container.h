@@ -0,0 +1,212 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   The per-process container file: hpcrun can write the profiles and
+//   traces of all threads of a process into one file instead of one
+//   file per thread and kind, and the analysis tools read its members
+//   in place.
+//
+// Description:
+//
+//   file     = hdr segment* footer trailer
+//   hdr      = magic{18b} version{5b} endian{1b}
+//   footer   = num-members{4b} [member]*
+//   member   = name-str num-segments{4b} [offset{8b} length{8b}]*
+//   trailer  = footer-offset{8b} footer-tag{8b}
+//
+//   A member's contents are its segments, concatenated in order.
+//   Threads append segments concurrently, so the segments of
+//   different members interleave.  The footer is written when the
+//   container is closed; a container without a valid trailer is
+//   incomplete.  Integers are big-endian, name-str is as in hpcfmt.
+//
+//   Members are named like the stand-alone files they replace (eg,
+//   'prog-000003-007-7f0101-1234-0.hpctrace'), and tools refer to a
+//   member with the path '<container>/<member-name>'.
+//
+//***************************************************************************
+
+#ifndef prof_lean_hpcrun_container
+#define prof_lean_hpcrun_container
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hpcfmt.h"
+#include "hpcio-buffer.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+static const char HPCRUN_CONTAINER_Magic[]   = "HPCRUN-container__"; // 18 bytes
+static const char HPCRUN_CONTAINER_Version[] = "01.00";              // 5 bytes
+static const char HPCRUN_CONTAINER_Endian[]  = "b";                  // 1 byte
+
+static const char HPCRUN_CONTAINER_FooterTag[] = "HPCPACK_";         // 8 bytes
+
+#define HPCRUN_CONTAINER_HdrSz      (24)
+#define HPCRUN_CONTAINER_TrailerSz  (16)
+#define HPCRUN_CONTAINER_NameMax    (255)
+
+
+//***************************************************************************
+// writing (hpcrun, hpcprof)
+//***************************************************************************
+
+// opaque types
+
+typedef struct hpcrun_container_s hpcrun_container_t;
+typedef struct hpcrun_container_member_s hpcrun_container_member_t;
+
+
+// Takes over 'fd' (open for writing, empty) and writes the header.
+// Memory comes from 'alloc' and is released only by
+// hpcrun_container_close().
+hpcrun_container_t*
+hpcrun_container_create(int fd, hpcfmt_alloc_fn alloc);
+
+// Adds a member.  'name' may be NULL and set later, but must be set
+// by the time the container is closed.
+hpcrun_container_member_t*
+hpcrun_container_member_new(hpcrun_container_t* c, const char* name);
+
+void
+hpcrun_container_member_setname(hpcrun_container_member_t* m,
+				 const char* name);
+
+// Appends 'size' bytes to member 'm' (an hpcrun_container_member_t*)
+// as one segment with pwrite(); safe inside signal handlers.  Members
+// may be written concurrently, but each by one thread at a time.
+//
+// Returns: 'size', else -1 with errno set.  (An hpcio_outbuf_write_fn.)
+ssize_t
+hpcrun_container_member_write(void* m, const void* data, size_t size);
+
+// Returns a stdio stream that appends to 'm' (each flush of its
+// buffer becomes one segment), else NULL.  fclose() the stream before
+// closing the container.
+FILE*
+hpcrun_container_member_fopen(hpcrun_container_member_t* m);
+
+// Writes the footer and trailer and closes the file.  No member may
+// be written during or after the close.  If 'dealloc' is non-NULL,
+// frees the container's memory.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+int
+hpcrun_container_close(hpcrun_container_t* c, hpcfmt_free_fn dealloc);
+
+
+//***************************************************************************
+// reading (hpcprof, hpcprof-mpi, hpcserver)
+//***************************************************************************
+
+typedef struct hpcrun_container_segment_t {
+  uint64_t offset;
+  uint64_t length;
+} hpcrun_container_segment_t;
+
+
+typedef struct hpcrun_container_entry_t {
+  char* name;
+  uint64_t size; // sum of segment lengths
+  uint32_t num_segments;
+  hpcrun_container_segment_t* segments;
+} hpcrun_container_entry_t;
+
+
+typedef struct hpcrun_container_index_t {
+  uint32_t num_members;
+  hpcrun_container_entry_t* members;
+} hpcrun_container_index_t;
+
+
+// Reads the footer of the container open as 'fs' (the position of
+// 'fs' is changed).
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR (eg, the file is not
+// a container or it was not closed).
+int
+hpcrun_container_index_fread(hpcrun_container_index_t* idx, FILE* fs,
+			     hpcfmt_alloc_fn alloc);
+
+void
+hpcrun_container_index_free(hpcrun_container_index_t* idx,
+			    hpcfmt_free_fn dealloc);
+
+const hpcrun_container_entry_t*
+hpcrun_container_index_find(const hpcrun_container_index_t* idx,
+			    const char* name);
+
+// If 'path' has the form '<dir>/<name>.hpcpack/<member>', returns a
+// pointer to '<member>' within 'path', else NULL.  Purely syntactic.
+const char*
+hpcrun_container_path_member(const char* path);
+
+// Opens the member named by 'path' ('<container>/<member>') as a
+// read-only stdio stream, else returns NULL with errno set.
+FILE*
+hpcrun_container_fopen_r(const char* path);
+
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif // prof_lean_hpcrun_container
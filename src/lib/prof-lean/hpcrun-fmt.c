@@ -616,28 +616,162 @@ hpcrun_fmt_loadmapEntry_free(loadmap_entry_t* x, hpcfmt_free_fn dealloc)
 // cct
 //***************************************************************************
 
- int
+// The node header is a fixed-size record (for a given set of epoch
+// flags): it is read/written as one block and then decoded, and a
+// dense metric vector is transferred with one block read/write.
+// This avoids a stream operation per byte, which dominates the cost
+// of reading profiles with many nodes.
+
+static size_t
+hpcrun_fmt_cct_node_hdr_size(epoch_flags_t flags)
+{
+  size_t sz = 4 + 4 + 2 + 8; // id, id_parent, lm_id, lm_ip
+  if (flags.fields.isLogicalUnwind) {
+    sz += 4 + (LUSH_LIP_DATA8_SZ * 8); // as_info, lip
+  }
+  return sz;
+}
+
+
+// Sparse metrics (epoch flag isSparseMetrics): see hpcrun-fmt.txt.
+// Zero is tested on the raw bits, which covers both 0 and 0.0.
+
+#define CCTNode_SparseEntryMaxSz (HPCRUN_FMT_LEB128_MaxSz + 8)
+#define CCTNode_SparseBufSz \
+  (HPCRUN_FMT_CCTNode_HdrMaxSz + HPCRUN_FMT_LEB128_MaxSz \
+   + 16 * CCTNode_SparseEntryMaxSz)
+
+static inline size_t
+leb128_put(uint8_t* b, uint64_t val)
+{
+  size_t n = 0;
+  while (val >= 0x80) {
+    b[n++] = (uint8_t)(val | 0x80);
+    val >>= 7;
+  }
+  b[n++] = (uint8_t)val;
+  return n;
+}
+
+
+static int
+leb128_fread(uint64_t* val, FILE* fs)
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = getc(fs);
+    if (c == EOF) {
+      return HPCFMT_ERR;
+    }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *val = v;
+      return HPCFMT_OK;
+    }
+  }
+  return HPCFMT_ERR;
+}
+
+
+static int
+hpcrun_fmt_cct_node_metrics_fread_sparse(hpcrun_fmt_cct_node_t* x, FILE* fs)
+{
+  uint64_t n = 0;
+  HPCFMT_ThrowIfError(leb128_fread(&n, fs));
+  if (n > x->num_metrics) {
+    return HPCFMT_ERR;
+  }
+
+  if (x->num_metrics > 0) {
+    memset(x->metrics, 0, x->num_metrics * sizeof(x->metrics[0]));
+  }
+
+  uint64_t id = (uint64_t)-1;
+  for (uint64_t i = 0; i < n; ++i) {
+    uint64_t gap = 0;
+    HPCFMT_ThrowIfError(leb128_fread(&gap, fs));
+    id += gap + 1;
+    if (id >= x->num_metrics) {
+      return HPCFMT_ERR;
+    }
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metrics[id].bits, fs));
+  }
+
+  return HPCFMT_OK;
+}
+
+
+// 'buf' (of CCTNode_SparseBufSz bytes) holds the encoded node header
+// up to 'b'; the metrics are appended and the whole record is written
+// with one fwrite unless it has many non-zero metrics.
+static int
+hpcrun_fmt_cct_node_metrics_fwrite_sparse(hpcrun_fmt_cct_node_t* x,
+					  uint8_t* buf, uint8_t* b, FILE* fs)
+{
+  uint8_t* end = buf + CCTNode_SparseBufSz;
+
+  uint64_t n = 0;
+  for (uint i = 0; i < x->num_metrics; ++i) {
+    if (x->metrics[i].bits != 0) {
+      n++;
+    }
+  }
+  b += leb128_put(b, n);
+
+  uint64_t id_prev = (uint64_t)-1;
+  for (uint i = 0; i < x->num_metrics && n > 0; ++i) {
+    if (x->metrics[i].bits == 0) {
+      continue;
+    }
+    if (b + CCTNode_SparseEntryMaxSz > end) {
+      HPCFMT_ThrowIfError(hpcfmt_fwrite(buf, b - buf, fs));
+      b = buf;
+    }
+    b += leb128_put(b, i - id_prev - 1);
+    hpcio_be8_put(b, x->metrics[i].bits);  b += 8;
+    id_prev = i;
+    n--;
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_fwrite(buf, b - buf, fs));
+  return HPCFMT_OK;
+}
+
+
+int
 hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 			  epoch_flags_t flags, FILE* fs)
 {
-  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->id, fs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->id_parent, fs));
+  uint8_t buf[HPCRUN_FMT_CCTNode_HdrMaxSz];
+  size_t sz = hpcrun_fmt_cct_node_hdr_size(flags);
+  HPCFMT_ThrowIfError(hpcfmt_fread(buf, sz, fs));
+
+  const uint8_t* b = buf;
+  x->id = hpcio_be4_get(b);         b += 4;
+  x->id_parent = hpcio_be4_get(b);  b += 4;
 
   x->as_info = lush_assoc_info_NULL;
   if (flags.fields.isLogicalUnwind) {
-    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->as_info.bits, fs));
+    x->as_info.bits = hpcio_be4_get(b);  b += 4;
   }
 
-  HPCFMT_ThrowIfError(hpcfmt_int2_fread(&x->lm_id, fs));
-  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->lm_ip, fs));
+  x->lm_id = hpcio_be2_get(b);  b += 2;
+  x->lm_ip = hpcio_be8_get(b);  b += 8;
 
   lush_lip_init(&x->lip);
   if (flags.fields.isLogicalUnwind) {
-    hpcrun_fmt_lip_fread(&x->lip, fs);
+    for (int i = 0; i < LUSH_LIP_DATA8_SZ; ++i) {
+      x->lip.data8[i] = hpcio_be8_get(b);  b += 8;
+    }
   }
 
-  for (int i = 0; i < x->num_metrics; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metrics[i].bits, fs));
+  if (flags.fields.isSparseMetrics) {
+    return hpcrun_fmt_cct_node_metrics_fread_sparse(x, fs);
+  }
+
+  if (x->num_metrics > 0) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread_vec(&x->metrics[0].bits,
+					      x->num_metrics, fs));
   }
   
   return HPCFMT_OK;
@@ -648,22 +782,35 @@ int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs)
 {
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->id, fs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->id_parent, fs));
+  uint8_t buf[CCTNode_SparseBufSz];
+  size_t sz = hpcrun_fmt_cct_node_hdr_size(flags);
+
+  uint8_t* b = buf;
+  hpcio_be4_put(b, x->id);         b += 4;
+  hpcio_be4_put(b, x->id_parent);  b += 4;
 
   if (flags.fields.isLogicalUnwind) {
-    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->as_info.bits, fs));
+    hpcio_be4_put(b, x->as_info.bits);  b += 4;
   }
 
-  HPCFMT_ThrowIfError(hpcfmt_int2_fwrite(x->lm_id, fs));
-  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->lm_ip, fs));
+  hpcio_be2_put(b, x->lm_id);  b += 2;
+  hpcio_be8_put(b, x->lm_ip);  b += 8;
 
   if (flags.fields.isLogicalUnwind) {
-    HPCFMT_ThrowIfError(hpcrun_fmt_lip_fwrite(&x->lip, fs));
+    for (int i = 0; i < LUSH_LIP_DATA8_SZ; ++i) {
+      hpcio_be8_put(b, x->lip.data8[i]);  b += 8;
+    }
   }
 
-  for (int i = 0; i < x->num_metrics; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+  if (flags.fields.isSparseMetrics) {
+    return hpcrun_fmt_cct_node_metrics_fwrite_sparse(x, buf, b, fs);
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_fwrite(buf, sz, fs));
+
+  if (x->num_metrics > 0) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite_vec(&x->metrics[0].bits,
+					       x->num_metrics, fs));
   }
   
   return HPCFMT_OK;
@@ -1049,3 +1196,414 @@ hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   return HPCFMT_OK;
 }
 
+
+//***************************************************************************
+// [hpcprof-metricdb] sparse format
+//***************************************************************************
+
+int
+hpcmetricDB_sparse_fmt_hdr_fread(hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				 FILE* infs)
+{
+  char tag[HPCMETRICDB_SPARSE_FMT_MagicLen + 1];
+
+  int nr = fread(tag, 1, HPCMETRICDB_SPARSE_FMT_MagicLen, infs);
+  tag[HPCMETRICDB_SPARSE_FMT_MagicLen] = '\0';
+
+  if (nr != HPCMETRICDB_SPARSE_FMT_MagicLen) {
+    return HPCFMT_ERR;
+  }
+  if (strcmp(tag, HPCMETRICDB_SPARSE_FMT_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(hdr->versionStr, 1, HPCMETRICDB_SPARSE_FMT_VersionLen, infs);
+  hdr->versionStr[HPCMETRICDB_SPARSE_FMT_VersionLen] = '\0';
+  if (nr != HPCMETRICDB_SPARSE_FMT_VersionLen) {
+    return HPCFMT_ERR;
+  }
+  hdr->version = atof(hdr->versionStr);
+
+  nr = fread(&hdr->endian, 1, HPCMETRICDB_SPARSE_FMT_EndianLen, infs);
+  if (nr != HPCMETRICDB_SPARSE_FMT_EndianLen) {
+    return HPCFMT_ERR;
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numMetrics), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numRows), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->numValues), infs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_fmt_hdr_fwrite(hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				  FILE* outfs)
+{
+  int nw;
+
+  nw = fwrite(HPCMETRICDB_SPARSE_FMT_Magic, 1,
+	      HPCMETRICDB_SPARSE_FMT_MagicLen, outfs);
+  if (nw != HPCMETRICDB_SPARSE_FMT_MagicLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCMETRICDB_SPARSE_FMT_Version, 1,
+	      HPCMETRICDB_SPARSE_FMT_VersionLen, outfs);
+  if (nw != HPCMETRICDB_SPARSE_FMT_VersionLen) return HPCFMT_ERR;
+
+  nw = fwrite(HPCMETRICDB_SPARSE_FMT_Endian, 1,
+	      HPCMETRICDB_SPARSE_FMT_EndianLen, outfs);
+  if (nw != HPCMETRICDB_SPARSE_FMT_EndianLen) return HPCFMT_ERR;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numMetrics, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numRows, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->numValues, outfs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_fmt_hdr_fprint(hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				  FILE* outfs)
+{
+  fprintf(outfs, "%s\n", HPCMETRICDB_SPARSE_FMT_Magic);
+  fprintf(outfs, "[hdr:...]\n");
+
+  fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
+  fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
+  fprintf(outfs, "(num-rows:    %u)\n", hdr->numRows);
+  fprintf(outfs, "(num-values:  %"PRIu64")\n", hdr->numValues);
+
+  return HPCFMT_OK;
+}
+
+
+// Index entries and values are (de)coded a block at a time so that
+// each block costs a single fread/fwrite.
+
+int
+hpcmetricDB_sparse_fmt_index_fread(hpcmetricDB_sparse_fmt_row_t* rows,
+				   uint32_t n, FILE* infs)
+{
+  uint8_t buf[HPCIO_VecBlockSz * HPCMETRICDB_SPARSE_FMT_RowSz];
+
+  while (n > 0) {
+    uint32_t k = (n < HPCIO_VecBlockSz) ? n : HPCIO_VecBlockSz;
+    size_t sz = k * HPCMETRICDB_SPARSE_FMT_RowSz;
+    if (fread(buf, 1, sz, infs) != sz) {
+      return HPCFMT_ERR;
+    }
+
+    const uint8_t* b = buf;
+    for (uint32_t i = 0; i < k; ++i, b += HPCMETRICDB_SPARSE_FMT_RowSz) {
+      rows[i].nodeId   = hpcio_be4_get(b);
+      rows[i].valueIdx = hpcio_be8_get(b + 4);
+    }
+    rows += k;
+    n -= k;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_fmt_index_fwrite(const hpcmetricDB_sparse_fmt_row_t* rows,
+				    uint32_t n, FILE* outfs)
+{
+  uint8_t buf[HPCIO_VecBlockSz * HPCMETRICDB_SPARSE_FMT_RowSz];
+
+  while (n > 0) {
+    uint32_t k = (n < HPCIO_VecBlockSz) ? n : HPCIO_VecBlockSz;
+
+    uint8_t* b = buf;
+    for (uint32_t i = 0; i < k; ++i, b += HPCMETRICDB_SPARSE_FMT_RowSz) {
+      hpcio_be4_put(b, rows[i].nodeId);
+      hpcio_be8_put(b + 4, rows[i].valueIdx);
+    }
+
+    size_t sz = k * HPCMETRICDB_SPARSE_FMT_RowSz;
+    if (fwrite(buf, 1, sz, outfs) != sz) {
+      return HPCFMT_ERR;
+    }
+    rows += k;
+    n -= k;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_fmt_values_fread(hpcmetricDB_sparse_fmt_value_t* vals,
+				    uint64_t n, FILE* infs)
+{
+  uint8_t buf[HPCIO_VecBlockSz * HPCMETRICDB_SPARSE_FMT_ValueSz];
+
+  while (n > 0) {
+    uint32_t k = (n < HPCIO_VecBlockSz) ? (uint32_t)n : HPCIO_VecBlockSz;
+    size_t sz = k * HPCMETRICDB_SPARSE_FMT_ValueSz;
+    if (fread(buf, 1, sz, infs) != sz) {
+      return HPCFMT_ERR;
+    }
+
+    const uint8_t* b = buf;
+    for (uint32_t i = 0; i < k; ++i, b += HPCMETRICDB_SPARSE_FMT_ValueSz) {
+      hpcfmt_byte8_union_t v;
+      v.i8 = hpcio_be8_get(b + 2);
+      vals[i].metricId = hpcio_be2_get(b);
+      vals[i].value = v.r8;
+    }
+    vals += k;
+    n -= k;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_fmt_values_fwrite(const hpcmetricDB_sparse_fmt_value_t* vals,
+				     uint64_t n, FILE* outfs)
+{
+  uint8_t buf[HPCIO_VecBlockSz * HPCMETRICDB_SPARSE_FMT_ValueSz];
+
+  while (n > 0) {
+    uint32_t k = (n < HPCIO_VecBlockSz) ? (uint32_t)n : HPCIO_VecBlockSz;
+
+    uint8_t* b = buf;
+    for (uint32_t i = 0; i < k; ++i, b += HPCMETRICDB_SPARSE_FMT_ValueSz) {
+      hpcfmt_byte8_union_t v;
+      v.r8 = vals[i].value;
+      hpcio_be2_put(b, vals[i].metricId);
+      hpcio_be8_put(b + 2, v.i8);
+    }
+
+    size_t sz = k * HPCMETRICDB_SPARSE_FMT_ValueSz;
+    if (fwrite(buf, 1, sz, outfs) != sz) {
+      return HPCFMT_ERR;
+    }
+    vals += k;
+    n -= k;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_fmt_node_fread(const hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				  const hpcmetricDB_sparse_fmt_row_t* rows,
+				  uint32_t nodeId,
+				  hpcmetricDB_sparse_fmt_value_t* vals,
+				  uint32_t* numVals, FILE* infs)
+{
+  *numVals = 0;
+
+  // binary search for 'nodeId' among [0, numRows); the sentinel at
+  // rows[numRows] bounds the last row
+  uint32_t lo = 0, hi = hdr->numRows;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (rows[mid].nodeId < nodeId) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  if (lo == hdr->numRows || rows[lo].nodeId != nodeId) {
+    return HPCFMT_OK;
+  }
+
+  uint64_t beg = rows[lo].valueIdx;
+  uint64_t end = rows[lo + 1].valueIdx;
+  if (end < beg || end - beg > hdr->numMetrics) {
+    return HPCFMT_ERR;
+  }
+
+  off_t off = (off_t)(hpcmetricDB_sparse_fmt_values_offset(hdr)
+		      + beg * HPCMETRICDB_SPARSE_FMT_ValueSz);
+  if (fseeko(infs, off, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  HPCFMT_ThrowIfError(hpcmetricDB_sparse_fmt_values_fread(vals, end - beg,
+							   infs));
+  *numVals = (uint32_t)(end - beg);
+  return HPCFMT_OK;
+}
+
+
+
+//***************************************************************************
+// unit test: cct node reader benchmark
+//
+//   cc -std=gnu99 -O2 -DUNIT_TEST=1 -I.. -I../.. hpcrun-fmt.c hpcfmt.c
+//      hpcio.c hpcio-buffer.c hpcrun-container.c lush/lush-support.c
+//   ./a.out [nodes] [metrics]
+//
+// from this directory in a configured tree (include/hpctoolkit-config.h
+// is generated by configure; with a separate build directory, add
+// -I<build>/src).
+//
+// writes a profile's worth of dense cct node records to a temporary
+// file, then reads them back with the block reader above and with the
+// former per-byte fgetc() reader (kept below), checks that both decode
+// the same values, and prints the time each takes.
+//***************************************************************************
+
+#ifndef UNIT_TEST
+#define UNIT_TEST 0
+#endif
+
+#if UNIT_TEST
+
+#include <time.h>
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// the reader before block decoding: one fgetc() per byte
+static int
+fgetc_beX_fread(uint64_t* val, int size, FILE* fs)
+{
+  uint64_t v = 0;
+  for (int shift = 8 * (size - 1); shift >= 0; shift -= 8) {
+    int c = fgetc(fs);
+    if (c == EOF) {
+      return (shift == 8 * (size - 1) && feof(fs)) ? HPCFMT_EOF : HPCFMT_ERR;
+    }
+    v |= ((uint64_t)(c & 0xff) << shift);
+  }
+  *val = v;
+  return HPCFMT_OK;
+}
+
+
+static int
+fgetc_cct_node_fread(hpcrun_fmt_cct_node_t* x, epoch_flags_t flags, FILE* fs)
+{
+  uint64_t v;
+
+  HPCFMT_ThrowIfError(fgetc_beX_fread(&v, 4, fs));  x->id = v;
+  HPCFMT_ThrowIfError(fgetc_beX_fread(&v, 4, fs));  x->id_parent = v;
+
+  x->as_info = lush_assoc_info_NULL;
+  if (flags.fields.isLogicalUnwind) {
+    HPCFMT_ThrowIfError(fgetc_beX_fread(&v, 4, fs));  x->as_info.bits = v;
+  }
+
+  HPCFMT_ThrowIfError(fgetc_beX_fread(&v, 2, fs));  x->lm_id = v;
+  HPCFMT_ThrowIfError(fgetc_beX_fread(&x->lm_ip, 8, fs));
+
+  lush_lip_init(&x->lip);
+  if (flags.fields.isLogicalUnwind) {
+    for (int i = 0; i < LUSH_LIP_DATA8_SZ; ++i) {
+      HPCFMT_ThrowIfError(fgetc_beX_fread(&x->lip.data8[i], 8, fs));
+    }
+  }
+
+  for (int i = 0; i < x->num_metrics; ++i) {
+    HPCFMT_ThrowIfError(fgetc_beX_fread(&x->metrics[i].bits, 8, fs));
+  }
+
+  return HPCFMT_OK;
+}
+
+
+typedef int (*cct_node_fread_fn)(hpcrun_fmt_cct_node_t*, epoch_flags_t, FILE*);
+
+// returns a checksum of the decoded nodes, or 0 on a read error
+static uint64_t
+read_all(cct_node_fread_fn fread_fn, FILE* fs, long nodes, int metrics,
+	 double* secs)
+{
+  hpcrun_metricVal_t vals[metrics];
+  hpcrun_fmt_cct_node_t x;
+  hpcrun_fmt_cct_node_init(&x);
+  x.num_metrics = metrics;
+  x.metrics = vals;
+
+  epoch_flags_t flags;
+  flags.bits = 0;
+
+  rewind(fs);
+  uint64_t sum = 1;
+  double t = now();
+  for (long n = 0; n < nodes; n++) {
+    if (fread_fn(&x, flags, fs) != HPCFMT_OK) {
+      return 0;
+    }
+    sum = sum * 31 + x.id + x.id_parent + x.lm_id + x.lm_ip;
+    for (int i = 0; i < metrics; i++) {
+      sum = sum * 31 + x.metrics[i].bits;
+    }
+  }
+  *secs = now() - t;
+
+  return sum;
+}
+
+
+int
+main(int argc, char** argv)
+{
+  long nodes = (argc > 1) ? atol(argv[1]) : 2000000;
+  int metrics = (argc > 2) ? atoi(argv[2]) : 20;
+
+  FILE* fs = tmpfile();
+  if (fs == NULL) {
+    perror("tmpfile");
+    return 1;
+  }
+  setvbuf(fs, NULL, _IOFBF, HPCIO_RWBufferSz);
+
+  hpcrun_metricVal_t vals[metrics];
+  hpcrun_fmt_cct_node_t x;
+  hpcrun_fmt_cct_node_init(&x);
+  x.num_metrics = metrics;
+  x.metrics = vals;
+
+  epoch_flags_t flags;
+  flags.bits = 0;
+
+  for (long n = 0; n < nodes; n++) {
+    x.id = 2 * n + 2;
+    x.id_parent = n;
+    x.lm_id = n % 7;
+    x.lm_ip = 0x400000 + 16 * n;
+    for (int i = 0; i < metrics; i++) {
+      x.metrics[i].r = (double)(n * metrics + i);
+    }
+    if (hpcrun_fmt_cct_node_fwrite(&x, flags, fs) != HPCFMT_OK) {
+      fprintf(stderr, "write failed\n");
+      return 1;
+    }
+  }
+  fflush(fs);
+
+  double t_fgetc, t_block;
+  uint64_t sum_fgetc = read_all(fgetc_cct_node_fread, fs, nodes, metrics,
+				&t_fgetc);
+  uint64_t sum_block = read_all(hpcrun_fmt_cct_node_fread, fs, nodes,
+				metrics, &t_block);
+
+  printf("%ld nodes x %d metrics\n", nodes, metrics);
+  printf("  fgetc reader: %.3fs\n", t_fgetc);
+  printf("  block reader: %.3fs\n", t_block);
+
+  if (sum_fgetc == 0 || sum_fgetc != sum_block) {
+    printf("  MISMATCH\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+#endif
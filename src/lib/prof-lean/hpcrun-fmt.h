@@ -98,9 +98,16 @@ static const char HPCRUN_TraceFnmSfx[] = "hpctrace";
 // hpcrun log filename suffix
 static const char HPCRUN_LogFnmSfx[] = "log";
 
+// hpcrun per-process container (profiles and traces of all threads)
+// filename suffix; see hpcrun-container.h
+static const char HPCRUN_ContainerFnmSfx[] = "hpcpack";
+
 // hpcprof metric db filename suffix
 static const char HPCPROF_MetricDBSfx[] = "metric-db";
 
+// hpcprof sparse metric db filename suffix
+static const char HPCPROF_SparseMetricDBSfx[] = "metric-sdb";
+
 static const char HPCPROF_TmpFnmSfx[] = "tmp";
 
 
@@ -111,7 +118,7 @@ static const char HPCPROF_TmpFnmSfx[] = "tmp";
 // N.B.: The header string is 24 bytes of character data
 
 static const char HPCRUN_FMT_Magic[]   = "HPCRUN-profile____"; // 18 bytes
-static const char HPCRUN_FMT_Version[] = "03.00";              // 5 bytes
+static const char HPCRUN_FMT_Version[] = "04.00";              // 5 bytes
 static const char HPCRUN_FMT_Endian[]  = "b";                  // 1 byte
 
 static const int HPCRUN_FMT_MagicLen   = (sizeof(HPCRUN_FMT_Magic) - 1);
@@ -119,8 +126,13 @@ static const int HPCRUN_FMT_VersionLen = (sizeof(HPCRUN_FMT_Version) - 1);
 static const int HPCRUN_FMT_EndianLen  = (sizeof(HPCRUN_FMT_Endian) - 1);
 
 
-// currently supported versions
+// currently supported versions: 2.0 up to, but not including, 5.0.
+// 4.0 adds sparse CCT node metrics (epoch flag 'isSparseMetrics').
+// later major versions may change the format in ways this reader
+// cannot see, so they are rejected rather than misread.
 static const double HPCRUN_FMT_Version_20 = 2.0;
+static const double HPCRUN_FMT_Version_40 = 4.0;
+static const double HPCRUN_FMT_Version_50 = 5.0;
 
 
 typedef struct hpcrun_fmt_hdr_t {
@@ -177,7 +189,8 @@ static const int  HPCRUN_FMT_EpochTagLen = (sizeof(HPCRUN_FMT_EpochTag) - 1);
 
 typedef struct epoch_flags_bitfield {
   bool isLogicalUnwind : 1;
-  uint64_t unused      : 63;
+  bool isSparseMetrics : 1; // CCT node metrics as (id, value) pairs
+  uint64_t unused      : 62;
 } epoch_flags_bitfield;
 
 
@@ -517,6 +530,18 @@ hpcrun_fmt_doRetainId(uint32_t id)
 // Secondary synthetic root: <lm-id: NULL, lm-ip: Flag1>
 
 
+// Upper bound on the size of the fixed node header (everything before
+// the metric vector): id, id_parent, as_info, lm_id, lm_ip, lip
+#define HPCRUN_FMT_CCTNode_HdrMaxSz (4 + 4 + 4 + 2 + 8 + (LUSH_LIP_DATA8_SZ * 8))
+
+// Metric encoding of a node.  Dense: 'num_metrics' 8-byte values.
+// Sparse (epoch flag 'isSparseMetrics'): a LEB128 count of non-zero
+// values, then for each one the LEB128 gap from the previous metric id
+// (the first is relative to -1) followed by the 8-byte value.  Most
+// nodes are interior and have no metrics, so they cost a single byte.
+#define HPCRUN_FMT_LEB128_MaxSz (10)
+
+
 typedef struct hpcrun_fmt_cct_node_t {
 
   // id and parent id.  0 is reserved as a NULL value
@@ -772,6 +797,134 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+//***************************************************************************
+// [hpcprof-metricdb] sparse format
+//***************************************************************************
+
+// A sparse metric-db file stores only the non-zero values of one
+// profile as compressed rows, one row per CCT node that has at least
+// one non-zero value:
+//
+//   hdr:    magic, version, endian, numNodes (4), numMetrics (4),
+//           numRows (4), numValues (8)
+//   index:  numRows + 1 entries of (nodeId (4), valueIdx (8)), sorted by
+//           nodeId.  Row r's values are [index[r].valueIdx,
+//           index[r+1].valueIdx); the last entry is a sentinel with
+//           nodeId = numNodes + 1 and valueIdx = numValues.
+//   values: numValues entries of (metricId (2), value (real8)), sorted
+//           by metricId within each row.
+//
+// As in the dense format, node ids begin at 1 and metric ids are
+// relative to the first metric of the profile.
+
+static const char HPCMETRICDB_SPARSE_FMT_Magic[]   = "HPCPROF-sparsedb__"; // 18 bytes
+static const char HPCMETRICDB_SPARSE_FMT_Version[] = "00.10";              // 5 bytes
+static const char HPCMETRICDB_SPARSE_FMT_Endian[]  = "b";                  // 1 byte
+
+#define HPCMETRICDB_SPARSE_FMT_MagicLenX   (sizeof(HPCMETRICDB_SPARSE_FMT_Magic) - 1)
+#define HPCMETRICDB_SPARSE_FMT_VersionLenX (sizeof(HPCMETRICDB_SPARSE_FMT_Version) - 1)
+#define HPCMETRICDB_SPARSE_FMT_EndianLenX  (sizeof(HPCMETRICDB_SPARSE_FMT_Endian) - 1)
+
+static const int HPCMETRICDB_SPARSE_FMT_MagicLen   = HPCMETRICDB_SPARSE_FMT_MagicLenX;
+static const int HPCMETRICDB_SPARSE_FMT_VersionLen = HPCMETRICDB_SPARSE_FMT_VersionLenX;
+static const int HPCMETRICDB_SPARSE_FMT_EndianLen  = HPCMETRICDB_SPARSE_FMT_EndianLenX;
+
+// size (in bytes) of the complete header, an index entry and a value
+static const int HPCMETRICDB_SPARSE_FMT_HeaderLen =
+  (HPCMETRICDB_SPARSE_FMT_MagicLenX + HPCMETRICDB_SPARSE_FMT_VersionLenX
+   + HPCMETRICDB_SPARSE_FMT_EndianLenX + 4 + 4 + 4 + 8);
+
+#define HPCMETRICDB_SPARSE_FMT_RowSz   (4 + 8)
+#define HPCMETRICDB_SPARSE_FMT_ValueSz (2 + 8)
+
+// metric ids are stored in 2 bytes
+#define HPCMETRICDB_SPARSE_FMT_MaxMetrics (1 << 16)
+
+
+typedef struct hpcmetricDB_sparse_fmt_hdr_t {
+
+  char versionStr[sizeof(HPCMETRICDB_SPARSE_FMT_Version)];
+  double version;
+  char endian;
+
+  uint32_t numNodes;
+  uint32_t numMetrics;
+  uint32_t numRows;
+  uint64_t numValues;
+
+} hpcmetricDB_sparse_fmt_hdr_t;
+
+
+typedef struct hpcmetricDB_sparse_fmt_row_t {
+
+  uint32_t nodeId;
+  uint64_t valueIdx;
+
+} hpcmetricDB_sparse_fmt_row_t;
+
+
+typedef struct hpcmetricDB_sparse_fmt_value_t {
+
+  uint16_t metricId;
+  double value;
+
+} hpcmetricDB_sparse_fmt_value_t;
+
+
+// file offset of the first value
+static inline uint64_t
+hpcmetricDB_sparse_fmt_values_offset(const hpcmetricDB_sparse_fmt_hdr_t* hdr)
+{
+  return (HPCMETRICDB_SPARSE_FMT_HeaderLen
+	  + ((uint64_t)hdr->numRows + 1) * HPCMETRICDB_SPARSE_FMT_RowSz);
+}
+
+
+int
+hpcmetricDB_sparse_fmt_hdr_fread(hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				 FILE* infs);
+
+int
+hpcmetricDB_sparse_fmt_hdr_fwrite(hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				  FILE* outfs);
+
+int
+hpcmetricDB_sparse_fmt_hdr_fprint(hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				  FILE* outfs);
+
+
+// Read/write 'n' consecutive index entries (normally hdr->numRows + 1)
+int
+hpcmetricDB_sparse_fmt_index_fread(hpcmetricDB_sparse_fmt_row_t* rows,
+				   uint32_t n, FILE* infs);
+
+int
+hpcmetricDB_sparse_fmt_index_fwrite(const hpcmetricDB_sparse_fmt_row_t* rows,
+				    uint32_t n, FILE* outfs);
+
+
+// Read/write 'n' consecutive values
+int
+hpcmetricDB_sparse_fmt_values_fread(hpcmetricDB_sparse_fmt_value_t* vals,
+				    uint64_t n, FILE* infs);
+
+int
+hpcmetricDB_sparse_fmt_values_fwrite(const hpcmetricDB_sparse_fmt_value_t* vals,
+				     uint64_t n, FILE* outfs);
+
+
+// Random access: given the header and the index ('rows', with
+// hdr->numRows + 1 entries), read the values of node 'nodeId' into
+// 'vals' (which must have room for hdr->numMetrics values) and set
+// '*numVals'.  A node without a row has no non-zero values.
+int
+hpcmetricDB_sparse_fmt_node_fread(const hpcmetricDB_sparse_fmt_hdr_t* hdr,
+				  const hpcmetricDB_sparse_fmt_row_t* rows,
+				  uint32_t nodeId,
+				  hpcmetricDB_sparse_fmt_value_t* vals,
+				  uint32_t* numVals, FILE* infs);
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
@@ -74,8 +74,15 @@ using std::vector;
 #include <set>
 using std::set;
 
+#include <unordered_map>
+
 #include <typeinfo>
 
+#include <algorithm>
+#include <utility>
+
+#include <climits>
+
 //*************************** User Include Files ****************************
 
 #include <include/gcc-attr.h>
@@ -336,7 +343,7 @@ ANode::IntToANodeType(long i)
   return (ANodeTy)i;
 }
 
-uint ANode::s_nextUniqueId = 2;
+std::atomic<uint> ANode::s_nextUniqueId(2);
 
 
 //***************************************************************************
@@ -464,72 +471,111 @@ ANode::aggregateMetricsIncl(uint mBegId, uint mEndId)
 }
 
 
-void
-ANode::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
+// numberPreorder: Number the subtree rooted at 'root' in preorder
+// with an explicit stack, so that a node always follows its
+// ancestors.  'parentIdx' gives the preorder index of each node's
+// parent, or UINT_MAX for the root.
+static void
+numberPreorder(ANode* root, vector<ANode*>& nodes, vector<uint>& parentIdx)
 {
-  if (ivalset.empty()) {
-    return; // short circuit
-  }
+  vector<std::pair<ANode*, uint> > stack;
+  stack.push_back(std::make_pair(root, (uint)UINT_MAX));
 
-  const ANode* root = this;
-  ANodeIterator it(root, NULL/*filter*/, false/*leavesOnly*/,
-		   IteratorStack::PostOrder);
-  for (ANode* n = NULL; (n = it.current()); ++it) {
-    if (n != root) {
-      ANode* n_parent = n->parent();
-      
-      for (VMAIntervalSet::const_iterator it1 = ivalset.begin();
-	   it1 != ivalset.end(); ++it1) {
-	const VMAInterval& ival = *it1;
-	uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
-
-	for (uint mId = mBegId; mId < mEndId; ++mId) {
-	  double mVal = n->demandMetric(mId, mEndId/*size*/);
-	  n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
-	}
-      }
+  while (!stack.empty()) {
+    ANode* n = stack.back().first;
+    uint p = stack.back().second;
+    stack.pop_back();
+
+    uint idx = nodes.size();
+    nodes.push_back(n);
+    parentIdx.push_back(p);
+
+    // push children in reverse so that they are numbered in order
+    size_t top = stack.size();
+    for (ANodeChildIterator it(n); it.Current(); ++it) {
+      stack.push_back(std::make_pair(it.current(), idx));
     }
+    std::reverse(stack.begin() + top, stack.end());
   }
 }
 
 
-void
-ANode::aggregateMetricsExcl(uint mBegId, uint mEndId)
+// accumulateMetrics: In reverse preorder (every node after all of its
+// descendants, i.e., the order of a post-order walk), add the values
+// in 'ivalset' of each node i to nodes tgt1[i] and tgt2[i] (either may
+// be UINT_MAX).  Values are read and written in place in each node's
+// metric vector; all of a node's metrics are moved in one visit.
+static void
+accumulateMetrics(const vector<ANode*>& nodes, const VMAIntervalSet& ivalset,
+		  const vector<uint>& tgt1, const vector<uint>* tgt2)
 {
-  VMAIntervalSet ivalset; // TODO: cheat using a VMAInterval set
-  for (uint mId = mBegId; mId < mEndId; ++mId) {
-    ivalset.insert(VMAInterval(mId, mId + 1)); // [ )
+  for (uint idx = nodes.size(); idx-- > 0; ) {
+    uint t1 = tgt1[idx];
+    uint t2 = (tgt2) ? (*tgt2)[idx] : (uint)UINT_MAX;
+    if (t1 == UINT_MAX && t2 == UINT_MAX) {
+      continue;
+    }
+
+    ANode* n = nodes[idx];
+    ANode* n_t1 = (t1 != UINT_MAX) ? nodes[t1] : NULL;
+    ANode* n_t2 = (t2 != UINT_MAX) ? nodes[t2] : NULL;
+
+    for (VMAIntervalSet::const_iterator it = ivalset.begin();
+	 it != ivalset.end(); ++it) {
+      uint mBegId = (uint)it->beg(), mEndId = (uint)it->end();
+
+      for (uint mId = mBegId; mId < mEndId; ++mId) {
+	double mVal = n->demandMetric(mId, mEndId/*size*/);
+	if (n_t1) {
+	  n_t1->demandMetric(mId, mEndId/*size*/) += mVal;
+	}
+	if (n_t2) {
+	  n_t2->demandMetric(mId, mEndId/*size*/) += mVal;
+	}
+      }
+    }
   }
-  aggregateMetricsExcl(ivalset);
 }
 
 
 void
-ANode::aggregateMetricsExcl(const VMAIntervalSet& ivalset)
+ANode::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
 {
   if (ivalset.empty()) {
     return; // short circuit
   }
 
-  AProcNode* frame = NULL; // will be set during tree traversal
-  aggregateMetricsExcl(frame, ivalset);
+  // Every node (but the root) adds its value to its parent.
+  vector<ANode*> nodes;
+  vector<uint> parentIdx;
+  numberPreorder(this, nodes, parentIdx);
+
+  accumulateMetrics(nodes, ivalset, parentIdx, NULL);
 }
 
 
 void
-ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
+ANode::aggregateMetricsExcl(uint mBegId, uint mEndId)
 {
-  ANode* n = this;
+  VMAIntervalSet ivalset; // TODO: cheat using a VMAInterval set
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    ivalset.insert(VMAInterval(mId, mId + 1)); // [ )
+  }
+  aggregateMetricsExcl(ivalset);
+}
 
-  // -------------------------------------------------------
-  // Pre-order visit
-  // -------------------------------------------------------
-  //
-  // laks 2015.10.21: we don't want accumulate the exclusive cost of 
-  // an inlined statement to the caller. Instead, we assume an inline
-  // function (Proc) as the same as a normal procedure (ProcFrm).
-  // And the lowest common ancestor for Proc and ProcFrm is AProcNode.
-  //
+
+// classifyForExcl: Determine whether 'n' is a logical procedure (an
+// exclusive-cost frame for its descendants) and whether it passes its
+// exclusive cost to its parent and frame (CCT::Stmts and inline macros).
+//
+// laks 2015.10.21: we don't want accumulate the exclusive cost of 
+// an inlined statement to the caller. Instead, we assume an inline
+// function (Proc) as the same as a normal procedure (ProcFrm).
+// And the lowest common ancestor for Proc and ProcFrm is AProcNode.
+static void
+classifyForExcl(ANode* n, bool& isLogicalProc, bool& isExclSrc)
+{
   bool isFrame = (typeid(*n) == typeid(ProcFrm));
   bool isProc  = (typeid(*n) == typeid(Proc));
 
@@ -559,34 +605,67 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
     isInlineMacro = !isInlineCall && myprocname.compare(GUARD_NAME) == 0;
   }
 
-  bool isLogicalProc   = isFrame || isInlineCall || isInlineMacro;
-  AProcNode * frameNxt = (isLogicalProc) ? static_cast<AProcNode*>(n) : frame;
+  isLogicalProc = isFrame || isInlineCall || isInlineMacro;
+  isExclSrc     = (typeid(*n) == typeid(CCT::Stmt)) || isInlineMacro;
+}
 
-  // -------------------------------------------------------
-  // Tree traversal
-  // -------------------------------------------------------
-  for (ANodeChildIterator it(n); it.Current(); ++it) {
-    ANode* x = it.current();
-    x->aggregateMetricsExcl(frameNxt, ivalset);
+
+void
+ANode::aggregateMetricsExcl(const VMAIntervalSet& ivalset)
+{
+  if (ivalset.empty()) {
+    return; // short circuit
   }
 
-  // -------------------------------------------------------
-  // Post-order visit
-  // -------------------------------------------------------
-  if (typeid(*n) == typeid(CCT::Stmt) || isInlineMacro) {
-    ANode* n_parent = n->parent();
+  // Each CCT::Stmt (or inline macro) adds its value to its parent and,
+  // if different, to its enclosing logical procedure (frame).  The
+  // frame of a node is its nearest logical-procedure ancestor, not
+  // counting the subtree root's own ancestors.
+  vector<ANode*> nodes;
+  vector<uint> parentIdx;
+  numberPreorder(this, nodes, parentIdx);
 
-    for (VMAIntervalSet::const_iterator it = ivalset.begin();
-        it != ivalset.end(); ++it) {
-      const VMAInterval& ival = *it;
-      uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
+  uint numNodes = nodes.size();
+  vector<bool> isLogicalProc(numNodes);
+  vector<uint> frameIdx(numNodes, UINT_MAX);
+  vector<uint> tgtParent(numNodes, UINT_MAX);
+  vector<uint> tgtFrame(numNodes, UINT_MAX);
+
+  bool isRootExclSrc = false;
+
+  for (uint idx = 0; idx < numNodes; ++idx) {
+    bool isLP = false, isExclSrc = false;
+    classifyForExcl(nodes[idx], isLP, isExclSrc);
+    isLogicalProc[idx] = isLP;
+
+    uint p = parentIdx[idx];
+    if (p != UINT_MAX) {
+      frameIdx[idx] = (isLogicalProc[p]) ? p : frameIdx[p];
+    }
+
+    if (isExclSrc) {
+      if (p == UINT_MAX) {
+	isRootExclSrc = true; // parent is outside the subtree
+      }
+      else {
+	tgtParent[idx] = p;
+	if (frameIdx[idx] != p) {
+	  tgtFrame[idx] = frameIdx[idx];
+	}
+      }
+    }
+  }
+
+  accumulateMetrics(nodes, ivalset, tgtParent, &tgtFrame);
 
+  ANode* n_parent = parent();
+  if (isRootExclSrc && n_parent) {
+    for (VMAIntervalSet::const_iterator it = ivalset.begin();
+	 it != ivalset.end(); ++it) {
+      uint mBegId = (uint)it->beg(), mEndId = (uint)it->end();
       for (uint mId = mBegId; mId < mEndId; ++mId) {
-        double mVal = n->demandMetric(mId, mEndId/*size*/);
-        n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
-        if (frame && frame != n_parent) {
-          frame->demandMetric(mId, mEndId/*size*/) += mVal;
-        }
+	double mVal = demandMetric(mId, mEndId/*size*/);
+	n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
       }
     }
   }
@@ -812,6 +891,114 @@ ANode::deleteChaff(ANode* x, uint8_t* deletedNodes)
 // Merging
 //**********************************************************************
 
+// DynChildIndex: A hash index over the direct ADynNode descendents of
+// a node x (cf. ANode::findDynChild), used by ANode::mergeDeep when x
+// has a large fan-out.  Merging n children into a node with m children
+// then costs O(n + m) instead of O(n * m).
+//
+// The index covers the standard merge condition of
+// ADynNode::isMergable() for nodes without a logical unwinding
+// association; lookups for other nodes (associations, or structured
+// leaves that may match through structure) must use findDynChild().
+// For each key, the index holds the *first* descendent in
+// findDynChild() order, so both return the same node.
+class DynChildIndex {
+public:
+  // the minimum fan-out for which an index is worth building
+  static const uint MinChildren = 16;
+
+  DynChildIndex(ANode* x)
+  {
+    m_map.reserve(x->childCount());
+    insertDescendents(x);
+  }
+
+  // isApplicable: whether find() is equivalent to findDynChild() for 'y'
+  static bool
+  isApplicable(const ADynNode& y)
+  {
+    return (y.assoc() == LUSH_ASSOC_NULL && !y.structure());
+  }
+
+  ADynNode*
+  find(const ADynNode& y) const
+  {
+    Map::const_iterator it = m_map.find(Key(y));
+    return (it != m_map.end()) ? it->second : NULL;
+  }
+
+  // insert: add a node that was just linked as the last child
+  void
+  insert(ADynNode* x_dyn)
+  {
+    if (x_dyn->assoc() == LUSH_ASSOC_NULL) {
+      m_map.insert(std::make_pair(Key(*x_dyn), x_dyn)); // keeps first
+    }
+  }
+
+private:
+  struct Key {
+    Key(const ADynNode& x)
+      : isLeaf(x.isLeaf()), lmId(x.lmId_real()), lmIP(x.lmIP_real()),
+	hasLip(x.lip() != NULL),
+	pathLen(lush_assoc_info__get_path_len(x.assocInfo()))
+    {
+      lip[0] = (hasLip) ? x.lip()->data8[0] : 0;
+      lip[1] = (hasLip) ? x.lip()->data8[1] : 0;
+    }
+
+    bool
+    operator==(const Key& y) const
+    {
+      return (isLeaf == y.isLeaf && lmId == y.lmId && lmIP == y.lmIP
+	      && hasLip == y.hasLip && lip[0] == y.lip[0] && lip[1] == y.lip[1]
+	      && pathLen == y.pathLen);
+    }
+
+    bool isLeaf;
+    LoadMap::LMId_t lmId;
+    VMA lmIP;
+    bool hasLip;
+    uint64_t lip[2];
+    uint32_t pathLen;
+  };
+
+  struct KeyHash {
+    size_t
+    operator()(const Key& x) const
+    {
+      uint64_t h = x.lmIP;
+      h = h * 31 + x.lmId;
+      h = h * 31 + ((x.isLeaf << 1) | x.hasLip);
+      h = h * 31 + x.pathLen;
+      h ^= x.lip[0] + (h << 6) + (h >> 2);
+      h ^= x.lip[1] + (h << 6) + (h >> 2);
+      return std::hash<uint64_t>()(h);
+    }
+  };
+
+  typedef std::unordered_map<Key, ADynNode*, KeyHash> Map;
+
+  // mirrors the traversal order of ANode::findDynChild()
+  void
+  insertDescendents(ANode* x)
+  {
+    for (ANodeChildIterator it(x); it.Current(); ++it) {
+      ANode* x_child = it.current();
+      ADynNode* x_child_dyn = dynamic_cast<ADynNode*>(x_child);
+      if (x_child_dyn) {
+	insert(x_child_dyn);
+      }
+      else {
+	insertDescendents(x_child);
+      }
+    }
+  }
+
+  Map m_map;
+};
+
+
 MergeEffectList*
 ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 uint oFlag)
@@ -834,6 +1021,11 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
   //    recur.
   // ------------------------------------------------------------
   MergeEffectList* effctLst = new MergeEffectList;
+
+  DynChildIndex* x_index = NULL;
+  if (y->childCount() > 1 && x->childCount() >= DynChildIndex::MinChildren) {
+    x_index = new DynChildIndex(x);
+  }
   
   for (ANodeChildIterator it(y); it.Current(); /* */) {
     ANode* y_child = it.current();
@@ -843,7 +1035,13 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 
     MergeEffectList* effctLst1 = NULL;
 
-    ADynNode* x_child_dyn = x->findDynChild(*y_child_dyn);
+    ADynNode* x_child_dyn = NULL;
+    if (x_index && DynChildIndex::isApplicable(*y_child_dyn)) {
+      x_child_dyn = x_index->find(*y_child_dyn);
+    }
+    else {
+      x_child_dyn = x->findDynChild(*y_child_dyn);
+    }
 
 #define MERGE_ACTION 0
 #define MERGE_ERROR 0
@@ -865,6 +1063,9 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 	effctLst1 = y_child->mergeDeep_fixInsert(x_newMetricBegIdx, mrgCtxt);
 
 	y_child->link(x);
+	if (x_index) {
+	  x_index->insert(y_child_dyn);
+	}
       }
     }
     else {
@@ -890,6 +1091,8 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
     delete effctLst1;
   }
 
+  delete x_index;
+
   return effctLst;
 }
 
@@ -70,6 +70,7 @@
 #include <set>
 
 #include <typeinfo>
+#include <atomic>
 
 #include <cstring> // for memcpy
 
@@ -139,7 +140,8 @@ public:
     OFlg_LeafMetricsOnly = (1 << 1), // Write metrics only at leaves (outdated)
     OFlg_Debug           = (1 << 2), // Debug: show xtra source line info
     OFlg_DebugAll        = (1 << 3), // Debug: (may be invalid format)
-    OFlg_StructId        = (1 << 4)  // Add hpcstruct node id (for debug)
+    OFlg_StructId        = (1 << 4), // Add hpcstruct node id (for debug)
+    OFlg_SparseMetricDB  = (1 << 5)  // Metric DB uses the sparse format
   };
 
 
@@ -320,19 +322,15 @@ public:
   ANode(ANodeTy type, ANode* parent, Struct::ACodeNode* strct = NULL)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   ANode(ANodeTy type,
 	ANode* parent, Struct::ACodeNode* strct, const Metric::IData& metrics)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(metrics),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   virtual ~ANode()
   { }
@@ -341,10 +339,9 @@ public:
   ANode(const ANode& x)
     : NonUniformDegreeTreeNode(NULL),
       Metric::IData(x),
-      m_type(x.m_type), m_id(s_nextUniqueId), m_strct(x.m_strct)
+      m_type(x.m_type), m_id(nextUniqueId()), m_strct(x.m_strct)
   {
     zeroLinks();
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
   }
 
   // deep copy of internals (but without children)
@@ -355,8 +352,7 @@ public:
       //NonUniformDegreeTreeNode::operator=(x);
       Metric::IData::operator=(x);
       m_type = x.m_type;
-      m_id = s_nextUniqueId;
-      s_nextUniqueId += 2;
+      m_id = nextUniqueId();
       // m_id: skip
       m_strct = x.m_strct;
     }
@@ -517,16 +513,6 @@ public:
   aggregateMetricsExcl(uint mBegId)
   { aggregateMetricsExcl(mBegId, mBegId + 1); }
 
-private:
-  //
-  // laks 2015.10.21: we don't want accumulate the exclusive cost of 
-  // an inlined statement to the caller. Instead, we assume an inline
-  // function (Proc) as the same as a normal procedure (ProcFrm).
-  // And the lowest common ancestor for Proc and ProcFrm is AProcNode.
-  void
-  aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset);
-
-public:
   // computeMetrics: compute this subtree's Metric::DerivedDesc metric
   //   values for metric ids [mBegId, mEndId)
   // computeMetricsMe: same, but for the node (not the subtree)
@@ -679,7 +665,13 @@ protected:
 
 
 private:
-  static uint s_nextUniqueId;
+  // N.B.: atomic since profiles may be read concurrently
+  // (cf. Analysis::CallPath::read)
+  static uint
+  nextUniqueId()
+  { return s_nextUniqueId.fetch_add(2); } // cf. HPCRUN_FMT_RetainIdFlag
+
+  static std::atomic<uint> s_nextUniqueId;
   
 protected:
   ANodeTy m_type; // obsolete with typeid(), but hard to replace
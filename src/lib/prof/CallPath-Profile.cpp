@@ -106,6 +106,7 @@ using namespace xml;
 
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/hpcrun-container.h>
 #include <lib/prof-lean/hpcrun-metric.h>
 
 #include <lib/support/diagnostics.h>
@@ -195,7 +196,6 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
   Profile& x = (*this);
 
   DIAG_Assert(!y.m_structure, "Profile::merge: source profile should not have structure yet!");
-  DIAG_Assert(y.m_fmtVersion == x.m_fmtVersion, "Error: cannot merge two different versions of measurement");
 
   // -------------------------------------------------------
   // merge name, flags, etc
@@ -223,10 +223,14 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
     y.m_measurementGranularity = x.m_measurementGranularity;
   }
 
-  DIAG_WMsgIf(x.m_fmtVersion != y.m_fmtVersion,
-	      "CallPath::Profile::merge(): ignoring incompatible versions: "
-	      << x.m_fmtVersion << " vs. " << y.m_fmtVersion);
-  DIAG_WMsgIf(x.m_flags.bits != y.m_flags.bits,
+  // supported versions differ only in how a file encodes the profile,
+  // so profiles read from any of them merge
+  x.m_fmtVersion = std::max(x.m_fmtVersion, y.m_fmtVersion);
+
+  // isSparseMetrics only describes how a file stores its metrics
+  epoch_flags_t xFlags = x.m_flags, yFlags = y.m_flags;
+  xFlags.fields.isSparseMetrics = yFlags.fields.isSparseMetrics = false;
+  DIAG_WMsgIf(xFlags.bits != yFlags.bits,
 	      "CallPath::Profile::merge(): ignoring incompatible flags: "
 	      << x.m_flags.bits << " vs. " << y.m_flags.bits);
   DIAG_WMsgIf(x.m_measurementGranularity != y.m_measurementGranularity,
@@ -380,6 +384,18 @@ Profile::merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects)
 }
 
 
+std::string
+Profile::traceTmpFileName(const std::string& traceFnm)
+{
+  string fnm = traceFnm;
+  const char* member = hpcrun_container_path_member(traceFnm.c_str());
+  if (member) {
+    fnm[member - traceFnm.c_str() - 1] = '.';
+  }
+  return fnm + "." + HPCPROF_TmpFnmSfx;
+}
+
+
 void
 Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
 {
@@ -411,7 +427,7 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
 
   DIAG_MsgIf(0, "Profile::merge_fixTrace: " << m_traceFileName);
 
-  string traceFileNameTmp = m_traceFileName + "." + HPCPROF_TmpFnmSfx;
+  string traceFileNameTmp = traceTmpFileName(m_traceFileName);
 
   char* infsBuf = new char[HPCIO_RWBufferSz];
   char* outfsBuf = new char[HPCIO_RWBufferSz];
@@ -861,6 +877,12 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
+  bool isSparseDB = (oFlags & CCT::Tree::OFlg_SparseMetricDB);
+  const char* dbFileSfx =
+    (isSparseDB) ? HPCPROF_SparseMetricDBSfx : HPCPROF_MetricDBSfx;
+  int dbHeaderSz =
+    (isSparseDB) ? HPCMETRICDB_SPARSE_FMT_HeaderLen : HPCMETRICDB_FMT_HeaderLen;
+
   os << "  <MetricDBTable>\n";
   for (uint i = 0; i < m_mMgr->size(); i++) {
     const Metric::ADesc* m = m_mMgr->metric(i);
@@ -871,10 +893,10 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
       if (m->partner()) {
          os << " partner" << MakeAttrNum(m->partner()->id());
       }
-      os << " db-glob=\"" << m->dbFileGlob() << "\""
+      os << " db-glob=\"" << m->dbFileGlob(dbFileSfx) << "\""
 	 << " db-id=\"" << m->dbId() << "\""
 	 << " db-num-metrics=\"" << m->dbNumMetrics() << "\""
-	 << " db-header-sz=\"" << HPCMETRICDB_FMT_HeaderLen << "\""
+	 << " db-header-sz=\"" << dbHeaderSz << "\""
 	 << "/>\n";
     }
   }
@@ -888,10 +910,33 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
     if (m_fmtVersion < 3) {
       unit_time_per_second = 1000000;
     }
+    // traces packed by 'hpcrun --container' are copied into the
+    // database as containers ('*.hpcpack'); a thread whose member
+    // could not be added writes a plain trace file instead.
+    bool havePlain = false, havePacked = false;
+    for (StringSet::const_iterator it = traceFileNameSet().begin();
+	 it != traceFileNameSet().end(); ++it) {
+      if (hpcrun_container_path_member(it->c_str())) {
+	havePacked = true;
+      }
+      else {
+	havePlain = true;
+      }
+    }
+    string traceGlob;
+    if (havePlain && havePacked) {
+      traceGlob = string("*.{") + HPCRUN_TraceFnmSfx + ","
+	+ HPCRUN_ContainerFnmSfx + "}";
+    }
+    else {
+      traceGlob = string("*.")
+	+ ((havePacked) ? HPCRUN_ContainerFnmSfx : HPCRUN_TraceFnmSfx);
+    }
+
     os << "  <TraceDBTable>\n";
     os << "    <TraceDB i" << MakeAttrNum(0)
        << " u=\"" << unit_time_per_second << "\""
-       << " db-glob=\"" << "*." << HPCRUN_TraceFnmSfx << "\""
+       << " db-glob=\"" << traceGlob << "\""
        << " db-min-time=\"" << m_traceMinTime << "\""
        << " db-max-time=\"" << m_traceMaxTime << "\""
        << " db-header-sz=\"" << HPCTRACE_FMT_HeaderLen << "\""
@@ -1046,7 +1091,8 @@ Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
 	    "is not a profile or it is corrupted\n", filename);
     prof_abort(-1);
   }
-  if ( !(hdr.version >= HPCRUN_FMT_Version_20) ) {
+  if ( !(hdr.version >= HPCRUN_FMT_Version_20
+	 && hdr.version < HPCRUN_FMT_Version_50) ) {
     DIAG_Throw("unsupported file version '" << hdr.versionStr << "'");
   }
 
@@ -1139,6 +1185,9 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
   if (ret != HPCFMT_OK) {
     DIAG_Throw("error reading 'epoch-hdr'");
   }
+  if (ehdr.flags.fields.unused != 0) {
+    DIAG_Throw("unsupported epoch flags 0x" << hex << ehdr.flags.bits << dec);
+  }
   if (outfs) {
     hpcrun_fmt_epochHdr_fprint(&ehdr, outfs);
   }
@@ -131,6 +131,12 @@ public:
   traceFileNameSet()
   { return m_traceFileNameSet; }
 
+  // Name of the rewritten copy of 'traceFnm' made by merge_fixTrace().
+  // For a container member ('<container>/<member>'), it goes next to
+  // the container.
+  static std::string
+  traceTmpFileName(const std::string& traceFnm);
+
   // enable/disable redundancy of procedure names
   // @param flag: true  -- redundancy is eliminated
   // 		  false -- redundancy is allowed
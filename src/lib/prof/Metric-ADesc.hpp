@@ -491,11 +491,11 @@ public:
 
 
   const std::string
-  dbFileGlob() const
+  dbFileGlob(const char* dbFileSfx = HPCPROF_MetricDBSfx) const
   {
     std::string dbFileGlob;
     if (!m_namePfx.empty()) { dbFileGlob += m_namePfx + nameSep; }
-    dbFileGlob += std::string("*.") + HPCPROF_MetricDBSfx;
+    dbFileGlob += std::string("*.") + dbFileSfx;
     return dbFileGlob;
   }
 
@@ -351,6 +351,8 @@ LM::operator=(const LM& x)
     m_fileMap  = NULL;
     m_procMap  = NULL;
     m_stmtMap  = NULL;
+    m_procIndex.clear();
+    m_stmtIndex.clear();
   }
   return *this;
 }
@@ -1059,24 +1061,41 @@ LM::findByVMA(VMA vma) const
 Proc*
 LM::findProc(VMA vma) const
 {
-  if (!m_procMap) {
-    buildMap(m_procMap, ANode::TyProc);
-  }
-  VMAInterval toFind(vma, vma+1); // [vma, vma+1)
-  VMAIntervalMap<Proc*>::iterator it = m_procMap->find(toFind);
-  return (it != m_procMap->end()) ? it->second : NULL;
+  return findInMap(m_procMap, m_procIndex, ANode::TyProc, vma);
 }
 
 
 Stmt*
 LM::findStmt(VMA vma) const
 {
-  if (!m_stmtMap) {
-    buildMap(m_stmtMap, ANode::TyStmt);
+  return findInMap(m_stmtMap, m_stmtIndex, ANode::TyStmt, vma);
+}
+
+
+template<typename T>
+T
+LM::findInMap(VMAIntervalMap<T>*& mp, VMAIntervalIndex<T>& idx,
+	      ANode::ANodeTy ty, VMA vma) const
+{
+  if (!mp) {
+    buildMap(mp, ty);
+    idx.build(*mp);
+  }
+
+  // While the map is being extended (e.g. by makeStructureSimple()
+  // between lookups), use the map directly.  Rebuild the index once
+  // the lookups since the last change could have paid for it.
+  if (!idx.isValid()) {
+    if (idx.noteStaleFind() < mp->size()) {
+      VMAInterval toFind(vma, vma+1); // [vma, vma+1)
+      typename VMAIntervalMap<T>::iterator it = mp->find(toFind);
+      return (it != mp->end()) ? it->second : NULL;
+    }
+    idx.build(*mp);
   }
-  VMAInterval toFind(vma, vma+1); // [vma, vma+1)
-  VMAIntervalMap<Stmt*>::iterator it = m_stmtMap->find(toFind);
-  return (it != m_stmtMap->end()) ? it->second : NULL;
+
+  const T* x = idx.find(vma);
+  return (x) ? *x : NULL;
 }
 
 
@@ -1135,7 +1135,10 @@ public:
   // findStmt: VMA interval -> Struct::Stmt*
   //
   // N.B. these maps are maintained when new Struct::Proc or
-  // Struct::Stmt are created
+  // Struct::Stmt are created.  Lookups go through flat interval
+  // indices (VMAIntervalIndex) that are rebuilt from the maps by
+  // computeVMAMaps(), or lazily once enough lookups have missed a
+  // stale index to pay for the rebuild.
   ACodeNode*
   findByVMA(VMA vma) const;
 
@@ -1146,8 +1149,10 @@ public:
     m_procMap = NULL;
     delete m_stmtMap;
     m_stmtMap = NULL;
-    findProc(0);
-    findStmt(0);
+    buildMap(m_procMap, ANode::TyProc);
+    buildMap(m_stmtMap, ANode::TyStmt);
+    m_procIndex.build(*m_procMap);
+    m_stmtIndex.build(*m_stmtMap);
   }
 
 
@@ -1159,6 +1164,7 @@ public:
   {
     if (m_procMap) {
       insertInMap(m_procMap, proc);
+      m_procIndex.invalidate();
       return true;
     }
     return false;
@@ -1173,6 +1179,7 @@ public:
   {
     if (m_stmtMap) {
       insertInMap(m_stmtMap, stmt);
+      m_stmtIndex.invalidate();
       return true;
     }
     return false;
@@ -1183,6 +1190,7 @@ public:
   {
     if (m_stmtMap) {
       eraseFromMap(m_stmtMap, stmt);
+      m_stmtIndex.invalidate();
       return true;
     }
     return false;
@@ -1214,6 +1222,8 @@ public:
 public:
   typedef VMAIntervalMap<Proc*> VMAToProcMap;
   typedef VMAIntervalMap<Stmt*> VMAToStmtRangeMap;
+  typedef VMAIntervalIndex<Proc*> VMAToProcIndex;
+  typedef VMAIntervalIndex<Stmt*> VMAToStmtRangeIndex;
 
 protected:
   void
@@ -1227,6 +1237,11 @@ protected:
   void
   buildMap(VMAIntervalMap<T>*& mp, ANode::ANodeTy ty) const;
 
+  template<typename T>
+  T
+  findInMap(VMAIntervalMap<T>*& mp, VMAIntervalIndex<T>& idx,
+	    ANode::ANodeTy ty, VMA vma) const;
+
   template<typename T>
   void
   insertInMap(VMAIntervalMap<T>* mp, T x) const
@@ -1274,6 +1289,8 @@ private:
   FileMap*                   m_fileMap; // mapped by RealPathMgr
   mutable VMAToProcMap*      m_procMap;
   mutable VMAToStmtRangeMap* m_stmtMap;
+  mutable VMAToProcIndex      m_procIndex;
+  mutable VMAToStmtRangeIndex m_stmtIndex;
 
 #if 0
   static RealPathMgr& s_realpathMgr;
@@ -0,0 +1,659 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Binary form of the program structure file (PGM)
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************ System Include Files ******************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+#include <map>
+
+//************************* User Include Files *******************************
+
+#include "PGMBinary.hpp"
+
+#include <lib/prof/Struct-Tree.hpp>
+
+#include <lib/binutils/VMAInterval.hpp>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/StrUtil.hpp>
+
+//************************ Forward Declarations ******************************
+
+#define DBG 0
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+namespace PGMBinary {
+
+//***************************************************************************
+// Writer
+//***************************************************************************
+
+Writer::Writer()
+{
+  m_strings.push_back('\0'); // offset 0: the empty string
+}
+
+
+Writer::~Writer()
+{
+}
+
+
+void
+Writer::startElement(const Element& elem)
+{
+  Record rec;
+  memset(&rec, 0, sizeof(rec));
+
+  rec.kind   = elem.kind;
+  rec.name   = internString(elem.name);
+  rec.lnName = internString(elem.lnName);
+  rec.file   = internString(elem.file);
+  rec.device = internString(elem.device);
+  rec.id     = elem.id;
+  rec.begLn  = elem.begLn;
+  rec.endLn  = elem.endLn;
+
+  if (!elem.vma.empty()) {
+    rec.flags |= FlagVMA;
+    VMAIntervalSet vmaset;
+    vmaset.fromString(elem.vma.c_str());
+    rec.vmaIdx = m_vmas.size();
+    for (VMAIntervalSet::const_iterator it = vmaset.begin();
+	 it != vmaset.end(); ++it) {
+      VMAPair pair = { it->beg(), it->end() };
+      m_vmas.push_back(pair);
+    }
+    rec.vmaCnt = m_vmas.size() - rec.vmaIdx;
+  }
+
+  if (elem.hasTarget) {
+    rec.flags |= FlagTarget;
+    rec.target = elem.target;
+  }
+
+  m_open.push_back(m_records.size());
+  m_records.push_back(rec);
+}
+
+
+void
+Writer::endElement()
+{
+  DIAG_Assert(!m_open.empty(), "PGMBinary::Writer: unbalanced element");
+  m_records[m_open.back()].end = m_records.size();
+  m_open.pop_back();
+}
+
+
+bool
+Writer::write(const string& fnm, const string& srcFnm) const
+{
+  if (!m_open.empty() || m_records.empty()) {
+    return false;
+  }
+
+  struct stat srcStat;
+  if (stat(srcFnm.c_str(), &srcStat) != 0) {
+    return false;
+  }
+
+  Header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PGMBinary_Magic, PGMBinary_MagicLen);
+  hdr.version      = PGMBinary_Version;
+  hdr.endian       = PGMBinary_Endian;
+  hdr.srcSize      = srcStat.st_size;
+  hdr.srcMtimeSec  = srcStat.st_mtim.tv_sec;
+  hdr.srcMtimeNsec = srcStat.st_mtim.tv_nsec;
+  hdr.numRecords   = m_records.size();
+  hdr.numVMAs      = m_vmas.size();
+  hdr.strBytes     = m_strings.size();
+
+  // the cache may be on a shared file system, so pid alone is not unique
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+  string tmpFnm = fnm + ".tmp." + host + "." + StrUtil::toStr((long)getpid());
+  FILE* fs = fopen(tmpFnm.c_str(), "w");
+  if (!fs) {
+    return false;
+  }
+
+  bool ok = (fwrite(&hdr, sizeof(hdr), 1, fs) == 1)
+    && (fwrite(m_records.data(), sizeof(Record), m_records.size(), fs)
+	== m_records.size())
+    && (m_vmas.empty()
+	|| fwrite(m_vmas.data(), sizeof(VMAPair), m_vmas.size(), fs)
+	   == m_vmas.size())
+    && (fwrite(m_strings.data(), 1, m_strings.size(), fs)
+	== m_strings.size());
+  ok = (fclose(fs) == 0) && ok;
+
+  if (ok) {
+    ok = (rename(tmpFnm.c_str(), fnm.c_str()) == 0);
+  }
+  if (!ok) {
+    unlink(tmpFnm.c_str());
+  }
+  return ok;
+}
+
+
+uint32_t
+Writer::internString(const string& str)
+{
+  if (str.empty()) {
+    return 0;
+  }
+
+  std::map<string, uint32_t>::iterator it = m_stringIdx.find(str);
+  if (it != m_stringIdx.end()) {
+    return it->second;
+  }
+
+  uint32_t off = m_strings.size();
+  m_strings.append(str);
+  m_strings.push_back('\0');
+  m_stringIdx.insert(std::make_pair(str, off));
+  return off;
+}
+
+
+//***************************************************************************
+// Reading
+//***************************************************************************
+
+bool
+isBinary(const char* fnm)
+{
+  char buf[PGMBinary_MagicLen];
+
+  int fd = open(fnm, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t ret = ::read(fd, buf, PGMBinary_MagicLen);
+  close(fd);
+
+  return (ret == PGMBinary_MagicLen
+	  && memcmp(buf, PGMBinary_Magic, PGMBinary_MagicLen) == 0);
+}
+
+
+string
+cacheName(const string& cacheDir, const string& xmlFnm)
+{
+  char rpath[PATH_MAX];
+  const char* path = realpath(xmlFnm.c_str(), rpath);
+  if (!path) {
+    path = xmlFnm.c_str();
+  }
+
+  // FNV-1a, so that the name is the same for every build of the tools
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char* p = path; *p; ++p) {
+    hash = (hash ^ (unsigned char)*p) * 0x100000001b3ULL;
+  }
+
+  const char* base = strrchr(path, '/');
+  base = (base) ? base + 1 : path;
+
+  char hashStr[32];
+  snprintf(hashStr, sizeof(hashStr), "%016llx", (unsigned long long)hash);
+
+  return cacheDir + "/" + base + "-" + hashStr + PGMBinary_Suffix;
+}
+
+
+// A mapped binary file whose layout has been validated.
+class MappedFile {
+public:
+  MappedFile()
+    : m_base(NULL), m_size(0), m_hdr(NULL), m_records(NULL),
+      m_vmas(NULL), m_strings(NULL)
+  { }
+
+  ~MappedFile()
+  {
+    if (m_base) {
+      munmap(m_base, m_size);
+    }
+  }
+
+  bool
+  open(const char* fnm, const char* srcFnm);
+
+  // valid after a successful open()
+  void*          m_base;
+  size_t         m_size;
+  const Header*  m_hdr;
+  const Record*  m_records;
+  const VMAPair* m_vmas;
+  const char*    m_strings;
+
+private:
+  bool
+  validate() const;
+};
+
+
+bool
+MappedFile::open(const char* fnm, const char* srcFnm)
+{
+  int fd = ::open(fnm, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+
+  m_size = st.st_size;
+  m_base = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m_base == MAP_FAILED) {
+    m_base = NULL;
+    return false;
+  }
+
+  m_hdr = (const Header*)m_base;
+  if (memcmp(m_hdr->magic, PGMBinary_Magic, PGMBinary_MagicLen) != 0
+      || m_hdr->version != PGMBinary_Version
+      || m_hdr->endian != PGMBinary_Endian) {
+    return false;
+  }
+
+  if (srcFnm) {
+    struct stat srcStat;
+    if (stat(srcFnm, &srcStat) != 0
+	|| m_hdr->srcSize != (uint64_t)srcStat.st_size
+	|| m_hdr->srcMtimeSec != (int64_t)srcStat.st_mtim.tv_sec
+	|| m_hdr->srcMtimeNsec != (int64_t)srcStat.st_mtim.tv_nsec) {
+      return false;
+    }
+  }
+
+  // sizes are checked one by one to avoid overflow
+  uint64_t avail = m_size - sizeof(Header);
+  if (m_hdr->numRecords > avail / sizeof(Record)) {
+    return false;
+  }
+  avail -= m_hdr->numRecords * sizeof(Record);
+  if (m_hdr->numVMAs > avail / sizeof(VMAPair)) {
+    return false;
+  }
+  avail -= m_hdr->numVMAs * sizeof(VMAPair);
+  if (m_hdr->strBytes != avail) {
+    return false;
+  }
+
+  const char* p = (const char*)m_base + sizeof(Header);
+  m_records = (const Record*)p;
+  p += m_hdr->numRecords * sizeof(Record);
+  m_vmas = (const VMAPair*)p;
+  p += m_hdr->numVMAs * sizeof(VMAPair);
+  m_strings = p;
+
+  return validate();
+}
+
+
+// validate: check every index in the file so that replaying it cannot
+// read out of bounds.
+bool
+MappedFile::validate() const
+{
+  uint64_t n = m_hdr->numRecords;
+  uint64_t nStr = m_hdr->strBytes;
+
+  if (n == 0 || n > UINT32_MAX || nStr == 0
+      || m_strings[0] != '\0' || m_strings[nStr - 1] != '\0') {
+    return false;
+  }
+
+  // the document must be a single HPCToolkitStructure element
+  const Record& top = m_records[0];
+  if (top.kind != KindStructure || top.end != n) {
+    return false;
+  }
+
+  std::vector<uint32_t> ends; // ends of the open records
+  for (uint32_t i = 0; i < n; ++i) {
+    const Record& rec = m_records[i];
+
+    while (!ends.empty() && ends.back() <= i) {
+      ends.pop_back();
+    }
+    if (rec.kind < KindStructure || rec.kind > KindGroup
+	|| (rec.kind == KindStructure) != (i == 0)
+	|| rec.end <= i || rec.end > n
+	|| (!ends.empty() && rec.end > ends.back())) {
+      return false;
+    }
+    if (rec.name >= nStr || rec.lnName >= nStr || rec.file >= nStr
+	|| rec.device >= nStr) {
+      return false;
+    }
+    if ((uint64_t)rec.vmaIdx + rec.vmaCnt > m_hdr->numVMAs) {
+      return false;
+    }
+    ends.push_back(rec.end);
+  }
+
+  // reject outdated documents here; the XML reader explains why
+  double ver = StrUtil::toDbl(string(m_strings + top.name));
+  return (ver >= 4.5);
+}
+
+
+// Replay: builds the structure from validated records, following
+// PGMDocHandler::startElement()/endElement() for Doc_STRUCT.
+class Replay {
+public:
+  Replay(Struct::Tree& structure, const MappedFile& file,
+	 DocHandlerArgs& docargs)
+    : m_structure(structure), m_file(file), m_args(docargs),
+      m_curRoot(NULL), m_curLM(NULL), m_curFile(NULL), m_curProc(NULL)
+  { }
+
+  void
+  run();
+
+private:
+  const char*
+  str(uint32_t off) const
+  { return m_file.m_strings + off; }
+
+  void
+  setVMAs(ACodeNode* node, const Record& rec) const
+  {
+    const VMAPair* vma = m_file.m_vmas + rec.vmaIdx;
+    for (uint32_t i = 0; i < rec.vmaCnt; ++i) {
+      node->vmaSet().insert(vma[i].beg, vma[i].end);
+    }
+  }
+
+  ANode*
+  startElement(const Record& rec);
+
+  void
+  endElement(const Record& rec);
+
+private:
+  Struct::Tree&      m_structure;
+  const MappedFile&  m_file;
+  DocHandlerArgs&    m_args;
+
+  Struct::Root* m_curRoot;
+  Struct::LM*   m_curLM;
+  Struct::File* m_curFile;
+  Struct::Proc* m_curProc;
+
+  std::vector<ANode*> m_scopeStack;
+  std::map<long, Struct::Proc*> m_idToProcMap;
+};
+
+
+void
+Replay::run()
+{
+  const Record* recs = m_file.m_records;
+  uint32_t n = m_file.m_hdr->numRecords;
+
+  std::vector<uint32_t> open;
+  for (uint32_t i = 0; i < n; ++i) {
+    while (!open.empty() && recs[open.back()].end <= i) {
+      endElement(recs[open.back()]);
+      open.pop_back();
+      m_scopeStack.pop_back();
+    }
+    m_scopeStack.push_back(startElement(recs[i]));
+    open.push_back(i);
+  }
+  while (!open.empty()) {
+    endElement(recs[open.back()]);
+    open.pop_back();
+    m_scopeStack.pop_back();
+  }
+}
+
+
+ANode*
+Replay::startElement(const Record& rec)
+{
+  ANode* curStrct = NULL;
+  bool hasVMA = (rec.flags & FlagVMA);
+
+  switch (rec.kind) {
+  case KindStructure:
+    m_curRoot = m_structure.root();
+    curStrct = m_curRoot;
+    break;
+
+  case KindLM: {
+    DIAG_Assert(m_curRoot && !m_curLM, "Parse error!");
+    string nm = m_args.realpath(str(rec.name));
+    m_curLM = LM::demand(m_curRoot, nm);
+    m_curFile = NULL;
+    m_curProc = NULL;
+    curStrct = m_curLM;
+    break;
+  }
+
+  case KindFile: {
+    DIAG_Assert(m_curLM && !m_curFile, "Parse error!");
+    string nm = m_args.realpath(str(rec.name));
+    m_curFile = File::demand(m_curLM, nm);
+    m_curProc = NULL;
+    curStrct = m_curFile;
+    break;
+  }
+
+  case KindProc: {
+    DIAG_Assert(m_curLM && m_curFile && !m_curProc, "Parse error: Support for nested procedures is disabled (cf. buildLMSkeleton())!");
+    string nm = str(rec.name);
+
+    m_curProc = m_curFile->findProc(nm);
+    if (m_curProc && !m_curProc->vmaSet().empty() && hasVMA) {
+      m_curProc = NULL;
+    }
+
+    if (!m_curProc) {
+      m_curProc = new Proc(nm, m_curFile, str(rec.lnName), false,
+			   rec.begLn, rec.endLn);
+      setVMAs(m_curProc, rec);
+      m_curProc->m_origId = rec.id;
+    }
+    else {
+      DIAG_Msg(0, "Warning: Found procedure '" << nm << "' multiple times within file '" << m_curFile->name() << "'; information for this procedure will be aggregated. If you do not want this, edit the STRUCTURE file and adjust the names by hand.");
+    }
+
+    curStrct = m_curProc;
+    m_idToProcMap[rec.id] = m_curProc;
+    break;
+  }
+
+  case KindAlien: {
+    string nm = str(rec.name);
+    string fnm = m_args.realpath(str(rec.file));
+
+    ACodeNode* parent = dynamic_cast<ACodeNode*>(m_scopeStack.back());
+    Alien* alien = new Alien(parent, fnm, nm, nm, rec.begLn, rec.endLn);
+
+    const char* ln = str(rec.lnName);
+    if (ln[0] != '\0') {
+      std::map<long, Proc*>::iterator it = m_idToProcMap.find(atol(ln));
+      alien->proc((it != m_idToProcMap.end()) ? it->second : NULL);
+    }
+    else {
+      alien->proc(NULL);
+    }
+    alien->m_origId = rec.id;
+
+    curStrct = alien;
+    break;
+  }
+
+  case KindLoop: {
+    DIAG_Assert(m_scopeStack.size() >= 3, "");
+    string fnm = m_args.realpath(str(rec.file));
+
+    ACodeNode* parent = dynamic_cast<ACodeNode*>(m_scopeStack.back());
+    ACodeNode* loop = new Loop(parent, fnm, rec.begLn, rec.endLn);
+    loop->m_origId = rec.id;
+    setVMAs(loop, rec);
+
+    curStrct = loop;
+    break;
+  }
+
+  case KindStmt:
+  case KindCall: {
+    DIAG_Assert(rec.begLn == rec.endLn, "S line range [" << rec.begLn << ", " << rec.endLn << "]");
+    DIAG_Assert(m_curProc != NULL, "");
+
+    ACodeNode* parent = dynamic_cast<ACodeNode*>(m_scopeStack.back());
+    Stmt* stmt;
+    if (rec.kind == KindStmt) {
+      stmt = new Stmt(parent, rec.begLn, rec.endLn);
+    }
+    else {
+      stmt = new Stmt(parent, rec.begLn, rec.endLn, 0, 0, Stmt::STMT_CALL);
+    }
+    setVMAs(stmt, rec);
+    if (rec.flags & FlagTarget) {
+      stmt->target((SrcFile::ln)rec.target);
+    }
+    if (rec.device != 0) {
+      stmt->device(str(rec.device));
+    }
+    stmt->m_origId = rec.id;
+
+    curStrct = stmt;
+    break;
+  }
+
+  case KindGroup: {
+    string grpnm = str(rec.name);
+    DIAG_Assert(!grpnm.empty(), "");
+    curStrct = Group::demand(m_curRoot, grpnm, m_scopeStack.back());
+    break;
+  }
+  }
+
+  DIAG_DevMsgIf(DBG, "PGMBinary: " << curStrct->toStringMe());
+  return curStrct;
+}
+
+
+void
+Replay::endElement(const Record& rec)
+{
+  switch (rec.kind) {
+  case KindStructure: m_curRoot = NULL; break;
+  case KindLM:        m_curLM = NULL;   break;
+  case KindFile:      m_curFile = NULL; break;
+  case KindProc:      m_curProc = NULL; break;
+  default:            break;
+  }
+}
+
+
+bool
+read(Struct::Tree& structure, const char* fnm, const char* srcFnm,
+     DocHandlerArgs& docargs)
+{
+  MappedFile file;
+  if (!file.open(fnm, srcFnm)) {
+    DIAG_DevMsgIf(DBG, "PGMBinary: not using '" << fnm << "'");
+    return false;
+  }
+
+  Replay replay(structure, file, docargs);
+  replay.run();
+  return true;
+}
+
+} // namespace PGMBinary
+
+} // namespace Struct
+
+} // namespace Prof
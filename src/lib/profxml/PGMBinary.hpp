@@ -0,0 +1,267 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Binary form of the program structure file (PGM)
+//
+// Description:
+//   A structure file is a pre-order list of scopes (HPCToolkitStructure,
+//   LM, F, P, A, L, S, C, G) with a handful of attributes each.  The
+//   binary form stores exactly those elements and attributes as
+//   fixed-size records, with strings in a shared string table and VMA
+//   intervals in a flat array:
+//
+//     [Header][Record x numRecords][VMAPair x numVMAs][string bytes]
+//
+//   Each record holds the index of the first record after its
+//   subtree, so the nesting is implicit.  A reader maps the file and
+//   replays the records through the same construction steps that
+//   PGMDocHandler applies to the XML, without any text parsing.
+//
+//   A binary file is produced by recording the XML as it is parsed
+//   (see PGMBinary::Writer) and, if the user names a structure cache
+//   directory, stored there (see cacheName()).  It records the size and
+//   modification time of the XML file and is ignored once those no
+//   longer match.  A binary file may also be given directly in place of
+//   the XML file.
+//
+//   Only STRUCTURE documents use the binary form; GROUP documents are
+//   always read as XML.
+//
+//***************************************************************************
+
+#ifndef _profxml_PGMBinary_
+#define _profxml_PGMBinary_
+
+//************************ System Include Files ******************************
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+//************************* User Include Files *******************************
+
+#include "DocHandlerArgs.hpp"
+
+#include <lib/prof/Struct-Tree.hpp>
+
+#include <lib/support/SrcFile.hpp>
+
+//************************ Forward Declarations ******************************
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+namespace PGMBinary {
+
+// 'HPCSTRUCT-BIN' padded with NULs; followed by the format version
+#define PGMBinary_Magic    "HPCSTRUCT-BIN\0\0"
+#define PGMBinary_MagicLen 16
+#define PGMBinary_Version  1
+#define PGMBinary_Endian   0x01020304
+
+// suffix of the binary copies of XML structure files in a cache
+#define PGMBinary_Suffix   ".bin"
+
+enum Kind {
+  KindStructure = 1,
+  KindLM,
+  KindFile,
+  KindProc,
+  KindAlien,
+  KindLoop,
+  KindStmt,
+  KindCall,
+  KindGroup
+};
+
+enum Flags {
+  FlagVMA    = 0x1, // 'v' attribute present (possibly an empty set)
+  FlagTarget = 0x2  // 't' attribute present
+};
+
+struct Header {
+  char     magic[PGMBinary_MagicLen];
+  uint32_t version;
+  uint32_t endian;
+
+  // identity of the XML file this was recorded from (0 if none)
+  uint64_t srcSize;
+  int64_t  srcMtimeSec;
+  int64_t  srcMtimeNsec;
+
+  uint64_t numRecords;
+  uint64_t numVMAs;
+  uint64_t strBytes;
+};
+
+// string attributes are offsets into the string table; offset 0 is
+// the empty string (i.e., an absent attribute)
+struct Record {
+  uint8_t  kind;
+  uint8_t  flags;
+  uint16_t unused;
+  uint32_t end;     // index of the first record after this subtree
+
+  uint32_t name;    // 'n' (for HPCToolkitStructure: 'version')
+  uint32_t lnName;  // 'ln'
+  uint32_t file;    // 'f'
+  uint32_t device;  // 'd'
+
+  int32_t  id;      // 'i'
+  uint32_t begLn;   // 'l'
+  uint32_t endLn;
+
+  uint32_t vmaIdx;  // 'v': [vmaIdx, vmaIdx + vmaCnt) of the VMA array
+  uint32_t vmaCnt;
+  uint32_t unused2;
+
+  int64_t  target;  // 't'
+};
+
+struct VMAPair {
+  uint64_t beg;
+  uint64_t end;
+};
+
+
+// ---------------------------------------------------------------------------
+// Element: the attributes of one XML element as seen by PGMDocHandler
+// ---------------------------------------------------------------------------
+
+struct Element {
+  Element()
+    : kind(0), id(0), begLn(SrcFile::ln_NULL), endLn(SrcFile::ln_NULL),
+      hasTarget(false), target(0)
+  { }
+
+  int kind;
+  std::string name, lnName, file, device;
+  int id;
+  SrcFile::ln begLn, endLn;
+  std::string vma; // textual VMA set, as in the 'v' attribute
+  bool hasTarget;
+  long target;
+};
+
+
+// ---------------------------------------------------------------------------
+// Writer: records elements in document order and writes the binary
+// file
+// ---------------------------------------------------------------------------
+
+class Writer {
+public:
+  Writer();
+  ~Writer();
+
+  void
+  startElement(const Element& elem);
+
+  void
+  endElement();
+
+  // write: write the recorded document to 'fnm', noting the identity
+  // of 'srcFnm'.  The file is written to a temporary and renamed, so
+  // concurrent readers see either nothing or a complete file.
+  // Returns false (leaving nothing behind) on any error.
+  bool
+  write(const std::string& fnm, const std::string& srcFnm) const;
+
+private:
+  uint32_t
+  internString(const std::string& str);
+
+private:
+  std::vector<Record>  m_records;
+  std::vector<VMAPair> m_vmas;
+  std::string          m_strings;
+  std::map<std::string, uint32_t> m_stringIdx;
+  std::vector<uint32_t> m_open; // indices of unclosed records
+};
+
+
+// ---------------------------------------------------------------------------
+// Reading
+// ---------------------------------------------------------------------------
+
+// isBinary: does 'fnm' begin with the binary magic?
+bool
+isBinary(const char* fnm);
+
+// cacheName: name of the binary copy of 'xmlFnm' in the structure
+// cache directory 'cacheDir': the XML file's base name and a hash of
+// its real path.
+std::string
+cacheName(const std::string& cacheDir, const std::string& xmlFnm);
+
+// read: add the structure in binary file 'fnm' to 'structure'.  If
+// 'srcFnm' is given, the binary must have been recorded from the
+// current contents of 'srcFnm'.  Returns false, without modifying
+// 'structure', if the file is missing, stale or malformed.
+bool
+read(Struct::Tree& structure, const char* fnm, const char* srcFnm,
+     DocHandlerArgs& docargs);
+
+} // namespace PGMBinary
+
+} // namespace Struct
+
+} // namespace Prof
+
+//****************************************************************************
+
+#endif  // _profxml_PGMBinary_
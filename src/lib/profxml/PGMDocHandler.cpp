@@ -204,10 +204,12 @@ using SrcFile::ln_NULL;
 
 PGMDocHandler::PGMDocHandler(Doc_t ty,
 			     Struct::Tree* structure,
-			     DocHandlerArgs& args)
+			     DocHandlerArgs& args,
+			     Struct::PGMBinary::Writer* binWriter)
   : m_docty(ty),
     m_args(args),
     m_structure(structure),
+    m_binWriter(binWriter),
 
     // element names
     elemStructure(XMLString::transcode("HPCToolkitStructure")),
@@ -276,12 +278,16 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
 			    const XERCES_CPP_NAMESPACE::Attributes& attributes)
 {
   Struct::ANode* curStrct = NULL;
+  Struct::PGMBinary::Element binElem;
 
   // Structure
   if (XMLString::equals(name, elemStructure)) {
     string verStr = getAttr(attributes, attrVer);
     double ver = StrUtil::toDbl(verStr);
 
+    binElem.kind = Struct::PGMBinary::KindStructure;
+    binElem.name = verStr;
+
     m_version = ver;
     if (m_version < 4.5) {
       PGM_Throw("Found file format version " << m_version << ": This format is outdated; please regenerate the file.");
@@ -298,6 +304,9 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string nm = getAttr(attributes, attrName); // must exist
     DIAG_Assert(m_curRoot && !m_curLM, "Parse error!");
 
+    binElem.kind = Struct::PGMBinary::KindLM;
+    binElem.name = nm;
+
     nm = m_args.realpath(nm);
     m_curLM = Prof::Struct::LM::demand(m_curRoot, nm);
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << m_curLM->toStringMe());
@@ -313,6 +322,9 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string nm = getAttr(attributes, attrName);
     DIAG_Assert(m_curLM && !m_curFile, "Parse error!");
 
+    binElem.kind = Struct::PGMBinary::KindFile;
+    binElem.name = nm;
+
     nm = m_args.realpath(nm);
     m_curFile = Struct::File::demand(m_curLM, nm);
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << m_curFile->toStringMe());
@@ -334,6 +346,14 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string vma = getAttr(attributes, attrVMA);
     string node_id = getAttr(attributes, attrId);
 
+    binElem.kind   = Struct::PGMBinary::KindProc;
+    binElem.name   = nm;
+    binElem.lnName = lnm;
+    binElem.id     = atoi(node_id.c_str());
+    binElem.begLn  = begLn;
+    binElem.endLn  = endLn;
+    binElem.vma    = vma;
+
     DIAG_Assert(m_curLM && m_curFile && !m_curProc, "Parse error: Support for nested procedures is disabled (cf. buildLMSkeleton())!");
 
     // -----------------------------------------------------
@@ -380,6 +400,12 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string nm  = getAttr(attributes, attrName);
     string ln  = getAttr(attributes, attrLnName);
     string fnm = getAttr(attributes, attrFile);
+
+    binElem.kind   = Struct::PGMBinary::KindAlien;
+    binElem.name   = nm;
+    binElem.lnName = ln;
+    binElem.file   = fnm;
+
     fnm = m_args.realpath(fnm);
 
     SrcFile::ln begLn, endLn;
@@ -392,6 +418,10 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string node_id = getAttr(attributes, attrId);
     alien->m_origId = atoi(node_id.c_str());
 
+    binElem.id    = alien->m_origId;
+    binElem.begLn = begLn;
+    binElem.endLn = endLn;
+
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << alien->toStringMe());
 
     curStrct = alien;
@@ -409,6 +439,7 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     getLineAttr(begLn, endLn, attributes);
 
     string fnm = getAttr(attributes, attrFile);
+    binElem.file = fnm;
     fnm = m_args.realpath(fnm);
 
     // by now the file and function names should have been found
@@ -423,6 +454,12 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
       loopNode->vmaSet().fromString(vma.c_str());
     }
 
+    binElem.kind  = Struct::PGMBinary::KindLoop;
+    binElem.id    = loopNode->m_origId;
+    binElem.begLn = begLn;
+    binElem.endLn = endLn;
+    binElem.vma   = vma;
+
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << loopNode->toStringMe());
 
     curStrct = loopNode;
@@ -454,6 +491,12 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string node_id = getAttr(attributes, attrId);
     stmtNode->m_origId = atoi(node_id.c_str());
 
+    binElem.kind  = Struct::PGMBinary::KindStmt;
+    binElem.id    = stmtNode->m_origId;
+    binElem.begLn = begLn;
+    binElem.endLn = endLn;
+    binElem.vma   = vma;
+
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << stmtNode->toStringMe());
 
     curStrct = stmtNode;
@@ -495,6 +538,17 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string node_id = getAttr(attributes, attrId);
     stmtNode->m_origId = atoi(node_id.c_str());
 
+    binElem.kind   = Struct::PGMBinary::KindCall;
+    binElem.id     = stmtNode->m_origId;
+    binElem.begLn  = begLn;
+    binElem.endLn  = endLn;
+    binElem.vma    = vma;
+    binElem.device = device;
+    if (!target.empty()) {
+      binElem.hasTarget = true;
+      binElem.target    = StrUtil::toLong(target);
+    }
+
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << stmtNode->toStringMe());
 
     curStrct = stmtNode;
@@ -505,6 +559,9 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     string grpnm = getAttr(attributes, attrName); // must exist
     DIAG_Assert(!grpnm.empty(), "");
 
+    binElem.kind = Struct::PGMBinary::KindGroup;
+    binElem.name = grpnm;
+
     Struct::ANode* parent = getCurrentScope(); // enclosing scope
     Struct::Group* grpStrct
       = Prof::Struct::Group::demand(m_curRoot, grpnm, parent);
@@ -526,6 +583,10 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     entry->SetLeaf(false);
   }
 
+  if (m_binWriter) {
+    m_binWriter->startElement(binElem);
+  }
+
   pushCurrentScope(curStrct);
 }
 
@@ -594,6 +655,10 @@ PGMDocHandler::endElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     groupNestingLvl--;
   }
 
+  if (m_binWriter) {
+    m_binWriter->endElement();
+  }
+
   popCurrentScope();
 }
 
@@ -69,6 +69,7 @@
 
 #include "XercesSAX2.hpp"
 #include "DocHandlerArgs.hpp"
+#include "PGMBinary.hpp"
 
 #include <lib/prof/Struct-Tree.hpp>
 
@@ -88,8 +89,11 @@ private:
 
 public:
 
+  // If 'binWriter' is given, the elements of the document are also
+  // recorded there (see PGMBinary.hpp).
   PGMDocHandler(Doc_t ty, Prof::Struct::Tree* structure,
-		DocHandlerArgs& args);
+		DocHandlerArgs& args,
+		Prof::Struct::PGMBinary::Writer* binWriter = NULL);
   ~PGMDocHandler();
 
   void
@@ -222,6 +226,7 @@ private:
   Doc_t m_docty;
   DocHandlerArgs& m_args;
   Prof::Struct::Tree* m_structure;
+  Prof::Struct::PGMBinary::Writer* m_binWriter;
   
   // variables for constant values during file processing
   double m_version;     // initialized to a negative
@@ -76,6 +76,7 @@ using std::string;
 //************************* User Include Files *******************************
 
 #include "PGMReader.hpp"
+#include "PGMBinary.hpp"
 #include "XercesUtil.hpp"
 
 //*********************** Xerces Include Files *******************************
@@ -133,7 +134,8 @@ void
 readStructure(Struct::Tree& structure, 
 	      const std::vector<string>& structureFiles,
 	      PGMDocHandler::Doc_t docty, 
-	      DocHandlerArgs& docargs)
+	      DocHandlerArgs& docargs,
+	      const string& binCacheDir)
 {
   if (structureFiles.empty()) { return; }
 
@@ -141,7 +143,38 @@ readStructure(Struct::Tree& structure,
 
   for (uint i = 0; i < structureFiles.size(); ++i) {
     const string& fnm = structureFiles[i];
-    read_PGM(structure, fnm.c_str(), docty, docargs);
+
+    if (docty != PGMDocHandler::Doc_STRUCT) {
+      read_PGM(structure, fnm.c_str(), docty, docargs);
+      continue;
+    }
+
+    // A structure file may be given in binary form, or may have a
+    // current binary copy in the cache.  Otherwise, parse the XML and
+    // try to leave a binary copy there for the next reader.
+    if (PGMBinary::isBinary(fnm.c_str())) {
+      if (!PGMBinary::read(structure, fnm.c_str(), NULL, docargs)) {
+	DIAG_Throw("Could not read binary " << PGMDocHandler::ToString(docty)
+		   << " file '" << fnm << "'.");
+      }
+      continue;
+    }
+
+    if (binCacheDir.empty()) {
+      read_PGM(structure, fnm.c_str(), docty, docargs);
+      continue;
+    }
+
+    string binFnm = PGMBinary::cacheName(binCacheDir, fnm);
+    if (PGMBinary::read(structure, binFnm.c_str(), fnm.c_str(), docargs)) {
+      continue;
+    }
+
+    PGMBinary::Writer binWriter;
+    read_PGM(structure, fnm.c_str(), docty, docargs, &binWriter);
+    if (!binWriter.write(binFnm, fnm)) {
+      DIAG_DevMsgIf(0, "Could not write '" << binFnm << "'");
+    }
   }
 
   FiniXerces();
@@ -152,7 +185,8 @@ void
 read_PGM(Struct::Tree& structure,
 	 const char* filenm,
 	 PGMDocHandler::Doc_t docty,
-	 DocHandlerArgs& docHandlerArgs)
+	 DocHandlerArgs& docHandlerArgs,
+	 PGMBinary::Writer* binWriter)
 {
   if (!filenm || filenm[0] == '\0') {
     return;
@@ -172,7 +206,7 @@ read_PGM(Struct::Tree& structure,
       parser->setFeature(XMLUni::fgXercesValidationErrorAsFatal, true);
       
       PGMDocHandler* handler = new PGMDocHandler(docty, &structure, 
-						 docHandlerArgs);
+						 docHandlerArgs, binWriter);
       parser->setContentHandler(handler);
       parser->setErrorHandler(handler);
 	  
@@ -67,6 +67,7 @@
 //************************* User Include Files *******************************
 
 #include "PGMDocHandler.hpp"
+#include "PGMBinary.hpp"
 #include "DocHandlerArgs.hpp"
 
 #include <lib/prof/Struct-Tree.hpp>
@@ -77,17 +78,26 @@ namespace Prof {
 
 namespace Struct {
 
+// readStructure: read structure (or group) files into 'structure'.
+// A STRUCTURE file may be given in binary form (see PGMBinary.hpp).
+// If 'binCacheDir' is given, an XML STRUCTURE file is read from its
+// binary copy there when that is current, and otherwise a binary copy
+// is written there for the next reader.
 void
 readStructure(Tree& structure, 
 	      const std::vector<string>& structureFiles,
 	      PGMDocHandler::Doc_t docty, 
-	      DocHandlerArgs& docargs);
+	      DocHandlerArgs& docargs,
+	      const std::string& binCacheDir = "");
 
+// read_PGM: read an XML structure file.  If 'binWriter' is given,
+// the document is also recorded there.
 void
 read_PGM(Tree& structure,
 	 const char* filenm,
 	 PGMDocHandler::Doc_t docty,
-	 DocHandlerArgs& docHandlerArgs);
+	 DocHandlerArgs& docHandlerArgs,
+	 PGMBinary::Writer* binWriter = NULL);
 
 } // namespace Struct
 
@@ -105,22 +105,341 @@ packStringSet(const StringSet& profile,
 static StringSet*
 unpackStringSet(uint8_t* buffer, size_t bufferSz);
 
+static void
+unpackMetricRows(Prof::CallPath::Profile& profile,
+		 const ParallelAnalysis::PackedMetrics& packedMetrics,
+		 uint nodeBeg, uint nodeEnd);
+
+static void
+updateMetrics(Prof::CallPath::Profile& profile,
+	      const ParallelAnalysis::PackedMetrics& packedMetrics);
+
 //***************************************************************************
 // private functions
 //***************************************************************************
 
-static void 
-broadcast_sizet
-(
-  size_t &size, 
-  MPI_Comm comm
-)
-{ 
-  long size_l = size;
-  MPI_Bcast(&size_l, 1, MPI_LONG, 0, comm);
-  size = size_l;
-} 
+//***************************************************************************
+// Chunked, non-blocking point-to-point transfers
+//
+// A message of 'size' bytes is sent as a size header (one long)
+// followed by ceil(size / ChunkSz) byte chunks, all with the same tag;
+// MPI's non-overtaking rule keeps them in order.  Chunking keeps MPI
+// counts within 'int' for large profiles and lets a receiver consume a
+// prefix of a message (e.g., unpack metric rows or forward chunks down
+// the broadcast tree) while the remainder is still in flight.
+//***************************************************************************
+
+static const size_t ChunkSz = 4 * 1024 * 1024; // bytes
+
+static inline size_t
+numChunks(size_t size)
+{
+  return (size + ChunkSz - 1) / ChunkSz;
+}
+
+static inline size_t
+chunkSize(size_t size, size_t k)
+{
+  size_t beg = k * ChunkSz;
+  return std::min(ChunkSz, size - beg);
+}
+
+
+class SendStream
+  : public Unique // prevent copying
+{
+public:
+  SendStream()
+    : m_hdr(0)
+  { }
+
+  ~SendStream()
+  { wait(); }
+
+  // begin: send the size header; chunks follow with sendChunk()
+  void
+  begin(size_t size, int dest, int tag, MPI_Comm comm)
+  {
+    m_hdr = (long)size;
+    m_dest = dest;
+    m_tag = tag;
+    m_comm = comm;
+    m_reqs.push_back(MPI_REQUEST_NULL);
+    MPI_Isend(&m_hdr, 1, MPI_LONG, m_dest, m_tag, m_comm, &m_reqs.back());
+  }
+
+  // sendChunk: send chunk 'k' of 'buf', which must remain live until wait()
+  void
+  sendChunk(const uint8_t* buf, size_t k)
+  {
+    size_t size = (size_t)m_hdr;
+    m_reqs.push_back(MPI_REQUEST_NULL);
+    MPI_Isend((void*)(buf + k * ChunkSz), (int)chunkSize(size, k), MPI_BYTE,
+	      m_dest, m_tag, m_comm, &m_reqs.back());
+  }
+
+  // post: send all of [buf, buf + size)
+  void
+  post(const uint8_t* buf, size_t size, int dest, int tag, MPI_Comm comm)
+  {
+    begin(size, dest, tag, comm);
+    for (size_t k = 0; k < numChunks(size); ++k) {
+      sendChunk(buf, k);
+    }
+  }
+
+  void
+  wait()
+  {
+    if (!m_reqs.empty()) {
+      MPI_Waitall((int)m_reqs.size(), &m_reqs[0], MPI_STATUSES_IGNORE);
+      m_reqs.clear();
+    }
+  }
+
+private:
+  long m_hdr;
+  int m_dest, m_tag;
+  MPI_Comm m_comm;
+  std::vector<MPI_Request> m_reqs;
+};
+
+
+class RecvStream
+  : public Unique // prevent copying
+{
+public:
+  RecvStream()
+    : m_hdr(0), m_hdrReq(MPI_REQUEST_NULL), m_hasHdr(false),
+      m_buf(NULL), m_bufSz(0), m_ownBuf(true), m_numDone(0)
+  { }
+
+  ~RecvStream()
+  {
+    wait();
+    if (m_ownBuf) {
+      free(m_buf);
+    }
+  }
+
+  // post: receive the next message from 'src'.  If 'buf' is given,
+  // the message is received into it and must have size 'bufSz';
+  // otherwise a buffer is malloc'ed (cf. release()).
+  void
+  post(int src, int tag, MPI_Comm comm, uint8_t* buf = NULL, size_t bufSz = 0)
+  {
+    m_src = src;
+    m_tag = tag;
+    m_comm = comm;
+    if (buf) {
+      m_buf = buf;
+      m_bufSz = bufSz;
+      m_ownBuf = false;
+    }
+    MPI_Irecv(&m_hdr, 1, MPI_LONG, m_src, m_tag, m_comm, &m_hdrReq);
+  }
+
+  // test: make progress without blocking; returns true when the whole
+  // message has arrived
+  bool
+  test()
+  {
+    if (!m_hasHdr) {
+      int flag = 0;
+      MPI_Test(&m_hdrReq, &flag, MPI_STATUS_IGNORE);
+      if (!flag) {
+	return false;
+      }
+      postChunks();
+    }
+    while (m_numDone < m_reqs.size()) {
+      int flag = 0;
+      MPI_Test(&m_reqs[m_numDone], &flag, MPI_STATUS_IGNORE);
+      if (!flag) {
+	return false;
+      }
+      m_numDone++;
+    }
+    return true;
+  }
+
+  // waitBytes: block until at least the first 'nBytes' bytes (or the
+  // whole message, if smaller) have arrived; returns the number of
+  // bytes available
+  size_t
+  waitBytes(size_t nBytes)
+  {
+    if (!m_hasHdr) {
+      MPI_Wait(&m_hdrReq, MPI_STATUS_IGNORE);
+      postChunks();
+    }
+    size_t nChunks = numChunks(std::min(nBytes, size()));
+    while (m_numDone < nChunks) {
+      MPI_Wait(&m_reqs[m_numDone], MPI_STATUS_IGNORE);
+      m_numDone++;
+    }
+    return std::min(m_numDone * ChunkSz, size());
+  }
+
+  void
+  wait()
+  {
+    if (m_hdrReq != MPI_REQUEST_NULL || m_hasHdr) {
+      waitBytes(size());
+    }
+  }
+
+  bool
+  hasHdr() const
+  { return m_hasHdr; }
+
+  // size: valid only after the header has arrived
+  size_t
+  size() const
+  { return m_hasHdr ? (size_t)m_hdr : SIZE_MAX; }
+
+  uint8_t*
+  data() const
+  { return m_buf; }
+
+  // release: transfer ownership of a malloc'ed buffer to the caller
+  uint8_t*
+  release()
+  {
+    wait();
+    uint8_t* buf = m_buf;
+    m_buf = NULL;
+    return buf;
+  }
+
+private:
+  void
+  postChunks()
+  {
+    m_hasHdr = true;
+    size_t size = (size_t)m_hdr;
+    if (m_ownBuf) {
+      m_buf = (uint8_t*)malloc(std::max(size, (size_t)1));
+    }
+    else {
+      DIAG_Assert(size == m_bufSz, "RecvStream: unexpected message size "
+		  << size << " from rank " << m_src << " (expected "
+		  << m_bufSz << ")");
+    }
+    m_reqs.resize(numChunks(size), MPI_REQUEST_NULL);
+    for (size_t k = 0; k < m_reqs.size(); ++k) {
+      MPI_Irecv(m_buf + k * ChunkSz, (int)chunkSize(size, k), MPI_BYTE,
+		m_src, m_tag, m_comm, &m_reqs[k]);
+    }
+  }
+
+  long m_hdr;
+  MPI_Request m_hdrReq;
+  bool m_hasHdr;
+
+  int m_src, m_tag;
+  MPI_Comm m_comm;
+
+  uint8_t* m_buf;
+  size_t m_bufSz;
+  bool m_ownBuf;
+
+  std::vector<MPI_Request> m_reqs; // one per chunk
+  size_t m_numDone; // chunks [0, m_numDone) have arrived
+};
+
+
+// postRecvs: post a receive from each of 'srcs' (tag: source rank)
+static void
+postRecvs(std::vector<RecvStream*>& streams, const std::vector<int>& srcs,
+	  MPI_Comm comm)
+{
+  for (uint i = 0; i < srcs.size(); ++i) {
+    RecvStream* s = new RecvStream;
+    s->post(srcs[i], srcs[i], comm);
+    streams.push_back(s);
+  }
+}
+
 
+// progressOthers: make progress on every stream but 'i' so that chunk
+// receives for later sources are posted as soon as their headers arrive
+static void
+progressOthers(std::vector<RecvStream*>& streams, uint i)
+{
+  for (uint j = 0; j < streams.size(); ++j) {
+    if (j != i && streams[j]) {
+      streams[j]->test();
+    }
+  }
+}
+
+
+// waitOne: complete streams[i] while making progress on the others
+static void
+waitOne(std::vector<RecvStream*>& streams, uint i)
+{
+  bool othersPosted = false;
+  while (!othersPosted) {
+    if (streams[i]->test()) {
+      return;
+    }
+    othersPosted = true;
+    for (uint j = 0; j < streams.size(); ++j) {
+      if (j != i && streams[j] && !streams[j]->test()
+	  && !streams[j]->hasHdr()) {
+	othersPosted = false;
+      }
+    }
+  }
+  streams[i]->wait();
+}
+
+
+// broadcastBytes: pipelined broadcast of [buf, buf + size) from rank 0
+// along the reduction tree.  On ranks other than 0, 'buf' and 'size'
+// are outputs and 'buf' is malloc'ed.
+static void
+broadcastBytes(uint8_t*& buf, size_t& size, int myRank, MPI_Comm comm)
+{
+  int numRanks = 0;
+  MPI_Comm_size(comm, &numRanks);
+
+  SendStream toChild[2];
+  int numChildren = 0;
+  for (int child = 2 * myRank + 1;
+       child <= 2 * myRank + 2 && child < numRanks; ++child) {
+    numChildren++;
+  }
+
+  if (myRank == 0) {
+    for (int c = 0; c < numChildren; ++c) {
+      toChild[c].post(buf, size, 2 * myRank + 1 + c, myRank, comm);
+    }
+  }
+  else {
+    int parent = (myRank - 1) / 2;
+    RecvStream fromParent;
+    fromParent.post(parent, parent, comm);
+    fromParent.waitBytes(0);
+    size = fromParent.size();
+
+    for (int c = 0; c < numChildren; ++c) {
+      toChild[c].begin(size, 2 * myRank + 1 + c, myRank, comm);
+    }
+    for (size_t k = 0; k < numChunks(size); ++k) {
+      fromParent.waitBytes((k + 1) * ChunkSz);
+      for (int c = 0; c < numChildren; ++c) {
+	toChild[c].sendChunk(fromParent.data(), k);
+      }
+    }
+    buf = fromParent.release();
+  }
+
+  for (int c = 0; c < numChildren; ++c) {
+    toChild[c].wait();
+  }
+}
 
 
 //***************************************************************************
@@ -142,13 +461,7 @@ broadcast
     packProfile(*profile, &buf, &size);
   }
 
-  broadcast_sizet(size, comm);
-
-  if (myRank != 0) {
-    buf = (uint8_t *)malloc(size * sizeof(uint8_t));
-  }
-
-  MPI_Bcast(buf, size, MPI_BYTE, 0, comm);
+  broadcastBytes(buf, size, myRank, comm);
 
   if (myRank != 0) {
     profile = unpackProfile(buf, size);
@@ -172,13 +485,7 @@ broadcast
     packStringSet(stringSet, &buf, &size);
   }
 
-  broadcast_sizet(size, comm);
-
-  if (myRank != 0) {
-    buf = (uint8_t *)malloc(size * sizeof(uint8_t));
-  }
-
-  MPI_Bcast(buf, size, MPI_BYTE, 0, comm);
+  broadcastBytes(buf, size, myRank, comm);
 
   if (myRank != 0) {
     StringSet *rhs = unpackStringSet(buf, size);
@@ -197,47 +504,54 @@ packSend(Prof::CallPath::Profile* profile,
   uint8_t* profileBuf = NULL;
   size_t profileBufSz = 0;
   packProfile(*profile, &profileBuf, &profileBufSz);
-  MPI_Send(profileBuf, (int)profileBufSz, MPI_BYTE, dest, myRank, comm);
+
+  SendStream out;
+  out.post(profileBuf, profileBufSz, dest, myRank, comm);
+  out.wait();
+
   free(profileBuf);
 }
 
 void
 recvMerge(Prof::CallPath::Profile* profile,
-	  int src, int myRank, MPI_Comm comm)
+	  const std::vector<int>& srcs, int myRank, MPI_Comm comm)
 {
-  // probe src
-  MPI_Status mpistat;
-  MPI_Probe(src, src, comm, &mpistat);
-  int profileBufSz;
-  MPI_Get_count(&mpistat, MPI_BYTE, &profileBufSz);
-
-  // receive profile from src
-  uint8_t *profileBuf = new uint8_t[profileBufSz];
-  MPI_Recv(profileBuf, profileBufSz, MPI_BYTE, src, src, comm, &mpistat);
-  Prof::CallPath::Profile* new_profile =
-    unpackProfile(profileBuf, (size_t)profileBufSz);
-  delete[] profileBuf;
-
-  if (DBG_CCT_MERGE) {
-    string pfx0 = "[" + StrUtil::toStr(myRank) + "]";
-    string pfx1 = "[" + StrUtil::toStr(src) + "]";
-    DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx0.c_str()));
-    DIAG_DevMsgIf(1, new_profile->metricMgr()->toString(pfx1.c_str()));
-  }
+  std::vector<RecvStream*> streams;
+  postRecvs(streams, srcs, comm);
+
+  for (uint i = 0; i < srcs.size(); ++i) {
+    int src = srcs[i];
+
+    waitOne(streams, i);
+    Prof::CallPath::Profile* new_profile =
+      unpackProfile(streams[i]->data(), streams[i]->size());
+    delete streams[i];
+    streams[i] = NULL;
+
+    // keep later transfers moving before the (long) merge
+    progressOthers(streams, i);
+
+    if (DBG_CCT_MERGE) {
+      string pfx0 = "[" + StrUtil::toStr(myRank) + "]";
+      string pfx1 = "[" + StrUtil::toStr(src) + "]";
+      DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx0.c_str()));
+      DIAG_DevMsgIf(1, new_profile->metricMgr()->toString(pfx1.c_str()));
+    }
     
-  int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
-  profile->merge(*new_profile, mergeTy);
+    int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
+    profile->merge(*new_profile, mergeTy);
 
-  // merging the perf event statistics
-  profile->metricMgr()->mergePerfEventStatistics(new_profile->metricMgr());
+    // merging the perf event statistics
+    profile->metricMgr()->mergePerfEventStatistics(new_profile->metricMgr());
 
-  if (DBG_CCT_MERGE) {
-    string pfx = ("[" + StrUtil::toStr(src)
-		  + " => " + StrUtil::toStr(myRank) + "]");
-    DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx.c_str()));
-  }
+    if (DBG_CCT_MERGE) {
+      string pfx = ("[" + StrUtil::toStr(src)
+		    + " => " + StrUtil::toStr(myRank) + "]");
+      DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx.c_str()));
+    }
 
-  delete new_profile;
+    delete new_profile;
+  }
 }
 
 void
@@ -248,24 +562,70 @@ packSend(std::pair<Prof::CallPath::Profile*,
   Prof::CallPath::Profile* profile = data.first;
   ParallelAnalysis::PackedMetrics* packedMetrics = data.second;
   packMetrics(*profile, *packedMetrics);
-  MPI_Send(packedMetrics->data(), packedMetrics->dataSize(),
-	   MPI_DOUBLE, dest, myRank, comm);
+
+  SendStream out;
+  out.post((uint8_t*)packedMetrics->data(),
+	   packedMetrics->dataSize() * sizeof(double), dest, myRank, comm);
+  out.wait();
 }
 
 void
 recvMerge(std::pair<Prof::CallPath::Profile*,
 	  ParallelAnalysis::PackedMetrics*> data,
-	  int src, int myRank, MPI_Comm comm)
+	  const std::vector<int>& srcs, int myRank, MPI_Comm comm)
 {
   Prof::CallPath::Profile* profile = data.first;
   ParallelAnalysis::PackedMetrics* packedMetrics = data.second;
 
-  // receive new metric data from src
-  MPI_Status mpistat;
-  MPI_Recv(packedMetrics->data(), packedMetrics->dataSize(),
-	   MPI_DOUBLE, src, src, comm, &mpistat);
-  DIAG_Assert(packedMetrics->verify(), DIAG_UnexpectedInput);
-  unpackMetrics(*profile, *packedMetrics);
+  // Receive into one matrix per source so that later sources stream
+  // in while earlier ones are unpacked.
+  std::vector<ParallelAnalysis::PackedMetrics*> matrices;
+  std::vector<RecvStream*> streams;
+  for (uint i = 0; i < srcs.size(); ++i) {
+    ParallelAnalysis::PackedMetrics* pm = packedMetrics;
+    if (i > 0) {
+      pm = new ParallelAnalysis::PackedMetrics(packedMetrics->numNodes(),
+					       packedMetrics->mBegId(),
+					       packedMetrics->mEndId(),
+					       packedMetrics->mDrvdBegId(),
+					       packedMetrics->mDrvdEndId());
+    }
+    matrices.push_back(pm);
+
+    RecvStream* s = new RecvStream;
+    s->post(srcs[i], srcs[i], comm, (uint8_t*)pm->data(),
+	    pm->dataSize() * sizeof(double));
+    streams.push_back(s);
+  }
+
+  for (uint i = 0; i < srcs.size(); ++i) {
+    ParallelAnalysis::PackedMetrics& pm = *matrices[i];
+    RecvStream& s = *streams[i];
+
+    // unpack rows as their chunks arrive (row 0 is unused)
+    size_t dataSz = pm.dataSize() * sizeof(double);
+    uint nodeBeg = 1;
+    for (size_t nBytes = 0; nBytes < dataSz; ) {
+      nBytes = s.waitBytes(nBytes + ChunkSz);
+      progressOthers(streams, i);
+
+      if (nodeBeg == 1) {
+	DIAG_Assert(pm.verify(), DIAG_UnexpectedInput);
+      }
+      uint nodeEnd = pm.numRows(nBytes / sizeof(double));
+      if (nodeEnd > nodeBeg) {
+	unpackMetricRows(*profile, pm, nodeBeg, nodeEnd);
+	nodeBeg = nodeEnd;
+      }
+    }
+    updateMetrics(*profile, pm);
+
+    delete streams[i];
+    streams[i] = NULL;
+    if (i > 0) {
+      delete matrices[i];
+    }
+  }
 }
 
 void
@@ -275,30 +635,31 @@ packSend(StringSet *stringSet,
   uint8_t* stringSetBuf = NULL;
   size_t stringSetBufSz = 0;
   packStringSet(*stringSet, &stringSetBuf, &stringSetBufSz);
-  MPI_Send(stringSetBuf, (int)stringSetBufSz, MPI_BYTE, 
-	   dest, myRank, comm);
+
+  SendStream out;
+  out.post(stringSetBuf, stringSetBufSz, dest, myRank, comm);
+  out.wait();
+
   free(stringSetBuf);
 }
 
 void
 recvMerge(StringSet *stringSet,
-	  int src, int myRank, MPI_Comm comm)
+	  const std::vector<int>& srcs, int myRank, MPI_Comm comm)
 {
-  // determine size of incoming packed directory set from src
-  MPI_Status mpistat;
-  MPI_Probe(src, src, comm, &mpistat);
-  int stringSetBufSz = 0;
-  MPI_Get_count(&mpistat, MPI_BYTE, &stringSetBufSz);
-
-  // receive new stringSet from src
-  uint8_t *stringSetBuf = new uint8_t[stringSetBufSz];
-  MPI_Recv(stringSetBuf, stringSetBufSz, MPI_BYTE, 
-	   src, src, comm, &mpistat);
-  StringSet *new_stringSet =
-    unpackStringSet(stringSetBuf, (size_t) stringSetBufSz);
-  delete[] stringSetBuf;
-  *stringSet += *new_stringSet;
-  delete new_stringSet;
+  std::vector<RecvStream*> streams;
+  postRecvs(streams, srcs, comm);
+
+  for (uint i = 0; i < srcs.size(); ++i) {
+    waitOne(streams, i);
+    StringSet *new_stringSet =
+      unpackStringSet(streams[i]->data(), streams[i]->size());
+    delete streams[i];
+    streams[i] = NULL;
+
+    *stringSet += *new_stringSet;
+    delete new_stringSet;
+  }
 }
 
 
@@ -393,25 +754,43 @@ packMetrics(const Prof::CallPath::Profile& profile,
 void
 unpackMetrics(Prof::CallPath::Profile& profile,
 	      const ParallelAnalysis::PackedMetrics& packedMetrics)
+{
+  unpackMetricRows(profile, packedMetrics, 1, packedMetrics.numNodes());
+  updateMetrics(profile, packedMetrics);
+}
+
+
+// unpackMetricRows: unpack rows [nodeBeg, nodeEnd) of 'packedMetrics'
+// into temporary derived metrics [mBegId, mEndId) in 'profile'
+static void
+unpackMetricRows(Prof::CallPath::Profile& profile,
+		 const ParallelAnalysis::PackedMetrics& packedMetrics,
+		 uint nodeBeg, uint nodeEnd)
 {
   Prof::CCT::Tree& cct = *profile.cct();
 
-  // 1. unpack 'packedMetrics' into temporary derived metrics [mBegId,
-  //    mEndId) in 'profile'
   uint mBegId = packedMetrics.mBegId(), mEndId = packedMetrics.mEndId();
 
   DIAG_Assert(packedMetrics.numNodes() == cct.maxDenseId() + 1, "");
   DIAG_Assert(packedMetrics.numMetrics() == mEndId - mBegId, "");
 
-  for (uint nodeId = 1; nodeId < packedMetrics.numNodes(); ++nodeId) {
+  for (uint nodeId = nodeBeg; nodeId < nodeEnd; ++nodeId) {
+    Prof::CCT::ANode* n = cct.findNode(nodeId);
     for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
-      Prof::CCT::ANode* n = cct.findNode(nodeId);
       n->demandMetric(mId2) = packedMetrics.idx(nodeId, mId1);
     }
   }
+}
+
+
+// updateMetrics: update derived metrics [mDrvdBeg, mDrvdEnd) based on
+// new values in [mBegId, mEndId)
+static void
+updateMetrics(Prof::CallPath::Profile& profile,
+	      const ParallelAnalysis::PackedMetrics& packedMetrics)
+{
+  Prof::CCT::Tree& cct = *profile.cct();
 
-  // 2. update derived metrics [mDrvdBeg, mDrvdEnd) based on new
-  //    values in [mBegId, mEndId)
   uint mDrvdBeg = packedMetrics.mDrvdBegId();
   uint mDrvdEnd = packedMetrics.mDrvdEndId();
   cct.root()->computeMetricsIncr(*profile.metricMgr(), mDrvdBeg, mDrvdEnd,
@@ -174,6 +174,21 @@ public:
   dataSize() const
   { return (m_numNodes * m_numMetrics) + m_numHdr; }
 
+  // numRows: number of complete rows (nodes) within the first
+  // 'numElems' elements of data(); used to unpack a partial transfer
+  uint
+  numRows(size_t numElems) const
+  {
+    if (numElems < m_numHdr) {
+      return 0;
+    }
+    if (m_numMetrics == 0) {
+      return m_numNodes;
+    }
+    size_t rows = (numElems - m_numHdr) / m_numMetrics;
+    return (rows < m_numNodes) ? (uint)rows : m_numNodes;
+  }
+
 private:
   static const uint m_numHdr = 4;
   static const uint m_numNodesIdx   = 0;
@@ -200,7 +215,14 @@ private:
 namespace ParallelAnalysis {
 
 // ------------------------------------------------------------------------
-// recvMerge: merge profile on rank_y into profile on rank_x
+// packSend: send the object on 'myRank' to rank 'dest'
+// recvMerge: merge the objects on ranks 'srcs' into the object on
+//   'myRank', in the order given.  Receives from every source are
+//   posted up front so that later transfers overlap the unpacking and
+//   merging of earlier ones.
+//
+// Objects are sent as a size header followed by fixed-size chunks
+// using non-blocking point-to-point operations (cf. ParallelAnalysis.cpp).
 // ------------------------------------------------------------------------
 
 void
@@ -208,7 +230,8 @@ packSend(Prof::CallPath::Profile* profile,
 	 int dest, int myRank, MPI_Comm comm = MPI_COMM_WORLD);
 void
 recvMerge(Prof::CallPath::Profile* profile,
-	  int src, int myRank, MPI_Comm comm = MPI_COMM_WORLD);
+	  const std::vector<int>& srcs, int myRank,
+	  MPI_Comm comm = MPI_COMM_WORLD);
 
 void
 packSend(std::pair<Prof::CallPath::Profile*,
@@ -217,14 +240,16 @@ packSend(std::pair<Prof::CallPath::Profile*,
 void
 recvMerge(std::pair<Prof::CallPath::Profile*,
 	  ParallelAnalysis::PackedMetrics*> data,
-	  int src, int myRank, MPI_Comm comm = MPI_COMM_WORLD);
+	  const std::vector<int>& srcs, int myRank,
+	  MPI_Comm comm = MPI_COMM_WORLD);
 
 void
 packSend(StringSet *stringSet,
 	 int dest, int myRank, MPI_Comm comm = MPI_COMM_WORLD);
 void
 recvMerge(StringSet *stringSet,
-	  int src, int myRank, MPI_Comm comm = MPI_COMM_WORLD);
+	  const std::vector<int>& srcs, int myRank,
+	  MPI_Comm comm = MPI_COMM_WORLD);
 
 // ------------------------------------------------------------------------
 // reduce: Uses a tree-based reduction to reduce the profile at every
@@ -233,30 +258,33 @@ recvMerge(StringSet *stringSet,
 // 
 // T: Prof::CallPath::Profile*
 // T: std::pair<Prof::CallPath::Profile*, ParallelAnalysis::PackedMetrics*>
+// T: StringSet*
 // ------------------------------------------------------------------------
 
 template<typename T>
 void
 reduce(T object, int myRank, int numRanks, MPI_Comm comm = MPI_COMM_WORLD)
 {
-  int lchild = 2 * myRank + 1;
-  if (lchild < numRanks) {
-    recvMerge(object, lchild, myRank);
-    int rchild = 2 * myRank + 2;
-    if (rchild < numRanks) {
-      recvMerge(object, rchild, myRank);
-    }
+  // N.B.: always merge left child before right
+  std::vector<int> children;
+  for (int child = 2 * myRank + 1;
+       child <= 2 * myRank + 2 && child < numRanks; ++child) {
+    children.push_back(child);
+  }
+  if (!children.empty()) {
+    recvMerge(object, children, myRank, comm);
   }
   if (myRank > 0) {
     int parent = (myRank - 1) / 2;
-    packSend(object, parent, myRank);
+    packSend(object, parent, myRank, comm);
   }
 }
 
 
 // ------------------------------------------------------------------------
 // broadcast: Broadcast the profile at the tree's root (rank 0) to every
-// other rank.  Assumes 0-based ranks.
+// other rank.  Assumes 0-based ranks.  Uses the same tree as 'reduce';
+// each rank forwards a chunk to its children as soon as it arrives.
 // ------------------------------------------------------------------------
 void
 broadcast(Prof::CallPath::Profile*& profile, int myRank,
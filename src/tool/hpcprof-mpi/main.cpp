@@ -137,22 +137,12 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 		       const vector<uint>& groupIdToGroupSizeMap,
 		       int myRank);
 
-static void
-makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		       const string& profileFile,
-		       const Analysis::Args& args, uint groupId, uint groupMax,
-		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
-		       int myRank);
-
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
 		      int myRank);
 
-static string
-makeDBFileName(const string& dbDir, uint groupId, const string& profileFile);
-
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
 	       const string& metricDBFnm);
@@ -308,7 +298,8 @@ realmain(int argc, char* const* argv)
   Analysis::Util::UIntVec* groupMap =
     (nArgs.groupMax > 1) ? nArgs.groupMap : NULL;
 
-  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags);
+  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags,
+				     /*mrgFlags*/ 0, args.prof_jobs);
 
   // -------------------------------------------------------
   // 1b. Create canonical CCT (metrics merged by <group>.<name>.*)
@@ -344,9 +335,29 @@ realmain(int argc, char* const* argv)
   // ids; corresponding nodes have idential ids.
   // -------------------------------------------------------
 
+  // N.B.: With a writable structure cache, rank 0 reads the structure
+  // first so that it can leave a binary copy of each XML structure
+  // file there; the other ranks then map the binary copies instead of
+  // all parsing the XML.  Without one, waiting for rank 0 would only
+  // serialize the parse, so all ranks read at once.
   Prof::Struct::Tree* structure = new Prof::Struct::Tree("");
   if (!args.structureFiles.empty()) {
-    Analysis::CallPath::readStructure(structure, args);
+    int rank0First = 0;
+    if (myRank == 0) {
+      rank0First = (!args.structCacheDir.empty()
+		    && access(args.structCacheDir.c_str(), W_OK) == 0);
+    }
+    MPI_Bcast(&rank0First, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (!rank0First || myRank == 0) {
+      Analysis::CallPath::readStructure(structure, args);
+    }
+    if (rank0First) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      if (myRank != 0) {
+	Analysis::CallPath::readStructure(structure, args);
+      }
+    }
   }
   profGbl->structure(structure);
 
@@ -595,8 +606,9 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
   for (uint i = 0; i < nArgs.paths->size(); ++i) {
     const string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
-    makeSummaryMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
-			   groupIdToGroupMetricsMap, myRank);
+    Analysis::CallPath::makeSummaryMetrics_Lcl(profGbl, fnm, groupId,
+					       nArgs.groupMax,
+					       groupIdToGroupMetricsMap);
   }
 
   // -------------------------------------------------------
@@ -682,11 +694,8 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 {
   Prof::Metric::Mgr& mMgrGbl = *(profGbl.metricMgr());
 
-  uint numSrc = mMgrGbl.size();
-  uint mSrcBeg = 0, mSrcEnd = numSrc; // [ )
+  uint mSrcBeg = 0, mSrcEnd = mMgrGbl.size(); // [ )
 
-  uint numDrvd = 0;
-  mDrvdBeg = mDrvdEnd = 0;   // [ )
   mXDrvdBeg = mXDrvdEnd = 0; // [ )
 
   // -------------------------------------------------------
@@ -697,51 +706,13 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
     Analysis::Args::MetricFlg_isSet(args.prof_metrics,
 				    Analysis::Args::MetricFlg_StatsAll);
 
-  mDrvdBeg = mMgrGbl.makeSummaryMetricsIncr(needAllStats, mSrcBeg, mSrcEnd);
-  if (mDrvdBeg != Prof::Metric::Mgr::npos) {
-    mDrvdEnd = mMgrGbl.size();
-    numDrvd = (mDrvdEnd - mDrvdBeg);
-  }
-
-  for (uint i = mSrcBeg; i < mSrcEnd; ++i) {
-    Prof::Metric::ADesc* m = mMgrGbl.metric(i);
-    m->visibility(HPCRUN_FMT_METRIC_HIDE);
-    m->isTemporary(true);
-  }
-
-  for (uint i = mDrvdBeg; i < mDrvdEnd; ++i) {
-    Prof::Metric::ADesc* m = mMgrGbl.metric(i);
-
-    uint groupId = 1; // default group-id
-
-    // find groupId embedded in metric descriptor name
-    const string& nmPfx = m->namePfx();
-    if (!nmPfx.empty()) {
-      groupId = (uint)StrUtil::toUInt64(nmPfx);
-    }
-    DIAG_Assert(groupId > 0, DIAG_UnexpectedInput);
-    DIAG_Assert(groupId < groupIdToGroupMetricsMap.size(), DIAG_UnexpectedInput);
-
-    // rank 0: set the number of inputs
-    if (myRank == 0) {
-      Prof::Metric::DerivedIncrDesc* mm = 
-	dynamic_cast<Prof::Metric::DerivedIncrDesc*>(m);
-      DIAG_Assert(mm, DIAG_UnexpectedInput);
-    
-      // N.B.: groupIdToGroupSizeMap is only initialized for rank 0
-      uint numInputs = groupIdToGroupSizeMap[groupId]; // / <n> TODO:threads
-      if (mm->expr()) {
-        mm->expr()->numSrcFxd(numInputs);
-      }
-    }
-   
-    // populate groupIdToGroupMetricsMap map
-    VMAIntervalSet*& ivalset = groupIdToGroupMetricsMap[groupId];
-    if (!ivalset) {
-      ivalset = new VMAIntervalSet;
-    }
-    ivalset->insert(i, i + 1); // [ )
-  }
+  // N.B.: groupIdToGroupSizeMap is only initialized for rank 0
+  uint numDrvd =
+    Analysis::CallPath::makeSummaryMetricDescs(profGbl, needAllStats,
+					       groupIdToGroupMetricsMap,
+					       (myRank == 0)
+					       ? &groupIdToGroupSizeMap : NULL,
+					       mDrvdBeg, mDrvdEnd);
   
   // -------------------------------------------------------
   // make temporary set of extra derived metrics (for reduction)
@@ -763,214 +734,56 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 }
 
 
-// makeSummaryMetrics_Lcl: Make summary metrics.
-//
-// Assumes:
-// - 'profGbl' is the canonical CCT (with structure and with
-//   canonical ids)
-// - each thread-level CCT is always a subset of 'profGbl' (the
-//   canonical CCT); in other words, 'profGbl' should not be pruned
-//   in any way!
-// - 'args' contains the correct final experiment database.
-//
-// FIXME: abstract between makeSummaryMetrics_Lcl() & makeThreadMetrics_Lcl()
-static void
-makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		       const string& profileFile,
-		       const Analysis::Args& args, uint groupId, uint groupMax,
-		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
-		       int myRank)
-{
-  Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
-  Prof::CCT::Tree* cctGbl = profGbl.cct();
-  Prof::CCT::ANode* cctRootGbl = cctGbl->root();
-
-  // -------------------------------------------------------
-  // read profile file
-  // -------------------------------------------------------
-  uint rFlags = (Prof::CallPath::Profile::RFlg_NoMetricSfx
-		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
-  uint rGroupId = (groupMax > 1) ? groupId : 0;
-
-  Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
-
-  // -------------------------------------------------------
-  // merge into canonical CCT
-  // -------------------------------------------------------
-  int mergeTy  = Prof::CallPath::Profile::Merge_MergeMetricByName;
-  int mergeFlg = (Prof::CCT::MrgFlg_AssertCCTMergeOnly);
-
-  // Add *some* structure information to the leaves of 'prof' so that
-  // it will be merged successfully with the structured canonical CCT
-  // 'profGbl'.
-  //
-  // Background: When CCT::Stmts are merged in
-  // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
-  // information is not retained.  This means that when merging 'prof'
-  // into 'profGbl' (using CallPath::Profile::merge()), many leaves in
-  // 'prof' will not find their corresponding node in 'profGbl' unless
-  // corrective measures are taken.
-  prof->structure(profGbl.structure());
-  Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
-  prof->structure(NULL);
-
-  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
-  uint mEnd = mBeg + prof->metricMgr()->size();        //  open end)
-
-  // -------------------------------------------------------
-  // compute local incl/excl sampled metrics and update local derived metrics
-  // -------------------------------------------------------
-
-  // 1. Batch compute local sampled metrics
-  VMAIntervalSet ivalsetIncl;
-  VMAIntervalSet ivalsetExcl;
-
-  for (uint mId = mBeg; mId < mEnd; ++mId) {
-    Prof::Metric::ADesc* m = mMgrGbl->metric(mId);
-    if (m->type() == Prof::Metric::ADesc::TyIncl) {
-      ivalsetIncl.insert(VMAInterval(mId, mId + 1)); // [ )
-    }
-    else if (m->type() == Prof::Metric::ADesc::TyExcl) {
-      ivalsetExcl.insert(VMAInterval(mId, mId + 1)); // [ )
-    }
-  }
-
-  cctRootGbl->aggregateMetricsIncl(ivalsetIncl);
-  cctRootGbl->aggregateMetricsExcl(ivalsetExcl);
-
-
-  // 2. Batch compute local derived metrics
-  const VMAIntervalSet* ivalsetDrvd = groupIdToGroupMetricsMap[groupId];
-  if (ivalsetDrvd) {
-    DIAG_Assert(ivalsetDrvd->size() == 1, DIAG_UnexpectedInput);
-    const VMAInterval& ival = *(ivalsetDrvd->begin());
-    uint mDrvdBeg = (uint)ival.beg();
-    uint mDrvdEnd = (uint)ival.end();
-
-    DIAG_MsgIf(0, "[" << myRank << "] grp " << groupId << ": [" << mDrvdBeg << ", " << mDrvdEnd << ")");
-    cctRootGbl->computeMetricsIncr(*mMgrGbl, mDrvdBeg, mDrvdEnd,
-				   Prof::Metric::AExprIncr::FnAccum);
-  }
-
-  // -------------------------------------------------------
-  // reinitialize metric values for next time
-  // -------------------------------------------------------
-
-  // TODO: This really should (a) come immediately after the MetricMgr
-  // merge above and (b) use FnInitSrc (not 0).  However, to do this
-  // we would need to (a) split the MetricMgr merge and CCT merge into
-  // two; and (b) use a CCT init (which whould initialize using
-  // assignment) instead of CCT::merge() (which initializes based on
-  // addition against 0).
-  cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
-  
-  delete prof;
-}
-
-
 // makeThreadMetrics_Lcl: Make thread-level metric database.
 //
-// Makes same assumptions as makeSummaryMetrics_Lcl but with one key
-// exception: Each thread-level CCT does not have to be a subset of
-// 'profGbl' (the canonical CCT); in other words, 'profGbl' may be
-// pruned.
+// Makes same assumptions as Analysis::CallPath::makeSummaryMetrics_Lcl
+// but with one key exception: Each thread-level CCT does not have to
+// be a subset of 'profGbl' (the canonical CCT); in other words,
+// 'profGbl' may be pruned.
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
 		      int myRank)
 {
-  Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
-  Prof::CCT::Tree* cctGbl = profGbl.cct();
-  Prof::CCT::ANode* cctRootGbl = cctGbl->root();
+  Prof::CCT::ANode* cctRootGbl = profGbl.cct()->root();
 
   // -------------------------------------------------------
-  // read profile file
+  // merge into canonical CCT and compute local incl/excl sampled metrics
   // -------------------------------------------------------
-  uint rFlags = (Prof::CallPath::Profile::RFlg_NoMetricSfx
-		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
-  uint rGroupId = (groupMax > 1) ? groupId : 0;
-
-  Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
-
-  // -------------------------------------------------------
-  // merge into canonical CCT
-  // -------------------------------------------------------
-  int mergeTy  = Prof::CallPath::Profile::Merge_MergeMetricByName;
   int mergeFlg = (Prof::CCT::MrgFlg_NormalizeTraceFileY
 		  | Prof::CCT::MrgFlg_CCTMergeOnly);
 
-  // Add *some* structure information to the leaves of 'prof' so that
-  // it will be merged successfully with the structured canonical CCT
-  // 'profGbl'.
-  //
-  // Background: When CCT::Stmts are merged in
-  // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
-  // information is not retained.  This means that when merging 'prof'
-  // into 'profGbl' (using CallPath::Profile::merge()), many leaves in
-  // 'prof' will not find their corresponding node in 'profGbl' unless
-  // corrective measures are taken.
-  prof->structure(profGbl.structure());
-  Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
-  prof->structure(NULL);
-
-  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
+  uint mBeg, mEnd; // [ )
+  Analysis::CallPath::readMergeProfile(profGbl, profileFile, groupId,
+				       groupMax, mergeFlg,
+				       args.db_makeMetricDB/*doAggregate*/,
+				       mBeg, mEnd);
 
   if (args.db_makeMetricDB) {
-    uint mEnd = mBeg + prof->metricMgr()->size(); // open end)
-
-    // -------------------------------------------------------
-    // compute local incl/excl sampled metrics
-    // -------------------------------------------------------
-
-    VMAIntervalSet ivalsetIncl;
-    VMAIntervalSet ivalsetExcl;
-    
-    for (uint mId = mBeg; mId < mEnd; ++mId) {
-      Prof::Metric::ADesc* m = mMgrGbl->metric(mId);
-      if (m->type() == Prof::Metric::ADesc::TyIncl) {
-	ivalsetIncl.insert(VMAInterval(mId, mId + 1)); // [ )
-      }
-      else if (m->type() == Prof::Metric::ADesc::TyExcl) {
-	ivalsetExcl.insert(VMAInterval(mId, mId + 1)); // [ )
-      }
-    }
-    
-    cctRootGbl->aggregateMetricsIncl(ivalsetIncl);
-    cctRootGbl->aggregateMetricsExcl(ivalsetExcl);
-
     // -------------------------------------------------------
     // write local sampled metric values into database
     // -------------------------------------------------------
 
-    string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
-    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    string dbFnm =
+      Analysis::CallPath::makeMetricDBFileName(args.db_dir, groupId,
+					       profileFile,
+					       args.db_metricDBSparse);
+    if (args.db_metricDBSparse) {
+      Analysis::CallPath::writeSparseMetricDB(profGbl, mBeg, mEnd, dbFnm);
+    }
+    else {
+      writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    }
 
     // -------------------------------------------------------
     // reinitialize metric values for next time
     // -------------------------------------------------------
     
-    // TODO: see corresponding comments in makeSummaryMetrics_Lcl()
+    // TODO: see corresponding comments in
+    // Analysis::CallPath::makeSummaryMetrics_Lcl()
     cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
   }
-
-  delete prof;
-}
-
-
-static string
-makeDBFileName(const string& dbDir, uint groupId, const string& profileFile)
-{
-  string grpStr = StrUtil::toStr(groupId);
- 
-  string fnm_base = FileUtil::rmSuffix(FileUtil::basename(profileFile.c_str()));
-
-  string fnm = grpStr + "." + fnm_base + "." + HPCPROF_MetricDBSfx;
-
-  string metricDBFnm = dbDir + "/" + fnm;
-  return metricDBFnm;
 }
 
 
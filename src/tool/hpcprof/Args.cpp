@@ -90,6 +90,7 @@ Args::Args()
 {
   hpcprof_isMetricArg = false;
   hpcprof_forceMetrics = false;
+  hpcprof_stream = false;
 }
 
 
@@ -111,8 +112,14 @@ Args::parse(int argc, const char* const argv[])
     hpcprof_forceMetrics = true;
   }
 
-  // Currently, hpcprof does not generate thread-level metric db
-  db_makeMetricDB = false;
+  if (parser.isOpt("stream")) {
+    hpcprof_stream = true;
+  }
+
+  // hpcprof generates only the sparse thread-level metric db
+  if (!db_metricDBSparse) {
+    db_makeMetricDB = false;
+  }
 }
 
 
@@ -79,6 +79,7 @@ using std::string;
 
 #include <lib/support/diagnostics.h>
 #include <lib/support/RealPathMgr.hpp>
+#include <lib/support/StrUtil.hpp>
 
 
 //*************************** Forward Declarations ***************************
@@ -91,6 +92,20 @@ makeMetrics(Prof::CallPath::Profile& prof,
 	    const Analysis::Args& args,
 	    const Analysis::Util::NormalizeProfileArgs_t& nArgs);
 
+static void
+makeMetricDB(Prof::CallPath::Profile& prof,
+	     const Analysis::Args& args,
+	     const Analysis::Util::NormalizeProfileArgs_t& nArgs);
+
+static void
+makeDatabaseStreamed(Args& args,
+		     const Analysis::Util::NormalizeProfileArgs_t& nArgs);
+
+static void
+makeSummaryMetricsStreamed(Prof::CallPath::Profile& prof,
+			   const Analysis::Args& args,
+			   const Analysis::Util::NormalizeProfileArgs_t& nArgs);
+
 
 //****************************************************************************
 
@@ -154,6 +169,12 @@ realmain(int argc, char* const* argv)
     exit(-1);
   }
 
+  if (args.hpcprof_stream) {
+    makeDatabaseStreamed(args, nArgs);
+    nArgs.destroy();
+    return 0;
+  }
+
   if (nArgs.paths->size() == 1 && !args.hpcprof_isMetricArg) {
     args.prof_metrics = Analysis::Args::MetricFlg_Thread;
   }
@@ -179,7 +200,8 @@ realmain(int argc, char* const* argv)
   uint mrgFlags = (Prof::CCT::MrgFlg_NormalizeTraceFileY);
 
   Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags);
+    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags,
+			     args.prof_jobs);
 
   prof->disable_redundancy(args.remove_redundancy);
 
@@ -235,7 +257,10 @@ realmain(int argc, char* const* argv)
   // -------------------------------------------------------
   // 2c. Create thread-level metric DB
   // -------------------------------------------------------
-  // Currently we use --metric=thread as a proxy for the metric database
+
+  if (args.db_makeMetricDB) {
+    makeMetricDB(*prof, args, nArgs);
+  }
 
   // ------------------------------------------------------------
   // 3. Generate Experiment database
@@ -336,3 +361,235 @@ makeMetrics(Prof::CallPath::Profile& prof,
     m->computedType(Prof::Metric::ADesc::ComputedTy_NonFinal);
   }
 }
+
+
+// makeMetricDB: Write a sparse metric-db file for each profile.  Each
+// profile's metrics were merged into 'prof' as a contiguous block of
+// source metrics, in the order the profiles were read (cf.
+// Analysis::CallPath::read()); a block begins with the metric whose
+// dbId() is 0 and spans dbNumMetrics() metrics.
+static void
+makeMetricDB(Prof::CallPath::Profile& prof,
+	     const Analysis::Args& args,
+	     const Analysis::Util::NormalizeProfileArgs_t& nArgs)
+{
+  Prof::Metric::Mgr& mMgr = *prof.metricMgr();
+
+  std::vector<uint> blockBeg;
+  for (uint mId = 0; mId < mMgr.size(); ++mId) {
+    Prof::Metric::ADesc* m = mMgr.metric(mId);
+    if (m->hasDBInfo() && m->dbId() == 0) {
+      blockBeg.push_back(mId);
+    }
+  }
+
+  // Profiles whose (suffixed) metric names coincide share columns, in
+  // which case the columns no longer hold per-profile values.
+  if (blockBeg.size() != nArgs.paths->size()) {
+    DIAG_WMsg(1, "Cannot match metrics to profiles; no metric database generated.");
+    mMgr.zeroDBInfo();
+    return;
+  }
+
+  for (uint i = 0; i < blockBeg.size(); ++i) {
+    uint mBeg = blockBeg[i];
+    uint mEnd = mBeg + mMgr.metric(mBeg)->dbNumMetrics();
+    DIAG_Assert(mEnd <= mMgr.size(), DIAG_UnexpectedInput);
+
+    const string& fnm = (*nArgs.paths)[i];
+    uint groupId = (*nArgs.groupMap)[i];
+
+    string dbFnm =
+      Analysis::CallPath::makeMetricDBFileName(args.db_dir, groupId, fnm,
+					       true/*isSparse*/);
+    Analysis::CallPath::writeSparseMetricDB(prof, mBeg, mEnd, dbFnm);
+
+    // As with hpcprof-mpi, describe the database by one block of metrics
+    if (i > 0) {
+      for (uint mId = mBeg; mId < mEnd; ++mId) {
+	mMgr.metric(mId)->zeroDBInfo();
+      }
+    }
+  }
+}
+
+
+//****************************************************************************
+// streamed database
+//
+// The in-memory path above keeps every profile's metric values in the
+// canonical CCT at once.  Instead, as in hpcprof-mpi, first merge only
+// the CCT skeletons, then read the profiles again one at a time,
+// accumulating each into the summary metrics and writing its
+// thread-level metric file before reading the next.  Peak memory is
+// the merged CCT plus one profile.
+//****************************************************************************
+
+static void
+makeDatabaseStreamed(Args& args,
+		     const Analysis::Util::NormalizeProfileArgs_t& nArgs)
+{
+  if (Analysis::Args::MetricFlg_isThread(args.prof_metrics)) {
+    DIAG_WMsg(1, "--stream does not compute 'thread' metrics; use --metric-db sparse for thread-level values.");
+  }
+
+  // ------------------------------------------------------------
+  // 1a. Create canonical CCT without metric values
+  // ------------------------------------------------------------
+
+  int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
+  Analysis::Util::UIntVec* groupMap =
+    (nArgs.groupMax > 1) ? nArgs.groupMap : NULL;
+
+  uint rFlags = (Prof::CallPath::Profile::RFlg_VirtualMetrics
+		 | Prof::CallPath::Profile::RFlg_NoMetricSfx
+		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
+  uint mrgFlags = (Prof::CCT::MrgFlg_NormalizeTraceFileY);
+
+  Prof::CallPath::Profile* prof =
+    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags,
+			     args.prof_jobs);
+
+  prof->disable_redundancy(args.remove_redundancy);
+
+  args.makeDatabaseDir();
+
+  // ------------------------------------------------------------
+  // 1b. Add static structure to canonical CCT
+  //
+  // N.B.: transformCudaCFGMain() is not applied: it restructures the
+  // CCT, after which the profiles no longer merge into it.
+  // ------------------------------------------------------------
+
+  Prof::Struct::Tree* structure = new Prof::Struct::Tree("");
+  if (!args.structureFiles.empty()) {
+    Analysis::CallPath::readStructure(structure, args);
+  }
+  prof->structure(structure);
+
+  Analysis::CallPath::overlayStaticStructureMain(*prof, args.agent,
+						 args.doNormalizeTy,
+						 true/*printProgress*/);
+
+  prof->cct()->makeDensePreorderIds();
+
+  // -------------------------------------------------------
+  // 2a. Create summary metrics (first pass over profiles)
+  // -------------------------------------------------------
+
+  makeSummaryMetricsStreamed(*prof, args, nArgs);
+
+  // -------------------------------------------------------
+  // 2b. Prune and normalize canonical CCT
+  // -------------------------------------------------------
+
+  // Pruning would drop nodes that the thread-level pass must find.
+  if (!args.db_makeMetricDB) {
+    Analysis::CallPath::pruneBySummaryMetrics(*prof, NULL);
+  }
+
+  Analysis::CallPath::normalize(*prof, args.agent, args.doNormalizeTy);
+
+  // Apply after all CCT pruning/normalization is completed.
+  Analysis::CallPath::applySummaryMetricAgents(*prof, args.agent);
+
+  prof->cct()->makeDensePreorderIds();
+
+  // -------------------------------------------------------
+  // 2c. Create thread-level metric DB (second pass over profiles)
+  // -------------------------------------------------------
+
+  if (args.db_makeMetricDB) {
+    Prof::CCT::ANode* cctRoot = prof->cct()->root();
+    int mergeFlg = (Prof::CCT::MrgFlg_CCTMergeOnly);
+
+    for (uint i = 0; i < nArgs.paths->size(); ++i) {
+      const string& fnm = (*nArgs.paths)[i];
+      uint groupId = (*nArgs.groupMap)[i];
+
+      uint mBeg, mEnd; // [ )
+      Analysis::CallPath::readMergeProfile(*prof, fnm, groupId,
+					   nArgs.groupMax, mergeFlg,
+					   true/*doAggregate*/, mBeg, mEnd);
+
+      string dbFnm =
+	Analysis::CallPath::makeMetricDBFileName(args.db_dir, groupId, fnm,
+						 true/*isSparse*/);
+      Analysis::CallPath::writeSparseMetricDB(*prof, mBeg, mEnd, dbFnm);
+
+      cctRoot->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
+    }
+  }
+
+  // ------------------------------------------------------------
+  // 3. Generate Experiment database
+  // ------------------------------------------------------------
+
+  Analysis::CallPath::pruneStructTree(*prof);
+
+  if (args.title.empty()) {
+    args.title = prof->name();
+  }
+
+  if (!args.db_makeMetricDB) {
+    prof->metricMgr()->zeroDBInfo();
+  }
+
+  Analysis::CallPath::makeDatabase(*prof, args);
+
+  delete prof;
+}
+
+
+// makeSummaryMetricsStreamed: cf. makeSummaryMetrics() in hpcprof-mpi,
+// with a single process so that no reduction is needed: the
+// incremental summary metrics accumulate each profile directly.
+static void
+makeSummaryMetricsStreamed(Prof::CallPath::Profile& prof,
+			   const Analysis::Args& args,
+			   const Analysis::Util::NormalizeProfileArgs_t& nArgs)
+{
+  Prof::Metric::Mgr& mMgr = *prof.metricMgr();
+  Prof::CCT::ANode* cctRoot = prof.cct()->root();
+
+  // -------------------------------------------------------
+  // create derived metrics, grouped by measurement group
+  // -------------------------------------------------------
+  bool needAllStats =
+    Analysis::Args::MetricFlg_isSet(args.prof_metrics,
+				    Analysis::Args::MetricFlg_StatsAll);
+
+  std::vector<uint> groupSize(nArgs.groupMax + 1, 0);
+  for (uint i = 0; i < nArgs.groupMap->size(); ++i) {
+    groupSize[(*nArgs.groupMap)[i]]++;
+  }
+
+  std::vector<VMAIntervalSet*> groupMetrics(nArgs.groupMax + 1, NULL);
+
+  uint mDrvdBeg, mDrvdEnd; // [ )
+  Analysis::CallPath::makeSummaryMetricDescs(prof, needAllStats, groupMetrics,
+					     &groupSize, mDrvdBeg, mDrvdEnd);
+
+  prof.isMetricMgrVirtual(false);
+
+  cctRoot->computeMetricsIncr(mMgr, mDrvdBeg, mDrvdEnd,
+			      Prof::Metric::AExprIncr::FnInit);
+
+  // -------------------------------------------------------
+  // accumulate each profile
+  // -------------------------------------------------------
+  for (uint i = 0; i < nArgs.paths->size(); ++i) {
+    const string& fnm = (*nArgs.paths)[i];
+    uint groupId = (*nArgs.groupMap)[i];
+    Analysis::CallPath::makeSummaryMetrics_Lcl(prof, fnm, groupId,
+					       nArgs.groupMax, groupMetrics);
+  }
+
+  for (uint i = 0; i < mMgr.size(); ++i) {
+    mMgr.metric(i)->computedType(Prof::Metric::ADesc::ComputedTy_NonFinal);
+  }
+
+  for (uint grpId = 1; grpId < groupMetrics.size(); ++grpId) {
+    delete groupMetrics[grpId];
+  }
+}
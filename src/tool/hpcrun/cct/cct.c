@@ -110,6 +110,13 @@ struct cct_node_t {
   cct_addr_t addr;
 
   bool is_leaf;
+
+  // ---------------------------------------------------------
+  // metrics: the node's metric data list, or NULL if no metric
+  // has been recorded at this node.  attached directly to the
+  // node so that sampling finds it without a map lookup.
+  // ---------------------------------------------------------
+  metric_data_list_t* metrics;
   
   // ---------------------------------------------------------
   // tree structure
@@ -152,6 +159,19 @@ new_persistent_id()
   return atomic_fetch_add_explicit(&global_persistent_id, 2, memory_order_relaxed);
 }
 
+//
+// count of operations that may detach, move or recycle existing nodes.
+// insertion alone never does, so node pointers cached across samples
+// stay valid as long as this count does not change.
+//
+static atomic_uint_least64_t cct_mutations = ATOMIC_VAR_INIT(0);
+
+static inline void
+cct_note_mutation(void)
+{
+  atomic_fetch_add_explicit(&cct_mutations, 1, memory_order_relaxed);
+}
+
 static cct_node_t*
 cct_node_create(cct_addr_t* addr, cct_node_t* parent)
 {
@@ -182,6 +202,7 @@ cct_node_create(cct_addr_t* addr, cct_node_t* parent)
   node->right = NULL;
 
   node->is_leaf = false;
+  node->metrics = NULL;
 
   return node;
 }
@@ -278,7 +299,6 @@ typedef struct {
   FILE* fs;
   epoch_flags_t flags;
   hpcrun_fmt_cct_node_t* tmp_node;
-  cct2metrics_t* cct2metrics_map;
 } write_arg_t;
 
 //
@@ -291,19 +311,15 @@ collapse_dummy_node(cct_node_t *node, cct_op_arg_t arg, size_t level)
     return;
   }
   
-  // get thread specific map
-  write_arg_t *write_arg = (write_arg_t *)arg;
-  cct2metrics_t **map = &(write_arg->cct2metrics_map);
-
   // merge dummy child metrics
   cct_node_t* parent = hpcrun_cct_parent(node);
-  metric_data_list_t *node_metrics = hpcrun_get_metric_data_list_specific(map, node);
+  metric_data_list_t *node_metrics = hpcrun_get_metric_data_list(node);
   if (node_metrics != NULL) {
-    metric_data_list_t *parent_metrics = hpcrun_get_metric_data_list_specific(map, parent);
+    metric_data_list_t *parent_metrics = hpcrun_get_metric_data_list(parent);
     if (parent_metrics != NULL) {
       hpcrun_merge_cct_metrics(parent_metrics, node_metrics);
     } else {
-      hpcrun_move_metric_data_list_specific(map, parent, node);
+      hpcrun_move_metric_data_list(parent, node);
     }
   }
 }
@@ -371,13 +387,12 @@ lwrite(cct_node_t* node, cct_op_arg_t arg, size_t level)
 #if 1
   // keren's code
   tmp->num_metrics = my_arg->num_kind_metrics;
-  metric_data_list_t *data_list = 
-    hpcrun_get_metric_data_list_specific(&(my_arg->cct2metrics_map), node);
+  metric_data_list_t *data_list = node->metrics;
   hpcrun_metric_set_dense_copy(tmp->metrics, data_list, my_arg->num_kind_metrics);
 #else
   // code from master
   tmp->num_metrics = my_arg->num_metrics;
-  metric_set_t* ms = hpcrun_get_metric_set_specific(&(my_arg->cct2metrics_map), node);
+  metric_set_t* ms = node->metrics;
 
   hpcrun_metric_set_dense_copy(tmp->metrics, ms, my_arg->num_metrics);
 #endif
@@ -447,6 +462,18 @@ hpcrun_cct_addr(cct_node_t* node)
   return node ? &(node->addr) : NULL;
 }
 
+metric_data_list_t*
+hpcrun_cct_metrics(cct_node_t* node)
+{
+  return node ? node->metrics : NULL;
+}
+
+void
+hpcrun_cct_set_metrics(cct_node_t* node, metric_data_list_t* metrics)
+{
+  if (node) node->metrics = metrics;
+}
+
 bool
 hpcrun_cct_is_leaf(cct_node_t* node)
 {
@@ -559,6 +586,7 @@ hpcrun_cct_delete_addr(cct_node_t* node, cct_addr_t* frm)
 {
   if(!node) return NULL;
 
+  cct_note_mutation();
   cct_node_t* found = splay(node->children, frm);
 
   node->children = found;
@@ -603,6 +631,13 @@ hpcrun_cct_delete_self(cct_node_t *cct)
   hpcrun_cct_node_free(cct);
 }
 
+//
+uint64_t
+hpcrun_cct_mutations(void)
+{
+  return atomic_load_explicit(&cct_mutations, memory_order_relaxed);
+}
+
 //
 // 2nd fundamental mutator: mark a node as "terminal". That is,
 //   it is the last node of a path
@@ -625,6 +660,7 @@ hpcrun_cct_terminate_path(cct_node_t* node)
 cct_node_t*
 hpcrun_cct_insert_node(cct_node_t* target, cct_node_t* src)
 {
+  cct_note_mutation();
   src->parent = target;
 
   cct_node_t* found = splay(target->children, &(src->addr));
@@ -759,7 +795,7 @@ hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path)
 // Writing operation
 //
 int
-hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epoch_flags_t flags)
+hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags)
 {
   if (!fs) return HPCRUN_ERR;
 
@@ -783,10 +819,6 @@ hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epo
     .fs          = fs,
     .flags       = flags,
     .tmp_node    = &tmp_node,
-
-    // multithreaded code: add personalized cct2metrics_map for multithreading programs
-    // this is to allow a thread to write the profile data of another thread.
-    .cct2metrics_map = cct2metrics_map
   };
   
   hpcrun_metricVal_t metrics[num_kind_metrics];
@@ -912,6 +944,7 @@ void
 hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
 		 merge_op_t merge, merge_op_arg_t arg)
 {
+  cct_note_mutation();
   if (hpcrun_cct_is_leaf (cct_a) && hpcrun_cct_is_leaf(cct_b)) {
     // nothing to clean, because cct_b is leaf
     merge(cct_a, cct_b, arg);
@@ -1023,6 +1056,7 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
 // FIXME: only temporary function, until hpcrun_merge is repaired
 void
 cct_remove_my_subtree(cct_node_t* cct){
+  cct_note_mutation();
   cct->children = NULL;
 //  printf("CHILDREN: %p\tLEFT: %p\tRIGHT: %p\n", cct->children, cct->left, cct->right);
 }
@@ -1077,6 +1111,7 @@ hpcrun_cct_node_alloc(){
 
 void
 hpcrun_cct_node_free(cct_node_t *cct){
+  cct_note_mutation();
   add_node_to_freelist(cct);
 }
 
@@ -1096,6 +1131,7 @@ hpcrun_cct_set_children(cct_node_t* cct, cct_node_t* children)
 {
   if(!cct)
     return;
+  cct_note_mutation();
   cct->children = children;
 }
 
@@ -1104,6 +1140,7 @@ hpcrun_cct_set_parent(cct_node_t* cct, cct_node_t* parent)
 {
   if(!cct)
     return;
+  cct_note_mutation();
   cct->parent = parent;
 }
 
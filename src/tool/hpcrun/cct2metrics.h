@@ -10,23 +10,6 @@
 #include <cct/cct.h>
 
 
-//
-// ******** Typedef ********
-//
-//
-typedef struct cct2metrics_t cct2metrics_t;
-//
-// ******** initialization
-//
-// The cct2metrics map gets explicit reference
-// only at initialization time.
-//
-// Thereafter, the interface ops refer to it
-// implicitly.
-// [Singleton pattern for GangOf4 enthusiasts]
-
-extern void hpcrun_cct2metrics_init(cct2metrics_t** map);
-
 // ******** Interface operations **********
 // 
 
@@ -42,23 +25,16 @@ extern metric_data_list_t* hpcrun_reify_metric_set(cct_node_id_t cct_id, int met
 //
 // get metric data list for a node (NULL value is ok).
 //
-extern metric_data_list_t* hpcrun_get_metric_data_list_specific(cct2metrics_t **map, cct_node_id_t cct_id);
-
 extern metric_data_list_t* hpcrun_get_metric_data_list(cct_node_id_t cct_id);
 
 //
 // move metric data list from one node to another
 //
-extern metric_data_list_t* hpcrun_move_metric_data_list_specific(cct2metrics_t **map,
-  cct_node_id_t dest_id, cct_node_id_t source_id);
-
 extern metric_data_list_t* hpcrun_move_metric_data_list(cct_node_id_t dest_id, cct_node_id_t source_id);
 
 
 extern void cct2metrics_assoc(cct_node_t* node, metric_data_list_t* kind_metrics);
 
-//extern cct2metrics_t* cct2metrics_new(cct_node_id_t node, metric_set_t** kind_metrics);
-
 typedef enum {SET, INCR} update_metric_t;
 
 static inline void
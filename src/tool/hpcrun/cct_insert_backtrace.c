@@ -97,6 +97,74 @@ hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp)
 	hpcrun_kernel_callpath = kcp;
 }
 
+//
+// per-thread memo of the last path inserted by cct_insert_raw_backtrace.
+//
+// consecutive samples usually share most of their call path, so the
+// node reached after each frame is remembered and a new path only
+// walks (and splays) from the first frame that differs.  entries are
+// keyed by the full cct address plus the enclosing function, i.e.,
+// exactly what the insertion loop looks at, so reusing a node gives
+// the same answer as inserting from the root.  the memo is dropped
+// whenever the cct may have detached or recycled a node.
+//
+
+#define BT_MEMO_MAX_FRAMES 256
+
+typedef struct cct_bt_memo_entry_t {
+  cct_addr_t addr;
+  ip_normalized_t the_function;
+  cct_node_t* node; // node reached after this frame
+} cct_bt_memo_entry_t;
+
+typedef struct cct_bt_memo_t {
+  cct_node_t* root;
+  uint64_t mutations;
+  bool retain_recursion;
+  int len;
+  cct_bt_memo_entry_t frame[BT_MEMO_MAX_FRAMES];
+} cct_bt_memo_t;
+
+
+static cct_bt_memo_t*
+bt_memo_get(void)
+{
+  // freeable memory may be reclaimed under us, taking cct nodes along
+  if (ENABLED(FREEABLE)) return NULL;
+
+  thread_data_t* td = hpcrun_safe_get_td();
+  if (td == NULL) return NULL;
+
+  if (td->bt_memo == NULL) {
+    td->bt_memo = hpcrun_malloc(sizeof(cct_bt_memo_t));
+    if (td->bt_memo == NULL) return NULL;
+    td->bt_memo->len = 0;
+  }
+  return td->bt_memo;
+}
+
+
+// only plain frames are memoized: lush may adjust the association of
+// a leaf after insertion, and a lip is not owned by the frame.
+static inline bool
+bt_memo_frame_ok(frame_t* f)
+{
+  return (f->lip == NULL) &&
+    (lush_assoc_info__get_assoc(f->as_info) == LUSH_ASSOC_NULL);
+}
+
+
+static inline bool
+bt_memo_frame_eq(cct_bt_memo_entry_t* e, frame_t* f)
+{
+  cct_addr_t addr =
+    (cct_addr_t) {.as_info = f->as_info, .ip_norm = f->ip_norm, .lip = f->lip};
+
+  return bt_memo_frame_ok(f) && cct_addr_eq(&(e->addr), &addr) &&
+    ip_normalized_eq(&(e->the_function), &(f->the_function));
+}
+
+
 static cct_node_t*
 cct_insert_raw_backtrace(cct_node_t* cct,
                             frame_t* path_beg, frame_t* path_end)
@@ -112,7 +180,36 @@ cct_insert_raw_backtrace(cct_node_t* cct,
 
   // FIXME: POGLEDAJ KOLIKO ON PUTA KROZ OVO PRODJE
 
+  cct_node_t* root = cct;
+  frame_t* path_top = path_beg;
   ip_normalized_t parent_routine = ip_normalized_NULL;
+
+  //
+  // find the prefix shared with the memoized path.  whether a frame is
+  // folded by recursive compression depends on the next inner frame as
+  // well, so the last shared frame is redone: resume after frame
+  // (k - 2) of a k-frame shared prefix.
+  //
+  cct_bt_memo_t* memo = bt_memo_get();
+  uint64_t mutations = hpcrun_cct_mutations();
+  if (memo) {
+    if (memo->root != root || memo->retain_recursion != retain_recursion ||
+	memo->mutations != mutations) {
+      memo->len = 0;
+    }
+    int k = 0;
+    for (frame_t* f = path_beg; f >= path_end && k < memo->len; f--, k++) {
+      if (! bt_memo_frame_eq(&memo->frame[k], f)) break;
+    }
+    if (k >= 2) {
+      cct = memo->frame[k - 2].node;
+      parent_routine = memo->frame[k - 2].the_function;
+      path_beg -= (k - 1);
+      TMSG(BT_INSERT, "resume at frame %d from memoized node %p", k - 1, cct);
+    }
+    memo->len = (k >= 2) ? k - 1 : 0;
+  }
+
   for(; path_beg >= path_end; path_beg--){
     if ( (! retain_recursion) &&
 	 (path_beg >= path_end + 1) && 
@@ -129,8 +226,28 @@ cct_insert_raw_backtrace(cct_node_t* cct,
       cct = hpcrun_cct_insert_addr(cct, &tmp);
     }
     parent_routine = path_beg->the_function;
+
+    if (memo) {
+      int i = path_top - path_beg;
+      if (i < BT_MEMO_MAX_FRAMES && i == memo->len && bt_memo_frame_ok(path_beg)) {
+	cct_bt_memo_entry_t* e = &memo->frame[i];
+	e->addr = (cct_addr_t) {.as_info = path_beg->as_info,
+				.ip_norm = path_beg->ip_norm,
+				.lip = path_beg->lip};
+	e->the_function = path_beg->the_function;
+	e->node = cct;
+	memo->len = i + 1;
+      }
+    }
   }
   hpcrun_cct_terminate_path(cct);
+
+  if (memo) {
+    memo->root = root;
+    memo->retain_recursion = retain_recursion;
+    memo->mutations = mutations;
+  }
+
   // FIXME: vi3 consider this function
   return cct;
 }
@@ -19,10 +19,6 @@ typedef struct core_profile_trace_data_t {
   // ----------------------------------------
   epoch_t* epoch;
 
-  //metrics: this is needed otherwise 
-  //hpcprof does not pick them up
-  cct2metrics_t* cct2metrics_map;
-
   // for metric scale (openmp uses)
   void (*scale_fn)(void*);
   // ----------------------------------------
@@ -37,6 +33,8 @@ typedef struct core_profile_trace_data_t {
   FILE* hpcrun_file;
   void* trace_buffer;
   hpcio_outbuf_t *trace_outbuf;
+  struct trace_writer_stream_t *trace_writer; // async trace writing, or NULL
+  int trace_in_container; // trace is a container member, named at close
 
   // ----------------------------------------
   // Perf support
@@ -49,6 +49,13 @@ const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_TRACE_CLOCK     = "HPCRUN_TRACE_CLOCK";
+const char* HPCRUN_TRACE_ASYNC     = "HPCRUN_TRACE_ASYNC";
+
+const char* HPCRUN_CONTAINER       = "HPCRUN_CONTAINER";
+
+const char* HPCRUN_UNWIND_RECIPES     = "HPCRUN_UNWIND_RECIPES";
+const char* HPCRUN_UNWIND_RECIPES_GEN = "HPCRUN_UNWIND_RECIPES_GEN";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
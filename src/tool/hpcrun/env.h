@@ -84,6 +84,13 @@ extern const char* HPCRUN_OPT_LUSH_AGENTS;
 extern const char* HPCRUN_OUT_PATH;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_TRACE_CLOCK;
+extern const char* HPCRUN_TRACE_ASYNC;
+
+extern const char* HPCRUN_CONTAINER;
+
+extern const char* HPCRUN_UNWIND_RECIPES;
+extern const char* HPCRUN_UNWIND_RECIPES_GEN;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
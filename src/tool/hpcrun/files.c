@@ -124,6 +124,7 @@
 #include "disabled.h"
 #include "files.h"
 #include "messages.h"
+#include "memory/hpcrun-malloc.h"
 #include "thread_data.h"
 #include "loadmap.h"
 #include "sample_prob.h"
@@ -139,7 +140,8 @@
 //***************************************************************
 
 // directory/progname-rank-thread-hostid-pid-gen.suffix
-#define FILENAME_TEMPLATE  "%s/%s-%06u-%03d-" HOSTID_FORMAT "-%u-%d.%s"
+#define MEMBERNAME_TEMPLATE  "%s-%06u-%03d-" HOSTID_FORMAT "-%u-%d.%s"
+#define FILENAME_TEMPLATE  "%s/" MEMBERNAME_TEMPLATE
 
 #define FILES_RANDOM_GEN  4
 #define FILES_MAX_GEN     11
@@ -153,6 +155,14 @@ struct fileid {
   int  gen;
 };
 
+// a profile or trace in the process container, named at close
+struct container_entry {
+  struct container_entry *next;
+  hpcrun_container_member_t *member;
+  int thread;
+  const char *suffix;
+};
+
 
 //***************************************************************
 // forward declarations 
@@ -183,6 +193,13 @@ static int log_rename_ret = 0;
 
 static int vdso_written = 0; // for coordination across fork
 
+static hpcrun_container_t *container = NULL;
+static int container_fd = -1;
+static struct container_entry *container_entries = NULL;
+
+// suffix of a member whose stream could not be opened
+static const char unused_member_suffix[] = "unused";
+
 char vdso_hash_str[HASH_LENGTH * 2];
 //***************************************************************
 // private operations
@@ -206,6 +223,14 @@ hpcrun_files_init(void)
     log_done = 0;
     log_rename_done = 0;
     log_rename_ret = 0;
+
+    // after fork, the parent's container is not ours to write
+    if (container != NULL) {
+      close(container_fd);
+    }
+    container = NULL;
+    container_fd = -1;
+    container_entries = NULL;
   }
 }
 
@@ -363,6 +388,49 @@ hpcrun_rename_file(int rank, int thread, const char *suffix)
 }
 
 
+// Add a member for 'thread' and 'suffix' to the process container,
+// opening the container on first use (with the early id, like the
+// trace files, and renamed at close).  Must hold the files lock.
+//
+// Returns: the new member, else die if the container can't be
+// created, or NULL (and the caller writes a stand-alone file) if the
+// member can't be allocated.
+//
+static hpcrun_container_member_t *
+hpcrun_container_add(int thread, const char *suffix)
+{
+  if (container == NULL) {
+    // opening early resets the late id; keep it if already in use
+    struct fileid late = lateid;
+    int fd = hpcrun_open_file(0, 0, HPCRUN_ContainerFnmSfx, FILES_EARLY);
+    if (late.done) {
+      lateid = late;
+    }
+    container = hpcrun_container_create(fd, hpcrun_malloc);
+    if (container == NULL) {
+      hpcrun_abort("hpctoolkit: unable to write %s file header: %s",
+		   HPCRUN_ContainerFnmSfx, strerror(errno));
+    }
+    container_fd = fd;
+  }
+
+  struct container_entry *ent = hpcrun_malloc(sizeof(*ent));
+  if (ent == NULL) {
+    return NULL;
+  }
+  ent->member = hpcrun_container_member_new(container, NULL);
+  if (ent->member == NULL) {
+    return NULL;
+  }
+  ent->thread = thread;
+  ent->suffix = suffix;
+  ent->next = container_entries;
+  container_entries = ent;
+
+  return ent->member;
+}
+
+
 //***************************************************************
 // interface operations
 //***************************************************************
@@ -484,6 +552,120 @@ hpcrun_open_profile_file(int rank, int thread)
 }
 
 
+// Container mode: all profiles and traces of the process go into one
+// file.  Requested with HPCRUN_CONTAINER; a process that does not
+// record data writes nothing.
+bool
+hpcrun_files_use_container(void)
+{
+  static int use_container = -1;
+
+  if (use_container < 0) {
+    char *str = getenv(HPCRUN_CONTAINER);
+    use_container = (str != NULL && str[0] != '\0' && strcmp(str, "0") != 0);
+  }
+  return use_container && hpcrun_sample_prob_active();
+}
+
+
+// Returns: stdio stream for the profile (hpcrun) data of 'thread' in
+// the process container, else NULL.
+FILE *
+hpcrun_open_profile_container(int thread)
+{
+  hpcrun_container_member_t *member;
+  FILE *fs = NULL;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  member = hpcrun_container_add(thread, HPCRUN_ProfileFnmSfx);
+  if (member != NULL) {
+    fs = hpcrun_container_member_fopen(member);
+    if (fs == NULL) {
+      // the member stays empty; keep it out of the profiles
+      container_entries->suffix = unused_member_suffix;
+    }
+  }
+  spinlock_unlock(&files_lock);
+
+  return fs;
+}
+
+
+// Returns: container member for the trace data of 'thread', else NULL.
+hpcrun_container_member_t *
+hpcrun_open_trace_container(int thread)
+{
+  hpcrun_container_member_t *member;
+
+  TMSG(TRACE, "Opening trace container member for %d", thread);
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  member = hpcrun_container_add(thread, HPCRUN_TraceFnmSfx);
+  spinlock_unlock(&files_lock);
+
+  return member;
+}
+
+
+// Rename the process container for 'rank' (as for the trace files),
+// name its members like the files they stand for, and write its
+// index.  Called once all profiles and traces are written.
+//
+// Returns: 0 on success, else -1 on failure.
+int
+hpcrun_close_container(int rank)
+{
+  char name[PATH_MAX];
+  int ret = 0;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+
+  if (container != NULL) {
+    if (rank < 0) {
+      rank = 0;
+    }
+    hpcrun_rename_log_file_early(rank);
+    struct fileid *id = &lateid;
+    if (hpcrun_rename_file(rank, 0, HPCRUN_ContainerFnmSfx) != 0) {
+      // still under its early name
+      rank = 0;
+      id = &earlyid;
+    }
+
+    // A reused thread id gets a member per thread, so number them
+    // through the generation field like the stand-alone files.  The
+    // entries are newest first, and the n-th profile and trace of a
+    // thread id get the same name.
+    for (struct container_entry *ent = container_entries; ent; ent = ent->next) {
+      int gen = id->gen;
+      for (struct container_entry *old = ent->next; old; old = old->next) {
+	if (old->thread == ent->thread && strcmp(old->suffix, ent->suffix) == 0) {
+	  gen++;
+	}
+      }
+      snprintf(name, PATH_MAX, MEMBERNAME_TEMPLATE, executable_name,
+	       rank, ent->thread, id->host, mypid, gen, ent->suffix);
+      hpcrun_container_member_setname(ent->member, name);
+    }
+
+    if (hpcrun_container_close(container, NULL) != HPCFMT_OK) {
+      EEMSG("hpctoolkit: unable to write the index of the %s file: %s",
+	    HPCRUN_ContainerFnmSfx, strerror(errno));
+      ret = -1;
+    }
+    container = NULL;
+    container_fd = -1;
+    container_entries = NULL;
+  }
+
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
 // Note: we use the log file as the lock for the file names, so we
 // need to rename the log file as the first late action.  Since this
 // is out of sequence, we save the return value and return it when the
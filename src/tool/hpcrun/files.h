@@ -47,6 +47,11 @@
 #ifndef files_h
 #define files_h
 
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <lib/prof-lean/hpcrun-container.h>
+
 
 //*****************************************************************************
 // forward declarations
@@ -66,6 +71,12 @@ int hpcrun_open_profile_file(int rank, int thread);
 int hpcrun_rename_log_file(int rank);
 int hpcrun_rename_trace_file(int rank, int thread);
 
+// container mode (see hpcrun-container.h)
+bool hpcrun_files_use_container(void);
+FILE *hpcrun_open_profile_container(int thread);
+hpcrun_container_member_t *hpcrun_open_trace_container(int thread);
+int hpcrun_close_container(int rank);
+
 // storing the hash of the vdso for the current process
 extern char vdso_hash_str[];
 void hpcrun_save_vdso();
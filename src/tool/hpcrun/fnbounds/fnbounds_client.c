@@ -75,6 +75,14 @@
 // 6. The bottom of this file has code for an interactive, stand-alone
 // client for testing hpcfnbounds in server mode.
 //
+// 7. If HPCRUN_FNBOUNDS_CACHE names a directory, query results are
+// cached there (e.g., in /dev/shm), keyed by the file's ELF build-id,
+// size and mtime, so that processes on a node analyze each library
+// only once.
+// Entries are published atomically with rename().  The process that
+// holds an entry's flock() does the analysis; any other process that
+// misses at the same time queries its own server instead of waiting.
+//
 // Todo:
 //
 
@@ -118,12 +126,15 @@ char	*outfile;
 //***************************************************************************
 
 #include <sys/types.h>
+#include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <elf.h>
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -131,6 +142,7 @@ char	*outfile;
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #if !defined(STAND_ALONE_CLIENT)
@@ -141,6 +153,8 @@ char	*outfile;
 #include "messages.h"
 #include "sample_sources_all.h"
 #include "monitor.h"
+
+#include <lib/support-lean/OSUtil.h>
 #else
 #include "syserv-mesg.h"
 #include "fnbounds_file_header.h"
@@ -156,6 +170,9 @@ char	*outfile;
 #define FAILURE  -1
 #define END_OF_FILE  -2
 
+#define CACHE_MAGIC   0x686663616368650aUL  // "hfcache\n"
+#define CACHE_BUILD_ID_MAX  64
+
 enum {
   SYSERV_ACTIVE = 1,
   SYSERV_INACTIVE
@@ -176,6 +193,20 @@ static long mem_limit = SERVER_MEM_LIMIT * 1024;
 static int  num_queries = 0;
 static int  mem_warning = 0;
 
+// fnbounds cache directory (NULL if disabled) and a hash of the server
+// command, so that different servers don't share entries.
+static char *cache_dir = NULL;
+static uint64_t cache_server_hash = 0;
+
+struct fnbounds_cache_hdr {
+  uint64_t  magic;
+  uint64_t  num_entries;
+  uint64_t  reference_offset;
+  int64_t   is_relocatable;
+};
+
+static void cache_init(void);
+
 extern char **environ;
 
 
@@ -512,6 +543,8 @@ hpcrun_syserv_init(void)
     return -1;
   }
 
+  cache_init();
+
   // limit on server memory usage in Meg
   char *str = getenv("HPCRUN_SERVER_MEMSIZE");
   long size;
@@ -576,8 +609,8 @@ hpcrun_syserv_fini(void)
 // Returns: pointer to array of void * and fills in the file header,
 // or else NULL on error.
 //
-void *
-hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
+static void *
+syserv_query_server(const char *fname, struct fnbounds_file_header *fh)
 {
   struct syserv_mesg mesg;
   void *addr;
@@ -691,6 +724,344 @@ hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
 }
 
 
+//*****************************************************************
+// Fnbounds Cache
+//*****************************************************************
+
+// 64-bit FNV-1a hash.
+static uint64_t
+hash_bytes(uint64_t hash, const void *buf, size_t len)
+{
+  const unsigned char *p = buf;
+  size_t k;
+
+  for (k = 0; k < len; k++) {
+    hash ^= p[k];
+    hash *= 0x100000001b3UL;
+  }
+  return hash;
+}
+
+#define HASH_INIT  0xcbf29ce484222325UL
+
+
+// Read the NT_GNU_BUILD_ID note from the program headers of an ELF
+// file into 'id'.  Returns: length of the build-id, or 0 if none.
+//
+static size_t
+read_build_id(int fd, unsigned char *id, size_t id_max)
+{
+  unsigned char ident[EI_NIDENT];
+  uint64_t phoff, phnum, phentsize;
+  int is64;
+
+  if (pread(fd, ident, EI_NIDENT, 0) != EI_NIDENT
+      || memcmp(ident, ELFMAG, SELFMAG) != 0) {
+    return 0;
+  }
+  is64 = (ident[EI_CLASS] == ELFCLASS64);
+
+  if (is64) {
+    Elf64_Ehdr eh;
+    if (pread(fd, &eh, sizeof(eh), 0) != sizeof(eh)) {
+      return 0;
+    }
+    phoff = eh.e_phoff;  phnum = eh.e_phnum;  phentsize = eh.e_phentsize;
+  }
+  else {
+    Elf32_Ehdr eh;
+    if (pread(fd, &eh, sizeof(eh), 0) != sizeof(eh)) {
+      return 0;
+    }
+    phoff = eh.e_phoff;  phnum = eh.e_phnum;  phentsize = eh.e_phentsize;
+  }
+
+  for (uint64_t i = 0; i < phnum; i++) {
+    uint64_t type, offset, size;
+    off_t ph_pos = phoff + i * phentsize;
+
+    if (is64) {
+      Elf64_Phdr ph;
+      if (pread(fd, &ph, sizeof(ph), ph_pos) != sizeof(ph)) {
+	return 0;
+      }
+      type = ph.p_type;  offset = ph.p_offset;  size = ph.p_filesz;
+    }
+    else {
+      Elf32_Phdr ph;
+      if (pread(fd, &ph, sizeof(ph), ph_pos) != sizeof(ph)) {
+	return 0;
+      }
+      type = ph.p_type;  offset = ph.p_offset;  size = ph.p_filesz;
+    }
+    if (type != PT_NOTE) {
+      continue;
+    }
+
+    // the build-id note is small and comes early in its segment
+    unsigned char buf[1024];
+    if (size > sizeof(buf)) {
+      size = sizeof(buf);
+    }
+    if (pread(fd, buf, size, offset) != (ssize_t) size) {
+      continue;
+    }
+
+    // Elf32_Nhdr and Elf64_Nhdr have the same layout
+    size_t pos = 0;
+    while (pos + sizeof(Elf32_Nhdr) <= size) {
+      Elf32_Nhdr *nh = (Elf32_Nhdr *) (buf + pos);
+      size_t name_pos = pos + sizeof(Elf32_Nhdr);
+      size_t desc_pos = name_pos + ((nh->n_namesz + 3) & ~3UL);
+      size_t next_pos = desc_pos + ((nh->n_descsz + 3) & ~3UL);
+
+      if (next_pos > size) {
+	break;
+      }
+      if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4
+	  && memcmp(buf + name_pos, "GNU", 4) == 0
+	  && nh->n_descsz > 0 && nh->n_descsz <= id_max) {
+	memcpy(id, buf + desc_pos, nh->n_descsz);
+	return nh->n_descsz;
+      }
+      pos = next_pos;
+    }
+  }
+
+  return 0;
+}
+
+
+// Make the cache entry name for 'fname': the hex build-id and a hash of
+// the file's size and mtime if there is a build-id, else a hash of the
+// file's identity (path, device, inode, size and mtime), followed by
+// the server hash.  strip and objcopy keep the build-id but change the
+// symbol table, so the build-id alone does not identify the bounds.
+// Returns: SUCCESS, or FAILURE if 'fname' is not a regular file.
+//
+static int
+cache_entry_name(const char *fname, char *name, size_t name_max)
+{
+  unsigned char id[CACHE_BUILD_ID_MAX];
+  struct stat st;
+  size_t id_len, k, pos;
+  int fd;
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return FAILURE;
+  }
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return FAILURE;
+  }
+  id_len = read_build_id(fd, id, sizeof(id));
+  close(fd);
+
+  if (name_max < 2 * CACHE_BUILD_ID_MAX + 32) {
+    return FAILURE;
+  }
+
+  if (id_len > 0) {
+    for (k = 0, pos = 0; k < id_len; k++, pos += 2) {
+      snprintf(name + pos, 3, "%02x", id[k]);
+    }
+    uint64_t hash = hash_bytes(HASH_INIT, &st.st_size, sizeof(st.st_size));
+    hash = hash_bytes(hash, &st.st_mtime, sizeof(st.st_mtime));
+    pos += snprintf(name + pos, name_max - pos, "-%08lx",
+		    (unsigned long) (hash & 0xffffffff));
+  }
+  else {
+    uint64_t hash = hash_bytes(HASH_INIT, fname, strlen(fname));
+    hash = hash_bytes(hash, &st.st_dev, sizeof(st.st_dev));
+    hash = hash_bytes(hash, &st.st_ino, sizeof(st.st_ino));
+    hash = hash_bytes(hash, &st.st_size, sizeof(st.st_size));
+    hash = hash_bytes(hash, &st.st_mtime, sizeof(st.st_mtime));
+    pos = snprintf(name, name_max, "f%016lx", (unsigned long) hash);
+  }
+  snprintf(name + pos, name_max - pos, "-%08lx",
+	   (unsigned long) (cache_server_hash & 0xffffffff));
+
+  return SUCCESS;
+}
+
+
+// Returns: address of the cached table for 'path' and fills in the
+// file header, else NULL if there is no (valid) entry.
+//
+static void *
+cache_load(const char *path, struct fnbounds_file_header *fh)
+{
+  struct fnbounds_cache_hdr hdr;
+  struct stat st;
+  void *addr;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (read_all(fd, &hdr, sizeof(hdr)) != SUCCESS
+      || hdr.magic != CACHE_MAGIC
+      || fstat(fd, &st) != 0
+      || (uint64_t) st.st_size != sizeof(hdr) + hdr.num_entries * sizeof(void *)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t num_bytes = hdr.num_entries * sizeof(void *);
+  size_t mmap_size = page_align(num_bytes);
+  addr = mmap_anon(mmap_size);
+  if (addr == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  if (read_all(fd, addr, num_bytes) != SUCCESS) {
+    munmap(addr, mmap_size);
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+
+  fh->num_entries = hdr.num_entries;
+  fh->reference_offset = hdr.reference_offset;
+  fh->is_relocatable = hdr.is_relocatable;
+  fh->mmap_size = mmap_size;
+
+  return addr;
+}
+
+
+// Write the table to a private temporary file and then rename() it
+// into place, so readers never see a partial entry.  The cache may be
+// on a shared file system, so the temporary name has the host id as
+// well as the pid.
+//
+static void
+cache_publish(const char *path, void *addr, struct fnbounds_file_header *fh)
+{
+  struct fnbounds_cache_hdr hdr;
+  char tmp_path[PATH_MAX];
+  int fd;
+
+  if (snprintf(tmp_path, PATH_MAX, "%s.%lx-%d.tmp", path,
+	       (unsigned long) OSUtil_hostid(), (int) getpid()) >= PATH_MAX) {
+    return;
+  }
+  fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    return;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = CACHE_MAGIC;
+  hdr.num_entries = fh->num_entries;
+  hdr.reference_offset = fh->reference_offset;
+  hdr.is_relocatable = fh->is_relocatable;
+
+  int ok = (write_all(fd, &hdr, sizeof(hdr)) == SUCCESS
+	    && write_all(fd, addr, fh->num_entries * sizeof(void *)) == SUCCESS);
+  ok = (close(fd) == 0) && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    return;
+  }
+  TMSG(FNBOUNDS_CLIENT, "cache publish: %s", path);
+}
+
+
+// Set up the cache directory from HPCRUN_FNBOUNDS_CACHE, creating it
+// (one level) if needed.  A new directory is made world-writable and
+// sticky (like /tmp), so that all users on a node can add entries but
+// not replace or remove each other's.
+//
+static void
+cache_init(void)
+{
+  char *dir = getenv("HPCRUN_FNBOUNDS_CACHE");
+
+  cache_dir = NULL;
+  if (dir == NULL || dir[0] == 0) {
+    return;
+  }
+  if (mkdir(dir, 01777) == 0) {
+    chmod(dir, 01777);  // not limited by the umask
+  }
+  else if (errno != EEXIST) {
+    EMSG("FNBOUNDS_CLIENT: unable to create fnbounds cache directory: %s",
+	 dir);
+    return;
+  }
+  cache_dir = dir;
+  cache_server_hash = hash_bytes(HASH_INIT, server, strlen(server));
+
+  TMSG(FNBOUNDS_CLIENT, "cache dir: %s", cache_dir);
+}
+
+
+// Returns: pointer to array of void * and fills in the file header,
+// or else NULL on error.  Answers from the cache when possible, else
+// queries the server and publishes the answer.
+//
+void *
+hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
+{
+  char name[2 * CACHE_BUILD_ID_MAX + 40];
+  char path[PATH_MAX];
+  char lock_path[PATH_MAX];
+  void *addr;
+
+  if (cache_dir == NULL || fname == NULL || fh == NULL
+      || cache_entry_name(fname, name, sizeof(name)) != SUCCESS
+      || snprintf(path, PATH_MAX, "%s/%s", cache_dir, name) >= PATH_MAX
+      || snprintf(lock_path, PATH_MAX, "%s.lock", path) >= PATH_MAX) {
+    return syserv_query_server(fname, fh);
+  }
+
+  addr = cache_load(path, fh);
+  if (addr != NULL) {
+    TMSG(FNBOUNDS_CLIENT, "cache hit: %s -> %s", fname, name);
+    return addr;
+  }
+
+  // Miss.  Only the process that holds the entry's lock analyzes the
+  // file and publishes the answer.  If another process holds it, then
+  // query the server directly rather than block startup on it.  Lock
+  // files are never removed (that would let two processes lock
+  // different files of the same name), and an flock() is dropped by
+  // the kernel if its holder dies, so there are no stale locks.
+  int lock_fd = open(lock_path, O_RDONLY | O_CREAT, 0644);
+  if (lock_fd >= 0 && flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+    close(lock_fd);
+    lock_fd = -1;
+  }
+
+  if (lock_fd >= 0) {
+    // the holder before us may have just published it
+    addr = cache_load(path, fh);
+    if (addr != NULL) {
+      TMSG(FNBOUNDS_CLIENT, "cache hit: %s -> %s", fname, name);
+      close(lock_fd);
+      return addr;
+    }
+  }
+
+  TMSG(FNBOUNDS_CLIENT, "cache miss%s: %s -> %s",
+       (lock_fd >= 0) ? "" : " (busy)", fname, name);
+  addr = syserv_query_server(fname, fh);
+  if (addr != NULL && lock_fd >= 0) {
+    cache_publish(path, addr, fh);
+  }
+
+  if (lock_fd >= 0) {
+    close(lock_fd);
+  }
+
+  return addr;
+}
+
+
 //*****************************************************************
 // Stand Alone Client
 //*****************************************************************
@@ -54,10 +54,13 @@
 // local includes
 //*****************************************************************************
 
-#include <lib/prof-lean/splay-uint64.h>
+#include <lib/prof-lean/hashmap-uint64.h>
+#include <lib/prof-lean/stdatomic.h>
+
+#include <hpcrun/memory/hpcrun-malloc.h>
+#include <hpcrun/messages/messages.h>
 
 #include "gpu-correlation-id-map.h"
-#include "gpu-splay-allocator.h"
 
 
 
@@ -70,26 +73,9 @@
 #include "gpu-print.h"
 
 
-#define st_insert				\
-  typed_splay_insert(correlation_id)
-
-#define st_lookup				\
-  typed_splay_lookup(correlation_id)
-
-#define st_delete				\
-  typed_splay_delete(correlation_id)
-
-#define st_forall				\
-  typed_splay_forall(correlation_id)
-
-#define st_count				\
-  typed_splay_count(correlation_id)
-
-#define st_alloc(free_list)			\
-  typed_splay_alloc(free_list, gpu_correlation_id_map_entry_t)
-
-#define st_free(free_list, node)		\
-  typed_splay_free(free_list, node)
+// outstanding correlations the map has room for initially; it grows
+// when they are exceeded, so start small
+#define GPU_CORRELATION_ID_MAP_CAPACITY 256
 
 
 
@@ -97,21 +83,14 @@
 // type declarations
 //*****************************************************************************
 
-#undef typed_splay_node
-#define typed_splay_node(correlation_id) gpu_correlation_id_map_entry_t
-
-typedef struct typed_splay_node(correlation_id) {
-  struct typed_splay_node(correlation_id) *left;
-  struct typed_splay_node(correlation_id) *right;
-  uint64_t gpu_correlation_id; // key
+struct gpu_correlation_id_map_entry_t {
+  struct gpu_correlation_id_map_entry_t *next; // free list link
 
   uint64_t host_correlation_id;
   uint32_t device_id;
   uint64_t start;
   uint64_t end;
-} typed_splay_node(correlation_id); 
-
-
+}; 
 
 
 
@@ -119,9 +98,9 @@ typedef struct typed_splay_node(correlation_id) {
 // local data
 //******************************************************************************
 
-static gpu_correlation_id_map_entry_t *map_root = NULL;
+static atomic_uintptr_t map = ATOMIC_VAR_INIT(0);
 
-static gpu_correlation_id_map_entry_t *free_list = NULL;
+static __thread gpu_correlation_id_map_entry_t *free_list = NULL;
 
 
 
@@ -129,20 +108,62 @@ static gpu_correlation_id_map_entry_t *free_list = NULL;
 // private operations
 //*****************************************************************************
 
-typed_splay_impl(correlation_id)
+static hashmap_uint64_t *
+gpu_correlation_id_map_get
+(
+ void
+)
+{
+  uintptr_t m = atomic_load_explicit(&map, memory_order_acquire);
+  if (m == 0) {
+    uintptr_t new_map =
+      (uintptr_t) hashmap_uint64_new(GPU_CORRELATION_ID_MAP_CAPACITY,
+				     hpcrun_malloc_safe);
+    if (new_map == 0) {
+      EMSG("gpu correlation id map: unable to allocate map");
+      return NULL;
+    }
+    // if another thread got there first, its map is used
+    if (atomic_compare_exchange_strong_explicit(&map, &m, new_map,
+						memory_order_acq_rel,
+						memory_order_acquire)) {
+      m = new_map;
+    }
+  }
+  return (hashmap_uint64_t *) m;
+}
 
 
 static gpu_correlation_id_map_entry_t *
 gpu_correlation_id_map_entry_alloc()
 {
-  return st_alloc(&free_list);
+  gpu_correlation_id_map_entry_t *e = free_list;
+  if (e) {
+    free_list = e->next;
+  } else {
+    e = (gpu_correlation_id_map_entry_t *)
+      hpcrun_malloc_safe(sizeof(gpu_correlation_id_map_entry_t));
+  }
+  return e;
+}
+
+
+static void
+gpu_correlation_id_map_entry_free
+(
+ gpu_correlation_id_map_entry_t *e
+)
+{
+  if (e) {
+    e->next = free_list;
+    free_list = e;
+  }
 }
 
 
 static gpu_correlation_id_map_entry_t *
 gpu_correlation_id_map_entry_new
 (
- uint32_t gpu_correlation_id, 
  uint64_t host_correlation_id
 )
 {
@@ -150,7 +171,6 @@ gpu_correlation_id_map_entry_new
 
   memset(e, 0, sizeof(gpu_correlation_id_map_entry_t)); 
 
-  e->gpu_correlation_id = gpu_correlation_id;
   e->host_correlation_id = host_correlation_id;
 
   return e;
@@ -169,7 +189,9 @@ gpu_correlation_id_map_lookup
 )
 {
   uint64_t correlation_id = gpu_correlation_id;
-  gpu_correlation_id_map_entry_t *result = st_lookup(&map_root, correlation_id);
+  hashmap_uint64_t *m = gpu_correlation_id_map_get();
+  gpu_correlation_id_map_entry_t *result = 
+    m ? hashmap_uint64_lookup(m, correlation_id) : NULL;
 
   PRINT("correlation_id map lookup: id=0x%lx (record %p)\n", 
        correlation_id, result);
@@ -185,15 +207,23 @@ gpu_correlation_id_map_insert
  uint64_t host_correlation_id
 )
 {
-  if (st_lookup(&map_root, gpu_correlation_id)) { 
+  hashmap_uint64_t *m = gpu_correlation_id_map_get();
+  if (m == NULL) return;
+
+  if (hashmap_uint64_lookup(m, gpu_correlation_id)) { 
     // fatal error: correlation_id already present; a
     // correlation should be inserted only once.
     assert(0);
   } else {
     gpu_correlation_id_map_entry_t *entry = 
-      gpu_correlation_id_map_entry_new(gpu_correlation_id, host_correlation_id);
+      gpu_correlation_id_map_entry_new(host_correlation_id);
 
-    st_insert(&map_root, entry);
+    if (!hashmap_uint64_insert(m, gpu_correlation_id, entry)) {
+      EMSG("gpu correlation id map: unable to grow, dropping correlation id %u",
+	   gpu_correlation_id);
+      gpu_correlation_id_map_entry_free(entry);
+      return;
+    }
 
     PRINT("correlation_id_map insert: correlation_id=0x%lx external_id=%ld (entry=%p)\n", 
 	  gpu_correlation_id, host_correlation_id, entry);
@@ -211,7 +241,8 @@ gpu_correlation_id_map_external_id_replace
 {
   PRINT("correlation_id map replace: id=0x%x\n", gpu_correlation_id);
 
-  gpu_correlation_id_map_entry_t *entry = st_lookup(&map_root, gpu_correlation_id);
+  gpu_correlation_id_map_entry_t *entry =
+    gpu_correlation_id_map_lookup(gpu_correlation_id);
   if (entry) {
     entry->host_correlation_id = host_correlation_id;
   }
@@ -224,8 +255,12 @@ gpu_correlation_id_map_delete
  uint32_t gpu_correlation_id
 )
 {
-  gpu_correlation_id_map_entry_t *node = st_delete(&map_root, gpu_correlation_id);
-  st_free(&free_list, node);
+  hashmap_uint64_t *m = gpu_correlation_id_map_get();
+  if (m == NULL) return;
+
+  gpu_correlation_id_map_entry_t *entry = 
+    hashmap_uint64_delete(m, gpu_correlation_id);
+  gpu_correlation_id_map_entry_free(entry);
 }
 
 
@@ -241,7 +276,8 @@ gpu_correlation_id_map_kernel_update
   uint64_t correlation_id = gpu_correlation_id;
   PRINT("correlation_id map replace: id=0x%lx\n", correlation_id);
 
-  gpu_correlation_id_map_entry_t *entry = st_lookup(&map_root, correlation_id);
+  gpu_correlation_id_map_entry_t *entry =
+    gpu_correlation_id_map_lookup(correlation_id);
   if (entry) {
     entry->device_id = device_id;
     entry->start = start;
@@ -301,5 +337,6 @@ gpu_correlation_id_map_count
  void
 )
 {
-  return st_count(map_root);
+  hashmap_uint64_t *m = gpu_correlation_id_map_get();
+  return m ? hashmap_uint64_count(m) : 0;
 }
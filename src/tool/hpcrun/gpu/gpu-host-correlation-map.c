@@ -54,13 +54,15 @@
 // local includes
 //******************************************************************************
 
-#include <lib/prof-lean/splay-uint64.h>
+#include <lib/prof-lean/hashmap-uint64.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #include <hpcrun/cct/cct.h>
+#include <hpcrun/memory/hpcrun-malloc.h>
+#include <hpcrun/messages/messages.h>
 
 #include "gpu-host-correlation-map.h"
 #include "gpu-op-placeholders.h"
-#include "gpu-splay-allocator.h"
 
 
 
@@ -73,26 +75,9 @@
 #include "gpu-print.h"
 
 
-#define st_insert				\
-  typed_splay_insert(host_correlation)
-
-#define st_lookup				\
-  typed_splay_lookup(host_correlation)
-
-#define st_delete				\
-  typed_splay_delete(host_correlation)
-
-#define st_forall				\
-  typed_splay_forall(host_correlation)
-
-#define st_count				\
-  typed_splay_count(host_correlation)
-
-#define st_alloc(free_list)			\
-  typed_splay_alloc(free_list, gpu_host_correlation_map_entry_t)
-
-#define st_free(free_list, node)		\
-  typed_splay_free(free_list, node)
+// outstanding gpu operations the map has room for initially; it grows
+// when they are exceeded, so start small
+#define GPU_HOST_CORRELATION_MAP_CAPACITY 256
 
 
 
@@ -100,14 +85,8 @@
 // type declarations
 //******************************************************************************
 
-#undef typed_splay_node
-#define typed_splay_node(host_correlation) gpu_host_correlation_map_entry_t
-
-typedef struct typed_splay_node(host_correlation) {
-  struct typed_splay_node(host_correlation) *left;
-  struct typed_splay_node(host_correlation) *right;
-
-  uint64_t host_correlation_id; // key
+struct gpu_host_correlation_map_entry_t {
+  struct gpu_host_correlation_map_entry_t *next; // free list link
 
   gpu_op_ccts_t gpu_op_ccts;
 
@@ -117,7 +96,7 @@ typedef struct typed_splay_node(host_correlation) {
 
   int samples;
   int total_samples;
-} typed_splay_node(host_correlation); 
+}; 
 
 
 
@@ -125,9 +104,9 @@ typedef struct typed_splay_node(host_correlation) {
 // local data
 //******************************************************************************
 
-static gpu_host_correlation_map_entry_t *map_root = NULL;
+static atomic_uintptr_t map = ATOMIC_VAR_INIT(0);
 
-static gpu_host_correlation_map_entry_t *free_list = NULL;
+static __thread gpu_host_correlation_map_entry_t *free_list = NULL;
 
 
 
@@ -135,7 +114,30 @@ static gpu_host_correlation_map_entry_t *free_list = NULL;
 // private operations
 //******************************************************************************
 
-typed_splay_impl(host_correlation)
+static hashmap_uint64_t *
+gpu_host_correlation_map_get
+(
+ void
+)
+{
+  uintptr_t m = atomic_load_explicit(&map, memory_order_acquire);
+  if (m == 0) {
+    uintptr_t new_map =
+      (uintptr_t) hashmap_uint64_new(GPU_HOST_CORRELATION_MAP_CAPACITY,
+				     hpcrun_malloc_safe);
+    if (new_map == 0) {
+      EMSG("gpu host correlation map: unable to allocate map");
+      return NULL;
+    }
+    // if another thread got there first, its map is used
+    if (atomic_compare_exchange_strong_explicit(&map, &m, new_map,
+						memory_order_acq_rel,
+						memory_order_acquire)) {
+      m = new_map;
+    }
+  }
+  return (hashmap_uint64_t *) m;
+}
 
 
 static gpu_host_correlation_map_entry_t *
@@ -144,14 +146,33 @@ gpu_host_correlation_map_entry_alloc
  void
 )
 {
-  return st_alloc(&free_list);
+  gpu_host_correlation_map_entry_t *e = free_list;
+  if (e) {
+    free_list = e->next;
+  } else {
+    e = (gpu_host_correlation_map_entry_t *)
+      hpcrun_malloc_safe(sizeof(gpu_host_correlation_map_entry_t));
+  }
+  return e;
+}
+
+
+static void
+gpu_host_correlation_map_entry_free
+(
+ gpu_host_correlation_map_entry_t *e
+)
+{
+  if (e) {
+    e->next = free_list;
+    free_list = e;
+  }
 }
 
 
 static gpu_host_correlation_map_entry_t *
 gpu_host_correlation_map_entry_new
 (
- uint64_t host_correlation_id,
  gpu_op_ccts_t *gpu_op_ccts, 
  uint64_t cpu_submit_time,
  gpu_activity_channel_t *activity_channel
@@ -161,7 +182,6 @@ gpu_host_correlation_map_entry_new
 
   memset(e, 0, sizeof(gpu_host_correlation_map_entry_t)); 
 
-  e->host_correlation_id = host_correlation_id;
   e->gpu_op_ccts = *gpu_op_ccts;
   e->cpu_submit_time = cpu_submit_time;
   e->activity_channel = activity_channel;
@@ -198,7 +218,9 @@ gpu_host_correlation_map_lookup
  uint64_t host_correlation_id
 )
 {
-  gpu_host_correlation_map_entry_t *result = st_lookup(&map_root, host_correlation_id);
+  hashmap_uint64_t *m = gpu_host_correlation_map_get();
+  gpu_host_correlation_map_entry_t *result = 
+    m ? hashmap_uint64_lookup(m, host_correlation_id) : NULL;
 
   PRINT("host_correlation_map lookup: id=0x%lx (entry %p)", host_correlation_id, result);
 
@@ -215,16 +237,24 @@ gpu_host_correlation_map_insert
  gpu_activity_channel_t *activity_channel
 )
 {
-  if (st_lookup(&map_root, host_correlation_id)) { 
+  hashmap_uint64_t *m = gpu_host_correlation_map_get();
+  if (m == NULL) return;
+
+  if (hashmap_uint64_lookup(m, host_correlation_id)) { 
     // fatal error: host_correlation id already present; a
     // correlation should be inserted only once.
     assert(0);
   } else {
     gpu_host_correlation_map_entry_t *entry = 
-      gpu_host_correlation_map_entry_new(host_correlation_id, gpu_op_ccts, 
-					 cpu_submit_time, activity_channel);
+      gpu_host_correlation_map_entry_new(gpu_op_ccts, cpu_submit_time, 
+					 activity_channel);
 
-    st_insert(&map_root, entry);
+    if (!hashmap_uint64_insert(m, host_correlation_id, entry)) {
+      EMSG("gpu host correlation map: unable to grow, dropping correlation id %lu",
+	   host_correlation_id);
+      gpu_host_correlation_map_entry_free(entry);
+      return;
+    }
 
     PRINT("host_correlation_map insert: correlation_id=0x%lx "
 	 "activity_channel=%p (entry=%p)", 
@@ -245,7 +275,8 @@ gpu_host_correlation_map_samples_increase
   PRINT("correlation_map samples update: correlation_id=0x%lx (update %d)", 
 	host_correlation_id, val);
 
-  gpu_host_correlation_map_entry_t *entry = st_lookup(&map_root, host_correlation_id);
+  gpu_host_correlation_map_entry_t *entry =
+    gpu_host_correlation_map_lookup(host_correlation_id);
 
   if (entry) {
     entry->samples += val;
@@ -268,7 +299,8 @@ gpu_host_correlation_map_total_samples_update
   PRINT("correlation_map total samples update: correlation_id=0x%lx (update %d)",
        host_correlation_id, val);
 
-  gpu_host_correlation_map_entry_t *entry = st_lookup(&map_root, host_correlation_id);
+  gpu_host_correlation_map_entry_t *entry =
+    gpu_host_correlation_map_lookup(host_correlation_id);
 
   if (entry) {
     entry->total_samples = val;
@@ -285,8 +317,12 @@ gpu_host_correlation_map_delete
  uint64_t host_correlation_id
 )
 {
-  gpu_host_correlation_map_entry_t *node = st_delete(&map_root, host_correlation_id);
-  st_free(&free_list, node);
+  hashmap_uint64_t *m = gpu_host_correlation_map_get();
+  if (m == NULL) return;
+
+  gpu_host_correlation_map_entry_t *entry = 
+    hashmap_uint64_delete(m, host_correlation_id);
+  gpu_host_correlation_map_entry_free(entry);
 }
 
 
@@ -348,5 +384,6 @@ gpu_host_correlation_map_count
  void
 )
 {
-  return st_count(map_root);
+  hashmap_uint64_t *m = gpu_host_correlation_map_get();
+  return m ? hashmap_uint64_count(m) : 0;
 }
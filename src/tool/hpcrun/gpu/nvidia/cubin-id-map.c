@@ -53,8 +53,9 @@
 // local includes
 //*****************************************************************************
 
+#include <lib/prof-lean/hashmap-uint64.h>
 #include <lib/prof-lean/spinlock.h>
-#include <lib/prof-lean/splay-macros.h>
+#include <lib/prof-lean/stdatomic.h>
 #include <hpcrun/messages/messages.h>
 #include <hpcrun/memory/hpcrun-malloc.h>
 
@@ -66,8 +67,8 @@
 // macros
 //*****************************************************************************
 
-
-#define CUPTI_CUBIN_ID_MAP_HASH_TABLE_SIZE 127
+// cubins the map has room for initially; it grows when they are exceeded
+#define CUPTI_CUBIN_ID_MAP_CAPACITY 64
 
 
 
@@ -79,23 +80,18 @@ struct cubin_id_map_entry_s {
   uint32_t cubin_id;
   uint32_t hpctoolkit_module_id;
   Elf_SymbolVector *elf_vector;
-  struct cubin_id_map_entry_s *left;
-  struct cubin_id_map_entry_s *right;
 };
 
 
-typedef struct {
-  uint32_t cubin_id;
-  cubin_id_map_entry_t *entry;
-} cubin_id_map_hash_entry_t;
-
-
 
 //*****************************************************************************
 // global data
 //*****************************************************************************
 
-static cubin_id_map_entry_t *cubin_id_map_root = NULL;
+static atomic_uintptr_t cubin_id_map = ATOMIC_VAR_INIT(0);
+
+// lookups need no lock; inserts and deletes take it so that a cubin is
+// not loaded and unloaded at the same time
 static spinlock_t cubin_id_map_lock = SPINLOCK_UNLOCKED;
 
 
@@ -104,45 +100,41 @@ static spinlock_t cubin_id_map_lock = SPINLOCK_UNLOCKED;
 // private operations
 //*****************************************************************************
 
+static hashmap_uint64_t *
+cubin_id_map_get()
+{
+  uintptr_t m = atomic_load_explicit(&cubin_id_map, memory_order_acquire);
+  if (m == 0) {
+    uintptr_t new_map =
+      (uintptr_t) hashmap_uint64_new(CUPTI_CUBIN_ID_MAP_CAPACITY,
+				     hpcrun_malloc_safe);
+    if (new_map == 0) {
+      EMSG("cubin_id map: unable to allocate map");
+      return NULL;
+    }
+    // if another thread got there first, its map is used
+    if (atomic_compare_exchange_strong_explicit(&cubin_id_map, &m, new_map,
+						memory_order_acq_rel,
+						memory_order_acquire)) {
+      m = new_map;
+    }
+  }
+  return (hashmap_uint64_t *) m;
+}
+
+
 static cubin_id_map_entry_t *
 cubin_id_map_entry_new(uint32_t cubin_id, Elf_SymbolVector *vector)
 {
   cubin_id_map_entry_t *e;
   e = (cubin_id_map_entry_t *)hpcrun_malloc_safe(sizeof(cubin_id_map_entry_t));
   e->cubin_id = cubin_id;
-  e->left = NULL;
-  e->right = NULL;
   e->elf_vector = vector;
 
   return e;
 }
 
 
-static cubin_id_map_entry_t *
-cubin_id_map_splay(cubin_id_map_entry_t *root, uint32_t key)
-{
-  REGULAR_SPLAY_TREE(cubin_id_map_entry_s, root, key, cubin_id, left, right);
-  return root;
-}
-
-
-static void
-cubin_id_map_delete_root()
-{
-  TMSG(DEFER_CTXT, "cubin_id %d: delete", cubin_id_map_root->cubin_id);
-
-  if (cubin_id_map_root->left == NULL) {
-    cubin_id_map_root = cubin_id_map_root->right;
-  } else {
-    cubin_id_map_root->left =
-      cubin_id_map_splay(cubin_id_map_root->left,
-        cubin_id_map_root->cubin_id);
-    cubin_id_map_root->left->right = cubin_id_map_root->right;
-    cubin_id_map_root = cubin_id_map_root->left;
-  }
-}
-
-
 
 //*****************************************************************************
 // interface operations
@@ -154,34 +146,8 @@ cubin_id_map_lookup
  uint32_t id
 )
 {
-  cubin_id_map_entry_t *result = NULL;
-
-  static __thread cubin_id_map_hash_entry_t *cubin_id_map_hash_table = NULL;
-
-  if (cubin_id_map_hash_table == NULL) {
-    cubin_id_map_hash_table = (cubin_id_map_hash_entry_t *)hpcrun_malloc_safe(
-      CUPTI_CUBIN_ID_MAP_HASH_TABLE_SIZE * sizeof(cubin_id_map_hash_entry_t));
-    memset(cubin_id_map_hash_table, 0, CUPTI_CUBIN_ID_MAP_HASH_TABLE_SIZE *
-      sizeof(cubin_id_map_hash_entry_t));
-  }
-
-  cubin_id_map_hash_entry_t *hash_entry = &(cubin_id_map_hash_table[id % CUPTI_CUBIN_ID_MAP_HASH_TABLE_SIZE]);
-
-  if (hash_entry->entry == NULL || hash_entry->cubin_id != id) {
-    spinlock_lock(&cubin_id_map_lock);
-
-    cubin_id_map_root = cubin_id_map_splay(cubin_id_map_root, id);
-    if (cubin_id_map_root && cubin_id_map_root->cubin_id == id) {
-      result = cubin_id_map_root;
-    }
-
-    spinlock_unlock(&cubin_id_map_lock);
-
-    hash_entry->cubin_id = id;
-    hash_entry->entry = result;
-  } else {
-    result = hash_entry->entry;
-  }
+  hashmap_uint64_t *m = cubin_id_map_get();
+  cubin_id_map_entry_t *result = m ? hashmap_uint64_lookup(m, id) : NULL;
 
   TMSG(DEFER_CTXT, "cubin_id map lookup: id=0x%lx (record %p)", id, result);
   return result;
@@ -196,37 +162,20 @@ cubin_id_map_insert
  Elf_SymbolVector *vector
 )
 {
+  hashmap_uint64_t *m = cubin_id_map_get();
+  if (m == NULL) return;
+
   spinlock_lock(&cubin_id_map_lock);
 
-  if (cubin_id_map_root != NULL) {
-    cubin_id_map_root =
-      cubin_id_map_splay(cubin_id_map_root, cubin_id);
-
-    if (cubin_id < cubin_id_map_root->cubin_id) {
-      cubin_id_map_entry_t *entry = cubin_id_map_entry_new(cubin_id, vector);
-      TMSG(DEFER_CTXT, "cubin_id map insert: id=0x%lx (record %p)", cubin_id, entry);
-      entry->left = entry->right = NULL;
-      entry->hpctoolkit_module_id = hpctoolkit_module_id;
-      entry->left = cubin_id_map_root->left;
-      entry->right = cubin_id_map_root;
-      cubin_id_map_root->left = NULL;
-      cubin_id_map_root = entry;
-    } else if (cubin_id > cubin_id_map_root->cubin_id) {
-      cubin_id_map_entry_t *entry = cubin_id_map_entry_new(cubin_id, vector);
-      TMSG(DEFER_CTXT, "cubin_id map insert: id=0x%lx (record %p)", cubin_id, entry);
-      entry->left = entry->right = NULL;
-      entry->hpctoolkit_module_id = hpctoolkit_module_id;
-      entry->left = cubin_id_map_root;
-      entry->right = cubin_id_map_root->right;
-      cubin_id_map_root->right = NULL;
-      cubin_id_map_root = entry;
-    } else {
-      // cubin_id already present
-    }
-  } else {
+  if (hashmap_uint64_lookup(m, cubin_id) == NULL) {
     cubin_id_map_entry_t *entry = cubin_id_map_entry_new(cubin_id, vector);
     entry->hpctoolkit_module_id = hpctoolkit_module_id;
-    cubin_id_map_root = entry;
+    TMSG(DEFER_CTXT, "cubin_id map insert: id=0x%lx (record %p)", cubin_id, entry);
+    if (!hashmap_uint64_insert(m, cubin_id, entry)) {
+      EMSG("cubin_id map: unable to insert cubin_id %u", cubin_id);
+    }
+  } else {
+    // cubin_id already present
   }
 
   spinlock_unlock(&cubin_id_map_lock);
@@ -239,10 +188,13 @@ cubin_id_map_delete
  uint32_t cubin_id
 )
 {
-  cubin_id_map_root = cubin_id_map_splay(cubin_id_map_root, cubin_id);
-  if (cubin_id_map_root && cubin_id_map_root->cubin_id == cubin_id) {
-    cubin_id_map_delete_root();
-  }
+  TMSG(DEFER_CTXT, "cubin_id %d: delete", cubin_id);
+  hashmap_uint64_t *m = cubin_id_map_get();
+  if (m == NULL) return;
+
+  spinlock_lock(&cubin_id_map_lock);
+  hashmap_uint64_delete(m, cubin_id);
+  spinlock_unlock(&cubin_id_map_lock);
 }
 
 
@@ -292,27 +244,12 @@ cubin_id_transform(uint32_t cubin_id, uint32_t function_index, uint64_t offset)
 // debugging code
 //*****************************************************************************
 
-static int
-cubin_id_map_count_helper
-(
- cubin_id_map_entry_t *entry
-)
-{
-  if (entry) {
-    int left = cubin_id_map_count_helper(entry->left);
-    int right = cubin_id_map_count_helper(entry->right);
-    return 1 + right + left;
-  }
-  return 0;
-}
-
-
 int
 cubin_id_map_count
 (
  void
 )
 {
-  return cubin_id_map_count_helper(cubin_id_map_root);
+  hashmap_uint64_t *m = cubin_id_map_get();
+  return m ? hashmap_uint64_count(m) : 0;
 }
-
@@ -50,6 +50,8 @@
 //***************************************************************************
 #include "sample_event.h"
 #include "disabled.h"
+#include "hpcrun_stats.h"
+#include "thread_data.h"
 
 #include <memory/hpcrun-malloc.h>
 #include <messages/messages.h>
@@ -63,27 +65,66 @@
 // local variables
 //***************************************************************************
 
-static atomic_long num_samples_total = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_attempted = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_blocked_async = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_blocked_dlopen = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_dropped = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_segv = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_partial = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_yielded = ATOMIC_VAR_INIT(0);
+// counters for code that runs without thread data (e.g., a signal
+// that arrives before a thread is initialized)
+static hpcrun_stats_t stats_nothread;
 
-static atomic_long num_unwind_intervals_total = ATOMIC_VAR_INIT(0);
-static atomic_long num_unwind_intervals_suspicious = ATOMIC_VAR_INIT(0);
+// counters of all registered threads
+static atomic_uintptr_t stats_threads = ATOMIC_VAR_INIT(0);
 
-static atomic_long trolled = ATOMIC_VAR_INIT(0);
-static atomic_long frames_total = ATOMIC_VAR_INIT(0);
-static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
-static atomic_long frames_libfail_total = ATOMIC_VAR_INIT(0);
 
-static atomic_long acc_trace_records = ATOMIC_VAR_INIT(0);
-static atomic_long acc_trace_records_dropped = ATOMIC_VAR_INIT(0);
-static atomic_long acc_samples = ATOMIC_VAR_INIT(0);
-static atomic_long acc_samples_dropped = ATOMIC_VAR_INIT(0);
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static inline hpcrun_stats_t*
+stats_local(void)
+{
+  if (hpcrun_td_avail()) {
+    return &(TD_GET(stats));
+  }
+  return &stats_nothread;
+}
+
+
+static inline void
+stats_add(hpcrun_stat_t k, long value)
+{
+  // N.B.: an atomic add on the thread's own counters is uncontended;
+  // it only guards against a nested signal handler on the same thread
+  atomic_fetch_add_explicit(&stats_local()->count[k], value,
+			    memory_order_relaxed);
+}
+
+
+static inline long
+stats_get(hpcrun_stats_t* stats, hpcrun_stat_t k)
+{
+  return atomic_load_explicit(&stats->count[k], memory_order_relaxed);
+}
+
+
+static long
+stats_sum(hpcrun_stat_t k)
+{
+  long sum = stats_get(&stats_nothread, k);
+  hpcrun_stats_t* stats = (hpcrun_stats_t*)
+    atomic_load_explicit(&stats_threads, memory_order_acquire);
+  for (; stats; stats = stats->next) {
+    sum += stats_get(stats, k);
+  }
+  return sum;
+}
+
+
+static void
+stats_clear(hpcrun_stats_t* stats)
+{
+  for (int k = 0; k < HPCRUN_STAT_NUM; k++) {
+    atomic_store_explicit(&stats->count[k], 0, memory_order_relaxed);
+  }
+}
+
 
 //***************************************************************************
 // interface operations
@@ -92,25 +133,37 @@ static atomic_long acc_samples_dropped = ATOMIC_VAR_INIT(0);
 void
 hpcrun_stats_reinit(void)
 {
-  atomic_store_explicit(&num_samples_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_attempted, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_blocked_async, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_blocked_dlopen, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_segv, 0, memory_order_relaxed);
+  // forget threads from before (e.g., in the parent before fork), but
+  // keep the current thread registered
+  stats_clear(&stats_nothread);
+  atomic_store_explicit(&stats_threads, 0, memory_order_release);
 
-  atomic_store_explicit(&num_unwind_intervals_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_unwind_intervals_suspicious, 0, memory_order_relaxed);
+  if (hpcrun_td_avail()) {
+    hpcrun_stats_t* stats = &(TD_GET(stats));
+    hpcrun_stats_thread_init(stats, stats->id);
+  }
+}
 
-  atomic_store_explicit(&trolled, 0, memory_order_relaxed);
-  atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
-  atomic_store_explicit(&frames_libfail_total, 0, memory_order_relaxed);
 
-  atomic_store_explicit(&acc_trace_records, 0, memory_order_relaxed);
-  atomic_store_explicit(&acc_trace_records_dropped, 0, memory_order_relaxed);
+void
+hpcrun_stats_thread_init(hpcrun_stats_t* stats, int id)
+{
+  stats_clear(stats);
+  stats->id = id;
 
-  atomic_store_explicit(&acc_samples, 0, memory_order_relaxed);
-  atomic_store_explicit(&acc_samples_dropped, 0, memory_order_relaxed);
+  // after fork(), the child's thread data may already be in the
+  // (inherited) list
+  uintptr_t head = atomic_load_explicit(&stats_threads, memory_order_acquire);
+  for (hpcrun_stats_t* x = (hpcrun_stats_t*) head; x; x = x->next) {
+    if (x == stats) return;
+  }
+
+  do {
+    stats->next = (hpcrun_stats_t*) head;
+  } while (!atomic_compare_exchange_weak_explicit(&stats_threads, &head,
+						  (uintptr_t) stats,
+						  memory_order_release,
+						  memory_order_acquire));
 }
 
 
@@ -121,14 +174,14 @@ hpcrun_stats_reinit(void)
 void
 hpcrun_stats_num_samples_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_total(void)
 {
-  return atomic_load_explicit(&num_samples_total, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_TOTAL);
 }
 
 
@@ -140,14 +193,14 @@ hpcrun_stats_num_samples_total(void)
 void
 hpcrun_stats_num_samples_attempted_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_attempted, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_ATTEMPTED, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_attempted(void)
 {
-  return atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_ATTEMPTED);
 }
 
 
@@ -161,15 +214,15 @@ hpcrun_stats_num_samples_attempted(void)
 void
 hpcrun_stats_num_samples_blocked_async_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_async, 1L, memory_order_relaxed);
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC, 1L);
+  stats_add(HPCRUN_STAT_SAMPLES_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_async(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC);
 }
 
 
@@ -181,14 +234,14 @@ hpcrun_stats_num_samples_blocked_async(void)
 void
 hpcrun_stats_num_samples_blocked_dlopen_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_dlopen, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_dlopen(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN);
 }
 
 
@@ -200,14 +253,14 @@ hpcrun_stats_num_samples_blocked_dlopen(void)
 void
 hpcrun_stats_num_samples_dropped_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_dropped, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_DROPPED, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_dropped(void)
 {
-  return atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_DROPPED);
 }
 
 
@@ -218,14 +271,14 @@ hpcrun_stats_num_samples_dropped(void)
 void
 hpcrun_stats_acc_samples_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_samples, value, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_ACC_SAMPLES, value);
 }
 
 
 long
 hpcrun_stats_acc_samples(void)
 {
-  return atomic_load_explicit(&acc_samples, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_ACC_SAMPLES);
 }
 
 
@@ -236,14 +289,50 @@ hpcrun_stats_acc_samples(void)
 void
 hpcrun_stats_acc_samples_dropped_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_samples_dropped, value, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_ACC_SAMPLES_DROPPED, value);
 }
 
 
 long
 hpcrun_stats_acc_samples_dropped(void)
 {
-  return atomic_load_explicit(&acc_samples_dropped, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_ACC_SAMPLES_DROPPED);
+}
+
+
+//-----------------------------
+// trace records dropped
+//-----------------------------
+
+void
+hpcrun_stats_trace_records_dropped_add(long value)
+{
+  stats_add(HPCRUN_STAT_TRACE_RECORDS_DROPPED, value);
+}
+
+
+long
+hpcrun_stats_trace_records_dropped(void)
+{
+  return stats_sum(HPCRUN_STAT_TRACE_RECORDS_DROPPED);
+}
+
+
+//-----------------------------
+// directed blame dropped
+//-----------------------------
+
+void
+hpcrun_stats_blame_dropped_add(long value)
+{
+  stats_add(HPCRUN_STAT_BLAME_DROPPED, value);
+}
+
+
+long
+hpcrun_stats_blame_dropped(void)
+{
+  return stats_sum(HPCRUN_STAT_BLAME_DROPPED);
 }
 
 
@@ -254,14 +343,14 @@ hpcrun_stats_acc_samples_dropped(void)
 void
 hpcrun_stats_acc_trace_records_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_trace_records, value, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_ACC_TRACE_RECORDS, value);
 }
 
 
 long
 hpcrun_stats_acc_trace_records(void)
 {
-  return atomic_load_explicit(&acc_trace_records, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_ACC_TRACE_RECORDS);
 }
 
 
@@ -272,14 +361,14 @@ hpcrun_stats_acc_trace_records(void)
 void
 hpcrun_stats_acc_trace_records_dropped_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_trace_records_dropped, value, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED, value);
 }
 
 
 long
 hpcrun_stats_acc_trace_records_dropped(void)
 {
-  return atomic_load_explicit(&acc_trace_records_dropped, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED);
 }
 
 
@@ -290,13 +379,13 @@ hpcrun_stats_acc_trace_records_dropped(void)
 void
 hpcrun_stats_num_samples_partial_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_partial, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_PARTIAL, 1L);
 }
 
 long
 hpcrun_stats_num_samples_partial(void)
 {
-  return atomic_load_explicit(&num_samples_partial, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_PARTIAL);
 }
 
 //-----------------------------
@@ -306,14 +395,14 @@ hpcrun_stats_num_samples_partial(void)
 void
 hpcrun_stats_num_samples_segv_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_segv, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_SEGV, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_segv(void)
 {
-  return atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_SEGV);
 }
 
 
@@ -326,14 +415,14 @@ hpcrun_stats_num_samples_segv(void)
 void
 hpcrun_stats_num_unwind_intervals_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_total, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_total(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL);
 }
 
 
@@ -345,14 +434,14 @@ hpcrun_stats_num_unwind_intervals_total(void)
 void
 hpcrun_stats_num_unwind_intervals_suspicious_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_suspicious, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_suspicious(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS);
 }
 
 //------------------------------------------------------
@@ -362,13 +451,13 @@ hpcrun_stats_num_unwind_intervals_suspicious(void)
 void
 hpcrun_stats_trolled_inc(void)
 {
-  atomic_fetch_add_explicit(&trolled, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_TROLLED, 1L);
 }
 
 long
 hpcrun_stats_trolled(void)
 {
-  return atomic_load_explicit(&trolled, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_TROLLED);
 }
 
 //------------------------------------------------------
@@ -378,13 +467,13 @@ hpcrun_stats_trolled(void)
 void
 hpcrun_stats_frames_total_inc(long amt)
 {
-  atomic_fetch_add_explicit(&frames_total, amt, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_FRAMES_TOTAL, amt);
 }
 
 long
 hpcrun_stats_frames_total(void)
 {
-  return atomic_load_explicit(&frames_total, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_FRAMES_TOTAL);
 }
 //-------------------------------------------------------
 // number of (unwind) frames where libunwind failed
@@ -393,13 +482,13 @@ hpcrun_stats_frames_total(void)
 void
 hpcrun_stats_frames_libfail_total_inc(long amt)
 {
-  atomic_fetch_add_explicit(&frames_libfail_total, amt, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL, amt);
 }
 
 long
 hpcrun_stats_frames_libfail_total(void)
 {
-  return atomic_load_explicit(&frames_libfail_total, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL);
 }
 
 //---------------------------------------------------------------------
@@ -409,13 +498,13 @@ hpcrun_stats_frames_libfail_total(void)
 void
 hpcrun_stats_trolled_frames_inc(long amt)
 {
-  atomic_fetch_add_explicit(&trolled_frames, amt, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_TROLLED_FRAMES, amt);
 }
 
 long
 hpcrun_stats_trolled_frames(void)
 {
-  return atomic_load_explicit(&trolled_frames, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_TROLLED_FRAMES);
 }
 
 //----------------------------
@@ -425,46 +514,88 @@ hpcrun_stats_trolled_frames(void)
 void
 hpcrun_stats_num_samples_yielded_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_yielded, 1L, memory_order_relaxed);
+  stats_add(HPCRUN_STAT_SAMPLES_YIELDED, 1L);
 }
 
 long
 hpcrun_stats_num_samples_yielded(void)
 {
-  return atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
+  return stats_sum(HPCRUN_STAT_SAMPLES_YIELDED);
 }
 
 //-----------------------------
 // print summary
 //-----------------------------
 
+static void
+stats_print_thread(hpcrun_stats_t* stats, const char* label)
+{
+  long blocked = (stats_get(stats, HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC)
+		  + stats_get(stats, HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN));
+
+  AMSG("THREAD %s: samples: %ld (recorded: %ld, blocked: %ld, errant: %ld, "
+       "trolled: %ld, yielded: %ld), frames: %ld, acc samples: %ld "
+       "(dropped: %ld)",
+       label,
+       stats_get(stats, HPCRUN_STAT_SAMPLES_TOTAL),
+       stats_get(stats, HPCRUN_STAT_SAMPLES_ATTEMPTED),
+       blocked,
+       stats_get(stats, HPCRUN_STAT_SAMPLES_DROPPED),
+       stats_get(stats, HPCRUN_STAT_TROLLED),
+       stats_get(stats, HPCRUN_STAT_SAMPLES_YIELDED),
+       stats_get(stats, HPCRUN_STAT_FRAMES_TOTAL),
+       stats_get(stats, HPCRUN_STAT_ACC_SAMPLES),
+       stats_get(stats, HPCRUN_STAT_ACC_SAMPLES_DROPPED));
+}
+
+
+// per-thread breakdown of the summary (debug flag THREAD_STATS)
+static void
+stats_print_threads(void)
+{
+  char label[32];
+
+  hpcrun_stats_t* stats = (hpcrun_stats_t*)
+    atomic_load_explicit(&stats_threads, memory_order_acquire);
+  for (; stats; stats = stats->next) {
+    snprintf(label, sizeof(label), "%d", stats->id);
+    stats_print_thread(stats, label);
+  }
+  stats_print_thread(&stats_nothread, "(none)");
+}
+
+
 void
 hpcrun_stats_print_summary(void)
 {
-  long cpu_blocked_async  = atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed);
-  long cpu_blocked_dlopen = atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
+  long cpu_blocked_async  = stats_sum(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC);
+  long cpu_blocked_dlopen = stats_sum(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN);
   long cpu_blocked = cpu_blocked_async + cpu_blocked_dlopen;
 
-  long cpu_dropped = atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
-  long cpu_segv = atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
-  long cpu_valid = atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
-  long cpu_yielded = atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
-  long cpu_total = atomic_load_explicit(&num_samples_total, memory_order_relaxed);
+  long cpu_dropped = stats_sum(HPCRUN_STAT_SAMPLES_DROPPED);
+  long cpu_segv = stats_sum(HPCRUN_STAT_SAMPLES_SEGV);
+  long cpu_valid = stats_sum(HPCRUN_STAT_SAMPLES_ATTEMPTED);
+  long cpu_yielded = stats_sum(HPCRUN_STAT_SAMPLES_YIELDED);
+  long cpu_total = stats_sum(HPCRUN_STAT_SAMPLES_TOTAL);
+
+  long cpu_trolled = stats_sum(HPCRUN_STAT_TROLLED);
+
+  long cpu_frames = stats_sum(HPCRUN_STAT_FRAMES_TOTAL);
+  long cpu_frames_trolled = stats_sum(HPCRUN_STAT_TROLLED_FRAMES);
+  long cpu_frames_libfail_total = stats_sum(HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL);
 
-  long cpu_trolled = atomic_load_explicit(&trolled, memory_order_relaxed);
+  long cpu_intervals_total = stats_sum(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL);
+  long cpu_intervals_susp = stats_sum(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS);
 
-  long cpu_frames = atomic_load_explicit(&frames_total, memory_order_relaxed);
-  long cpu_frames_trolled = atomic_load_explicit(&trolled_frames, memory_order_relaxed);
-  long cpu_frames_libfail_total = atomic_load_explicit(&frames_libfail_total, memory_order_relaxed);
+  long acc_samp = stats_sum(HPCRUN_STAT_ACC_SAMPLES);
+  long acc_samp_dropped = stats_sum(HPCRUN_STAT_ACC_SAMPLES_DROPPED);
 
-  long cpu_intervals_total = atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
-  long cpu_intervals_susp = atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
+  long trace_dropped = stats_sum(HPCRUN_STAT_TRACE_RECORDS_DROPPED);
 
-  long acc_samp = atomic_load_explicit(&acc_samples, memory_order_relaxed);
-  long acc_samp_dropped = atomic_load_explicit(&acc_samples_dropped, memory_order_relaxed);
+  long blame_dropped = stats_sum(HPCRUN_STAT_BLAME_DROPPED);
 
-  long acc_trace = atomic_load_explicit(&acc_trace_records, memory_order_relaxed);
-  long acc_trace_dropped = atomic_load_explicit(&acc_trace_records_dropped, memory_order_relaxed);
+  long acc_trace = stats_sum(HPCRUN_STAT_ACC_TRACE_RECORDS);
+  long acc_trace_dropped = stats_sum(HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED);
 
   hpcrun_memory_summary();
 
@@ -491,6 +622,20 @@ hpcrun_stats_print_summary(void)
        cpu_intervals_total, cpu_intervals_susp
        );
 
+  if (trace_dropped > 0) {
+    AMSG("TRACE ANOMALIES: records dropped: %ld (trace writer fell behind)",
+	 trace_dropped);
+  }
+
+  if (blame_dropped > 0) {
+    AMSG("BLAME ANOMALIES: blame dropped: %ld (blame map full)",
+	 blame_dropped);
+  }
+
+  if (ENABLED(THREAD_STATS)) {
+    stats_print_threads();
+  }
+
   if (hpcrun_get_disabled()) {
     AMSG("SAMPLING HAS BEEN DISABLED");
   }
@@ -44,6 +44,66 @@
 //
 // ******************************************************* EndRiceCopyright *
 
+#ifndef HPCRUN_STATS_H
+#define HPCRUN_STATS_H
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <stdbool.h>
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include <lib/prof-lean/stdatomic.h>
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+// Counters are kept per thread (in thread_data_t) so that the sample
+// path does not write shared cache lines; they are summed when read.
+
+typedef enum {
+  HPCRUN_STAT_SAMPLES_TOTAL,
+  HPCRUN_STAT_SAMPLES_ATTEMPTED,
+  HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC,
+  HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN,
+  HPCRUN_STAT_SAMPLES_DROPPED,
+  HPCRUN_STAT_SAMPLES_SEGV,
+  HPCRUN_STAT_SAMPLES_PARTIAL,
+  HPCRUN_STAT_SAMPLES_YIELDED,
+
+  HPCRUN_STAT_UNWIND_INTERVALS_TOTAL,
+  HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS,
+
+  HPCRUN_STAT_TROLLED,
+  HPCRUN_STAT_FRAMES_TOTAL,
+  HPCRUN_STAT_TROLLED_FRAMES,
+  HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL,
+
+  HPCRUN_STAT_TRACE_RECORDS_DROPPED,
+
+  HPCRUN_STAT_BLAME_DROPPED,
+
+  HPCRUN_STAT_ACC_TRACE_RECORDS,
+  HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED,
+  HPCRUN_STAT_ACC_SAMPLES,
+  HPCRUN_STAT_ACC_SAMPLES_DROPPED,
+
+  HPCRUN_STAT_NUM
+} hpcrun_stat_t;
+
+typedef struct hpcrun_stats_t {
+  atomic_long count[HPCRUN_STAT_NUM];
+
+  int id;                       // thread id
+  struct hpcrun_stats_t* next;  // all registered threads
+} hpcrun_stats_t;
+
 
 //***************************************************************************
 // interface operations
@@ -51,6 +111,10 @@
 
 void hpcrun_stats_reinit(void);
 
+// hpcrun_stats_thread_init: clear and register the counters of a new
+// thread (idempotent for counters already registered)
+void hpcrun_stats_thread_init(hpcrun_stats_t* stats, int id);
+
 //-----------------------------
 // samples total 
 //-----------------------------
@@ -106,6 +170,20 @@ void hpcrun_stats_acc_samples_dropped_add(long value);
 long hpcrun_stats_acc_samples_dropped(void);
 
 
+//-----------------------------
+// trace records dropped (async trace writer fell behind)
+//-----------------------------
+void hpcrun_stats_trace_records_dropped_add(long value);
+long hpcrun_stats_trace_records_dropped(void);
+
+
+//-----------------------------
+// directed blame dropped (blame map window full)
+//-----------------------------
+void hpcrun_stats_blame_dropped_add(long value);
+long hpcrun_stats_blame_dropped(void);
+
+
 //-----------------------------
 // acc trace records 
 //-----------------------------
@@ -200,3 +278,5 @@ long hpcrun_stats_trolled_frames(void);
 //-----------------------------
 
 void hpcrun_stats_print_summary(void);
+
+#endif // HPCRUN_STATS_H
@@ -57,6 +57,11 @@
 
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
+
+#ifndef UNIT_TEST
+#define UNIT_TEST 0
+#endif
 
 #define LOADMAP_DEBUG 0
 
@@ -73,6 +78,421 @@ static spinlock_t loadmap_lock = SPINLOCK_UNLOCKED;
 
 static loadmap_notify_t *notification_recipients = NULL;
 
+
+//***************************************************************************
+// load module indices
+//
+// Lookups by address, id and name run during unwinding and on every
+// dlopen, so each is backed by an index maintained alongside the list:
+//  - by address: the currently mapped load modules sorted by start
+//    address, with a running maximum of end addresses so that
+//    overlapping mappings are still resolved in list order (the list
+//    is in decreasing id order);
+//  - by id: an array indexed by load module id;
+//  - by name: an open-addressing hash table.
+//
+// Writers are serialized by 'index_lock'.  Readers take no locks.
+// Each index lives in a block with a fixed capacity that is never
+// freed, and is replaced (not resized) when it grows.  The address
+// index is updated in place and guarded by a sequence counter; a
+// reader that races with an update (e.g., a sample taken inside
+// dlopen) falls back to scanning the list, as does every reader if
+// an index could not be allocated.
+//***************************************************************************
+
+#define ADDR_INDEX_INIT_SIZE  64
+#define ID_INDEX_INIT_SIZE    256
+#define NAME_INDEX_INIT_SIZE  256  // power of 2
+
+typedef struct lm_addr_entry_t {
+  uintptr_t start;
+  uintptr_t end;
+  uintptr_t max_end;   // maximum 'end' over entries [0, this]
+  uint16_t  id;
+  load_module_t* lm;
+} lm_addr_entry_t;
+
+typedef struct lm_addr_index_t {
+  size_t capacity;
+  size_t size;
+  lm_addr_entry_t entry[];
+} lm_addr_index_t;
+
+typedef struct lm_table_t {
+  size_t capacity;
+  size_t size;
+  load_module_t* entry[];
+} lm_table_t;
+
+enum {
+  INDEX_NONE = 0,  // not yet allocated
+  INDEX_OK,
+  INDEX_FAILED     // allocation failed; scan the list
+};
+
+static spinlock_t index_lock = SPINLOCK_UNLOCKED;
+static atomic_int index_state = ATOMIC_VAR_INIT(INDEX_NONE);
+
+static atomic_uint addr_index_seq = ATOMIC_VAR_INIT(0);
+static atomic_uintptr_t addr_index = ATOMIC_VAR_INIT(0);
+static atomic_uintptr_t id_index = ATOMIC_VAR_INIT(0);
+static atomic_uintptr_t name_index = ATOMIC_VAR_INIT(0);
+
+
+// N.B.: the indices are allocated on first use, because the loadmap
+// is initialized before the thread's memstore.
+static void
+index_init()
+{
+  atomic_store_explicit(&index_state, INDEX_NONE, memory_order_relaxed);
+  atomic_store_explicit(&addr_index_seq, 0, memory_order_relaxed);
+  atomic_store_explicit(&addr_index, 0, memory_order_relaxed);
+  atomic_store_explicit(&id_index, 0, memory_order_relaxed);
+  atomic_store_explicit(&name_index, 0, memory_order_relaxed);
+  spinlock_init(&index_lock);
+}
+
+
+static void
+index_fail()
+{
+  EMSG("loadmap: unable to allocate load module index, using list");
+  atomic_store_explicit(&index_state, INDEX_FAILED, memory_order_release);
+}
+
+
+static inline bool
+index_usable()
+{
+  return atomic_load_explicit(&index_state, memory_order_acquire) == INDEX_OK;
+}
+
+
+// index_lock_for_update: lock the indices for update, allocating them if needed.
+// Returns: true if the indices are usable (and locked).
+static bool
+index_lock_for_update()
+{
+  int state = atomic_load_explicit(&index_state, memory_order_acquire);
+  if (state == INDEX_FAILED) return false;
+
+  spinlock_lock(&index_lock);
+  if (atomic_load_explicit(&index_state, memory_order_relaxed) == INDEX_NONE) {
+    size_t addr_sz = sizeof(lm_addr_index_t)
+      + ADDR_INDEX_INIT_SIZE * sizeof(lm_addr_entry_t);
+    size_t id_sz = sizeof(lm_table_t)
+      + ID_INDEX_INIT_SIZE * sizeof(load_module_t*);
+    size_t name_sz = sizeof(lm_table_t)
+      + NAME_INDEX_INIT_SIZE * sizeof(load_module_t*);
+
+    lm_addr_index_t* ai = hpcrun_malloc(addr_sz);
+    lm_table_t* ii = hpcrun_malloc(id_sz);
+    lm_table_t* ni = hpcrun_malloc(name_sz);
+    if (!ai || !ii || !ni) {
+      index_fail();
+    }
+    else {
+      memset(ai, 0, addr_sz);
+      memset(ii, 0, id_sz);
+      memset(ni, 0, name_sz);
+      ai->capacity = ADDR_INDEX_INIT_SIZE;
+      ii->capacity = ID_INDEX_INIT_SIZE;
+      ni->capacity = NAME_INDEX_INIT_SIZE;
+
+      // N.B.: the list is empty when the indices are first allocated
+      atomic_store_explicit(&addr_index, (uintptr_t) ai, memory_order_relaxed);
+      atomic_store_explicit(&id_index, (uintptr_t) ii, memory_order_relaxed);
+      atomic_store_explicit(&name_index, (uintptr_t) ni, memory_order_relaxed);
+      atomic_store_explicit(&index_state, INDEX_OK, memory_order_release);
+    }
+  }
+
+  if (!index_usable()) {
+    spinlock_unlock(&index_lock);
+    return false;
+  }
+  return true;
+}
+
+
+static uint64_t
+name_hash(const char* name)
+{
+  // FNV-1a
+  uint64_t h = 0xcbf29ce484222325UL;
+  for (const unsigned char* p = (const unsigned char*) name; *p; p++) {
+    h ^= *p;
+    h *= 0x100000001b3UL;
+  }
+  return h;
+}
+
+
+// ---------------------------------------------------------
+// by address
+// ---------------------------------------------------------
+
+static inline lm_addr_index_t*
+addr_index_get()
+{
+  return (lm_addr_index_t*)
+    atomic_load_explicit(&addr_index, memory_order_acquire);
+}
+
+
+static void
+addr_index_write_begin()
+{
+  unsigned int seq = atomic_load_explicit(&addr_index_seq,
+					  memory_order_relaxed);
+  atomic_store_explicit(&addr_index_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+
+static void
+addr_index_write_end()
+{
+  unsigned int seq = atomic_load_explicit(&addr_index_seq,
+					  memory_order_relaxed);
+  atomic_store_explicit(&addr_index_seq, seq + 1, memory_order_release);
+}
+
+
+// recompute the running maximum of end addresses from entry 'pos' on
+static void
+addr_index_fix_max(lm_addr_index_t* idx, size_t pos)
+{
+  uintptr_t max_end = (pos > 0) ? idx->entry[pos - 1].max_end : 0;
+  for (size_t i = pos; i < idx->size; i++) {
+    if (idx->entry[i].end > max_end) {
+      max_end = idx->entry[i].end;
+    }
+    idx->entry[i].max_end = max_end;
+  }
+}
+
+
+static void
+addr_index_insert(load_module_t* lm)
+{
+  if (!index_lock_for_update()) return;
+  addr_index_write_begin();
+
+  lm_addr_index_t* idx = addr_index_get();
+  if (idx->size == idx->capacity) {
+    size_t capacity = 2 * idx->capacity;
+    lm_addr_index_t* new_idx =
+      hpcrun_malloc(sizeof(lm_addr_index_t)
+		    + capacity * sizeof(lm_addr_entry_t));
+    if (!new_idx) {
+      index_fail();
+      addr_index_write_end();
+      spinlock_unlock(&index_lock);
+      return;
+    }
+    new_idx->capacity = capacity;
+    new_idx->size = idx->size;
+    memcpy(new_idx->entry, idx->entry, idx->size * sizeof(lm_addr_entry_t));
+    atomic_store_explicit(&addr_index, (uintptr_t) new_idx,
+			  memory_order_release);
+    idx = new_idx;
+  }
+
+  uintptr_t start = (uintptr_t) lm->dso_info->start_addr;
+
+  // insert after any entries with the same start
+  size_t lo = 0, hi = idx->size;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (idx->entry[mid].start <= start) lo = mid + 1;
+    else hi = mid;
+  }
+  memmove(&idx->entry[lo + 1], &idx->entry[lo],
+	  (idx->size - lo) * sizeof(lm_addr_entry_t));
+
+  lm_addr_entry_t* e = &idx->entry[lo];
+  e->start = start;
+  e->end = (uintptr_t) lm->dso_info->end_addr;
+  e->id = lm->id;
+  e->lm = lm;
+  idx->size++;
+  addr_index_fix_max(idx, lo);
+
+  addr_index_write_end();
+  spinlock_unlock(&index_lock);
+}
+
+
+static void
+addr_index_remove(load_module_t* lm)
+{
+  if (!index_lock_for_update()) return;
+
+  lm_addr_index_t* idx = addr_index_get();
+  size_t pos = idx->size;
+  for (size_t i = 0; i < idx->size; i++) {
+    if (idx->entry[i].lm == lm) {
+      pos = i;
+      break;
+    }
+  }
+
+  if (pos < idx->size) {
+    addr_index_write_begin();
+    memmove(&idx->entry[pos], &idx->entry[pos + 1],
+	    (idx->size - pos - 1) * sizeof(lm_addr_entry_t));
+    idx->size--;
+    addr_index_fix_max(idx, pos);
+    addr_index_write_end();
+  }
+
+  spinlock_unlock(&index_lock);
+}
+
+
+// Returns: true if the index answered the query (setting '*lm_out'
+// to the load module or NULL), false if the caller must scan the list.
+static bool
+addr_index_find(uintptr_t begin, uintptr_t end, load_module_t** lm_out)
+{
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (!index_usable()) return false;
+
+    unsigned int seq = atomic_load_explicit(&addr_index_seq,
+					    memory_order_acquire);
+    if (seq & 1) {
+      // an update is in progress, possibly interrupted by this thread
+      return false;
+    }
+
+    lm_addr_index_t* idx = addr_index_get();
+    size_t n = idx->size;
+    if (n > idx->capacity) n = idx->capacity;
+
+    // entries [0, lo) start at or below 'begin'
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (idx->entry[mid].start <= begin) lo = mid + 1;
+      else hi = mid;
+    }
+
+    // scan down while an entry could still cover 'end'; on overlap,
+    // prefer the largest id (i.e., the first match in the list)
+    load_module_t* lm = NULL;
+    uint16_t lm_id = 0;
+    for (size_t i = lo; i > 0; i--) {
+      lm_addr_entry_t* e = &idx->entry[i - 1];
+      if (e->max_end < end) break;
+      if (end <= e->end && (lm == NULL || e->id > lm_id)) {
+	lm = e->lm;
+	lm_id = e->id;
+      }
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&addr_index_seq, memory_order_relaxed) == seq) {
+      *lm_out = lm;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// ---------------------------------------------------------
+// by id
+// ---------------------------------------------------------
+
+static void
+id_index_insert(load_module_t* lm)
+{
+  if (!index_lock_for_update()) return;
+
+  lm_table_t* idx = (lm_table_t*)
+    atomic_load_explicit(&id_index, memory_order_relaxed);
+  if (lm->id >= idx->capacity) {
+    size_t capacity = idx->capacity;
+    while (lm->id >= capacity) capacity *= 2;
+    size_t sz = sizeof(lm_table_t) + capacity * sizeof(load_module_t*);
+    lm_table_t* new_idx = hpcrun_malloc(sz);
+    if (!new_idx) {
+      index_fail();
+      spinlock_unlock(&index_lock);
+      return;
+    }
+    memset(new_idx, 0, sz);
+    new_idx->capacity = capacity;
+    memcpy(new_idx->entry, idx->entry, idx->capacity * sizeof(load_module_t*));
+    new_idx->entry[lm->id] = lm;
+    atomic_store_explicit(&id_index, (uintptr_t) new_idx,
+			  memory_order_release);
+  }
+  else {
+    atomic_store_explicit((_Atomic(uintptr_t)*) &idx->entry[lm->id],
+			  (uintptr_t) lm, memory_order_release);
+  }
+
+  spinlock_unlock(&index_lock);
+}
+
+
+// ---------------------------------------------------------
+// by name
+// ---------------------------------------------------------
+
+static void
+name_table_put(lm_table_t* tbl, load_module_t* lm, uint64_t hash)
+{
+  size_t mask = tbl->capacity - 1;
+  for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+    load_module_t* x = tbl->entry[i];
+    if (x == NULL || strcmp(x->name, lm->name) == 0) {
+      if (x == NULL) tbl->size++;
+      atomic_store_explicit((_Atomic(uintptr_t)*) &tbl->entry[i],
+			    (uintptr_t) lm, memory_order_release);
+      return;
+    }
+  }
+}
+
+
+static void
+name_index_insert(load_module_t* lm)
+{
+  if (!index_lock_for_update()) return;
+
+  lm_table_t* idx = (lm_table_t*)
+    atomic_load_explicit(&name_index, memory_order_relaxed);
+
+  // keep the load factor at most 1/2
+  if (2 * (idx->size + 1) > idx->capacity) {
+    size_t capacity = 2 * idx->capacity;
+    size_t sz = sizeof(lm_table_t) + capacity * sizeof(load_module_t*);
+    lm_table_t* new_idx = hpcrun_malloc(sz);
+    if (!new_idx) {
+      index_fail();
+      spinlock_unlock(&index_lock);
+      return;
+    }
+    memset(new_idx, 0, sz);
+    new_idx->capacity = capacity;
+    for (size_t i = 0; i < idx->capacity; i++) {
+      load_module_t* x = idx->entry[i];
+      if (x) name_table_put(new_idx, x, name_hash(x->name));
+    }
+    name_table_put(new_idx, lm, name_hash(lm->name));
+    atomic_store_explicit(&name_index, (uintptr_t) new_idx,
+			  memory_order_release);
+  }
+  else {
+    name_table_put(idx, lm, name_hash(lm->name));
+  }
+
+  spinlock_unlock(&index_lock);
+}
+
 void
 hpcrun_loadmap_notify_register(loadmap_notify_t *n)
 {
@@ -216,6 +636,9 @@ hpcrun_loadModule_new(const char* name)
   x->next = NULL;
   x->prev = NULL;
 
+  id_index_insert(x);
+  name_index_insert(x);
+
   return x;
 }
 
@@ -288,10 +711,9 @@ hpcrun_loadmap_print(hpcrun_loadmap_t* loadmap)
 
 //***************************************************************************
 
-load_module_t*
-hpcrun_loadmap_findByAddr(void* begin, void* end)
+static load_module_t*
+loadmap_scanByAddr(void* begin, void* end)
 {
-  TMSG(LOADMAP, "find by address %p -- %p", begin, end);
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     TMSG(LOADMAP, "\tload module %s", x->name);
     if (x->dso_info) {
@@ -314,10 +736,9 @@ hpcrun_loadmap_findByAddr(void* begin, void* end)
 }
 
 
-load_module_t*
-hpcrun_loadmap_findByName(const char* name)
+static load_module_t*
+loadmap_scanByName(const char* name)
 {
-  TMSG(LOADMAP, "find by name: %s", name);
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     if (strcmp(x->name, name) == 0) {
       TMSG(LOADMAP, "       --->FOUND", x->name);
@@ -328,10 +749,9 @@ hpcrun_loadmap_findByName(const char* name)
   return NULL;
 }
 
-load_module_t*
-hpcrun_loadmap_findById(uint16_t id)
+static load_module_t*
+loadmap_scanById(uint16_t id)
 {
-  TMSG(LOADMAP, "find by id %d", id);
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     if (x->id == id) {
       TMSG(LOADMAP, "       --->%s", x->name);
@@ -342,6 +762,71 @@ hpcrun_loadmap_findById(uint16_t id)
   return NULL;
 }
 
+
+load_module_t*
+hpcrun_loadmap_findByAddr(void* begin, void* end)
+{
+  TMSG(LOADMAP, "find by address %p -- %p", begin, end);
+
+  load_module_t* lm = NULL;
+  if (addr_index_find((uintptr_t) begin, (uintptr_t) end, &lm)) {
+    TMSG(LOADMAP, "       --->%s", (lm) ? lm->name : "(NOT FOUND)");
+    return lm;
+  }
+  return loadmap_scanByAddr(begin, end);
+}
+
+
+load_module_t*
+hpcrun_loadmap_findByName(const char* name)
+{
+  TMSG(LOADMAP, "find by name: %s", name);
+
+  if (!index_usable()) {
+    return loadmap_scanByName(name);
+  }
+
+  lm_table_t* idx = (lm_table_t*)
+    atomic_load_explicit(&name_index, memory_order_acquire);
+  size_t mask = idx->capacity - 1;
+  for (size_t i = name_hash(name) & mask; ; i = (i + 1) & mask) {
+    load_module_t* x = (load_module_t*)
+      atomic_load_explicit((_Atomic(uintptr_t)*) &idx->entry[i],
+			   memory_order_acquire);
+    if (x == NULL) {
+      break;
+    }
+    if (strcmp(x->name, name) == 0) {
+      TMSG(LOADMAP, "       --->FOUND", x->name);
+      return x;
+    }
+  }
+  TMSG(LOADMAP, "       --->(NOT FOUND)");
+  return NULL;
+}
+
+
+load_module_t*
+hpcrun_loadmap_findById(uint16_t id)
+{
+  TMSG(LOADMAP, "find by id %d", id);
+
+  if (!index_usable()) {
+    return loadmap_scanById(id);
+  }
+
+  lm_table_t* idx = (lm_table_t*)
+    atomic_load_explicit(&id_index, memory_order_acquire);
+  load_module_t* x = NULL;
+  if (id < idx->capacity) {
+    x = (load_module_t*)
+      atomic_load_explicit((_Atomic(uintptr_t)*) &idx->entry[id],
+			   memory_order_acquire);
+  }
+  TMSG(LOADMAP, "       --->%s", (x) ? x->name : "(NOT FOUND)");
+  return x;
+}
+
 const char*
 hpcrun_loadmap_findLoadName(const char* name)
 {
@@ -433,6 +918,7 @@ hpcrun_loadmap_map(dso_info_t* dso)
       TMSG(LOADMAP, " !! Internal consistency check fires !!");
       hpcrun_loadmap_unmap(lm);
       lm->dso_info = dso;
+      addr_index_insert(lm);
     }
     else {
       EMSG("hpcrun_loadmap_map(): attempt to both map dso '%s' and place it on the free list!", dso->name);
@@ -443,6 +929,7 @@ hpcrun_loadmap_map(dso_info_t* dso)
 	lm = hpcrun_loadModule_new(dso->name);
 	lm->dso_info = dso;
 	hpcrun_loadmap_pushFront(lm);
+	addr_index_insert(lm);
 
 #if UW_RECIPE_MAP_DEBUG
         fprintf(stderr, "hpcrun_loadmap_map: '%s' start=%p end=%p\n", 
@@ -473,6 +960,7 @@ hpcrun_loadmap_unmap(load_module_t* lm)
   void *start_addr = old_dso->start_addr;
   void *end_addr = old_dso->end_addr;
 
+  addr_index_remove(lm);
   lm->dso_info = NULL;
 
   // tallent: For now, do not move the loadmap to the back of the
@@ -524,6 +1012,7 @@ hpcrun_initLoadmap()
 
   s_loadmap_ptr = &s_loadmap;
   hpcrun_loadmap_init(s_loadmap_ptr);
+  index_init();
 
   s_dso_free_list = NULL;
 }
@@ -534,3 +1023,114 @@ hpcrun_getLoadmap()
 {
   return s_loadmap_ptr;
 }
+
+
+/****************************************************************************
+ * unit test (needs hpctoolkit-config.h from a configured build tree)
+ *
+ *   cc -std=gnu99 -O2 -DUNIT_TEST=1 -I<build>/src -I../.. -I../../lib \
+ *      -I../../tool -I. -Imessages -Imemory -Ifnbounds -Icct \
+ *      -Iunwind/common -Iunwind/x86-family -Iutilities loadmap.c
+ *   ./a.out [operations]
+ *
+ * random map, unmap and lookup operations over a few thousand load
+ * modules with overlapping address ranges and reused names; every
+ * indexed lookup must return the same module as the list scan.
+ ****************************************************************************/
+
+#if UNIT_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_MAX_LM 3000
+
+void *
+hpcrun_malloc(size_t size)
+{
+  return malloc(size);
+}
+
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+
+void
+hpcrun_emsg(const char *fmt, ...)
+{
+}
+
+
+void
+hpcrun_pmsg(const char *tag, const char *fmt, ...)
+{
+}
+
+
+int
+main(int argc, char **argv)
+{
+  static load_module_t *lms[TEST_MAX_LM];
+  long ops = (argc > 1) ? atol(argv[1]) : 20000;
+  long addr_lookups = 0, addr_hits = 0;
+  char name[64];
+
+  srand(1);
+  hpcrun_initLoadmap();
+
+  for (long i = 0; i < ops; i++) {
+    int op = rand() % 4;
+
+    if (op == 0 && s_loadmap.size < TEST_MAX_LM - 1) {
+      snprintf(name, sizeof(name), "/lib/m%d.so", rand() % 4000);
+      uintptr_t start = (uintptr_t) (rand() % 100000) * 16;
+      uintptr_t end = start + 1 + rand() % 4000;
+      dso_info_t *dso = hpcrun_dso_make(name, NULL, NULL, (void *) start,
+					(void *) end, 0);
+      load_module_t *lm = hpcrun_loadmap_map(dso);
+      lms[lm->id] = lm;
+    }
+    else if (op == 1 && s_loadmap.size > 0) {
+      load_module_t *lm = lms[1 + rand() % s_loadmap.size];
+      if (lm != NULL) {
+	hpcrun_loadmap_unmap(lm);
+      }
+    }
+    else {
+      uintptr_t begin = (uintptr_t) (rand() % 1700000);
+      uintptr_t end = begin + rand() % 50;
+      load_module_t *lm = hpcrun_loadmap_findByAddr((void *) begin,
+						    (void *) end);
+      addr_lookups++;
+      addr_hits += (lm != NULL);
+      if (lm != loadmap_scanByAddr((void *) begin, (void *) end)) {
+	printf("FAIL: findByAddr(0x%lx, 0x%lx)\n", begin, end);
+	return 1;
+      }
+
+      if (s_loadmap.size > 0) {
+	int id = 1 + rand() % (s_loadmap.size + 2);
+	if (hpcrun_loadmap_findById(id) != loadmap_scanById(id)) {
+	  printf("FAIL: findById(%d)\n", id);
+	  return 1;
+	}
+
+	snprintf(name, sizeof(name), "/lib/m%d.so", rand() % 4000);
+	if (hpcrun_loadmap_findByName(name) != loadmap_scanByName(name)) {
+	  printf("FAIL: findByName(%s)\n", name);
+	  return 1;
+	}
+      }
+    }
+  }
+
+  printf("%d load modules, %ld address lookups (%ld hits): ok\n",
+	 s_loadmap.size, addr_lookups, addr_hits);
+  return 0;
+}
+
+#endif
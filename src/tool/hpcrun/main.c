@@ -94,6 +94,7 @@
 #include "hpcrun_stats.h"
 #include "hpcrun_flag_stacks.h"
 #include "name.h"
+#include "rank.h"
 #include "start-stop.h"
 #include "custom-init.h"
 #include "cct_insert_backtrace.h"
@@ -121,6 +122,7 @@
 #include "thread_finalize.h"
 #include "thread_use.h"
 #include "trace.h"
+#include "trace_writer.h"
 #include "write_data.h"
 #include "sample-sources/itimer.h"
 #include <utilities/token-iter.h>
@@ -134,6 +136,7 @@
 
 #include <unwind/common/backtrace.h>
 #include <unwind/common/unwind.h>
+#include <unwind/common/uw_recipe_file.h>
 
 #include <utilities/arch/context-pc.h>
 
@@ -701,6 +704,18 @@ hpcrun_fini_internal()
     // write all threads' profile data and close trace file
     hpcrun_threadMgr_data_fini(hpcrun_get_thread_data());
 
+    // wait for the trace writer thread, if any
+    hpcrun_trace_writer_fini();
+
+    // the container index goes last, after every profile and trace
+    if (hpcrun_files_use_container()) {
+      hpcrun_close_container(hpcrun_get_rank());
+    }
+
+    // with HPCRUN_UNWIND_RECIPES_GEN, analyze the load modules while
+    // their fnbounds tables are still at hand
+    uw_recipe_file_fini();
+
     fnbounds_fini();
     hpcrun_stats_print_summary();
     messages_fini();
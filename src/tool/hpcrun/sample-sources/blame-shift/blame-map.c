@@ -47,6 +47,24 @@
 //
 // directed blame shifting for locks, critical sections, ...
 //
+// The map accumulates blame per object (e.g., a lock address) from
+// sampled waiters until the object's owner collects and clears it.
+// It is an open-addressing table keyed by the full 64-bit object
+// address.  Each slot holds the key and a word that packs a 16-bit
+// generation with 48 bits of blame; all updates are compare-and-swap
+// on that word, so the map is lock free and safe in signal handlers.
+//
+// An object lives in one of PROBE_MAX consecutive slots from its hash.
+// A slot whose blame is zero holds no information, so it may be taken
+// over by another object: the taker bumps the generation (and sets
+// BUSY) before it changes the key, which makes the CAS of any thread
+// that still sees the old key fail.  Two threads may add the same new
+// object in different slots at once; blame_map_get_blame() therefore
+// collects every slot for the object in its window.
+//
+// Blame is dropped only if all PROBE_MAX slots hold blame for other
+// objects; such drops are counted (hpcrun_stats_blame_dropped).
+//
 
 /******************************************************************************
  * system includes
@@ -54,6 +72,10 @@
 
 #include <assert.h>
 
+#ifndef UNIT_TEST
+#define UNIT_TEST 0
+#endif
+
 
 
 /******************************************************************************
@@ -62,9 +84,15 @@
 
 #include "blame-map.h"
 
-#include <hpcrun/messages/messages.h>
+#include <hpcrun/hpcrun_stats.h>
 #include <lib/prof-lean/stdatomic.h>
+
+#if UNIT_TEST
+// hpcrun-malloc.h needs the configured hpctoolkit-config.h
+void *hpcrun_malloc(size_t size);
+#else
 #include <memory/hpcrun-malloc.h>
+#endif
 
 /******************************************************************************
  * macros
@@ -73,26 +101,25 @@
 #define N (128*1024)
 #define INDEX_MASK ((N)-1)
 
-#define LOSSLESS_BLAME
-
-#ifdef BLAME_MAP_LOCKING
+// slots searched for an object, starting at its hash
+#define PROBE_MAX 16
 
-#define do_lock() \
-{ \
-  for(;;) { \
-    if (fetch_and_store_i64(&thelock, 1) == 0) break; \
-    while (thelock == 1); \
-  } \
-}
-
-#define do_unlock() thelock = 0
+// passes over the window while slots are being taken over; bounded
+// since the taker may be the thread this signal handler interrupted
+#define CLAIM_PASSES 4
 
-#else
+#define BLAME_BITS 48
+#define BLAME_MASK ((UINT64_C(1) << BLAME_BITS) - 1)
+#define GEN_ONE    (UINT64_C(1) << BLAME_BITS)
+#define GEN_MASK   (~BLAME_MASK)
 
-#define do_lock() 
-#define do_unlock()
+// slot is being taken over, its key is changing (part of the blame bits,
+// so a BUSY slot never looks empty)
+#define BUSY       (UINT64_C(1) << (BLAME_BITS - 1))
+#define BLAME_MAX  (BUSY - 1)
 
-#endif
+#define word_blame(w) ((w) & BLAME_MASK)
+#define word_gen(w)   ((w) & GEN_MASK)
 
 
 
@@ -100,73 +127,88 @@
  * data type
  *****************************************************************************/
 
-typedef struct {
-  uint32_t obj_id;
-  uint32_t blame;
-} blame_parts_t;
-
-typedef union {
-  uint_fast64_t combined;
-  blame_parts_t parts;
-} blame_all_t;
-
-
 union blame_entry_t {
-  atomic_uint_fast64_t value;
+  struct {
+    _Atomic(uint64_t) key;      // object, 0 if never used
+    _Atomic(uint64_t) word;     // generation | blame
+  };
+  char pad[16];
 };
 
 
 
-/***************************************************************************
- * private data  
- ***************************************************************************/
-
-static uint64_t volatile thelock;
-
-
-
 /***************************************************************************
  * private operations
  ***************************************************************************/
 
-uint32_t 
-blame_entry_obj_id(uint_fast64_t value)
+// objects are addresses, aligned and clustered: mix all the bits
+static inline uint32_t
+blame_map_hash(uint64_t obj)
 {
-  blame_all_t entry;
-  entry.combined = value;
-  return entry.parts.obj_id;
+  obj ^= obj >> 33;
+  obj *= UINT64_C(0xff51afd7ed558ccd);
+  obj ^= obj >> 33;
+  return (uint32_t) (obj & INDEX_MASK);
 }
 
 
-uint32_t 
-blame_entry_blame(uint_fast64_t value)
+static inline blame_entry_t *
+blame_map_slot(blame_entry_t table[], uint32_t start, int i)
 {
-  blame_all_t entry;
-  entry.combined = value;
-  return entry.parts.blame;
+  return &table[(start + i) & INDEX_MASK];
 }
 
-uint32_t 
-blame_map_obj_id(uint64_t obj)
+
+static inline uint64_t
+blame_add(uint64_t word, uint32_t metric_value)
 {
-  return ((uint32_t) ((uint64_t)obj) >> 2);
+  uint64_t blame = word_blame(word) + metric_value;
+  if (blame > BLAME_MAX) blame = BLAME_MAX;
+  return word_gen(word) | blame;
 }
 
 
-uint32_t 
-blame_map_hash(uint64_t obj) 
+// add to the slot if it (still) belongs to obj; 
+// returns false if it does not.
+static bool
+slot_add(blame_entry_t *e, uint64_t obj, uint32_t metric_value)
 {
-  return ((uint32_t)((blame_map_obj_id(obj)) & INDEX_MASK));
+  uint64_t word = atomic_load_explicit(&e->word, memory_order_acquire);
+  for (;;) {
+    if (word & BUSY) return false;
+    if (atomic_load_explicit(&e->key, memory_order_acquire) != obj) {
+      return false;
+    }
+    // fails if the slot was taken over (new generation) since 'word'
+    if (atomic_compare_exchange_weak_explicit(&e->word, &word,
+					      blame_add(word, metric_value),
+					      memory_order_acq_rel,
+					      memory_order_acquire)) {
+      return true;
+    }
+  }
 }
 
 
-uint_fast64_t 
-blame_map_entry(uint64_t obj, uint32_t metric_value)
+// take over a slot that holds no blame and start obj there;
+// returns false if the slot has blame or someone else got it.
+static bool
+slot_claim(blame_entry_t *e, uint64_t obj, uint32_t metric_value)
 {
-  blame_all_t be;
-  be.parts.obj_id = blame_map_obj_id(obj);
-  be.parts.blame = metric_value;
-  return be.combined;
+  uint64_t word = atomic_load_explicit(&e->word, memory_order_acquire);
+  if (word_blame(word) != 0) return false;
+
+  uint64_t gen = word_gen(word + GEN_ONE);
+  if (!atomic_compare_exchange_strong_explicit(&e->word, &word, gen | BUSY,
+					       memory_order_acq_rel,
+					       memory_order_relaxed)) {
+    return false;
+  }
+
+  atomic_store_explicit(&e->key, obj, memory_order_relaxed);
+  atomic_store_explicit(&e->word, blame_add(gen, metric_value),
+			memory_order_release);
+  return true;
 }
 
 
@@ -188,7 +230,8 @@ blame_map_init(blame_entry_t table[])
 {
   int i;
   for(i = 0; i < N; i++) {
-    atomic_store(&table[i].value, 0);
+    atomic_init(&table[i].key, 0);
+    atomic_init(&table[i].word, 0);
   }
 }
 
@@ -197,84 +240,186 @@ void
 blame_map_add_blame(blame_entry_t table[],
 		    uint64_t obj, uint32_t metric_value)
 {
-  uint32_t obj_id = blame_map_obj_id(obj);
-  uint32_t index = blame_map_hash(obj);
-
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  uint_fast64_t oldval = atomic_load(&table[index].value);
+  if (metric_value == 0) return;
 
-  for(;;) {
-    blame_all_t newval;
-    newval.combined = oldval;
-    newval.parts.blame += metric_value;
+  uint32_t start = blame_map_hash(obj);
+  int i, pass;
 
-    uint32_t obj_at_index = newval.parts.obj_id;
-    if(obj_at_index == obj_id) {
-#ifdef LOSSLESS_BLAME
-      if (atomic_compare_exchange_strong_explicit(&table[index].value, &oldval, newval.combined,
-						  memory_order_relaxed, memory_order_relaxed)) 
-        break;
-#else
-      // the atomicity is not needed here, but it is the easiest way to write this
-      atomic_store(&table[index].value, newval.combined);
-      break;
-#endif
-    } else {
-      if(newval.parts.obj_id == 0) {
-	newval.combined = blame_map_entry(obj, metric_value);
-#ifdef LOSSLESS_BLAME
-	if ((atomic_compare_exchange_strong_explicit(&table[index].value, &oldval, newval.combined,
-						     memory_order_relaxed, memory_order_relaxed)))  
-          break;
-	// otherwise, try again
-#else
-        // the atomicity is not needed here, but it is the easiest way to write this
-        atomic_store(&table[index].value, newval.combined);
-	break;
-#endif
+  for (pass = 0; pass < CLAIM_PASSES; pass++) {
+    // where obj already is
+    for (i = 0; i < PROBE_MAX; i++) {
+      if (slot_add(blame_map_slot(table, start, i), obj, metric_value)) {
+	return;
       }
-      else {
-	EMSG("leaked blame %d\n", metric_value);
-	// entry in use for another object's blame
-	// in this case, since it isn't easy to shift 
-	// our blame efficiently, we simply drop it.
-	break;
+    }
+
+    // else any slot without blame: never used, or whose object's blame
+    // has been collected
+    bool busy = false;
+    for (i = 0; i < PROBE_MAX; i++) {
+      blame_entry_t *e = blame_map_slot(table, start, i);
+      if (slot_claim(e, obj, metric_value)) {
+	return;
       }
+      busy |= ((atomic_load_explicit(&e->word, memory_order_relaxed) 
+		& BUSY) != 0);
     }
+
+    // a slot in transition may be becoming obj's (or free): look again
+    if (!busy) break;
   }
-  do_unlock();
+
+  // the window is full of other objects' blame; since it isn't easy to
+  // shift our blame efficiently, we simply drop it.
+  hpcrun_stats_blame_dropped_add(metric_value);
 }
 
 
 uint64_t 
 blame_map_get_blame(blame_entry_t table[], uint64_t obj)
 {
-  static uint64_t zero = 0;
+  uint32_t start = blame_map_hash(obj);
   uint64_t val = 0;
-  uint32_t obj_id = blame_map_obj_id(obj);
-  uint32_t index = blame_map_hash(obj);
-
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  for(;;) {
-    uint_fast64_t oldval = atomic_load(&table[index].value);
-    uint32_t entry_obj_id = blame_entry_obj_id(oldval);
-    if(entry_obj_id == obj_id) {
-#ifdef LOSSLESS_BLAME
-      if (!atomic_compare_exchange_strong_explicit(&table[index].value, &oldval, zero,
-						  memory_order_relaxed, memory_order_relaxed)) 
-        continue; // try again on failure
-#else
-      table[index].all = 0;
-#endif
-      val = (uint64_t) blame_entry_blame(oldval);
+  int i;
+
+  for (i = 0; i < PROBE_MAX; i++) {
+    blame_entry_t *e = blame_map_slot(table, start, i);
+    uint64_t word = atomic_load_explicit(&e->word, memory_order_acquire);
+    for (;;) {
+      if ((word & BUSY) || word_blame(word) == 0) break;
+      if (atomic_load_explicit(&e->key, memory_order_acquire) != obj) break;
+      // keep the generation: the slot stays obj's until taken over
+      if (atomic_compare_exchange_weak_explicit(&e->word, &word, 
+						word_gen(word),
+						memory_order_acq_rel,
+						memory_order_acquire)) {
+	val += word_blame(word);
+	break;
+      }
     }
-    break;
   }
-  do_unlock();
 
   return val;
 }
+
+
+
+/******************************************************************************
+ * unit test (builds in an unconfigured source tree, from this directory)
+ *
+ *   cc -std=gnu11 -O2 -DUNIT_TEST=1 -I../../../.. -I../../.. -I../.. \
+ *      blame-map.c -lpthread
+ *   ./a.out [objects] [operations] [threads]
+ *
+ * waiter threads add random blame to random objects while owner threads
+ * collect it, as for contended locks; at the end the blame collected
+ * plus the blame dropped must equal the blame added.  Compare the
+ * throughput with the same run before this map (direct-mapped, 32-bit
+ * ids), which lost blame on every collision.
+ *****************************************************************************/
+
+#if UNIT_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+static atomic_ullong test_dropped;
+static atomic_ullong test_added;
+static atomic_ullong test_collected;
+
+static blame_entry_t *test_map;
+static uint64_t test_objects = 100000;
+static uint64_t test_ops = 10000000;
+
+void *
+hpcrun_malloc(size_t size)
+{
+  return malloc(size);
+}
+
+
+void
+hpcrun_stats_blame_dropped_add(long value)
+{
+  atomic_fetch_add(&test_dropped, value);
+}
+
+
+static uint64_t
+test_obj(unsigned int *seed)
+{
+  // lock-like addresses: 64-byte aligned, spread over a large heap
+  return UINT64_C(0x7f0000000000) + 64 * (rand_r(seed) % test_objects);
+}
+
+
+static void *
+test_thread(void *arg)
+{
+  unsigned int seed = (unsigned int) (uintptr_t) arg;
+  bool owner = ((uintptr_t) arg) & 1;
+  uint64_t added = 0, collected = 0;
+
+  for (uint64_t i = 0; i < test_ops; i++) {
+    uint64_t obj = test_obj(&seed);
+    if (owner) {
+      collected += blame_map_get_blame(test_map, obj);
+    } else {
+      uint32_t v = 1 + rand_r(&seed) % 1000;
+      blame_map_add_blame(test_map, obj, v);
+      added += v;
+    }
+  }
+
+  atomic_fetch_add(&test_added, added);
+  atomic_fetch_add(&test_collected, collected);
+  return NULL;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  int n_threads = 8;
+  if (argc > 1) test_objects = strtoull(argv[1], NULL, 10);
+  if (argc > 2) test_ops = strtoull(argv[2], NULL, 10);
+  if (argc > 3) n_threads = atoi(argv[3]);
+
+  test_map = blame_map_new();
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  pthread_t th[n_threads];
+  for (int i = 0; i < n_threads; i++) {
+    pthread_create(&th[i], NULL, test_thread, (void *) (uintptr_t) (i + 1));
+  }
+  for (int i = 0; i < n_threads; i++) {
+    pthread_join(th[i], NULL);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  // what the owners did not get to yet
+  uint64_t left = 0;
+  for (uint64_t k = 0; k < test_objects; k++) {
+    left += blame_map_get_blame(test_map, UINT64_C(0x7f0000000000) + 64 * k);
+  }
+
+  uint64_t added = atomic_load(&test_added);
+  uint64_t collected = atomic_load(&test_collected) + left;
+  uint64_t dropped = atomic_load(&test_dropped);
+  double secs = (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+
+  printf("%d threads, %lu objects: %.1f Mops/s\n", n_threads, test_objects,
+	 n_threads * test_ops / secs / 1e6);
+  printf("blame added %lu, collected %lu, dropped %lu (%.4f%%): %s\n",
+	 added, collected, dropped, 100.0 * dropped / added,
+	 (collected + dropped == added) ? "ok" : "MISMATCH");
+
+  return (collected + dropped == added) ? 0 : 1;
+}
+
+#endif
@@ -226,11 +226,6 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   cptd->epoch = hpcrun_malloc(sizeof(epoch_t));
   cptd->epoch->csdata_ctxt = copy_thr_ctxt(thr_ctxt);
 
-  // ----------------------------------------
-  // cct2metrics map: associate a metric_set with
-  //                  a cct node
-  hpcrun_cct2metrics_init(&(cptd->cct2metrics_map));
-
   // ----------------------------------------
   // tracing
   // ----------------------------------------
@@ -243,6 +238,8 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   cptd->hpcrun_file  = NULL;
   cptd->trace_buffer = NULL;
   cptd->trace_outbuf = NULL;
+  cptd->trace_writer = NULL;
+  cptd->trace_in_container = 0;
 
   // ----------------------------------------
   // perf event support
@@ -269,6 +266,7 @@ void
 hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sources)
 {
   hpcrun_meminfo_t memstore;
+  hpcrun_stats_t stats;
   thread_data_t* td = hpcrun_get_thread_data();
 
   // ----------------------------------------
@@ -277,12 +275,15 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
 
   // Wipe the thread data with a bogus bit pattern, but save the
   // memstore so we can reuse it in the child after fork.  This must
-  // come first.
+  // come first.  Also save the statistics, which may already be
+  // linked into the list of all threads' statistics.
   td->inside_hpcrun = 1;
   memstore = td->memstore;
+  memcpy(&stats, &td->stats, sizeof(stats));
   memset(td, 0xfe, sizeof(thread_data_t));
   td->inside_hpcrun = 1;
   td->memstore = memstore;
+  memcpy(&td->stats, &stats, sizeof(stats));
   hpcrun_make_memstore(&td->memstore, is_child);
   td->mem_low = 0;
 
@@ -291,6 +292,11 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
   // ----------------------------------------
   core_profile_trace_data_init(&(td->core_profile_trace_data), id, thr_ctxt);
 
+  // ----------------------------------------
+  // statistics
+  // ----------------------------------------
+  hpcrun_stats_thread_init(&td->stats, id);
+
   // ----------------------------------------
   // blame shifting support
   // ----------------------------------------
@@ -356,6 +362,7 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
   hpcrun_bt_init(&(td->bt), NEW_BACKTRACE_INIT_SZ);
 
   td->uw_hash_table = uw_hash_new(1023, hpcrun_malloc);
+  td->bt_memo = NULL;
 
   // ----------------------------------------
   // trampoline
@@ -63,6 +63,7 @@
 #include "epoch.h"
 #include "cct2metrics.h"
 #include "core_profile_trace_data.h"
+#include "hpcrun_stats.h"
 #include "ompt/omp-tools.h"
 
 #include <lush/lush-pthread.i>
@@ -194,7 +195,6 @@ typedef struct thread_data_t {
   // ----------------------------------------
   // core_profile_trace_data contains the following
   // epoch: loadmap + cct + cct_ctxt
-  // cct2metrics map: associate a metric_set with
   // tracing: trace_min_time_us and trace_max_time_us
   // IO support file handle: hpcrun_file;
   // Perf event support
@@ -228,6 +228,9 @@ typedef struct thread_data_t {
   backtrace_t bt;     // backtrace used for unwinding
   uw_hash_table_t *uw_hash_table;
 
+  // last path inserted into a cct (cf. cct_insert_backtrace.c)
+  struct cct_bt_memo_t* bt_memo;
+
   // ----------------------------------------
   // trampoline
   // ----------------------------------------
@@ -257,6 +260,11 @@ typedef struct thread_data_t {
   int              handling_sample;
   int              fnbounds_lock;
 
+  // ----------------------------------------
+  // statistics (cf. hpcrun_stats.c)
+  // ----------------------------------------
+  hpcrun_stats_t   stats;
+
   // ----------------------------------------
   // Logical unwinding
   // ----------------------------------------
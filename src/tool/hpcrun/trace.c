@@ -49,7 +49,10 @@
 //*********************************************************************
 
 #include <stdio.h>
-#include <sys/time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <strings.h>
+#include <time.h>
 #include <assert.h>
 #include <limits.h>
 
@@ -67,6 +70,7 @@
 #include "rank.h"
 #include "string.h"
 #include "trace.h"
+#include "trace_writer.h"
 #include "thread_data.h"
 #include "sample_prob.h"
 
@@ -78,11 +82,26 @@
 #include <lib/prof-lean/hpcio.h>
 #include <lib/prof-lean/hpcio-buffer.h>
 
+#if defined(HOST_CPU_x86_64)
+#include <cpuid.h>
+#endif
+
 
 //*********************************************************************
 // type declarations
 //*********************************************************************
 
+// Clock sources for trace record time stamps.  Whatever the source,
+// time stamps are nanoseconds in the CLOCK_REALTIME epoch so that they
+// line up with the GPU activity records that are appended with
+// externally supplied times.
+typedef enum {
+  TRACE_CLOCK_REALTIME,       // clock_gettime(CLOCK_REALTIME)
+  TRACE_CLOCK_MONOTONIC_RAW,  // clock_gettime(CLOCK_MONOTONIC_RAW) + offset,
+                              // re-anchored about once per second
+  TRACE_CLOCK_TSC             // rdtsc, calibrated against CLOCK_REALTIME
+} trace_clock_t;
+
 
 
 //*********************************************************************
@@ -90,7 +109,10 @@
 //*********************************************************************
 
 static void hpcrun_trace_file_validate(int valid, char *op);
+static size_t trace_datum_size(hpctrace_hdr_flags_t flags);
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint32_t dLCA, uint64_t nanotime);
+static void hpcrun_trace_clock_init(void);
+static inline uint64_t hpcrun_trace_clock_now(void);
 
 
 //*********************************************************************
@@ -99,6 +121,37 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 
 static int tracing = 0;
 
+static trace_clock_t trace_clock = TRACE_CLOCK_REALTIME;
+
+// CLOCK_REALTIME is NTP-adjusted and CLOCK_MONOTONIC_RAW is not, so
+// each thread re-computes its offset between them about once per
+// second (ns)
+#define MONOTONIC_RAW_REANCHOR_NS 1000000000
+
+static __thread uint64_t raw_anchor_ns = 0;
+static __thread uint64_t raw_offset = 0;
+static __thread uint64_t raw_last_ns = 0;
+
+#if defined(HOST_CPU_x86_64)
+
+// TSC to ns conversion: ns = (ticks * mult) >> TSC_MULT_SHIFT.
+#define TSC_MULT_SHIFT 32
+
+// initial calibration interval (ns)
+#define TSC_CALIBRATE_NS 10000000
+
+// each thread re-anchors its TSC conversion against CLOCK_REALTIME
+// (and refines its multiplier) about once per second of ticks
+static uint64_t tsc_mult = 0;
+static uint64_t tsc_recalibrate_ticks = 0;
+
+static __thread uint64_t tsc_anchor_tsc = 0;
+static __thread uint64_t tsc_anchor_ns = 0;
+static __thread uint64_t tsc_thread_mult = 0;
+static __thread uint64_t tsc_last_ns = 0;
+
+#endif
+
 //*********************************************************************
 // interface operations
 //*********************************************************************
@@ -116,6 +169,8 @@ hpcrun_trace_init()
   if (getenv(HPCRUN_TRACE)) {
       tracing = 1;
       TMSG(TRACE, "Tracing is ON");
+      hpcrun_trace_clock_init();
+      hpcrun_trace_writer_init();
   }
 }
 
@@ -136,17 +191,6 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     TMSG(TRACE, "Hit active portion");
     int fd, ret;
 
-    // I think unlocked is ok here (we don't overlap any system
-    // locks).  At any rate, locks only protect against threads, they
-    // don't help with signal handlers (that's much harder).
-    fd = hpcrun_open_trace_file(cptd->id);
-    hpcrun_trace_file_validate(fd >= 0, "open");
-    cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
-    ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
-			      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED,
-                              hpcrun_malloc);
-    hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
-
     hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
 #ifdef DATACENTRIC_TRACE
     HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS, true);
@@ -160,6 +204,54 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
 #else
     HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS, false);
 #endif
+
+    // I think unlocked is ok here (we don't overlap any system
+    // locks).  At any rate, locks only protect against threads, they
+    // don't help with signal handlers (that's much harder).
+    hpcrun_container_member_t* member = NULL;
+    fd = -1;
+    if (hpcrun_files_use_container()) {
+      member = hpcrun_open_trace_container(cptd->id);
+      if (member == NULL) {
+	EMSG("unable to add trace %d to the container, writing a file",
+	     cptd->id);
+      }
+    }
+    cptd->trace_in_container = (member != NULL);
+    if (member == NULL) {
+      fd = hpcrun_open_trace_file(cptd->id);
+      hpcrun_trace_file_validate(fd >= 0, "open");
+    }
+
+    cptd->trace_writer = NULL;
+    if (hpcrun_trace_writer_enabled()) {
+      // full buffers are written by the trace writer thread
+      cptd->trace_writer =
+	hpcrun_trace_writer_open(&cptd->trace_outbuf, fd,
+				 (member) ? hpcrun_container_member_write : NULL,
+				 member, trace_datum_size(flags));
+      if (cptd->trace_writer == NULL) {
+	EMSG("unable to start asynchronous trace writing, writing synchronously");
+      }
+    }
+
+    if (cptd->trace_writer != NULL) {
+      ret = HPCFMT_OK;
+    }
+    else if (member) {
+      cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
+      ret = hpcio_outbuf_attach_fn(&cptd->trace_outbuf,
+				   hpcrun_container_member_write, member,
+				   cptd->trace_buffer, HPCRUN_TraceBufferSz,
+				   HPCIO_OUTBUF_UNLOCKED, hpcrun_malloc);
+    }
+    else {
+      cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
+      ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
+				HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED,
+				hpcrun_malloc);
+    }
+    hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
     
     ret = hpctrace_fmt_hdr_outbuf(flags, cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
@@ -181,11 +273,7 @@ void
 hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metric_id, uint32_t dLCA)
 {
   if (tracing && hpcrun_sample_prob_active()) {
-    struct timeval tv;
-    int ret = gettimeofday(&tv, NULL);
-    assert(ret == 0 && "in trace_append: gettimeofday failed!");
-    uint64_t nanotime = ((uint64_t)tv.tv_usec
-			  + (((uint64_t)tv.tv_sec) * 1000000)) * 1000;
+    uint64_t nanotime = hpcrun_trace_clock_now();
 
     // mark the leaf of a call path recorded in a trace record for retention
     // so that the call path associated with the trace record can be recovered.
@@ -221,13 +309,22 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
-    int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
+    int ret;
+    if (cptd->trace_writer != NULL) {
+      ret = hpcrun_trace_writer_close(cptd->trace_writer,
+				      &cptd->trace_outbuf);
+      cptd->trace_writer = NULL;
+    }
+    else {
+      ret = hpcio_outbuf_close(&cptd->trace_outbuf);
+    }
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
     }
 
+    // container members are named when the container is closed
     int rank = hpcrun_get_rank();
-    if (rank >= 0) {
+    if (rank >= 0 && !cptd->trace_in_container) {
       hpcrun_rename_trace_file(rank, cptd->id);
     }
   }
@@ -281,6 +378,213 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 }
 
 
+// bytes per record written by hpctrace_fmt_datum_outbuf()
+static size_t
+trace_datum_size(hpctrace_hdr_flags_t flags)
+{
+  size_t size = sizeof(uint64_t) + sizeof(uint32_t); // comp, cpId
+  if (HPCTRACE_HDR_FLAGS_GET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS)) {
+    size += sizeof(uint32_t); // metricId
+  }
+  return size;
+}
+
+
+static inline uint64_t
+timespec_to_ns(const struct timespec *ts)
+{
+  return ((uint64_t)ts->tv_sec) * 1000000000 + (uint64_t)ts->tv_nsec;
+}
+
+
+static inline uint64_t
+clock_ns(clockid_t clk)
+{
+  struct timespec ts;
+  int ret = clock_gettime(clk, &ts);
+  assert(ret == 0 && "in trace clock: clock_gettime failed!");
+  (void) ret;
+  return timespec_to_ns(&ts);
+}
+
+
+#if defined(HOST_CPU_x86_64)
+
+static inline uint64_t
+tsc_read(void)
+{
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return (((uint64_t) hi) << 32) | lo;
+}
+
+
+static inline uint64_t
+tsc_scale(uint64_t ticks, uint64_t mult)
+{
+  return (uint64_t)(((unsigned __int128) ticks * mult) >> TSC_MULT_SHIFT);
+}
+
+
+// The TSC is usable only if it ticks at a constant rate regardless of
+// P/C-states (CPUID.80000007H:EDX[8]); otherwise converted times drift
+// arbitrarily between recalibrations.
+static bool
+tsc_is_invariant(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0
+      || eax < 0x80000007) {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1U << 8)) != 0;
+}
+
+
+static bool
+tsc_calibrate(void)
+{
+  if (!tsc_is_invariant()) {
+    return false;
+  }
+
+  struct timespec delay = { 0, TSC_CALIBRATE_NS };
+
+  uint64_t ns0 = clock_ns(CLOCK_MONOTONIC_RAW);
+  uint64_t tsc0 = tsc_read();
+  nanosleep(&delay, NULL);
+  uint64_t ns1 = clock_ns(CLOCK_MONOTONIC_RAW);
+  uint64_t tsc1 = tsc_read();
+
+  if (tsc1 <= tsc0 || ns1 <= ns0) {
+    return false;
+  }
+
+  uint64_t dtsc = tsc1 - tsc0;
+  tsc_mult = (uint64_t)((((unsigned __int128) (ns1 - ns0)) << TSC_MULT_SHIFT)
+			/ dtsc);
+  tsc_recalibrate_ticks = (uint64_t)(((unsigned __int128) dtsc * 1000000000)
+				     / (ns1 - ns0));
+
+  TMSG(TRACE, "TSC calibrated: %lu ticks/s", tsc_recalibrate_ticks);
+  return tsc_mult != 0 && tsc_recalibrate_ticks != 0;
+}
+
+
+static uint64_t
+tsc_now(void)
+{
+  uint64_t tsc = tsc_read();
+  uint64_t dtsc = tsc - tsc_anchor_tsc;
+
+  if (tsc_anchor_tsc == 0 || tsc < tsc_anchor_tsc
+      || dtsc >= tsc_recalibrate_ticks) {
+    // re-anchor against the wall clock; use the elapsed interval to
+    // refine this thread's multiplier for the next period.
+    uint64_t ns = clock_ns(CLOCK_REALTIME);
+    if (tsc_anchor_tsc != 0 && tsc > tsc_anchor_tsc && ns > tsc_anchor_ns) {
+      tsc_thread_mult = (uint64_t)
+	((((unsigned __int128) (ns - tsc_anchor_ns)) << TSC_MULT_SHIFT) / dtsc);
+    } else {
+      tsc_thread_mult = tsc_mult;
+    }
+    tsc_anchor_tsc = tsc;
+    tsc_anchor_ns = ns;
+    dtsc = 0;
+  }
+
+  uint64_t ns = tsc_anchor_ns + tsc_scale(dtsc, tsc_thread_mult);
+
+  // never let a re-anchor step a thread's trace backwards
+  if (ns < tsc_last_ns) {
+    ns = tsc_last_ns;
+  }
+  tsc_last_ns = ns;
+
+  return ns;
+}
+
+#endif
+
+
+static uint64_t
+monotonic_raw_now(void)
+{
+  uint64_t raw = clock_ns(CLOCK_MONOTONIC_RAW);
+
+  if (raw_anchor_ns == 0 || raw - raw_anchor_ns >= MONOTONIC_RAW_REANCHOR_NS) {
+    // re-anchor against the wall clock
+    raw_offset = clock_ns(CLOCK_REALTIME) - raw;
+    raw_anchor_ns = raw;
+  }
+
+  uint64_t ns = raw + raw_offset;
+
+  // never let a re-anchor step a thread's trace backwards
+  if (ns < raw_last_ns) {
+    ns = raw_last_ns;
+  }
+  raw_last_ns = ns;
+
+  return ns;
+}
+
+
+static void
+hpcrun_trace_clock_init(void)
+{
+  const char *clock_str = getenv(HPCRUN_TRACE_CLOCK);
+
+  trace_clock = TRACE_CLOCK_REALTIME;
+
+  if (clock_str == NULL || strcasecmp(clock_str, "REALTIME") == 0) {
+    // default
+  }
+  else if (strcasecmp(clock_str, "MONOTONIC_RAW") == 0) {
+    trace_clock = TRACE_CLOCK_MONOTONIC_RAW;
+  }
+  else if (strcasecmp(clock_str, "TSC") == 0) {
+#if defined(HOST_CPU_x86_64)
+    if (tsc_calibrate()) {
+      trace_clock = TRACE_CLOCK_TSC;
+    } else {
+      EMSG("%s=%s: no invariant TSC, using MONOTONIC_RAW",
+	   HPCRUN_TRACE_CLOCK, clock_str);
+      trace_clock = TRACE_CLOCK_MONOTONIC_RAW;
+    }
+#else
+    EMSG("%s=%s: TSC not supported on this platform, using MONOTONIC_RAW",
+	 HPCRUN_TRACE_CLOCK, clock_str);
+    trace_clock = TRACE_CLOCK_MONOTONIC_RAW;
+#endif
+  }
+  else {
+    EMSG("unknown trace clock in %s (%s), using REALTIME",
+	 HPCRUN_TRACE_CLOCK, clock_str);
+  }
+
+  TMSG(TRACE, "Trace clock = %d", trace_clock);
+}
+
+
+// return the current time in ns (CLOCK_REALTIME epoch) for a trace record
+static inline uint64_t
+hpcrun_trace_clock_now(void)
+{
+  switch (trace_clock) {
+  case TRACE_CLOCK_MONOTONIC_RAW:
+    return monotonic_raw_now();
+#if defined(HOST_CPU_x86_64)
+  case TRACE_CLOCK_TSC:
+    return tsc_now();
+#endif
+  default:
+    return clock_ns(CLOCK_REALTIME);
+  }
+}
+
+
 static void
 hpcrun_trace_file_validate(int valid, char *op)
 {
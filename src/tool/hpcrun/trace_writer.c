@@ -0,0 +1,520 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File: trace_writer.c
+//
+// Purpose:
+//   Asynchronous trace writer, see trace_writer.h.
+//
+//   Full buffers travel to the helper thread on the forward direction
+//   of each stream's bichannel and come back empty on the backward
+//   direction, so the sampling thread only does a lock-free push and
+//   pop.  The helper thread sleeps on a futex (sem_post is overridden
+//   for blame shifting and is not safe here) and also wakes up
+//   periodically.  Streams of finished threads are recycled, buffers
+//   and all, for new threads.
+//
+//***************************************************************************
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include <monitor.h>
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include "env.h"
+#include "hpcrun_stats.h"
+#include "thread_data.h"
+#include "trace_writer.h"
+
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+
+#include <lib/prof-lean/bichannel.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
+
+
+//***************************************************************************
+// macros
+//***************************************************************************
+
+// double buffering, unless HPCRUN_TRACE_ASYNC asks for more
+#define TRACE_WRITER_MIN_BUFFERS 2
+#define TRACE_WRITER_MAX_BUFFERS 64
+
+// the helper thread wakes up at least this often (seconds)
+#define TRACE_WRITER_WAKEUP_SECS 1
+
+// at close, wait this long for the helper to return a buffer (ms)
+#define TRACE_WRITER_CLOSE_WAIT_MS 5000
+
+#define FORWARD  bichannel_direction_forward
+#define BACKWARD bichannel_direction_backward
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+typedef struct trace_writer_block_t {
+  s_element_ptr_t next;
+  size_t size;                  // bytes in use when pushed forward
+  char data[];
+} trace_writer_block_t;
+
+
+typedef enum {
+  STREAM_FREE,                  // recycled, not touched by the helper
+  STREAM_OPEN,
+  STREAM_CLOSED                 // no more blocks will be pushed
+} stream_state_t;
+
+
+struct trace_writer_stream_t {
+  s_element_ptr_t next;         // list of all streams (never shrinks)
+  trace_writer_stream_t *next_free;
+
+  atomic_int state;
+  bichannel_t channel;          // forward: full blocks, backward: empty
+
+  int fd;
+  hpcio_outbuf_write_fn *write_fn;
+  void *write_arg;
+  size_t record_size;
+  bool failed;                  // a write failed, discard the rest
+  bool closing;                 // the owning thread is in the final flush
+
+  trace_writer_block_t **blocks;
+};
+
+
+//***************************************************************************
+// local variables
+//***************************************************************************
+
+static bool enabled = false;
+static int num_buffers = TRACE_WRITER_MIN_BUFFERS;
+
+static s_element_ptr_t streams;
+
+static spinlock_t free_lock = SPINLOCK_UNLOCKED;
+static trace_writer_stream_t *free_streams = NULL;
+
+static pthread_once_t writer_once;
+static pthread_t writer_thread;
+static bool writer_started = false;
+
+static atomic_bool writer_stop;
+static atomic_uint writer_wakeups;
+
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static void
+writer_wake(void)
+{
+  atomic_fetch_add(&writer_wakeups, 1);
+  syscall(SYS_futex, &writer_wakeups, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+
+static void
+writer_wait(unsigned int seen)
+{
+  struct timespec timeout = { TRACE_WRITER_WAKEUP_SECS, 0 };
+
+  // returns at once if a wakeup came after 'seen' was read
+  syscall(SYS_futex, &writer_wakeups, FUTEX_WAIT_PRIVATE, seen,
+	  &timeout, NULL, 0);
+}
+
+
+static void
+block_write(trace_writer_stream_t *s, trace_writer_block_t *b)
+{
+  size_t done = 0;
+
+  while (!s->failed && done < b->size) {
+    ssize_t ret;
+    if (s->write_fn != NULL) {
+      ret = s->write_fn(s->write_arg, b->data + done, b->size - done);
+    }
+    else {
+      ret = write(s->fd, b->data + done, b->size - done);
+    }
+
+    if (ret > 0) {
+      done += ret;
+    }
+    else if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    else {
+      // there is no thread to report to, so drop the rest of this
+      // stream rather than retry forever
+      EMSG("trace writer: write failed: %s", strerror(errno));
+      s->failed = true;
+    }
+  }
+}
+
+
+// write everything pushed so far.  Returns true if the stream is
+// finished (closed and drained) and has been recycled.
+static bool
+stream_drain(trace_writer_stream_t *s)
+{
+  // read the state before stealing: a close that comes later has its
+  // final block picked up by the next call
+  int state = atomic_load_explicit(&s->state, memory_order_acquire);
+  if (state == STREAM_FREE) {
+    return false;
+  }
+
+  bichannel_steal(&s->channel, FORWARD);
+  bichannel_reverse(&s->channel, FORWARD);
+
+  trace_writer_block_t *b;
+  while ((b = (trace_writer_block_t *)
+	  bichannel_pop(&s->channel, FORWARD)) != NULL) {
+    block_write(s, b);
+    bichannel_push(&s->channel, BACKWARD, (s_element_t *) b);
+  }
+
+  if (state != STREAM_CLOSED) {
+    return false;
+  }
+
+  if (s->fd >= 0) {
+    close(s->fd);
+    s->fd = -1;
+  }
+
+  atomic_store_explicit(&s->state, STREAM_FREE, memory_order_release);
+
+  spinlock_lock(&free_lock);
+  s->next_free = free_streams;
+  free_streams = s;
+  spinlock_unlock(&free_lock);
+
+  return true;
+}
+
+
+static void
+drain_all(void)
+{
+  trace_writer_stream_t *s = (trace_writer_stream_t *) cstack_ptr_get(&streams);
+  for (; s != NULL; s = (trace_writer_stream_t *) cstack_ptr_get(&s->next)) {
+    stream_drain(s);
+  }
+}
+
+
+static void *
+writer_main(void *arg)
+{
+  // samples are taken in the application's threads, not here
+  sigset_t mask;
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  for (;;) {
+    bool stop = atomic_load(&writer_stop);
+    unsigned int seen = atomic_load(&writer_wakeups);
+
+    drain_all();
+
+    if (stop) break;
+    writer_wait(seen);
+  }
+
+  return NULL;
+}
+
+
+static void
+writer_start(void)
+{
+  // the helper thread is not an application thread: keep libmonitor
+  // (and so hpcrun) out of it
+  monitor_disable_new_threads();
+  int ret = pthread_create(&writer_thread, NULL, writer_main, NULL);
+  monitor_enable_new_threads();
+
+  if (ret != 0) {
+    EEMSG("hpcrun: unable to start the trace writer thread: %s",
+	  strerror(ret));
+    return;
+  }
+  writer_started = true;
+}
+
+
+static trace_writer_stream_t *
+stream_alloc(void)
+{
+  spinlock_lock(&free_lock);
+  trace_writer_stream_t *s = free_streams;
+  if (s != NULL) {
+    free_streams = s->next_free;
+  }
+  spinlock_unlock(&free_lock);
+
+  if (s != NULL) {
+    return s;
+  }
+
+  s = hpcrun_malloc(sizeof(trace_writer_stream_t));
+  if (s == NULL) {
+    return NULL;
+  }
+  memset(s, 0, sizeof(*s));
+  atomic_init(&s->state, STREAM_FREE);
+
+  s->blocks = hpcrun_malloc(num_buffers * sizeof(trace_writer_block_t *));
+  if (s->blocks == NULL) {
+    return NULL;
+  }
+  for (int i = 0; i < num_buffers; i++) {
+    s->blocks[i] = hpcrun_malloc(sizeof(trace_writer_block_t)
+				 + HPCRUN_TraceBufferSz);
+    if (s->blocks[i] == NULL) {
+      return NULL;
+    }
+  }
+
+  cstack_push(&streams, (s_element_t *) s);
+
+  return s;
+}
+
+
+// wait (briefly) for the helper to return an empty block
+static trace_writer_block_t *
+stream_wait_empty(trace_writer_stream_t *s)
+{
+  struct timespec pause = { 0, 1000000 };
+
+  for (int ms = 0; ms < TRACE_WRITER_CLOSE_WAIT_MS; ms++) {
+    if (!writer_started || atomic_load(&writer_stop)) {
+      break;
+    }
+    writer_wake();
+    nanosleep(&pause, NULL);
+
+    bichannel_steal(&s->channel, BACKWARD);
+    trace_writer_block_t *b = (trace_writer_block_t *)
+      bichannel_pop(&s->channel, BACKWARD);
+    if (b != NULL) {
+      return b;
+    }
+  }
+
+  return NULL;
+}
+
+
+// hpcio_outbuf_swap_fn: runs in the sampling thread
+static void *
+stream_swap(void *arg, void *buf, size_t size)
+{
+  trace_writer_stream_t *s = (trace_writer_stream_t *) arg;
+  trace_writer_block_t *full = (trace_writer_block_t *)
+    ((char *) buf - offsetof(trace_writer_block_t, data));
+
+  trace_writer_block_t *empty = (trace_writer_block_t *)
+    bichannel_pop(&s->channel, BACKWARD);
+  if (empty == NULL) {
+    bichannel_steal(&s->channel, BACKWARD);
+    empty = (trace_writer_block_t *) bichannel_pop(&s->channel, BACKWARD);
+  }
+  if (empty == NULL && s->closing) {
+    // the final flush is not in a sample, so waiting costs nothing
+    empty = stream_wait_empty(s);
+  }
+  if (empty == NULL) {
+    // the helper is behind: never wait for it, drop these records
+    hpcrun_stats_trace_records_dropped_add(size / s->record_size);
+    return buf;
+  }
+
+  full->size = size;
+  bichannel_push(&s->channel, FORWARD, (s_element_t *) full);
+  writer_wake();
+
+  return empty->data;
+}
+
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+bool
+hpcrun_trace_writer_init(void)
+{
+  static const pthread_once_t once_init = PTHREAD_ONCE_INIT;
+
+  // forget the streams and helper thread of the parent after fork
+  cstack_ptr_set(&streams, NULL);
+  free_streams = NULL;
+  spinlock_unlock(&free_lock);
+  writer_once = once_init;
+  writer_started = false;
+  atomic_init(&writer_stop, false);
+  atomic_init(&writer_wakeups, 0);
+
+  const char *str = getenv(HPCRUN_TRACE_ASYNC);
+  enabled = (str != NULL && *str != '\0' && strcmp(str, "0") != 0);
+  if (enabled) {
+    int n = atoi(str);
+    num_buffers = (n < TRACE_WRITER_MIN_BUFFERS) ? TRACE_WRITER_MIN_BUFFERS
+      : (n > TRACE_WRITER_MAX_BUFFERS) ? TRACE_WRITER_MAX_BUFFERS : n;
+    TMSG(TRACE, "asynchronous trace writer, %d buffers per thread",
+	 num_buffers);
+  }
+
+  return enabled;
+}
+
+
+bool
+hpcrun_trace_writer_enabled(void)
+{
+  return enabled;
+}
+
+
+trace_writer_stream_t *
+hpcrun_trace_writer_open(hpcio_outbuf_t **outbuf, int fd,
+			 hpcio_outbuf_write_fn *write_fn, void *write_arg,
+			 size_t record_size)
+{
+  pthread_once(&writer_once, writer_start);
+  if (!writer_started) {
+    return NULL;
+  }
+
+  trace_writer_stream_t *s = stream_alloc();
+  if (s == NULL) {
+    return NULL;
+  }
+
+  s->fd = fd;
+  s->write_fn = write_fn;
+  s->write_arg = write_arg;
+  s->record_size = (record_size > 0) ? record_size : 1;
+  s->failed = false;
+  s->closing = false;
+
+  // block 0 goes to the outbuf, the others wait on the backward side
+  bichannel_init(&s->channel);
+  for (int i = 1; i < num_buffers; i++) {
+    bichannel_push(&s->channel, BACKWARD, (s_element_t *) s->blocks[i]);
+  }
+
+  if (hpcio_outbuf_attach_swap(outbuf, stream_swap, s, s->blocks[0]->data,
+			       HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED,
+			       hpcrun_malloc) != HPCFMT_OK) {
+    return NULL;
+  }
+
+  atomic_store_explicit(&s->state, STREAM_OPEN, memory_order_release);
+
+  return s;
+}
+
+
+int
+hpcrun_trace_writer_close(trace_writer_stream_t *stream,
+			  hpcio_outbuf_t **outbuf)
+{
+  // the flush in hpcio_outbuf_close() pushes the final block, and may
+  // wait for the helper rather than drop it
+  stream->closing = true;
+  int ret = hpcio_outbuf_close(outbuf);
+
+  atomic_store_explicit(&stream->state, STREAM_CLOSED, memory_order_release);
+  writer_wake();
+
+  return ret;
+}
+
+
+void
+hpcrun_trace_writer_fini(void)
+{
+  if (!writer_started) {
+    return;
+  }
+
+  atomic_store(&writer_stop, true);
+  writer_wake();
+  pthread_join(writer_thread, NULL);
+  writer_started = false;
+}
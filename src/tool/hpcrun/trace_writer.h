@@ -0,0 +1,115 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+//***************************************************************************
+// Description:
+//
+//   Optional asynchronous writer for trace buffers (HPCRUN_TRACE_ASYNC).
+//
+//   Each traced thread gets a stream with a few buffers of
+//   HPCRUN_TraceBufferSz bytes.  When the thread's outbuf fills, the
+//   full buffer is pushed (lock-free) to a per-process helper thread
+//   that does the write(), and the thread continues in an empty one.
+//   The sampling thread never waits for the file system: if the
+//   helper has not returned any buffer yet, the full buffer's records
+//   are discarded and counted in hpcrun_stats.  The final flush, at
+//   thread exit, waits a few seconds for a buffer instead.
+//
+//***************************************************************************
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include <lib/prof-lean/hpcio-buffer.h>
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+typedef struct trace_writer_stream_t trace_writer_stream_t;
+
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+// reset the writer for a new process (also after fork); returns true
+// if asynchronous trace writing is enabled
+bool hpcrun_trace_writer_init(void);
+
+bool hpcrun_trace_writer_enabled(void);
+
+// open a stream that writes to 'fd', or through 'write_fn' if it is
+// non-NULL, and attach 'outbuf' to it.  'record_size' is the size of
+// the trace records, for counting drops.  Returns NULL on failure.
+trace_writer_stream_t *
+hpcrun_trace_writer_open(hpcio_outbuf_t **outbuf, int fd,
+			 hpcio_outbuf_write_fn *write_fn, void *write_arg,
+			 size_t record_size);
+
+// close 'outbuf' in place of hpcio_outbuf_close(); its last buffer is
+// handed to the helper, waiting for it if needed.  The helper thread
+// writes what is queued, closes the fd (if any) and recycles the
+// stream.  Returns the hpcio_outbuf_close() result.
+int hpcrun_trace_writer_close(trace_writer_stream_t *stream,
+			      hpcio_outbuf_t **outbuf);
+
+// write everything queued and stop the helper thread
+void hpcrun_trace_writer_fini(void);
+
+#endif // TRACE_WRITER_H
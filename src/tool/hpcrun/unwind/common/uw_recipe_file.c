@@ -0,0 +1,632 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+/*
+ * Unwind recipe files: unwind recipes computed ahead of time for a
+ * load module (see uw_recipe_file.h).
+ *
+ * A file is named after the load module's base name and a hash of its
+ * size, mtime and unwinder, and holds
+ *
+ *   header        uw_recipe_file_hdr_t
+ *   functions     uw_recipe_file_fcn_t[num_fcns], one per fnbounds
+ *                 interval, sorted by start
+ *   intervals     num_intervals entries of 8 + record_size bytes: the
+ *                 interval's start and end offsets in its function and
+ *                 the unwinder's encoding of its recipe
+ *
+ * Function addresses are normalized as in the fnbounds table, so a file
+ * serves every process that maps the load module, wherever it is.
+ * Files are published with rename() and never change afterwards; a
+ * process maps a file read-only and never unmaps it, since other
+ * threads may be reading it in a signal handler.
+ */
+
+//******************************************************************************
+// system includes
+//******************************************************************************
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//******************************************************************************
+// local includes
+//******************************************************************************
+
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+#include <lib/prof-lean/mcs-lock.h>
+#include <lib/prof-lean/stdatomic.h>
+#include <lib/support-lean/OSUtil.h>
+
+#include "env.h"
+#include "handling_sample.h"
+#include "thread_data.h"
+#include "unwind-interval.h"
+#include "uw_recipe_file.h"
+
+//******************************************************************************
+// macros
+//******************************************************************************
+
+#define UW_RECIPE_FILE_MAGIC    "HPCUNWND"
+#define UW_RECIPE_FILE_VERSION  1
+#define UW_RECIPE_FILE_SFX      "hpcunwind"
+
+// entries buffered while writing a file
+#define FCN_BUF_LEN  1024
+#define IVL_BUF_SIZE (64 * 1024)
+
+//******************************************************************************
+// type
+//******************************************************************************
+
+typedef struct uw_recipe_file_hdr_s {
+  char     magic[8];
+  uint32_t version;
+  uint32_t unwinder;
+  uint32_t record_size;
+  uint32_t num_fcns;
+  uint64_t num_intervals;
+
+  // the load module and its fnbounds table when the file was written
+  uint64_t module_size;
+  int64_t  module_mtime;
+  uint64_t fnbounds_len;
+  uint64_t fnbounds_first;
+  uint64_t fnbounds_last;
+} uw_recipe_file_hdr_t;
+
+typedef struct uw_recipe_file_fcn_s {
+  uint64_t start;           // normalized
+  uint32_t len;
+  uint32_t num_intervals;   // 0 if it could not be analyzed
+  uint64_t first_interval;
+} uw_recipe_file_fcn_t;
+
+typedef struct uw_recipe_file_ivl_s {
+  uint32_t start;           // offsets in the function
+  uint32_t end;
+  char record[];
+} uw_recipe_file_ivl_t;
+
+// a load module mapping and its recipe file (hdr == NULL if it has none)
+typedef struct uw_recipe_file_s {
+  load_module_t *lm;
+  dso_info_t *dso;
+  unwinder_t uw;
+  const uw_recipe_file_hdr_t *hdr;
+  const uw_recipe_file_fcn_t *fcns;
+  const char *intervals;
+  size_t stride;
+  struct uw_recipe_file_s *next;
+} uw_recipe_file_t;
+
+//******************************************************************************
+// local data
+//******************************************************************************
+
+static const char *recipe_dir = NULL;       // use files here
+static const char *recipe_gen_dir = NULL;   // write files here
+
+// load modules looked up so far; added at the head under attach_lock,
+// read without it
+static _Atomic(uintptr_t) recipe_files;
+static mcs_lock_t attach_lock;
+
+//******************************************************************************
+// private operations
+//******************************************************************************
+
+static uint64_t
+hash_bytes(uint64_t hash, const void *buf, size_t len)
+{
+  const unsigned char *p = buf;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 0x100000001b3UL;
+  }
+  return hash;
+}
+
+
+// Append 'str' to 'path' at '*len'.  Returns: false if it does not fit.
+static bool
+path_append(char *path, size_t *len, const char *str)
+{
+  size_t n = strlen(str);
+  if (*len + n >= PATH_MAX) {
+    return false;
+  }
+  memcpy(path + *len, str, n + 1);
+  *len += n;
+  return true;
+}
+
+
+// Make the path of the recipe file for load module 'name' (whose file
+// is 'st') in 'dir', '<dir>/<base>-<hash>.hpcunwind'.  Built by hand,
+// not with snprintf(), as this runs in the signal handler.
+// Returns: false if it does not fit.
+static bool
+uw_recipe_file_path(const char *dir, const char *name, struct stat *st,
+		    unwinder_t uw, char *path)
+{
+  const char *base = strrchr(name, '/');
+  base = (base) ? base + 1 : name;
+
+  uint64_t hash = hash_bytes(0xcbf29ce484222325UL, base, strlen(base));
+  hash = hash_bytes(hash, &st->st_size, sizeof(st->st_size));
+  hash = hash_bytes(hash, &st->st_mtime, sizeof(st->st_mtime));
+  hash = hash_bytes(hash, &uw, sizeof(uw));
+
+  char hex[18];
+  hex[0] = '-';
+  for (int i = 0; i < 16; i++) {
+    hex[16 - i] = "0123456789abcdef"[(hash >> (4 * i)) & 0xf];
+  }
+  hex[17] = 0;
+
+  size_t len = 0;
+  path[0] = 0;
+  return path_append(path, &len, dir)
+    && path_append(path, &len, "/")
+    && path_append(path, &len, base)
+    && path_append(path, &len, hex)
+    && path_append(path, &len, "." UW_RECIPE_FILE_SFX);
+}
+
+
+// Returns: true if the recipe file header 'hdr' was written for this
+// load module, fnbounds table and unwinder.
+static bool
+uw_recipe_file_matches(const uw_recipe_file_hdr_t *hdr, dso_info_t *dso,
+		       struct stat *st, unwinder_t uw,
+		       const uw_recipe_codec_t *codec)
+{
+  return memcmp(hdr->magic, UW_RECIPE_FILE_MAGIC, sizeof(hdr->magic)) == 0
+    && hdr->version == UW_RECIPE_FILE_VERSION
+    && hdr->unwinder == uw
+    && hdr->record_size == codec->record_size
+    && hdr->module_size == (uint64_t) st->st_size
+    && hdr->module_mtime == (int64_t) st->st_mtime
+    && hdr->fnbounds_len == dso->nsymbols
+    && hdr->fnbounds_first == (uint64_t) (uintptr_t) dso->table[0]
+    && hdr->fnbounds_last ==
+         (uint64_t) (uintptr_t) dso->table[dso->nsymbols - 1];
+}
+
+
+// Map and check the recipe file of the load module mapping 'f'.
+static void
+uw_recipe_file_attach(uw_recipe_file_t *f, const uw_recipe_codec_t *codec)
+{
+  dso_info_t *dso = f->dso;
+  char path[PATH_MAX];
+  struct stat st, fst;
+
+  if (dso == NULL || dso->table == NULL || dso->nsymbols < 2
+      || stat(f->lm->name, &st) != 0 || !S_ISREG(st.st_mode)
+      || !uw_recipe_file_path(recipe_dir, f->lm->name, &st, f->uw, path)) {
+    return;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  if (fstat(fd, &fst) != 0 || fst.st_size < (off_t) sizeof(uw_recipe_file_hdr_t)) {
+    close(fd);
+    return;
+  }
+  void *addr = mmap(NULL, fst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return;
+  }
+
+  const uw_recipe_file_hdr_t *hdr = addr;
+  size_t stride = sizeof(uw_recipe_file_ivl_t) + codec->record_size;
+  size_t size = sizeof(*hdr) + hdr->num_fcns * sizeof(uw_recipe_file_fcn_t)
+    + hdr->num_intervals * stride;
+
+  if (!uw_recipe_file_matches(hdr, dso, &st, f->uw, codec)
+      || size != (size_t) fst.st_size) {
+    TMSG(UW_RECIPE_MAP, "recipe file %s does not match %s, not used",
+	 path, f->lm->name);
+    munmap(addr, fst.st_size);
+    return;
+  }
+
+  f->fcns = (const uw_recipe_file_fcn_t *) (hdr + 1);
+  f->intervals = (const char *) (f->fcns + hdr->num_fcns);
+  f->stride = stride;
+  f->hdr = hdr;
+
+  TMSG(UW_RECIPE_MAP, "recipe file %s: %u functions for %s",
+       path, hdr->num_fcns, f->lm->name);
+}
+
+
+// Returns: the recipe file entry for the current mapping of 'lm', or
+// NULL if it is not there yet and cannot be added now.
+static uw_recipe_file_t *
+uw_recipe_file_find(load_module_t *lm, unwinder_t uw,
+		    const uw_recipe_codec_t *codec)
+{
+  dso_info_t *dso = lm->dso_info;
+  uw_recipe_file_t *f;
+
+  for (f = (uw_recipe_file_t *)
+	 atomic_load_explicit(&recipe_files, memory_order_acquire);
+       f; f = f->next) {
+    if (f->lm == lm && f->dso == dso && f->uw == uw) return f;
+  }
+
+  // we may be in a signal handler: if another thread is adding a load
+  // module, don't wait, decode this function instead
+  mcs_node_t me;
+  if (!mcs_trylock(&attach_lock, &me)) {
+    return NULL;
+  }
+
+  uw_recipe_file_t *head = (uw_recipe_file_t *)
+    atomic_load_explicit(&recipe_files, memory_order_relaxed);
+  for (f = head; f; f = f->next) {
+    if (f->lm == lm && f->dso == dso && f->uw == uw) break;
+  }
+  if (f == NULL) {
+    f = hpcrun_malloc(sizeof(*f));
+    if (f) {
+      memset(f, 0, sizeof(*f));
+      f->lm = lm;
+      f->dso = dso;
+      f->uw = uw;
+      uw_recipe_file_attach(f, codec);
+      f->next = head;
+      atomic_store_explicit(&recipe_files, (uintptr_t) f,
+			    memory_order_release);
+    }
+  }
+
+  mcs_unlock(&attach_lock, &me);
+  return f;
+}
+
+
+// Decode the intervals of 'fcn' at 'start' into a list, as
+// build_intervals() returns them.  Returns: false if out of memory.
+static bool
+uw_recipe_file_decode(uw_recipe_file_t *f, const uw_recipe_file_fcn_t *fcn,
+		      uintptr_t start, const uw_recipe_codec_t *codec,
+		      btuwi_status_t *stat)
+{
+  bitree_uwi_t *first = NULL, *last = NULL;
+  const char *ivl = f->intervals + fcn->first_interval * f->stride;
+
+  for (uint32_t i = 0; i < fcn->num_intervals; i++, ivl += f->stride) {
+    const uw_recipe_file_ivl_t *rec = (const uw_recipe_file_ivl_t *) ivl;
+    bitree_uwi_t *u = bitree_uwi_malloc(f->uw, codec->recipe_size);
+    if (u == NULL) {
+      bitree_uwi_free(f->uw, first);
+      return false;
+    }
+    uwi_t *uwi = bitree_uwi_rootval(u);
+    uwi->interval.start = start + rec->start;
+    uwi->interval.end = start + rec->end;
+    codec->decode((uw_recipe_t *) uwi->recipe, rec->record);
+
+    if (last) bitree_uwi_set_rightsubtree(last, u);
+    else first = u;
+    last = u;
+  }
+
+  stat->first_undecoded_ins = (char *) (start + fcn->len);
+  stat->first = first;
+  stat->count = fcn->num_intervals;
+  stat->error = 0;
+  return true;
+}
+
+
+//------------------------------------------------------------------------------
+// writing recipe files
+//------------------------------------------------------------------------------
+
+// Build the intervals of [start, end), surviving a fault in the code
+// as uw_recipe_map_lookup() does.  This runs at exit, not in a sample,
+// so mark the thread as handling one: the segv handler only jumps back
+// from a fault inside a sample.  Returns: false after a fault.
+static bool
+uw_recipe_file_build(void *start, void *end, unwinder_t uw,
+		     btuwi_status_t *stat)
+{
+  thread_data_t *td = hpcrun_get_thread_data();
+  sigjmp_buf_t *oldjmp = td->current_jmp_buf;
+
+  hpcrun_set_handling_sample(td);
+  td->current_jmp_buf = &(td->bad_interval);
+
+  if (sigsetjmp(td->bad_interval.jb, 1) == 0) {
+    *stat = build_intervals(start, end - start, uw);
+    td->current_jmp_buf = oldjmp;
+    hpcrun_clear_handling_sample(td);
+    return true;
+  }
+
+  td->current_jmp_buf = oldjmp;
+  hpcrun_clear_handling_sample(td);
+  return false;
+}
+
+
+static bool
+write_at(int fd, const void *buf, size_t len, off_t pos)
+{
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t ret = pwrite(fd, p, len, pos);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += ret;  len -= ret;  pos += ret;
+  }
+  return true;
+}
+
+
+// Analyze every function of 'lm' and write them to fd.
+// Returns: false on a write error.
+static bool
+uw_recipe_file_write_fcns(int fd, load_module_t *lm, unwinder_t uw,
+			  const uw_recipe_codec_t *codec,
+			  uw_recipe_file_hdr_t *hdr)
+{
+  static uw_recipe_file_fcn_t fcn_buf[FCN_BUF_LEN];
+  static char ivl_buf[IVL_BUF_SIZE];
+
+  dso_info_t *dso = lm->dso_info;
+  uintptr_t dist = (dso->is_relocatable) ? dso->start_to_ref_dist : 0;
+  size_t stride = sizeof(uw_recipe_file_ivl_t) + codec->record_size;
+  uint32_t num_fcns = dso->nsymbols - 1;
+
+  off_t fcn_pos = sizeof(*hdr);
+  off_t ivl_pos = fcn_pos + num_fcns * sizeof(uw_recipe_file_fcn_t);
+  size_t nfcn = 0, nivl = 0;
+  uint64_t num_intervals = 0;
+
+  for (uint32_t i = 0; i < num_fcns; i++) {
+    uintptr_t start = (uintptr_t) dso->table[i];
+    uintptr_t end = (uintptr_t) dso->table[i + 1];
+    uw_recipe_file_fcn_t *fcn = &fcn_buf[nfcn++];
+
+    fcn->start = start;
+    fcn->len = (end - start <= UINT32_MAX) ? end - start : 0;
+    fcn->num_intervals = 0;
+    fcn->first_interval = num_intervals;
+
+    btuwi_status_t stat;
+    if (fcn->len > 0
+	&& uw_recipe_file_build((void *) (start + dist), (void *) (end + dist),
+				uw, &stat)) {
+      for (bitree_uwi_t *u = stat.first; u; u = UWI_NEXT(u)) {
+	if (nivl + stride > IVL_BUF_SIZE) {
+	  if (!write_at(fd, ivl_buf, nivl, ivl_pos)) return false;
+	  ivl_pos += nivl;
+	  nivl = 0;
+	}
+	uw_recipe_file_ivl_t *rec = (uw_recipe_file_ivl_t *) (ivl_buf + nivl);
+	rec->start = UWI_START_ADDR(u) - (start + dist);
+	rec->end = UWI_END_ADDR(u) - (start + dist);
+	codec->encode(rec->record, bitree_uwi_recipe(u));
+	nivl += stride;
+	fcn->num_intervals++;
+      }
+      num_intervals += fcn->num_intervals;
+      bitree_uwi_free(uw, stat.first);
+    }
+
+    if (nfcn == FCN_BUF_LEN || i + 1 == num_fcns) {
+      if (!write_at(fd, fcn_buf, nfcn * sizeof(*fcn), fcn_pos)) return false;
+      fcn_pos += nfcn * sizeof(*fcn);
+      nfcn = 0;
+    }
+  }
+  if (nivl > 0 && !write_at(fd, ivl_buf, nivl, ivl_pos)) return false;
+
+  hdr->num_fcns = num_fcns;
+  hdr->num_intervals = num_intervals;
+  return true;
+}
+
+
+// Write the recipe file of 'lm' to a private temporary file and then
+// rename() it into place, so readers never see a partial file.
+static void
+uw_recipe_file_write(load_module_t *lm, unwinder_t uw,
+		     const uw_recipe_codec_t *codec)
+{
+  dso_info_t *dso = lm->dso_info;
+  char path[PATH_MAX], tmp_path[PATH_MAX];
+  struct stat st;
+
+  if (dso == NULL || dso->table == NULL || dso->nsymbols < 2
+      || stat(lm->name, &st) != 0 || !S_ISREG(st.st_mode)
+      || !uw_recipe_file_path(recipe_gen_dir, lm->name, &st, uw, path)) {
+    return;
+  }
+  if (access(path, F_OK) == 0) {
+    TMSG(UW_RECIPE_MAP, "recipe file %s exists", path);
+    return;
+  }
+  // unique across the nodes sharing the directory
+  if (snprintf(tmp_path, PATH_MAX, "%s." HOSTID_FORMAT "-%d.tmp", path,
+	       OSUtil_hostid(), (int) getpid()) >= PATH_MAX) {
+    return;
+  }
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    EMSG("unable to write unwind recipe file %s", tmp_path);
+    return;
+  }
+
+  uw_recipe_file_hdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, UW_RECIPE_FILE_MAGIC, sizeof(hdr.magic));
+  hdr.version = UW_RECIPE_FILE_VERSION;
+  hdr.unwinder = uw;
+  hdr.record_size = codec->record_size;
+  hdr.module_size = st.st_size;
+  hdr.module_mtime = st.st_mtime;
+  hdr.fnbounds_len = dso->nsymbols;
+  hdr.fnbounds_first = (uintptr_t) dso->table[0];
+  hdr.fnbounds_last = (uintptr_t) dso->table[dso->nsymbols - 1];
+
+  bool ok = uw_recipe_file_write_fcns(fd, lm, uw, codec, &hdr)
+    && write_at(fd, &hdr, sizeof(hdr), 0);
+  ok = (close(fd) == 0) && ok;
+
+  if (!ok || rename(tmp_path, path) != 0) {
+    EMSG("unable to write unwind recipe file %s", path);
+    unlink(tmp_path);
+    return;
+  }
+  TMSG(UW_RECIPE_MAP, "recipe file %s: %u functions, %lu intervals for %s",
+       path, hdr.num_fcns, (unsigned long) hdr.num_intervals, lm->name);
+}
+
+
+// Returns: dir from environment variable 'var', created (one level)
+// if needed, or NULL if unset or unusable.
+static const char *
+uw_recipe_file_dir(const char *var, bool create)
+{
+  const char *dir = getenv(var);
+
+  if (dir == NULL || dir[0] == 0) {
+    return NULL;
+  }
+  if (create && mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    EMSG("unable to create unwind recipe directory %s", dir);
+    return NULL;
+  }
+  return dir;
+}
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+void
+uw_recipe_file_init(void)
+{
+  recipe_dir = uw_recipe_file_dir(HPCRUN_UNWIND_RECIPES, false);
+  recipe_gen_dir = uw_recipe_file_dir(HPCRUN_UNWIND_RECIPES_GEN, true);
+
+  // after fork, start over like the recipe map (mappings are inherited)
+  atomic_store_explicit(&recipe_files, 0, memory_order_relaxed);
+  mcs_init(&attach_lock);
+}
+
+
+bool
+uw_recipe_file_intervals(load_module_t *lm, void *fcn_start, void *fcn_end,
+			 unwinder_t uw, btuwi_status_t *stat)
+{
+  if (recipe_dir == NULL || lm == NULL) return false;
+
+  const uw_recipe_codec_t *codec = uw_recipe_codec(uw);
+  if (codec == NULL) return false;
+
+  uw_recipe_file_t *f = uw_recipe_file_find(lm, uw, codec);
+  if (f == NULL || f->hdr == NULL) return false;
+
+  uintptr_t start = (uintptr_t) fcn_start;
+  uintptr_t dist = (f->dso->is_relocatable) ? f->dso->start_to_ref_dist : 0;
+  uint64_t key = start - dist;
+
+  // binary search for the function starting at key
+  uint32_t lo = 0, hi = f->hdr->num_fcns;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (f->fcns[mid].start < key) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo == f->hdr->num_fcns) return false;
+
+  const uw_recipe_file_fcn_t *fcn = &f->fcns[lo];
+  if (fcn->start != key || fcn->len != (uintptr_t) fcn_end - start
+      || fcn->num_intervals == 0) {
+    return false;
+  }
+
+  return uw_recipe_file_decode(f, fcn, start, codec, stat);
+}
+
+
+void
+uw_recipe_file_fini(void)
+{
+  if (recipe_gen_dir == NULL) return;
+
+  for (unwinder_t uw = 0; uw < NUM_UNWINDERS; uw++) {
+    const uw_recipe_codec_t *codec = uw_recipe_codec(uw);
+    if (codec == NULL) continue;
+
+    for (load_module_t *lm = hpcrun_getLoadmap()->lm_head; lm; lm = lm->next) {
+      uw_recipe_file_write(lm, uw, codec);
+    }
+  }
+}
@@ -0,0 +1,116 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+/*
+ * Interface to unwind recipe files: unwind recipes computed ahead of
+ * time for every function of a load module, so that a lookup in the
+ * unwind recipe map can skip decoding the function.
+ *
+ * With HPCRUN_UNWIND_RECIPES_GEN=<dir>, hpcrun writes a file for each
+ * load module in the loadmap at the end of the run.  With
+ * HPCRUN_UNWIND_RECIPES=<dir>, hpcrun maps the file for a load module
+ * the first time it needs a recipe in it.  Functions are keyed by
+ * their bounds in the fnbounds table (the output of hpcfnbounds), so a
+ * file is used only if the load module and its table still match.
+ */
+
+#ifndef _UW_RECIPE_FILE_H_
+#define _UW_RECIPE_FILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "binarytree_uwi.h"
+#include <hpcrun/loadmap.h>
+
+//******************************************************************************
+// type
+//******************************************************************************
+
+// how an unwinder's recipe (the recipe part of a uwi_t) is stored in a
+// file: record_size bytes that must not depend on where the load
+// module or the interval tree are in memory.
+typedef struct uw_recipe_codec_s {
+  size_t recipe_size;
+  size_t record_size;   // a multiple of 4
+  void (*encode)(void *record, uw_recipe_t *recipe);
+  void (*decode)(uw_recipe_t *recipe, const void *record);
+} uw_recipe_codec_t;
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+/*
+ * Implemented by each architecture, like build_intervals().
+ * Returns NULL if recipes of unwinder uw cannot be stored in a file.
+ */
+const uw_recipe_codec_t *
+uw_recipe_codec(unwinder_t uw);
+
+
+void
+uw_recipe_file_init(void);
+
+
+/*
+ * If the recipe file of lm has the intervals of the function
+ * [fcn_start, fcn_end), build them as build_intervals() would and
+ * return true, else return false.
+ */
+bool
+uw_recipe_file_intervals(load_module_t *lm, void *fcn_start, void *fcn_end,
+			 unwinder_t uw, btuwi_status_t *stat);
+
+
+/*
+ * In generation mode, write the recipe file of each mapped load module
+ * that does not have one yet.
+ */
+void
+uw_recipe_file_fini(void);
+
+#endif  /* !_UW_RECIPE_FILE_H_ */
@@ -83,6 +83,7 @@
 #include "thread_data.h"
 #include "uw_hash.h"
 #include "uw_recipe_map.h"
+#include "uw_recipe_file.h"
 #include "unwind-interval.h"
 #include <fnbounds/fnbounds_interface.h>
 #include <lib/prof-lean/cskiplist.h>
@@ -618,6 +619,7 @@ uw_recipe_map_init(void)
 #endif
   mcs_init(&GFL_lock);
   bitree_uwi_init(my_alloc);
+  uw_recipe_file_init();
 
   TMSG(UW_RECIPE_MAP, "init address-to-recipe map");
   ilmstat_btuwi_pair_t* lsentinel =
@@ -745,7 +747,12 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
 
       int ljmp = sigsetjmp(td->bad_interval.jb, 1);
       if (ljmp == 0) {
-        btuwi_status_t btuwi_stat = build_intervals(fcn_start, fcn_end - fcn_start, uw);
+        // use the recipes computed ahead of time, if any; else decode
+        btuwi_status_t btuwi_stat;
+        if (!uw_recipe_file_intervals(ilm_btui->lm, fcn_start, fcn_end, uw,
+                                      &btuwi_stat)) {
+          btuwi_stat = build_intervals(fcn_start, fcn_end - fcn_start, uw);
+        }
         if (btuwi_stat.error != 0) {
           TMSG(UW_RECIPE_MAP, "build_intervals: fcn range %p to %p: error %d",
          fcn_start, fcn_end, btuwi_stat.error);
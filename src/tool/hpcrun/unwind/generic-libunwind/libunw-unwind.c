@@ -100,6 +100,7 @@
 #include <unwind/common/unw-datatypes.h>
 #include <unwind/common/unwind.h>
 #include <unwind/common/uw_recipe_map.h>
+#include <unwind/common/uw_recipe_file.h>
 #include <unwind/common/binarytree_uwi.h>
 #include <unwind/common/libunw_intervals.h>
 #include <utilities/arch/context-pc.h>
@@ -191,6 +192,13 @@ build_intervals(char  *ins, unsigned int len, unwinder_t uw)
   return libunw_build_intervals(ins, len);
 }
 
+// libunwind recipes are not stored in unwind recipe files
+const uw_recipe_codec_t *
+uw_recipe_codec(unwinder_t uw)
+{
+  return NULL;
+}
+
 void
 uw_recipe_tostr(void *uwr, char str[], unwinder_t uw)
 {
@@ -67,6 +67,7 @@
 #include "ppc64-unwind-interval.h"
 #include "hpcrun-malloc.h"
 #include "uw_recipe_map.h"
+#include "uw_recipe_file.h"
 #include "fnbounds_interface.h"
 #include <hpcrun/hpcrun_stats.h>
 #include <messages/messages.h>
@@ -105,6 +106,14 @@ build_intervals(char  *ins, unsigned int len, unwinder_t uw)
 }
 
 
+// ppc64 recipes are not stored in unwind recipe files
+const uw_recipe_codec_t *
+uw_recipe_codec(unwinder_t uw)
+{
+  return NULL;
+}
+
+
 //***************************************************************************
 // unwind_interval interface
 //***************************************************************************
@@ -52,6 +52,7 @@
 #include <memory/hpcrun-malloc.h>
 #include <hpcrun/hpcrun_stats.h>
 #include <hpcrun/unwind/common/libunw_intervals.h>
+#include <hpcrun/unwind/common/uw_recipe_file.h>
 
 #include <messages/messages.h>
 
@@ -253,6 +254,73 @@ uw_recipe_print(void* recipe)
 }
 
 
+/*************************************************************************************
+ * unwind recipe files
+ ************************************************************************************/
+
+// an x86recipe_t without prev_canonical, which matters only while the
+// intervals of a function are being built
+typedef struct x86recipe_record_s {
+  uint8_t ra_status;
+  uint8_t bp_status;
+  uint8_t has_tail_calls;
+  uint8_t pad;
+  int32_t sp_ra_pos;
+  int32_t sp_bp_pos;
+  int32_t bp_ra_pos;
+  int32_t bp_bp_pos;
+} x86recipe_record_t;
+
+static void
+x86recipe_encode(void *record, uw_recipe_t *recipe)
+{
+  x86recipe_t *xr = (x86recipe_t*)recipe;
+  x86recipe_record_t r = {
+    .ra_status = xr->ra_status,
+    .bp_status = xr->reg.bp_status,
+    .has_tail_calls = xr->has_tail_calls,
+    .sp_ra_pos = xr->reg.sp_ra_pos,
+    .sp_bp_pos = xr->reg.sp_bp_pos,
+    .bp_ra_pos = xr->reg.bp_ra_pos,
+    .bp_bp_pos = xr->reg.bp_bp_pos
+  };
+  memcpy(record, &r, sizeof(r));
+}
+
+static void
+x86recipe_decode(uw_recipe_t *recipe, const void *record)
+{
+  x86recipe_t *xr = (x86recipe_t*)recipe;
+  x86recipe_record_t r;
+  memcpy(&r, record, sizeof(r));
+
+  xr->ra_status = r.ra_status;
+  xr->reg.sp_ra_pos = r.sp_ra_pos;
+  xr->reg.sp_bp_pos = r.sp_bp_pos;
+  xr->reg.bp_status = r.bp_status;
+  xr->reg.bp_ra_pos = r.bp_ra_pos;
+  xr->reg.bp_bp_pos = r.bp_bp_pos;
+  xr->prev_canonical = NULL;
+  xr->has_tail_calls = r.has_tail_calls;
+
+  hpcrun_stats_num_unwind_intervals_total_inc();
+}
+
+static const uw_recipe_codec_t x86recipe_codec = {
+  .recipe_size = sizeof(x86recipe_t),
+  .record_size = sizeof(x86recipe_record_t),
+  .encode = x86recipe_encode,
+  .decode = x86recipe_decode
+};
+
+const uw_recipe_codec_t *
+uw_recipe_codec(unwinder_t uw)
+{
+  // DWARF_UNWINDER recipes hold libunwind state
+  return (uw == NATIVE_UNWINDER) ? &x86recipe_codec : NULL;
+}
+
+
 /*************************************************************************************
  * private operations 
  ************************************************************************************/
@@ -145,8 +145,17 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
   if (rank < 0) {
     rank = 0;
   }
-  int fd = hpcrun_open_profile_file(rank, cptd->id);
-  fs = fdopen(fd, "w");
+  if (hpcrun_files_use_container()) {
+    fs = hpcrun_open_profile_container(cptd->id);
+    if (fs == NULL) {
+      EMSG("unable to add profile %d to the container, writing a file",
+	   cptd->id);
+    }
+  }
+  if (fs == NULL) {
+    int fd = hpcrun_open_profile_file(rank, cptd->id);
+    fs = fdopen(fd, "w");
+  }
   if (fs == NULL) {
     EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
     return NULL;
@@ -249,6 +258,7 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
 
     epoch_flags.fields.isLogicalUnwind = hpcrun_isLogicalUnwind();
     TMSG(LUSH,"epoch lush flag set to %s", epoch_flags.fields.isLogicalUnwind ? "true" : "false");
+    epoch_flags.fields.isSparseMetrics = true;
     
     TMSG(DATA_WRITE,"epoch flags = %"PRIx64"", epoch_flags.bits);
     hpcrun_fmt_epochHdr_fwrite(fs, epoch_flags,
@@ -300,7 +310,7 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
     //
 
     cct_bundle_t* cct      = &(s->csdata);
-    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct, cptd->cct2metrics_map);
+    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct);
     if(ret != HPCRUN_OK) {
       TMSG(DATA_WRITE, "Error writing tree %#lx", cct);
       TMSG(DATA_WRITE, "Number of tree nodes lost: %ld", cct->num_nodes);
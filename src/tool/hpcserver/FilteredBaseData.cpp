@@ -63,6 +63,7 @@
 
 #include <assert.h>
 #include <iostream>
+#include <algorithm>
 
 
 #include "DebugUtils.hpp"
@@ -73,12 +74,17 @@ FilteredBaseData::FilteredBaseData(string filename, int _headerSize) {
 	baseDataFile = new BaseDataFile(filename, _headerSize);
 	headerSize = _headerSize;
 	baseOffsets = baseDataFile->getOffsets();
+	summaries.resize(baseDataFile->getNumberOfFiles(), NULL);
+	summaryLastUse.resize(baseDataFile->getNumberOfFiles(), 0);
+	viewCount = 0;
 	//Filters are default, which is allow everything, so this will initialize the vector
 	filter();
 
 }
 
 FilteredBaseData::~FilteredBaseData() {
+	for (unsigned int i = 0; i < summaries.size(); i++)
+		delete summaries[i];
 	delete baseDataFile;
 }
 
@@ -121,6 +127,51 @@ int FilteredBaseData::getInt(FileOffset position)
 	return baseDataFile->getMasterBuffer()->getInt(position);
 }
 
+//Each slot is only touched by the thread working on that rank (see
+//SpaceTimeDataController::fillTraces), and trimSummaries runs between
+//views, so no locking is needed.
+TraceSummary* FilteredBaseData::getSummary(int pseudoRank)
+{
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	summaryLastUse[rankMapping[pseudoRank]] = viewCount;
+	return summaries[rankMapping[pseudoRank]];
+}
+void FilteredBaseData::setSummary(int pseudoRank, TraceSummary* summary)
+{
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	delete summaries[rankMapping[pseudoRank]];
+	summaries[rankMapping[pseudoRank]] = summary;
+	summaryLastUse[rankMapping[pseudoRank]] = viewCount;
+}
+
+static bool compareLastUse(const std::pair<unsigned int, int>& a,
+		const std::pair<unsigned int, int>& b)
+{
+	return a.first < b.first;
+}
+
+void FilteredBaseData::trimSummaries()
+{
+	viewCount++;
+
+	vector<std::pair<unsigned int, int> > cached;
+	for (unsigned int i = 0; i < summaries.size(); i++)
+		if (summaries[i] != NULL)
+			cached.push_back(std::make_pair(summaryLastUse[i], (int) i));
+
+	if (cached.size() <= (unsigned int) TraceSummary::MAX_CACHED)
+		return;
+
+	int numEvict = cached.size() - TraceSummary::MAX_CACHED;
+	std::nth_element(cached.begin(), cached.begin() + numEvict, cached.end(),
+			compareLastUse);
+	for (int i = 0; i < numEvict; i++)
+	{
+		delete summaries[cached[i].second];
+		summaries[cached[i].second] = NULL;
+	}
+}
+
 int FilteredBaseData::getNumberOfRanks()
 {
 	return rankMapping.size();
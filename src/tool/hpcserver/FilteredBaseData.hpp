@@ -64,6 +64,7 @@
 #include "BaseDataFile.hpp"
 #include "FilterSet.hpp"
 #include "FileUtils.hpp"//For FileOffset
+#include "TraceSummary.hpp"
 
 #include <vector>
 #include <stdint.h>
@@ -85,6 +86,13 @@ namespace TraceviewerServer
 		int getNumberOfRanks();
 		int* getProcessIDs();
 		short* getThreadIDs();
+		//Summaries outlive filter changes, so they are kept by real rank.
+		//NULL until TraceDataByRank builds one.
+		TraceSummary* getSummary(int pseudoRank);
+		void setSummary(int pseudoRank, TraceSummary* summary);
+		//Starts a new view: frees the least recently used summaries beyond
+		//TraceSummary::MAX_CACHED. No thread may be using a summary.
+		void trimSummaries();
 	private:
 
 		void filter();
@@ -96,6 +104,10 @@ namespace TraceviewerServer
 		//pool to the real ranks from the filtered pool.
 		vector<int> rankMapping;
 		int headerSize;
+		vector<TraceSummary*> summaries;
+		//The view in which each summary was last used
+		vector<unsigned int> summaryLastUse;
+		unsigned int viewCount;
 	};
 
 
@@ -91,6 +91,9 @@ public:
 	 * must only be added with addNew() once. If it is removed from the list
 	 * with remove(), it must be added with reAdd(). It is not necessary to call
 	 * putOnTop() after adding an element as it will already be on top.
+	 *
+	 * There is no locking in here. When pages are read from several threads,
+	 * LargeByteBuffer makes sure only one thread at a time modifies the list.
 	 */
 	LRUList(int expectedMaxSize)//Up to linear time
 	{
@@ -113,6 +113,10 @@ namespace TraceviewerServer
 		numPages = FullPages + (PartialPageSize == 0 ? 0 : 1);
 		pageManagementList = new LRUList<VersatileMemoryPage>(numPages);
 
+		//The pages register their own address with pageManagementList, so
+		//construct them in place and never let the vector reallocate.
+		masterBuffer.reserve(numPages);
+
 		FileDescriptor fd = open(sPath.c_str(), O_RDONLY);
 
 		FileOffset sizeRemaining = fileSize;
@@ -121,31 +125,77 @@ namespace TraceviewerServer
 		{
 			FileOffset mapping_len = min( mmPageSize, sizeRemaining);
 
-			masterBuffer.push_back(VersatileMemoryPage(mmPageSize*i, mapping_len, fd, pageManagementList));
+			masterBuffer.emplace_back(mmPageSize*i, mapping_len, fd, pageManagementList);
 
 			sizeRemaining -= mapping_len;
 
 		}
 
+#ifdef ENABLE_OPENMP
+		numReaderLocks = omp_get_max_threads();
+		readerLocks = new ReaderLock[numReaderLocks];
+		for (int i = 0; i < numReaderLocks; i++)
+			omp_init_lock(&readerLocks[i].lock);
+#endif
 	}
 
 	int LargeByteBuffer::getInt(FileOffset pos)
 	{
-		int Page = pos / mmPageSize;
-		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
-		int val = ByteUtilities::readInt(p2D);
-		return val;
+		return read(pos, ByteUtilities::readInt);
 	}
 	Long LargeByteBuffer::getLong(FileOffset pos)
+	{
+		return read(pos, ByteUtilities::readLong);
+	}
+
+	//The value is decoded before the lock is released, since the page may
+	//be unmapped by another thread right after.
+	template <typename T>
+	T LargeByteBuffer::read(FileOffset pos, T (*decode)(char*))
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
+#ifdef ENABLE_OPENMP
+		if (omp_in_parallel())
+		{
+			int tid = omp_get_thread_num();
+			if (tid < numReaderLocks)
+			{
+				omp_set_lock(&readerLocks[tid].lock);
+				char* p2D = masterBuffer[Page].getIfMapped();
+				if (p2D != NULL)
+				{
+					T val = decode(p2D + loc);
+					omp_unset_lock(&readerLocks[tid].lock);
+					return val;
+				}
+				omp_unset_lock(&readerLocks[tid].lock);
+			}
+
+			lockAll();
+			T val = decode(masterBuffer[Page].get() + loc);
+			unlockAll();
+			return val;
+		}
+#endif
 		char* p2D = masterBuffer[Page].get() + loc;
-		Long val = ByteUtilities::readLong(p2D);
-		return val;
+		return decode(p2D);
+	}
 
+#ifdef ENABLE_OPENMP
+	//Always taken in the same order, so two threads mapping pages at once
+	//can't deadlock.
+	void LargeByteBuffer::lockAll()
+	{
+		for (int i = 0; i < numReaderLocks; i++)
+			omp_set_lock(&readerLocks[i].lock);
 	}
+	void LargeByteBuffer::unlockAll()
+	{
+		for (int i = numReaderLocks - 1; i >= 0; i--)
+			omp_unset_lock(&readerLocks[i].lock);
+	}
+#endif
 	//Could very well be a template, but we only use it for uint64_t
 	uint64_t LargeByteBuffer::lcm(uint64_t _a, uint64_t _b)
 	{
@@ -196,6 +246,11 @@ namespace TraceviewerServer
 	{
 		masterBuffer.clear();
 		delete pageManagementList;
+#ifdef ENABLE_OPENMP
+		for (int i = 0; i < numReaderLocks; i++)
+			omp_destroy_lock(&readerLocks[i].lock);
+		delete[] readerLocks;
+#endif
 
 	}
 }
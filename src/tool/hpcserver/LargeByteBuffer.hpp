@@ -60,6 +60,8 @@
 #ifndef LARGEBYTEBUFFER_H_
 #define LARGEBYTEBUFFER_H_
 
+#include <include/hpctoolkit-config.h>
+
 #include "VersatileMemoryPage.hpp"
 #include "ByteUtilities.hpp"
 #include "FileUtils.hpp" //For FileOffset
@@ -69,6 +71,10 @@
 #include <vector>
 #include <stdint.h>
 
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 namespace TraceviewerServer
 {
 
@@ -83,9 +89,24 @@ namespace TraceviewerServer
 	private:
 		static uint64_t lcm(uint64_t, uint64_t);
 		static uint64_t getRamSize();
+		template <typename T> T read(FileOffset, T (*)(char*));
 		vector<VersatileMemoryPage> masterBuffer;
 		int numPages;
 		LRUList<VersatileMemoryPage>* pageManagementList;
+#ifdef ENABLE_OPENMP
+		//Inside an OpenMP parallel region, each thread reads an already mapped
+		//page holding only its own lock. Mapping a page may unmap another one
+		//and reorders pageManagementList, so it holds all of them.
+		struct ReaderLock
+		{
+			omp_lock_t lock;
+			char pad[64];//keep each lock on its own cache line
+		};
+		void lockAll();
+		void unlockAll();
+		ReaderLock* readerLocks;
+		int numReaderLocks;
+#endif
 
 	};
 
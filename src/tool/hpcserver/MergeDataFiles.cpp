@@ -58,6 +58,8 @@
 //
 //***************************************************************************
 
+#include <include/hpctoolkit-config.h>
+
 #include "MergeDataFiles.hpp"
 #include "ByteUtilities.hpp"
 #include "Constants.hpp"
@@ -70,6 +72,19 @@
 #include <cstdlib>
 #include <cstdio>
 #include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/hpcrun-container.h>
 
 using namespace std;
 typedef int64_t Long;
@@ -78,9 +93,6 @@ namespace TraceviewerServer
 	MergeDataAttribute MergeDataFiles::merge(string directory, string globInputFile,
 			string outputFile)
 	{
-		 int lastDot = globInputFile.find_last_of('.');
-		 string suffix = globInputFile.substr(lastDot);
-
 		DEBUGCOUT(2) << "Checking to see if " << outputFile << " exists" << endl;
 
 
@@ -105,52 +117,47 @@ namespace TraceviewerServer
 			return FAIL_NO_DATA;
 		}
 
-		DataOutputFileStream dos(outputFile.c_str());
-
 		//-----------------------------------------------------
-		// 1. write the header:
-		//  int type (0: unknown, 1: mpi, 2: openmp, 3: hybrid, ...
-		//	int num_files
+		// 1. Find the trace files and, for each one, its
+		//  process ID, thread ID, size and offset in the merged
+		//  file. This also detects if the application is mp,
+		//  mt, or hybrid (no accelerator is supported).
+		//-----------------------------------------------------
+		//  Traces may be plain files or members of containers
+		//  (*.hpcpack); both are named <prog>-<proc>-<thread>-...
 		//-----------------------------------------------------
-
-		int type = 0;
-		dos.writeInt(type);
-
 		vector<string> allPaths = FileUtils::getAllFilesInDir(directory);
-		vector<string> filteredFileNames;
+		vector<string> filesToRemove;
+		vector<pair<string, TraceFile> > candidates;//(basic name, file)
 		vector<string>::iterator it;
 		for (it = allPaths.begin(); it != allPaths.end(); it++)
 		{
 			string val = *it;
-			if (val.find(".hpctrace") < string::npos)//This is hardcoded, which isn't great but will have to do because GlobInputFile is regex-style ("*.hpctrace")
-				filteredFileNames.push_back(val);
+			if (endsWith(val, string(".") + HPCRUN_ContainerFnmSfx))
+			{
+				if (addContainerMembers(val, candidates))
+					filesToRemove.push_back(val);
+			}
+			else if (val.find(".hpctrace") < string::npos)//This is hardcoded, which isn't great but will have to do because GlobInputFile is regex-style ("*.hpctrace")
+			{
+				TraceFile file;
+				file.name = val;
+				candidates.push_back(make_pair(val.substr(FileUtils::combinePaths(directory, "").length()), file));//This ensures we count the "/" at the end of the path
+				filesToRemove.push_back(val);
+			}
 		}
 		// on linux, we have to sort the files
 		//To sort them, we need a random access iterator, which means we need to load all of them into a vector
-		sort(filteredFileNames.begin(), filteredFileNames.end());
-
-		dos.writeInt(filteredFileNames.size());
-		const Long num_metric_header = 2 * SIZEOF_INT; // type of app (4 bytes) + num procs (4 bytes)
-		 Long num_metric_index = filteredFileNames.size()
-				* (SIZEOF_LONG + 2 * SIZEOF_INT);
-		FileOffset currentOffset = num_metric_header + num_metric_index;
+		sort(candidates.begin(), candidates.end(), compareFirst);
 
+		int type = 0;
+		vector<TraceFile> traceFiles;
 		int name_format = 0; // FIXME hack:some hpcprof revisions have different format name !!
-		//-----------------------------------------------------
-		// 2. Record the process ID, thread ID and the currentOffset
-		//   It will also detect if the application is mp, mt, or hybrid
-		//	 no accelator is supported
-		//  for all files:
-		//		int proc-id, int thread-id, long currentOffset
-		//-----------------------------------------------------
-		vector<string>::iterator it2;
-		for (it2 = filteredFileNames.begin(); it2 < filteredFileNames.end(); it2++)
+		vector<pair<string, TraceFile> >::iterator it2;
+		for (it2 = candidates.begin(); it2 < candidates.end(); it2++)
 		{
 
-			 string Filename = *it2;
-			 int last_pos_basic_name = Filename.length() - suffix.length();
-			 string Basic_name = Filename.substr(FileUtils::combinePaths(directory, "").length(),//This ensures we count the "/" at the end of the path
-					last_pos_basic_name);
+			 string Basic_name = it2->first;
 
 			vector<string> tokens = splitString(Basic_name, '-');
 
@@ -159,71 +166,240 @@ namespace TraceviewerServer
 			if (num_tokens < PROC_POS)
 				// if it is wrong file with the right extension, we skip
 				continue;
-			int proc;
+			TraceFile file = it2->second;
 			string Token_To_Parse = tokens[name_format + num_tokens - PROC_POS];
-			proc = atoi(Token_To_Parse.c_str());
-			if ((proc == 0) && (!FileUtils::stringActuallyZero(Token_To_Parse)))
+			file.proc = atoi(Token_To_Parse.c_str());
+			if ((file.proc == 0) && (!FileUtils::stringActuallyZero(Token_To_Parse)))
 			{
 				// old version of name format
 				name_format = 1;
 				string Token_To_Parse = tokens[name_format + num_tokens - PROC_POS];
-				proc = atoi(Token_To_Parse.c_str());
+				file.proc = atoi(Token_To_Parse.c_str());
 			}
-			dos.writeInt(proc);
-			if (proc != 0)
+			if (file.proc != 0)
 				type |= MULTI_PROCESSES;
-			 int Thread = atoi(tokens[name_format + num_tokens - THREAD_POS].c_str());
-			dos.writeInt(Thread);
-			if (Thread != 0)
+			file.thread = atoi(tokens[name_format + num_tokens - THREAD_POS].c_str());
+			if (file.thread != 0)
 				type |= MULTI_THREADING;
-			dos.writeLong(currentOffset);
-			currentOffset += FileUtils::getFileSize(Filename);
+			if (file.member.empty())
+				file.size = FileUtils::getFileSize(file.name);
+			traceFiles.push_back(file);
 		}
+
+		const Long num_metric_header = 2 * SIZEOF_INT; // type of app (4 bytes) + num procs (4 bytes)
+		 Long num_metric_index = traceFiles.size()
+				* (SIZEOF_LONG + 2 * SIZEOF_INT);
+		FileOffset currentOffset = num_metric_header + num_metric_index;
+		for (unsigned int i = 0; i < traceFiles.size(); i++)
+		{
+			traceFiles[i].offset = currentOffset;
+			currentOffset += traceFiles[i].size;
+		}
+
 		//-----------------------------------------------------
-		// 3. Copy all data from the multiple files into one file
+		// 2. write the header:
+		//  int type (0: unknown, 1: mpi, 2: openmp, 3: hybrid, ...
+		//	int num_files
+		//  for all files:
+		//		int proc-id, int thread-id, long offset
 		//-----------------------------------------------------
-		ProgressBar prog("Merging database", filteredFileNames.size());
-		for (it2 = filteredFileNames.begin(); it2 < filteredFileNames.end(); it2++)
+		int fd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
 		{
-			string i = *it2;
+			cerr << "Could not create " << outputFile << ": " << strerror(errno) << endl;
+			return STATUS_UNKNOWN;
+		}
 
-			ifstream dis(i.c_str(), ios_base::binary | ios_base::in);
-			char data[PAGE_SIZE_GUESS];
-			dis.read(data, PAGE_SIZE_GUESS);
-			int bytesRead = dis.gcount();
-			while (bytesRead > 0)
-			{
-				dos.write(data, bytesRead);
-				dis.read(data, PAGE_SIZE_GUESS);
-				bytesRead = dis.gcount();
-			}
-			dis.close();
-			prog.incrementProgress();
+		vector<char> header(num_metric_header + num_metric_index);
+		char* pos = &header[0];
+		ByteUtilities::writeInt(pos, type);
+		ByteUtilities::writeInt(pos + SIZEOF_INT, traceFiles.size());
+		pos += num_metric_header;
+		for (unsigned int i = 0; i < traceFiles.size(); i++)
+		{
+			ByteUtilities::writeInt(pos, traceFiles[i].proc);
+			ByteUtilities::writeInt(pos + SIZEOF_INT, traceFiles[i].thread);
+			ByteUtilities::writeLong(pos + 2 * SIZEOF_INT, traceFiles[i].offset);
+			pos += SIZEOF_LONG + 2 * SIZEOF_INT;
 		}
-		insertMarker(&dos);
-		dos.close();
+		bool ok = writeAt(fd, &header[0], header.size(), 0);
+
 		//-----------------------------------------------------
-		// 4. FIXME: write the type of the application
-		//  	the type of the application is computed in step 2
-		//		Ideally, this step has to be in the beginning !
+		// 3. Copy all data from the multiple files into one file.
+		//  Every file's place is known, so they are copied
+		//  independently, in parallel, and in the kernel when
+		//  it can (copy_file_range).
 		//-----------------------------------------------------
-		//While we don't actually want to do any input operations, adding the input flag prevents the file from being truncated to 0 bytes
-		DataOutputFileStream f(outputFile.c_str(), ios_base::in | ios_base::out | ios_base::binary);
-		f.writeInt(type);
-		f.close();
+		ProgressBar prog("Merging database", traceFiles.size());
+		int numFiles = traceFiles.size();
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(&&:ok)
+#endif
+		for (int i = 0; i < numFiles; i++)
+		{
+			ok = copyInto(fd, traceFiles[i]) && ok;
+#ifdef ENABLE_OPENMP
+#pragma omp critical
+#endif
+			prog.incrementProgress();
+		}
+
+		//The marker goes last, so a merged file that has it is complete
+		ok = ok && insertMarker(fd, currentOffset);
+		ok = (close(fd) == 0) && ok;
+		if (!ok)
+		{
+			cerr << "Could not merge the trace files into " << outputFile << endl;
+			remove(outputFile.c_str());
+			return STATUS_UNKNOWN;
+		}
 
 		//-----------------------------------------------------
 		// 5. remove old files
 		//-----------------------------------------------------
-		removeFiles(filteredFileNames);
+		removeFiles(filesToRemove);
 		return SUCCESS_MERGED;
 	}
 
 
 
-	void MergeDataFiles::insertMarker(DataOutputFileStream* dos)
+	bool MergeDataFiles::insertMarker(int fd, FileOffset offset)
+	{
+		char buffer[SIZEOF_LONG];
+		ByteUtilities::writeLong(buffer, MARKER_END_MERGED_FILE);
+		return writeAt(fd, buffer, SIZEOF_LONG, offset);
+	}
+	bool MergeDataFiles::writeAt(int fd, const char* buffer, size_t len, FileOffset offset)
+	{
+		while (len > 0)
+		{
+			ssize_t written = pwrite(fd, buffer, len, offset);
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+			{
+				cerr << "Write failed: " << strerror(errno) << endl;
+				return false;
+			}
+			buffer += written;
+			len -= written;
+			offset += written;
+		}
+		return true;
+	}
+	bool MergeDataFiles::compareFirst(const pair<string, TraceFile>& a,
+			const pair<string, TraceFile>& b)
 	{
-		dos->writeLong(MARKER_END_MERGED_FILE);
+		return a.first < b.first;
+	}
+	bool MergeDataFiles::endsWith(const string& str, const string& ending)
+	{
+		return str.length() >= ending.length()
+				&& str.compare(str.length() - ending.length(), ending.length(), ending) == 0;
+	}
+	//Adds the traces in the container at 'path' to 'files'. Returns false
+	//(and adds nothing) if it can't be read, e.g. it was never finished.
+	bool MergeDataFiles::addContainerMembers(const string& path,
+			vector<pair<string, TraceFile> >& files)
+	{
+		FILE* fs = hpcio_fopen_r(path.c_str());
+		if (!fs)
+		{
+			cerr << "Could not open " << path << ": " << strerror(errno) << endl;
+			return false;
+		}
+		hpcrun_container_index_t idx;
+		int ret = hpcrun_container_index_fread(&idx, fs, malloc);
+		hpcio_fclose(fs);
+		if (ret != HPCFMT_OK)
+		{
+			cerr << "Skipping incomplete or corrupt container " << path << endl;
+			hpcrun_container_index_free(&idx, free);
+			return false;
+		}
+
+		for (uint32_t i = 0; i < idx.num_members; i++)
+		{
+			const hpcrun_container_entry_t& e = idx.members[i];
+			if (!endsWith(e.name, ".hpctrace"))
+				continue;
+			TraceFile file;
+			file.name = path;
+			file.member = e.name;
+			file.size = e.size;
+			for (uint32_t j = 0; j < e.num_segments; j++)
+				file.segments.push_back(make_pair((FileOffset) e.segments[j].offset,
+						(FileOffset) e.segments[j].length));
+			files.push_back(make_pair(file.member, file));
+		}
+		hpcrun_container_index_free(&idx, free);
+		return true;
+	}
+	//Copies one trace file to its place in the merged file. A trace in a
+	//container is copied one segment at a time.
+	bool MergeDataFiles::copyInto(int outFd, const TraceFile& file)
+	{
+		int inFd = open(file.name.c_str(), O_RDONLY);
+		if (inFd < 0)
+		{
+			cerr << "Could not open " << file.name << ": " << strerror(errno) << endl;
+			return false;
+		}
+
+		bool ok = true;
+		if (file.member.empty())
+			ok = copyRange(inFd, 0, outFd, file.offset, file.size, file.name);
+		else
+		{
+			FileOffset outOff = file.offset;
+			for (unsigned int i = 0; ok && i < file.segments.size(); i++)
+			{
+				ok = copyRange(inFd, file.segments[i].first, outFd, outOff,
+						file.segments[i].second, file.name);
+				outOff += file.segments[i].second;
+			}
+		}
+		close(inFd);
+		return ok;
+	}
+	//copy_file_range lets the kernel (or the file system, e.g. by sharing
+	//extents) do the copy; where it isn't available we fall back to
+	//pread/pwrite.
+	bool MergeDataFiles::copyRange(int inFd, FileOffset inStart, int outFd,
+			FileOffset outStart, FileOffset len, const string& name)
+	{
+		FileOffset done = 0;
+#ifdef __NR_copy_file_range
+		while (done < len)
+		{
+			loff_t inOff = inStart + done;
+			loff_t outOff = outStart + done;
+			long copied = syscall(__NR_copy_file_range, inFd, &inOff, outFd, &outOff,
+					(size_t) (len - done), 0U);
+			if (copied < 0 && errno == EINTR)
+				continue;
+			if (copied <= 0)
+				break;//Not supported here, or the file shrank: try the slow way
+			done += copied;
+		}
+#endif
+		vector<char> buffer(done < len ? COPY_BUFFER_SIZE : 0);
+		while (done < len)
+		{
+			size_t want = min((FileOffset) COPY_BUFFER_SIZE, len - done);
+			ssize_t bytesRead = pread(inFd, &buffer[0], want, inStart + done);
+			if (bytesRead < 0 && errno == EINTR)
+				continue;
+			if (bytesRead <= 0)
+			{
+				cerr << "Could not read " << name << endl;
+				return false;
+			}
+			if (!writeAt(outFd, &buffer[0], bytesRead, outStart + done))
+				return false;
+			done += bytesRead;
+		}
+		return true;
 	}
 	bool MergeDataFiles::isMergedFileCorrect(string* filename)
 	{
@@ -262,14 +438,10 @@ namespace TraceviewerServer
 		{
 			string filename = *it;
 
-			unsigned int l = filename.length();
-			//if it ends with ".hpctrace", we are good.
+			//if it ends with ".hpctrace" (or is a container of them), we are good.
 			string ending = ".hpctrace";
-			if (l < ending.length())
-				continue;
-			string supposedext = filename.substr(l - ending.length());
-
-			if (ending == supposedext)
+			if (endsWith(filename, ending)
+					|| endsWith(filename, string(".") + HPCRUN_ContainerFnmSfx))
 			{
 				return true;
 			}
@@ -59,9 +59,10 @@
 #ifndef MERGEDATAFILES_H_
 #define MERGEDATAFILES_H_
 
-#include "DataOutputFileStream.hpp"
+#include "FileUtils.hpp" //FileOffset
 #include <vector>
 #include <string>
+#include <utility>
 #include <stdint.h>
 
 using namespace std;
@@ -80,11 +81,26 @@ namespace TraceviewerServer
 
 		static vector<string> splitString(string, char);
 	private:
+		struct TraceFile
+		{
+			string name;//the file, or the container holding it
+			string member;//name in the container (empty if a plain file)
+			vector<pair<FileOffset, FileOffset> > segments;//(offset, length) in the container
+			int proc, thread;
+			FileOffset size;
+			FileOffset offset;//where it goes in the merged file
+		};
 		static const uint64_t MARKER_END_MERGED_FILE = 0xFFFFFFFFDEADF00D;
-		static const int PAGE_SIZE_GUESS = 4096;
+		static const int COPY_BUFFER_SIZE = 1 << 20;
 		static const int PROC_POS = 5;
 		static const int THREAD_POS = 4;
-		static void insertMarker(DataOutputFileStream*);
+		static bool insertMarker(int, FileOffset);
+		static bool writeAt(int, const char*, size_t, FileOffset);
+		static bool copyInto(int, const TraceFile&);
+		static bool copyRange(int, FileOffset, int, FileOffset, FileOffset, const string&);
+		static bool addContainerMembers(const string&, vector<pair<string, TraceFile> >&);
+		static bool compareFirst(const pair<string, TraceFile>&, const pair<string, TraceFile>&);
+		static bool endsWith(const string&, const string&);
 		static bool isMergedFileCorrect(string*);
 		static bool removeFiles(vector<string>);
 		//This was in Util.java in a modified form but is more useful here
@@ -221,6 +221,7 @@ namespace TraceviewerServer
 
 		*controller->attributes = correspondingAttributes;
 
+		controller->trimSummaries();
 		ProcessTimeline* nextTrace = controller->getNextTrace();
 		int LinesSentCount = 0;
 		int waitcount = 0;
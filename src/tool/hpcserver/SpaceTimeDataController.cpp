@@ -56,9 +56,15 @@
 //   [The set of functions, macros, etc. defined in the file]
 //
 //***************************************************************************
+#include <include/hpctoolkit-config.h>
+
 #include "SpaceTimeDataController.hpp"
 #include "FileData.hpp"
 #include <iostream>
+
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
 using namespace std;
 namespace TraceviewerServer
 {
@@ -130,16 +136,31 @@ namespace TraceviewerServer
 		//Traces might be null. resetTraces will fix that.
 		resetTraces();
 
+		//Same as handing out lines with getNextTrace, but the lines are
+		//independent, so read them on all threads. The number of threads
+		//comes from OMP_NUM_THREADS. Ranks can differ a lot in size, so
+		//hand them out dynamically.
+		int firstLine = attributes->lineNum;
+		Time startingTime = minBegTime + attributes->begTime;
 
-		//Taken straight from TimelineThread
-		ProcessTimeline* nextTrace = getNextTrace();
-		while (nextTrace != NULL)
+		trimSummaries();
+
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int line = firstLine; line < tracesLength; line++)
 		{
+			ProcessTimeline* nextTrace = new ProcessTimeline(*attributes, line, dataTrace,
+					startingTime, headerSize);
 			nextTrace->readInData();
 			addNextTrace(nextTrace);
-
-			nextTrace = getNextTrace();
 		}
+		attributes->lineNum = max(firstLine, tracesLength);
+	}
+
+	void SpaceTimeDataController::trimSummaries()
+	{
+		dataTrace->trimSummaries();
 	}
 
 	 int* SpaceTimeDataController::getValuesXProcessID()
@@ -89,6 +89,8 @@ namespace TraceviewerServer
 		 short* getValuesXThreadID();
 
 		std::string getExperimentXML();
+		//Call before drawing a new view, not while lines are being read
+		void trimSummaries();
 		ImageTraceAttributes* attributes;
 		ProcessTimeline** traces;
 		int tracesLength;
@@ -112,8 +112,16 @@ namespace TraceviewerServer
 		{
 			// the data is too big: try to fit the "big" data into the display
 
+			// if a pixel spans at least one bucket of the rank's summary, draw
+			// from the summary instead of searching the file for every pixel
+			TraceSummary* summary = getSummary();
+			int level = (summary == NULL) ? -1 : summary->levelFor(pixelLength);
+
 			//fills in the rest of the data for this process timeline
-			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, 0, pixelLength, timeStart);
+			if (level >= 0)
+				sampleSummary(summary, level, pixelLength, timeStart);
+			else
+				sampleTimeLine(startLoc, endLoc, 0, numPixelsH, 0, pixelLength, timeStart);
 		}
 		// --------------------------------------------------------------------------------------------------
 		// get the last data if necessary: the rightmost time is still less then the upper limit
@@ -172,6 +180,52 @@ namespace TraceviewerServer
 	}
 
 
+	/*******************************************************************************************
+	 * Same samples as sampleTimeLine, one for each of pixels 1 to numPixelsH-1 in order,
+	 * but each one is the summary's record for the boundary nearest to the pixel's time.
+	 * That record is at most half a pixel away from the one sampleTimeLine would find.
+	 ******************************************************************************************/
+	void TraceDataByRank::sampleSummary(TraceSummary* summary, int level, double pixelLength,
+			Time startingTime)
+	{
+		for (int pixel = 1; pixel < numPixelsH; pixel++)
+		{
+			Time time = (long)(pixel * pixelLength + startingTime);
+			listCPID->push_back(summary->get(time, level));
+		}
+	}
+
+	/*******************************************************************************************
+	 * Returns this rank's summary, building it on first use. Each boundary is searched for
+	 * starting from the previous one, so building costs about as much as one fully
+	 * zoomed-out view of the rank. Returns NULL for ranks too small to need one.
+	 ******************************************************************************************/
+	TraceSummary* TraceDataByRank::getSummary()
+	{
+		TraceSummary* summary = data->getSummary(rank);
+		if (summary != NULL)
+			return summary;
+
+		Long numRec = 1 + getNumberOfRecords(minloc, maxloc);
+		if (numRec <= (1 << TraceSummary::MAX_DEPTH))
+			return NULL;
+
+		Time minTime = data->getLong(minloc);
+		Time maxTime = data->getLong(maxloc);
+		if (maxTime <= minTime)
+			return NULL;
+
+		summary = new TraceSummary(minTime, maxTime, TraceSummary::MAX_DEPTH);
+		FileOffset loc = minloc;
+		for (int k = 0; k < summary->numBoundaries(); k++)
+		{
+			loc = findTimeInInterval(summary->boundaryTime(k), loc, maxloc);
+			summary->add(getData(loc));
+		}
+		data->setSummary(rank, summary);
+		return summary;
+	}
+
 	/*********************************************************************************
 	 *	Returns the location in the traceFile of the trace data (time stamp and cpid)
 	 *	Precondition: the location of the trace data is between minLoc and maxLoc.
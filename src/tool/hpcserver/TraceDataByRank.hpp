@@ -64,6 +64,7 @@
 
 #include "TimeCPID.hpp"
 #include "FilteredBaseData.hpp"
+#include "TraceSummary.hpp"
 #include "FileUtils.hpp"//FileOffset
 
 namespace TraceviewerServer
@@ -78,6 +79,7 @@ namespace TraceviewerServer
 
 		void getData(Time timeStart, Time timeRange, double pixelLength);
 		int sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel, int endPixel, int minIndex, double pixelLength, Time startingTime);
+		void sampleSummary(TraceSummary* summary, int level, double pixelLength, Time startingTime);
 		FileOffset findTimeInInterval(Time time, FileOffset l_boundOffset, FileOffset r_boundOffset);
 
 
@@ -96,6 +98,7 @@ namespace TraceviewerServer
 		FileOffset getRelativeLocation(FileOffset);
 		void addSample(unsigned int, TimeCPID);
 		TimeCPID getData(FileOffset);
+		TraceSummary* getSummary();
 		Long getNumberOfRecords(FileOffset, FileOffset);
 		void postProcess();
 	};
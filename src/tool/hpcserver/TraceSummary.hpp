@@ -0,0 +1,143 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   A per-rank summary of a trace at power-of-two time resolutions.
+//
+// Description:
+//   The rank's time range is cut into 2^depth equal buckets. For each
+//   bucket boundary we keep the record findTimeInInterval picks for that
+//   time, so a view whose pixels are at least one bucket wide can be drawn
+//   from the summary without touching the trace file. Level l of the
+//   pyramid is every 2^(depth-l)-th boundary, so coarser views use fewer,
+//   stable boundaries and a pan does not change which records are drawn.
+//
+//***************************************************************************
+
+#ifndef TRACESUMMARY_HPP_
+#define TRACESUMMARY_HPP_
+
+#include <vector>
+
+#include "TimeCPID.hpp"
+
+namespace TraceviewerServer
+{
+	class TraceSummary
+	{
+	public:
+		//4097 boundaries, about 48KB a rank, is enough for views up to
+		//4096 pixels wide. Ranks with fewer records than that don't get one.
+		static const int MAX_DEPTH = 12;
+		//At most this many summaries (about 96MB) stay cached between
+		//views; the least recently drawn ranks lose theirs first.
+		static const int MAX_CACHED = 2048;
+
+		TraceSummary(Time _minTime, Time _maxTime, int _depth)
+		{
+			minTime = _minTime;
+			maxTime = _maxTime;
+			depth = _depth;
+			times.reserve(numBoundaries());
+			cpids.reserve(numBoundaries());
+		}
+
+		int numBoundaries()
+		{
+			return (1 << depth) + 1;
+		}
+		//The time of boundary k at the finest level
+		Time boundaryTime(int k)
+		{
+			return minTime + (Time) (k * ((maxTime - minTime) / (double) (1 << depth)));
+		}
+		//Boundaries must be added in order, 0 to numBoundaries()-1
+		void add(TimeCPID record)
+		{
+			times.push_back(record.timestamp);
+			cpids.push_back(record.cpid);
+		}
+
+		//The coarsest level whose buckets are no wider than a pixel,
+		//or -1 if even the finest one is too coarse for this view.
+		int levelFor(double pixelLength)
+		{
+			double width = maxTime - minTime;
+			for (int level = 0; level <= depth; level++, width /= 2)
+			{
+				if (width <= pixelLength)
+					return level;
+			}
+			return -1;
+		}
+		//The record at the boundary of 'level' nearest to 'time'
+		TimeCPID get(Time time, int level)
+		{
+			int buckets = 1 << level;
+			int k = 0;
+			if (time >= maxTime)
+				k = buckets;
+			else if (time > minTime)
+				k = (int) ((time - minTime) * (double) buckets / (maxTime - minTime) + 0.5);
+			k <<= (depth - level);
+			return TimeCPID(times[k], cpids[k]);
+		}
+
+	private:
+		Time minTime, maxTime;
+		int depth;
+		//Kept apart so a boundary costs 12 bytes, not sizeof(TimeCPID)
+		std::vector<Time> times;
+		std::vector<int> cpids;
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* TRACESUMMARY_HPP_ */
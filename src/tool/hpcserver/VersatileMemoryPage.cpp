@@ -80,6 +80,7 @@ namespace TraceviewerServer
 		index = mostRecentlyUsed->addNewUnused(this);
 		file = _file;
 		isMapped = false;
+		referenced = false;
 		if (MAX_PAGES_TO_ALLOCATE_AT_ONCE <1)
 			cerr<<"Set max pages before creating any VersatileMemoryPages"<<endl;
 	}
@@ -106,6 +107,20 @@ namespace TraceviewerServer
 		return page;
 	}
 
+	//Unlike get(), this does not touch the LRU list, so several threads may
+	//call it at once as long as none of them can unmap pages meanwhile (see
+	//LargeByteBuffer). Returns NULL if the page has to be mapped first.
+	char* VersatileMemoryPage::getIfMapped()
+	{
+		if (!isMapped)
+			return NULL;
+
+		if (!__atomic_load_n(&referenced, __ATOMIC_RELAXED))
+			__atomic_store_n(&referenced, true, __ATOMIC_RELAXED);
+
+		return page;
+	}
+
 	void VersatileMemoryPage::mapPage()
 	{
 
@@ -121,6 +136,16 @@ namespace TraceviewerServer
 
 			VersatileMemoryPage* toRemove = mostRecentlyUsed->getLast();
 
+			//Pages read through getIfMapped since they were last looked at
+			//aren't really least recently used; move them to the front.
+			//Each pass clears a flag, so this ends within getUsedPageCount() steps.
+			while (toRemove->referenced)
+			{
+				toRemove->referenced = false;
+				mostRecentlyUsed->putOnTop(toRemove->index);
+				toRemove = mostRecentlyUsed->getLast();
+			}
+
 			DEBUGCOUT(1)<<"Kicking " << toRemove->index << " out"<<endl;
 
 			if (toRemove->isMapped != true)
@@ -141,6 +166,7 @@ namespace TraceviewerServer
 
 
 		isMapped = true;
+		referenced = false;
 		mostRecentlyUsed->reAdd(index);
 	}
 	void VersatileMemoryPage::unmapPage()
@@ -77,6 +77,7 @@ namespace TraceviewerServer
 		virtual ~VersatileMemoryPage();
 		static void setMaxPages(int);
 		char* get();
+		char* getIfMapped();
 	private:
 		void mapPage();
 		void unmapPage();
@@ -88,6 +89,9 @@ namespace TraceviewerServer
 		FileDescriptor file;
 
 		bool isMapped;
+		//Set by getIfMapped, which may run concurrently and so can't reorder
+		//the LRU list itself. Cleared when mapPage gives the page a second chance.
+		bool referenced;
 		LRUList<VersatileMemoryPage>* mostRecentlyUsed;
 
 		// Use MAP_POPULATE if available
@@ -63,6 +63,8 @@
 using std::cerr;
 using std::endl;
 
+#include <stdlib.h>
+
 #include <string>
 using std::string;
 
@@ -148,6 +150,11 @@ Options: Output files\n\
   -o <file>, --output <file>\n\
                        Write hpcstruct file to <file>.\n\
                        Use '--output=-' to write output to stdout.\n\
+  --cache <dir>        Reuse and save results in the structure cache <dir>.\n\
+                       Entries are keyed by a hash of the binary's contents\n\
+                       and of the options above, so <dir> may be shared by\n\
+                       all users of a system.  Defaults to the value of\n\
+                       HPCTOOLKIT_HPCSTRUCT_CACHE, if set.\n\
 ";
 
 #define CLP CmdLineParser
@@ -172,6 +179,8 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
   // Output options
   { 'o', "output",          CLP::ARG_REQ , CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "cache",           CLP::ARG_REQ , CLP::DUPOPT_CLOB, NULL,
+     NULL },
 
   // General
   { 'v', "verbose",     CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,
@@ -335,7 +344,8 @@ Args::parse(int argc, const char* const argv[])
     }
     if (parser.isOpt("replace-path")) {
       string arg = parser.getOptArg("replace-path");
-      
+      replacePathStr = arg;
+
       std::vector<std::string> replacePaths;
       StrUtil::tokenize_str(arg, CLP_SEPARATOR, replacePaths);
       
@@ -360,6 +370,15 @@ Args::parse(int argc, const char* const argv[])
     if (parser.isOpt("output")) {
       out_filenm = parser.getOptArg("output");
     }
+    if (parser.isOpt("cache")) {
+      cacheDir = parser.getOptArg("cache");
+    }
+    else {
+      const char* env = getenv("HPCTOOLKIT_HPCSTRUCT_CACHE");
+      if (env != NULL) {
+	cacheDir = env;
+      }
+    }
 
     // Check for required arguments
     if (parser.getNumArgs() != 1) {
@@ -117,7 +117,9 @@ public:
 
   // Parsed Data: optional arguments
   std::string searchPathStr;          // default: "."
+  std::string replacePathStr;         // raw --replace-path arguments
   std::string dbgProcGlob;
+  std::string cacheDir;               // default: $HPCTOOLKIT_HPCSTRUCT_CACHE
 
   bool prettyPrintOutput;         // default: true
   bool useBinutils;		  // default: false
@@ -55,14 +55,18 @@
 //****************************** Include Files ******************************
 
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <iostream>
 using std::cerr;
 using std::endl;
 
 #include <dlfcn.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fstream>
@@ -73,8 +77,6 @@ using std::endl;
 
 #include <include/hpctoolkit-config.h>
 
-#include <include/hpctoolkit-config.h>
-
 #include "Args.hpp"
 
 #include <lib/banal/Struct.hpp>
@@ -84,6 +86,11 @@ using std::endl;
 #include <lib/support/FileUtil.hpp>
 #include <lib/support/IOUtil.hpp>
 #include <lib/support/RealPathMgr.hpp>
+#include <lib/xml/xml.hpp>
+
+extern "C" {
+#include <lib/prof-lean/crypto-hash.h>
+}
 
 #ifdef ENABLE_OPENMP
 #include <omp.h>
@@ -98,6 +105,196 @@ static int
 realmain(int argc, char* argv[]);
 
 
+//***************************** Structure Cache *****************************
+
+//
+// A cache entry is the hpcstruct file for one binary, stored under
+//
+//   <cache>/<xx>/<content-hash>-<options-hash>.hpcstruct
+//
+// where <content-hash> is the MD5 of the binary's bytes and <xx> its
+// first two hex digits.  <options-hash> covers everything else that
+// changes the output: the hpcstruct version, the binary's basename
+// (used in the names of unknown files and procs), and the structure
+// recovery options.  The only place the binary's path appears in the
+// output is the <LM> tag, which is rewritten on the way out.
+//
+// Entries are immutable and written with tmp file + rename, so any
+// number of hpcstruct processes (and users) may share one cache.
+//
+
+static string
+hashString(const unsigned char* buf, size_t len)
+{
+  unsigned char hash[HASH_LENGTH];
+  char hex[2 * HASH_LENGTH + 1];
+
+  if (crypto_hash_compute(buf, len, hash, HASH_LENGTH) != 0
+      || crypto_hash_to_hexstring(hash, hex, sizeof(hex)) != 0) {
+    return "";
+  }
+  return string(hex);
+}
+
+
+// Returns the MD5 of the contents of 'fnm', or "" on failure.
+static string
+hashFile(const string & fnm)
+{
+  int fd = open(fnm.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return "";
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || ! S_ISREG(sb.st_mode) || sb.st_size == 0) {
+    close(fd);
+    return "";
+  }
+
+  void* buf = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (buf == MAP_FAILED) {
+    return "";
+  }
+
+  string ans = hashString((const unsigned char*) buf, sb.st_size);
+  munmap(buf, sb.st_size);
+  return ans;
+}
+
+
+// Make 'dir' if needed.  If 'parent' is non-null, give 'dir' the same
+// permissions as 'parent', so that a cache root created group-writable
+// (or 1777) stays usable by everyone regardless of the umask of
+// whoever adds a subdirectory.
+static bool
+makeCacheDir(const string & dir, const char* parent)
+{
+  struct stat sb;
+  if (stat(dir.c_str(), &sb) == 0) {
+    return S_ISDIR(sb.st_mode);
+  }
+  if (parent != NULL && stat(parent, &sb) != 0) {
+    return false;
+  }
+  if (mkdir(dir.c_str(), 0777) != 0) {
+    return errno == EEXIST;
+  }
+  if (parent != NULL) {
+    chmod(dir.c_str(), sb.st_mode & 07777);
+  }
+  return true;
+}
+
+
+// Returns the full path of the cache entry for 'args', or "" if the
+// binary can not be hashed.
+static string
+cacheEntryName(const Args & args)
+{
+  string content = hashFile(args.in_filenm);
+  if (content.empty()) {
+    return "";
+  }
+
+  string key = string(HPCTOOLKIT_VERSION_STRING) + "\n"
+    + FileUtil::basename(args.in_filenm) + "\n"
+    + (args.compute_gpu_cfg ? "gpucfg" : "") + "\n"
+    + args.searchPathStr + "\n"
+    + args.replacePathStr + "\n";
+
+  string options = hashString((const unsigned char*) key.c_str(), key.length());
+  if (options.empty()) {
+    return "";
+  }
+
+  return args.cacheDir + "/" + content.substr(0, 2) + "/"
+    + content + "-" + options + ".hpcstruct";
+}
+
+
+// Copy the cache entry 'entry' to 'out_filenm', replacing the <LM>
+// name with 'lm_name'.  Returns true on a hit.
+static bool
+cacheLookup(const string & entry, const string & lm_name,
+	    const string & out_filenm)
+{
+  ifstream in(entry.c_str());
+  if (! in.is_open()) {
+    return false;
+  }
+
+  ofstream out(out_filenm.c_str(), ofstream::out | ofstream::trunc);
+  if (! out.is_open()) {
+    return false;
+  }
+
+  // The <LM> tag is within the first few lines, after the DTD.
+  // EscapeStr never leaves a bare '"' in an attribute value.
+  string line;
+  bool found = false;
+  while (! found && getline(in, line)) {
+    if (line.compare(0, 3, "<LM") == 0) {
+      size_t beg = line.find(" n=\"");
+      size_t end = (beg == string::npos) ? beg : line.find('"', beg + 4);
+      if (end != string::npos) {
+	line.replace(beg + 4, end - beg - 4, xml::EscapeStr(lm_name));
+      }
+      found = true;
+    }
+    out << line << "\n";
+  }
+  if (! found) {
+    return false;
+  }
+
+  out << in.rdbuf();
+  out.close();
+  return ! out.fail();
+}
+
+
+// Add the freshly written 'out_filenm' to the cache as 'entry'.
+// Failures are not errors; the cache is only an optimization.
+static void
+cacheInsert(const string & out_filenm, const string & cache_dir,
+	    const string & entry)
+{
+  string subdir = entry.substr(0, entry.rfind('/'));
+
+  if (! makeCacheDir(cache_dir, NULL)
+      || ! makeCacheDir(subdir, cache_dir.c_str())) {
+    DIAG_Msg(1, "unable to create structure cache directory: " << subdir);
+    return;
+  }
+
+  ifstream in(out_filenm.c_str());
+  if (! in.is_open() || in.peek() == ifstream::traits_type::eof()) {
+    return;
+  }
+
+  // the cache may be on a shared file system, so pid alone is not unique
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+  string tmp = entry + ".tmp." + host + "." + to_string(getpid());
+  ofstream out(tmp.c_str(), ofstream::out | ofstream::trunc);
+  if (! out.is_open()) {
+    DIAG_Msg(1, "unable to write structure cache entry: " << tmp);
+    return;
+  }
+
+  out << in.rdbuf();
+  out.close();
+
+  // entries are never modified in place, so read-only for all is enough
+  if (out.fail() || chmod(tmp.c_str(), 0444) != 0
+      || rename(tmp.c_str(), entry.c_str()) != 0) {
+    unlink(tmp.c_str());
+  }
+}
+
+
 //***************************** Analyze Cubins ******************************
 
 static const char* cubins_analysis_makefile =
@@ -109,7 +306,8 @@ static const char* cubins_analysis_makefile =
 // for each .cubin file.
 //
 static void
-doMeasurementsDir(string measurements_dir, BAnal::Struct::Options & opts)
+doMeasurementsDir(string measurements_dir, BAnal::Struct::Options & opts,
+		  string cache_dir)
 {
   measurements_dir = RealPath(measurements_dir.c_str());
 
@@ -171,9 +369,19 @@ doMeasurementsDir(string measurements_dir, BAnal::Struct::Options & opts)
 
   string gpucfg = opts.compute_gpu_cfg ? "yes" : "no";
 
+  // make runs in structs_dir, so a relative cache must be anchored here
+  string cache_opt = "";
+  if (! cache_dir.empty()) {
+    if (cache_dir[0] != '/') {
+      cache_dir = string(RealPath(".")) + "/" + cache_dir;
+    }
+    cache_opt = "--cache " + cache_dir;
+  }
+
   makefile << "CUBINS_DIR =  " << cubins_dir << "\n"
 	   << "STRUCTS_DIR = " << structs_dir << "\n"
-	   << "CUBIN_CFG = " << gpucfg << "\n\n"
+	   << "CUBIN_CFG = " << gpucfg << "\n"
+	   << "CACHE_OPT = " << cache_opt << "\n\n"
 	   << cubins_analysis_makefile << endl;
   makefile.close();
 
@@ -261,7 +469,7 @@ realmain(int argc, char* argv[])
   struct stat sb;
 
   if (stat(args.in_filenm.c_str(), &sb) == 0 && S_ISDIR(sb.st_mode)) {
-    doMeasurementsDir(args.in_filenm, opts);
+    doMeasurementsDir(args.in_filenm, opts, args.cacheDir);
     return 0;
   }
 
@@ -270,6 +478,19 @@ realmain(int argc, char* argv[])
   // ------------------------------------------------------------
 
   const char* osnm = (args.out_filenm == "-") ? NULL : args.out_filenm.c_str();
+
+  // The cache only holds plain hpcstruct files, so skip it for stdout
+  // and for the (experimental) gaps file.
+  string cacheEntry = "";
+  if (! args.cacheDir.empty() && osnm != NULL && ! args.show_gaps) {
+    cacheEntry = cacheEntryName(args);
+    if (! cacheEntry.empty()
+	&& cacheLookup(cacheEntry, args.in_filenm, args.out_filenm)) {
+      DIAG_Msg(1, "using cached structure: " << cacheEntry);
+      return (0);
+    }
+  }
+
   std::ostream* outFile = IOUtil::OpenOStream(osnm);
   char* outBuf = new char[HPCIO_RWBufferSz];
 
@@ -301,6 +522,10 @@ realmain(int argc, char* argv[])
   IOUtil::CloseStream(outFile);
   delete[] outBuf;
 
+  if (! cacheEntry.empty()) {
+    cacheInsert(args.out_filenm, args.cacheDir, cacheEntry);
+  }
+
   if (gapsFile != NULL) {
     IOUtil::CloseStream(gapsFile);
     delete[] gapsBuf;